@@ -149,6 +149,15 @@ function secondsToDuration(s) {
 
 // *******************************************************************************
 
+// aggregated data, only used during initial loading
+let bootstrapData = null;
+
+async function apiGetBootstrapJson() {
+    return await getUrlJson('/ofp-api/v1/bootstrap');
+}
+
+// *******************************************************************************
+
 async function apiGetStatusJson() {
     return await getUrlJson('/ofp-api/v1/status');
 }
@@ -201,10 +210,12 @@ async function changeZoneOverrides(override) {
 
 async function apiGetOrderTypesJson() {
     // TODO: reorder
+    if (bootstrapData !== null) return { orders: bootstrapData.orders };
     return await getUrlJson('/ofp-api/v1/orders');
 }
 
 async function apiGetZoneOverrideJson() {
+    if (bootstrapData !== null) return { override: bootstrapData.override };
     return await getUrlJson('/ofp-api/v1/override');
 }
 
@@ -268,6 +279,7 @@ async function changeZoneValue(zoneId, value) {
 }
 
 async function apiGetZonesJson() {
+    if (bootstrapData !== null) return { zones: bootstrapData.zones };
     return await getUrlJson('/ofp-api/v1/zones');
 }
 
@@ -343,6 +355,7 @@ async function loadZoneConfiguration() {
 // *******************************************************************************
 
 async function apiGetPlanningListJson() {
+    if (bootstrapData !== null) return { plannings: bootstrapData.plannings };
     return await getUrlJson('/ofp-api/v1/plannings');
 }
 
@@ -433,6 +446,10 @@ async function loadPlanningList() {
 // *******************************************************************************
 
 async function apiGetPlanningSlotsJson(planningId) {
+    if (bootstrapData !== null) {
+        let planning = bootstrapData.plannings.find(p => p.id === +planningId);
+        if (planning !== undefined) return { slots: planning.slots };
+    }
     return await getUrlJson(`/ofp-api/v1/plannings/${planningId}`);
 }
 
@@ -695,6 +712,7 @@ async function loadAccounts() {
 }
 
 async function apiGetAccountsJson() {
+    if (bootstrapData !== null) return { accounts: bootstrapData.accounts };
     return await getUrlJson('/ofp-api/v1/accounts');
 }
 
@@ -755,10 +773,19 @@ async function initCertificateButtons() {
 // *******************************************************************************
 
 async function apiGetHardwareTypesJson() {
+    if (bootstrapData !== null) {
+        let { current, supported } = bootstrapData.hardware;
+        return { current, supported };
+    }
     return await getUrlJson('/ofp-api/v1/hardware');
 }
 
 async function apiGetHardwareParamsJson(hardwareId) {
+    // parameters are only provided to admins, and for current hardware
+    if (bootstrapData !== null) {
+        let { current, parameters } = bootstrapData.hardware;
+        if (hardwareId === current && parameters !== undefined) return { parameters };
+    }
     return await getUrlJson(`/ofp-api/v1/hardware/${hardwareId}/parameters`);
 }
 
@@ -775,7 +802,7 @@ async function loadHardwareSupported() {
     };
 
     el.value = current;
-    loadHardwareParameters(current);
+    await loadHardwareParameters(current);
 }
 
 async function initHardwareParametersButtons() {
@@ -821,6 +848,15 @@ async function loadHardwareParameters(hardwareId) {
 let isIntervalInProgress = false;
 
 async function ofp_init() {
+    // fetch everything at once, individual requests are used as a fallback
+    try {
+        bootstrapData = await apiGetBootstrapJson();
+    }
+    catch (err) {
+        logError(err);
+        bootstrapData = null;
+    }
+
     await loadStatus().catch(logError);
     await loadZoneOverrides().catch(logError);
     await loadZoneConfiguration().catch(logError);
@@ -833,6 +869,9 @@ async function ofp_init() {
     await loadHardwareSupported().catch(logError);
     await initHardwareParametersButtons().catch(logError);
 
+    // further loadings need fresh data
+    bootstrapData = null;
+
     // periodically refresh zone
     setInterval(function () {
         if (isIntervalInProgress)
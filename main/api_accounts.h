@@ -1,10 +1,15 @@
 #ifndef API_ACCOUNTS_H
 #define API_ACCOUNTS_H
 
+#include <stdbool.h>
+#include <cjson.h>
 #include <esp_https_server.h>
 
 #include "utils.h"
 
+/* JSON builder, shared with the bootstrap entrypoint */
+bool api_accounts_add_accounts(cJSON *root, httpd_req_t *req);
+
 esp_err_t serve_api_get_accounts(httpd_req_t *req, struct re_result *captures);
 
 esp_err_t serve_api_post_accounts(httpd_req_t *req, struct re_result *captures);
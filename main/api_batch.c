@@ -0,0 +1,375 @@
+#include <string.h>
+#include <cjson.h>
+#include <esp_log.h>
+
+#include "sdkconfig.h"
+
+#include "str.h"
+#include "ofp.h"
+#include "webserver.h"
+#include "arena.h"
+#include "api_batch.h"
+#include "api_zones.h"
+
+static const char TAG[] = "api_batch";
+
+#define BATCH_MAX_OPERATION_COUNT 64
+
+/***************************************************************************/
+
+enum batch_op_type
+{
+    BATCH_OP_ZONE_MODE = 0,
+    BATCH_OP_SLOT_ADD,
+    BATCH_OP_SLOT_UPDATE,
+    BATCH_OP_SLOT_DELETE,
+    BATCH_OP_PLANNING_RENAME,
+    BATCH_OP_ENUM_SIZE
+};
+
+static const char *batch_op_names[] = {
+    "zone_mode",
+    "slot_add",
+    "slot_update",
+    "slot_delete",
+    "planning_rename",
+};
+
+enum batch_op_status
+{
+    BATCH_OP_STATUS_SKIPPED = 0,
+    BATCH_OP_STATUS_INVALID,
+    BATCH_OP_STATUS_FAILED,
+    BATCH_OP_STATUS_APPLIED,
+};
+
+static const char *batch_op_status_names[] = {
+    "skipped",
+    "invalid",
+    "failed",
+    "applied",
+};
+
+/* a validated operation, strings point into the parsed JSON body */
+struct batch_op
+{
+    enum batch_op_type type;
+    enum batch_op_status status;
+    const char *error;
+    // zone_mode
+    struct ofp_zone *zone;
+    enum ofp_zone_mode mode;
+    int mode_value;
+    // slots and plannings
+    int planning_id;
+    int slot_id;
+    int dow;
+    int hour;
+    int minute;
+    int order_id;
+    char *name;
+};
+
+/***************************************************************************/
+
+/* optional integer member, value is set to -1 if missing */
+static bool batch_get_optional_int(cJSON *node, const char *key, int *value, int min, int max)
+{
+    *value = -1;
+    enum json_helper_result res = cjson_get_child_int(node, key, value);
+    if (res == JSON_HELPER_RESULT_NOT_FOUND)
+    {
+        *value = -1;
+        return true;
+    }
+    return res == JSON_HELPER_RESULT_SUCCESS && *value >= min && *value < max;
+}
+
+/* optional order member, value is set to -1 if missing */
+static bool batch_get_optional_order(cJSON *node, int *order_id)
+{
+    *order_id = -1;
+    char *order = NULL;
+    enum json_helper_result res = cjson_get_child_string(node, json_key_order, &order);
+    if (res == JSON_HELPER_RESULT_NOT_FOUND)
+        return true;
+    if (res != JSON_HELPER_RESULT_SUCCESS || order == NULL)
+        return false;
+
+    const struct ofp_order_info *info = ofp_order_info_by_str_id(order);
+    if (info == NULL)
+        return false;
+
+    *order_id = info->order_id;
+    return true;
+}
+
+/* returns an error message, or NULL if the operation is valid */
+static const char *batch_op_validate(cJSON *node, struct batch_op *op)
+{
+    if (!cJSON_IsObject(node))
+        return "Invalid operation";
+
+    char *type = NULL;
+    if (cjson_get_child_string(node, json_key_op, &type) != JSON_HELPER_RESULT_SUCCESS || type == NULL)
+        return "Invalid op";
+
+    op->type = BATCH_OP_ENUM_SIZE;
+    for (int i = 0; i < BATCH_OP_ENUM_SIZE; i++)
+        if (strcmp(type, batch_op_names[i]) == 0)
+            op->type = i;
+    if (op->type == BATCH_OP_ENUM_SIZE)
+        return "Unknown op";
+
+    ESP_LOGV(TAG, "op %s", batch_op_names[op->type]);
+
+    // zone mode operation
+    if (op->type == BATCH_OP_ZONE_MODE)
+    {
+        char *zone_id = NULL;
+        if (cjson_get_child_string(node, json_key_zone, &zone_id) != JSON_HELPER_RESULT_SUCCESS || zone_id == NULL)
+            return "Invalid zone";
+
+        op->zone = api_zones_find_zone_by_id(zone_id);
+        if (op->zone == NULL)
+            return "Zone not found";
+
+        char *mode = NULL;
+        if (cjson_get_child_string(node, json_key_mode, &mode) != JSON_HELPER_RESULT_SUCCESS || mode == NULL)
+            return "Invalid mode";
+
+        if (!api_zones_parse_mode(mode, &op->mode, &op->mode_value))
+            return "Invalid mode";
+
+        if (op->mode == HW_OFP_ZONE_MODE_PLANNING && ofp_planning_list_find_planning_by_id(op->mode_value) == NULL)
+            return "Planning not found";
+
+        return NULL;
+    }
+
+    // every other operation targets a planning
+    if (cjson_get_child_int(node, json_key_planning, &op->planning_id) != JSON_HELPER_RESULT_SUCCESS)
+        return "Invalid planning";
+
+    struct ofp_planning *plan = ofp_planning_list_find_planning_by_id(op->planning_id);
+    if (plan == NULL)
+        return "Planning not found";
+
+    if (op->type == BATCH_OP_PLANNING_RENAME)
+    {
+        if (cjson_get_child_string(node, stor_key_name, &op->name) != JSON_HELPER_RESULT_SUCCESS || op->name == NULL)
+            return "Invalid name";
+        return NULL;
+    }
+
+    // updating and deleting target an existing slot
+    if (op->type == BATCH_OP_SLOT_UPDATE || op->type == BATCH_OP_SLOT_DELETE)
+    {
+        if (cjson_get_child_int(node, json_key_slot, &op->slot_id) != JSON_HELPER_RESULT_SUCCESS)
+            return "Invalid slot";
+
+        bool found = false;
+        for (int i = 0; i < OFP_MAX_PLANNING_SLOT_COUNT && !found; i++)
+            found = plan->slots[i] != NULL && plan->slots[i]->id == op->slot_id;
+        if (!found)
+            return "Slot not found";
+
+        if (op->type == BATCH_OP_SLOT_DELETE)
+            return NULL;
+    }
+
+    // slot values are required for adding, optional for updating
+    if (!batch_get_optional_int(node, json_key_dow, &op->dow, 0, OFP_DOW_ENUM_SIZE))
+        return "Invalid dow";
+    if (!batch_get_optional_int(node, json_key_hour, &op->hour, 0, 24))
+        return "Invalid hour";
+    if (!batch_get_optional_int(node, json_key_minute, &op->minute, 0, 60))
+        return "Invalid minute";
+    if (!batch_get_optional_order(node, &op->order_id))
+        return "Invalid order";
+
+    if (op->type == BATCH_OP_SLOT_ADD && (op->dow < 0 || op->hour < 0 || op->minute < 0 || op->order_id < 0))
+        return "Missing slot value";
+
+    return NULL;
+}
+
+static bool batch_op_apply(struct batch_op *op)
+{
+    ESP_LOGD(TAG, "batch_op_apply %s", batch_op_names[op->type]);
+
+    switch (op->type)
+    {
+    case BATCH_OP_ZONE_MODE:
+        if (op->mode == HW_OFP_ZONE_MODE_FIXED)
+        {
+            if (!ofp_zone_set_mode_fixed(op->zone, op->mode_value))
+                return false;
+        }
+        else if (!ofp_zone_set_mode_planning(op->zone, op->mode_value))
+            return false;
+        return ofp_zone_store(op->zone);
+
+    case BATCH_OP_SLOT_ADD:
+        return ofp_planning_add_new_slot(op->planning_id, op->dow, op->hour, op->minute, op->order_id);
+
+    case BATCH_OP_SLOT_UPDATE:
+        if (op->dow >= 0 && !ofp_planning_slot_set_dow(op->planning_id, op->slot_id, op->dow))
+            return false;
+        if (op->hour >= 0 && !ofp_planning_slot_set_hour(op->planning_id, op->slot_id, op->hour))
+            return false;
+        if (op->minute >= 0 && !ofp_planning_slot_set_minute(op->planning_id, op->slot_id, op->minute))
+            return false;
+        if (op->order_id >= 0 && !ofp_planning_slot_set_order(op->planning_id, op->slot_id, op->order_id))
+            return false;
+        return true;
+
+    case BATCH_OP_SLOT_DELETE:
+        return ofp_planning_remove_existing_slot(op->planning_id, op->slot_id);
+
+    case BATCH_OP_PLANNING_RENAME:
+        return ofp_planning_change_description(op->planning_id, op->name);
+
+    default:
+        return false;
+    }
+}
+
+static esp_err_t batch_serve_results(httpd_req_t *req, const char *status, struct batch_op *ops, int count)
+{
+    cJSON *root = cJSON_CreateObject();
+    cJSON *results = cJSON_AddArrayToObject(root, json_key_results);
+    for (int i = 0; i < count; i++)
+    {
+        cJSON *r = cJSON_CreateObject();
+        cJSON_AddItemToArray(results, r);
+        cJSON_AddStringToObject(r, json_key_status, batch_op_status_names[ops[i].status]);
+        if (ops[i].error != NULL)
+            cJSON_AddStringToObject(r, json_key_error, ops[i].error);
+    }
+
+    httpd_resp_set_status(req, status);
+    esp_err_t result = serve_json(req, root);
+    cJSON_Delete(root);
+    return result;
+}
+
+/***************************************************************************/
+
+/*
+ * Every operation is validated against the current state before anything is modified.
+ * Then all operations are applied in order within a single transaction, which is
+ * either committed to storage as a whole, or rolled back on the first failure.
+ */
+esp_err_t serve_api_post_batch(httpd_req_t *req, struct re_result *captures)
+{
+    int version = re_get_int(captures, 1);
+    ESP_LOGD(TAG, "serve_api_post_batch version=%i", version);
+    if (version != 1)
+        return webserver_resp_send_404(req);
+
+    // read
+    char *buf = webserver_get_request_data_atomic_max_size(req, CONFIG_OFP_UI_WEBSERVER_DATA_MAX_SIZE_BATCH);
+    if (buf == NULL)
+    {
+        ESP_LOGW(TAG, "Failed getting request data");
+        return ESP_FAIL;
+    }
+
+    // parse
+    cJSON *root = cJSON_Parse(buf);
+
+    // cleanup
+    scoped_free(buf);
+
+    // parse error
+    if (root == NULL)
+        return webserver_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Failed parsing JSON body");
+
+    // operations are required
+    cJSON *operations = cJSON_GetObjectItemCaseSensitive(root, json_key_operations);
+    int count = cJSON_GetArraySize(operations);
+    if (!cJSON_IsArray(operations) || count == 0 || count > BATCH_MAX_OPERATION_COUNT)
+    {
+        ESP_LOGD(TAG, "Invalid operations");
+        cJSON_Delete(root);
+        return webserver_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid operations");
+    }
+
+    struct batch_op *ops = calloc(count, sizeof(struct batch_op));
+    if (ops == NULL)
+    {
+        ESP_LOGW(TAG, "calloc failed");
+        cJSON_Delete(root);
+        return webserver_resp_send_500(req);
+    }
+
+    // validate everything first
+    bool valid = true;
+    int i = 0;
+    cJSON *node;
+    cJSON_ArrayForEach(node, operations)
+    {
+        ops[i].error = batch_op_validate(node, &ops[i]);
+        if (ops[i].error != NULL)
+        {
+            ESP_LOGD(TAG, "Invalid operation %i: %s", i, ops[i].error);
+            ops[i].status = BATCH_OP_STATUS_INVALID;
+            valid = false;
+        }
+        i++;
+    }
+
+    esp_err_t result;
+    if (!valid)
+    {
+        result = batch_serve_results(req, http_400_hdr, ops, count);
+        goto cleanup;
+    }
+
+    // apply everything, or nothing
+    if (!ofp_transaction_begin())
+    {
+        result = webserver_resp_send_500(req);
+        goto cleanup;
+    }
+
+    bool applied = true;
+    for (i = 0; i < count; i++)
+    {
+        if (!batch_op_apply(&ops[i]))
+        {
+            ESP_LOGD(TAG, "Operation %i failed, rolling back", i);
+            ops[i].status = BATCH_OP_STATUS_FAILED;
+            ops[i].error = "Operation failed";
+            applied = false;
+            break;
+        }
+        ops[i].status = BATCH_OP_STATUS_APPLIED;
+    }
+
+    if (!applied)
+    {
+        // operations applied so far are reverted
+        for (int j = 0; j < i; j++)
+            ops[j].status = BATCH_OP_STATUS_SKIPPED;
+        ofp_transaction_rollback();
+        result = batch_serve_results(req, http_409_hdr, ops, count);
+        goto cleanup;
+    }
+
+    // applied in memory, but not stored
+    if (!ofp_transaction_commit())
+    {
+        ESP_LOGW(TAG, "Could not store the batch");
+        result = webserver_resp_send_500(req);
+        goto cleanup;
+    }
+
+    result = batch_serve_results(req, http_200_hdr, ops, count);
+
+cleanup:
+    free(ops);
+    cJSON_Delete(root);
+    return result;
+}
@@ -0,0 +1,11 @@
+#ifndef API_BATCH_H
+#define API_BATCH_H
+
+#include <esp_https_server.h>
+
+#include "utils.h"
+
+/* applies many zone/planning operations at once, all or nothing */
+esp_err_t serve_api_post_batch(httpd_req_t *req, struct re_result *captures);
+
+#endif /* API_BATCH_H */
\ No newline at end of file
@@ -0,0 +1,146 @@
+#include <string.h>
+#include <cjson.h>
+#include <esp_log.h>
+
+#include "str.h"
+#include "ofp.h"
+#include "webserver.h"
+#include "api_bootstrap.h"
+#include "api_accounts.h"
+#include "api_hw.h"
+#include "api_plannings.h"
+#include "api_zones.h"
+
+static const char TAG[] = "api_bootstrap";
+
+/***************************************************************************/
+
+/*
+ * Sends the members of a section object as a chunk of the bootstrap object
+ *
+ * Every section is serialized on its own and sent right away, so that
+ * the whole document is never held in memory at once. The enclosing
+ * braces of the section are stripped so that members from all sections
+ * end up in the same top level object.
+ *
+ * Takes ownership of the section (deleted before returning)
+ */
+static esp_err_t bootstrap_send_section(httpd_req_t *req, cJSON *section, int *sent_count)
+{
+    char *txt = cJSON_PrintUnformatted(section);
+    cJSON_Delete(section);
+    if (txt == NULL)
+    {
+        ESP_LOGW(TAG, "Could not serialize section");
+        return ESP_FAIL;
+    }
+
+    size_t len = strlen(txt);
+    assert(len >= 2);
+
+    // empty section
+    esp_err_t err = ESP_OK;
+    if (len == 2)
+        goto cleanup;
+
+    if (*sent_count > 0)
+    {
+        err = webserver_resp_send_chunk(req, ",", 1);
+        if (err != ESP_OK)
+            goto cleanup;
+    }
+
+    ESP_LOGV(TAG, "Sending section: %s", txt);
+    err = webserver_resp_send_chunk(req, txt + 1, len - 2);
+    if (err == ESP_OK)
+        (*sent_count)++;
+
+cleanup:
+    cJSON_free(txt);
+    return err;
+}
+
+/***************************************************************************/
+
+esp_err_t serve_api_get_bootstrap(httpd_req_t *req, struct re_result *captures)
+{
+    int version = re_get_int(captures, 1);
+    ESP_LOGD(TAG, "serve_api_get_bootstrap version=%i", version);
+    if (version != 1)
+        return webserver_resp_send_404(req);
+
+    struct ofp_planning_list *plan_list = ofp_planning_list_get();
+    if (plan_list == NULL)
+    {
+        ESP_LOGW(TAG, "No planning list available");
+        return webserver_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Planning list not initialized");
+    }
+
+    httpd_resp_set_type(req, http_content_type_json);
+    httpd_resp_set_hdr(req, str_cache_control, str_private_no_store);
+
+    // from here on, response is streamed and errors can only abort it
+    int sent_count = 0;
+    esp_err_t err = webserver_resp_send_chunk(req, "{", 1);
+    if (err != ESP_OK)
+        return err;
+
+    cJSON *section = cJSON_CreateObject();
+    api_zones_add_orders(section);
+    err = bootstrap_send_section(req, section, &sent_count);
+    if (err != ESP_OK)
+        return err;
+
+    section = cJSON_CreateObject();
+    api_zones_add_override(section);
+    err = bootstrap_send_section(req, section, &sent_count);
+    if (err != ESP_OK)
+        return err;
+
+    section = cJSON_CreateObject();
+    if (!api_zones_add_zones(section))
+    {
+        cJSON_Delete(section);
+        return ESP_FAIL;
+    }
+    err = bootstrap_send_section(req, section, &sent_count);
+    if (err != ESP_OK)
+        return err;
+
+    section = cJSON_CreateObject();
+    api_plannings_add_plannings(section, plan_list, true);
+    err = bootstrap_send_section(req, section, &sent_count);
+    if (err != ESP_OK)
+        return err;
+
+    section = cJSON_CreateObject();
+    if (!api_accounts_add_accounts(section, req))
+    {
+        cJSON_Delete(section);
+        return ESP_FAIL;
+    }
+    err = bootstrap_send_section(req, section, &sent_count);
+    if (err != ESP_OK)
+        return err;
+
+    // parameters of the current hardware are restricted to admins
+    section = cJSON_CreateObject();
+    cJSON *hardware = cJSON_AddObjectToObject(section, json_key_hardware);
+    api_hw_add_hardware(hardware);
+    struct ofp_hw *hw = ofp_hw_get_current();
+    if (hw != NULL && ofp_session_user_is_admin(req) && !api_hw_add_parameters(hardware, hw))
+    {
+        cJSON_Delete(section);
+        return ESP_FAIL;
+    }
+    err = bootstrap_send_section(req, section, &sent_count);
+    if (err != ESP_OK)
+        return err;
+
+    err = webserver_resp_send_chunk(req, "}", 1);
+    if (err != ESP_OK)
+        return err;
+
+    // terminate chunked response
+    return webserver_resp_send_chunk(req, NULL, 0);
+}
@@ -0,0 +1,11 @@
+#ifndef API_BOOTSTRAP_H
+#define API_BOOTSTRAP_H
+
+#include <esp_https_server.h>
+
+#include "utils.h"
+
+/* everything the UI needs at startup, in a single streamed response */
+esp_err_t serve_api_get_bootstrap(httpd_req_t *req, struct re_result *captures);
+
+#endif /* API_BOOTSTRAP_H */
\ No newline at end of file
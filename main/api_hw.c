@@ -8,6 +8,7 @@
 #include "webserver.h"
 #include "api_hw.h"
 #include "storage.h"
+#include "s2p_595.h"
 
 static const char TAG[] = "api_hw";
 
@@ -31,19 +32,11 @@ struct ofp_hw *ofp_get_hardware_from_stored_id(void)
 
 /***************************************************************************/
 
-esp_err_t serve_api_get_hardware(httpd_req_t *req, struct re_result *captures)
+void api_hw_add_hardware(cJSON *root)
 {
-    int version = re_get_int(captures, 1);
-    ESP_LOGD(TAG, "serve_api_get_hardware version=%i", version);
-    if (version != 1)
-        return httpd_resp_send_404(req);
-
     // fetch current hardware id from storage, returns NULL if not found
     char *current_hw_id = kv_ns_get_str_atomic(kv_get_ns_ofp(), stor_key_hardware_type); // must be free'd after use
 
-    // provide hardware list
-    cJSON *root = cJSON_CreateObject();
-
     if (current_hw_id != NULL)
     {
         cJSON_AddStringToObject(root, json_key_current, current_hw_id);
@@ -54,6 +47,7 @@ esp_err_t serve_api_get_hardware(httpd_req_t *req, struct re_result *captures)
         cJSON_AddNullToObject(root, json_key_current);
     }
 
+    // provide hardware list
     cJSON *supported = cJSON_AddArrayToObject(root, json_key_supported);
     for (int i = 0; i < ofp_hw_list_get_count(); i++)
     {
@@ -63,35 +57,10 @@ esp_err_t serve_api_get_hardware(httpd_req_t *req, struct re_result *captures)
         cJSON_AddStringToObject(j, json_key_id, hw->id);
         cJSON_AddStringToObject(j, json_key_description, hw->description);
     }
-
-    httpd_resp_set_hdr(req, str_cache_control, str_private_max_age_600);
-
-    esp_err_t result = serve_json(req, root);
-    cJSON_Delete(root);
-    return result;
 }
 
-/***************************************************************************/
-
-esp_err_t serve_api_get_hardware_id_parameters(httpd_req_t *req, struct re_result *captures)
+bool api_hw_add_parameters(cJSON *root, struct ofp_hw *hw)
 {
-    int version = re_get_int(captures, 1);
-    char *id = re_get_string(captures, 2);
-    ESP_LOGD(TAG, "serve_api_get_hardware_id_parameters version=%i id=%s", version, id);
-    if (version != 1)
-        return httpd_resp_send_404(req);
-
-    // restrict access
-    if (!ofp_session_user_is_admin(req))
-        return httpd_resp_send_err(req, HTTPD_403_FORBIDDEN, "Unauthorized");
-
-    // find hardware
-    struct ofp_hw *hw = ofp_hw_list_find_hw_by_id(id);
-
-    // nothing found
-    if (hw == NULL)
-        return httpd_resp_send_404(req);
-
     assert(hw->params != NULL);
 
     // build hardware target namespace
@@ -99,14 +68,14 @@ esp_err_t serve_api_get_hardware_id_parameters(httpd_req_t *req, struct re_resul
     if (!kv_build_ns_hardware(hw->id, tmp_hw_ns_name))
     {
         ESP_LOGE(TAG, "Could not build hardware namespace");
-        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Hardware name too long");
+        return false;
     }
 
     // provide list of parameters
     char *str;
     int num;
+    bool success = true;
     nvs_handle_t h = kv_open_ns(tmp_hw_ns_name);
-    cJSON *root = cJSON_CreateObject();
     cJSON *parameters = cJSON_AddArrayToObject(root, json_key_parameters);
     for (int i = 0; i < hw->param_count; i++)
     {
@@ -131,12 +100,64 @@ esp_err_t serve_api_get_hardware_id_parameters(httpd_req_t *req, struct re_resul
             break;
         default:
             ESP_LOGW(TAG, "Invalid ofp_hw_param_type value detected: %i for parameter %s of hardware %s", param->type, param->id, hw->id);
-            cJSON_Delete(root);
-            return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Invalid hardware parameter value detected");
+            success = false;
+            break;
         }
+        if (!success)
+            break;
     }
     kv_close(h);
 
+    return success;
+}
+
+/***************************************************************************/
+
+esp_err_t serve_api_get_hardware(httpd_req_t *req, struct re_result *captures)
+{
+    int version = re_get_int(captures, 1);
+    ESP_LOGD(TAG, "serve_api_get_hardware version=%i", version);
+    if (version != 1)
+        return webserver_resp_send_404(req);
+
+    cJSON *root = cJSON_CreateObject();
+    api_hw_add_hardware(root);
+
+    httpd_resp_set_hdr(req, str_cache_control, str_private_max_age_600);
+
+    esp_err_t result = serve_json(req, root);
+    cJSON_Delete(root);
+    return result;
+}
+
+/***************************************************************************/
+
+esp_err_t serve_api_get_hardware_id_parameters(httpd_req_t *req, struct re_result *captures)
+{
+    int version = re_get_int(captures, 1);
+    char *id = re_get_string(captures, 2);
+    ESP_LOGD(TAG, "serve_api_get_hardware_id_parameters version=%i id=%s", version, id);
+    if (version != 1)
+        return webserver_resp_send_404(req);
+
+    // restrict access
+    if (!ofp_session_user_is_admin(req))
+        return webserver_resp_send_err(req, HTTPD_403_FORBIDDEN, "Unauthorized");
+
+    // find hardware
+    struct ofp_hw *hw = ofp_hw_list_find_hw_by_id(id);
+
+    // nothing found
+    if (hw == NULL)
+        return webserver_resp_send_404(req);
+
+    cJSON *root = cJSON_CreateObject();
+    if (!api_hw_add_parameters(root, hw))
+    {
+        cJSON_Delete(root);
+        return webserver_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Invalid hardware parameter value detected");
+    }
+
     esp_err_t result = serve_json(req, root);
     cJSON_Delete(root);
     return result;
@@ -157,18 +178,18 @@ esp_err_t serve_api_post_hardware(httpd_req_t *req, struct re_result *captures)
     int version = re_get_int(captures, 1);
     ESP_LOGD(TAG, "Serve_api_post_hardware version=%i", version);
     if (version != 1)
-        return httpd_resp_send_404(req);
+        return webserver_resp_send_404(req);
 
     // restrict access
     if (!ofp_session_user_is_admin(req))
-        return httpd_resp_send_err(req, HTTPD_403_FORBIDDEN, "Unauthorized");
+        return webserver_resp_send_err(req, HTTPD_403_FORBIDDEN, "Unauthorized");
 
     // get params
     struct ofp_form_data *data = webserver_form_data_from_req(req);
     if (data == NULL)
     {
         ESP_LOGD(TAG, "Error parsing x-www-form-urlencoded data");
-        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Malformed request body");
+        return webserver_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Malformed request body");
     }
 
     // get the requested hardware
@@ -177,7 +198,7 @@ esp_err_t serve_api_post_hardware(httpd_req_t *req, struct re_result *captures)
     {
         ESP_LOGD(TAG, "Missing parameter '%s'", stor_key_hardware_type); // TODO: give incorrect value in msg
         form_data_free(data);
-        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Hardware type not provided");
+        return webserver_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Hardware type not provided");
     }
 
     // search if the requested hardware is known
@@ -186,7 +207,7 @@ esp_err_t serve_api_post_hardware(httpd_req_t *req, struct re_result *captures)
     {
         ESP_LOGD(TAG, "Unknown hardware '%s'", form_hw_current);
         form_data_free(data);
-        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Unknown hardware type"); // TODO: give incorrect value in msg
+        return webserver_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Unknown hardware type"); // TODO: give incorrect value in msg
     }
 
     // iterate desired hardware parameters
@@ -201,7 +222,7 @@ esp_err_t serve_api_post_hardware(httpd_req_t *req, struct re_result *captures)
         {
             ESP_LOGD(TAG, "Missing parameter '%s'", hw_param_id); // TODO: give incorrect value in msg
             form_data_free(data);
-            return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Missing parameter");
+            return webserver_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Missing parameter");
         }
 
         // verify parameter type if needed
@@ -212,7 +233,7 @@ esp_err_t serve_api_post_hardware(httpd_req_t *req, struct re_result *captures)
             {
                 ESP_LOGD(TAG, "Invalid format for integer parameter '%s': %s", hw_param_id, form_param_value);
                 form_data_free(data);
-                return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid parameter");
+                return webserver_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid parameter");
             }
         }
     }
@@ -220,6 +241,9 @@ esp_err_t serve_api_post_hardware(httpd_req_t *req, struct re_result *captures)
     // if we reached here, everything is correct, store the updated parameters without checking for errors
     ESP_LOGV(TAG, "Request is valid, storing data");
 
+    // restored before the new configuration is loaded, on next boot
+    s2p_595_forget();
+
     // store new hardware type in common namespace
     nvs_handle_t h = kv_open_ns(kv_get_ns_ofp());
     kv_set_str(h, stor_key_hardware_type, form_hw_current);
@@ -231,7 +255,7 @@ esp_err_t serve_api_post_hardware(httpd_req_t *req, struct re_result *captures)
     if (!kv_build_ns_hardware(form_hw_current, tmp_hw_ns_name))
     {
         ESP_LOGE(TAG, "Could not build hardware namespace");
-        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Hardware name too long");
+        return webserver_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Hardware name too long");
     }
 
     h = kv_open_ns(tmp_hw_ns_name);
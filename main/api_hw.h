@@ -1,9 +1,16 @@
 #ifndef API_HW_H
 #define API_HW_H
 
+#include <stdbool.h>
+#include <cjson.h>
 #include <esp_https_server.h>
 
 #include "utils.h"
+#include "ofp.h"
+
+/* JSON builders, shared with the bootstrap entrypoint */
+void api_hw_add_hardware(cJSON *root);
+bool api_hw_add_parameters(cJSON *root, struct ofp_hw *hw);
 
 esp_err_t serve_api_get_hardware(httpd_req_t *req, struct re_result *captures);
 
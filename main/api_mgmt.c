@@ -2,6 +2,7 @@
 #include <esp_log.h>
 #include <esp_random.h>
 #include <esp_ota_ops.h>
+#include <esp_heap_caps.h>
 
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
@@ -16,6 +17,18 @@
 #include "str.h"
 #include "ofp.h"
 #include "webserver.h"
+#include "arena.h"
+#include "json_pool.h"
+#include "s2p_595.h"
+#include "boot.h"
+#include "mqtt_bridge.h"
+#include "linky.h"
+#include "history.h"
+#include "loop_stats.h"
+#include "pulse_timer.h"
+#include "output.h"
+#include "usage.h"
+#include "trace.h"
 #include "uptime.h"
 #include "api_mgmt.h"
 #include "fwupd.h"
@@ -33,6 +46,9 @@ static const char TAG[] = "api_mgmt";
 #define SELF_SIGNED_CERT_NOT_BEFORE "20200101000000"
 #define SELF_SIGNED_CERT_NOT_AFTER "20401231235959"
 
+#define MGMT_TRACE_CHUNK_LEN 1024
+#define MGMT_TRACE_QUERY_MAX_LEN 16
+
 /***************************************************************************/
 
 static void reboot_wait(void *pvParameters)
@@ -40,6 +56,10 @@ static void reboot_wait(void *pvParameters)
     ESP_LOGI(TAG, "Rebooting in %i seconds...", REBOOT_WAIT_SEC);
     wait_sec(REBOOT_WAIT_SEC);
 
+    // keep transitions and time in orders recorded since the last save
+    history_checkpoint();
+    usage_save();
+
     ESP_LOGI(TAG, "Rebooting NOW !");
     // Task should NOT exit (or BY DEFAULT it causes FreeRTOS to abort()
     esp_restart();
@@ -56,6 +76,17 @@ static void mgmt_queue_reboot(void)
     configASSERT(xHandle);
 }
 
+static void mgmt_add_histogram(cJSON *parent, const char *name, const struct histogram *h)
+{
+    cJSON *obj = cJSON_AddObjectToObject(parent, name);
+    cJSON_AddNumberToObject(obj, "count", h->count);
+    cJSON_AddNumberToObject(obj, "mean", histogram_mean(h));
+    cJSON_AddNumberToObject(obj, "max", h->max);
+    cJSON *buckets = cJSON_AddArrayToObject(obj, "buckets");
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++)
+        cJSON_AddItemToArray(buckets, cJSON_CreateNumber(h->buckets[i]));
+}
+
 /***************************************************************************/
 
 esp_err_t serve_api_get_status(httpd_req_t *req, struct re_result *captures)
@@ -63,7 +94,7 @@ esp_err_t serve_api_get_status(httpd_req_t *req, struct re_result *captures)
     int version = re_get_int(captures, 1);
     ESP_LOGD(TAG, "serve_api_get_status version=%i", version);
     if (version != 1)
-        return httpd_resp_send_404(req);
+        return webserver_resp_send_404(req);
 
     time_t sys_uptime = get_system_uptime();
     const struct uptime_wifi *wi = uptime_get_wifi_stats();
@@ -85,6 +116,146 @@ esp_err_t serve_api_get_status(httpd_req_t *req, struct re_result *captures)
     cJSON_AddNumberToObject(wifi, "disconnects", wi->disconnects);
     cJSON_AddNumberToObject(wifi, "cumulated_uptime", wi->cumulated_uptime + current_wifi_uptime);
     cJSON_AddNumberToObject(wifi, "current_uptime", current_wifi_uptime);
+    cJSON_AddNumberToObject(wifi, "reconnect_latency_last_ms", wi->reconnect_latency_last_ms);
+    cJSON_AddNumberToObject(wifi, "reconnect_latency_max_ms", wi->reconnect_latency_max_ms);
+
+    // heap usage and fragmentation, to compare allocation strategies over time
+    cJSON *memory = cJSON_AddObjectToObject(root, "memory");
+    cJSON_AddNumberToObject(memory, "free", esp_get_free_heap_size());
+    cJSON_AddNumberToObject(memory, "minimum_free", esp_get_minimum_free_heap_size());
+    cJSON_AddNumberToObject(memory, "largest_free_block", heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+    cJSON_AddNumberToObject(memory, "fragmentation", heap_get_fragmentation());
+
+    struct arena_stats stats;
+    arena_get_global_stats(&stats);
+    cJSON *arena = cJSON_AddObjectToObject(memory, "request_arena");
+    cJSON_AddNumberToObject(arena, "block_size", stats.block_size);
+    cJSON_AddNumberToObject(arena, "peak", stats.peak);
+    cJSON_AddNumberToObject(arena, "resets", stats.resets);
+    cJSON_AddNumberToObject(arena, "overflows", stats.overflows);
+
+    struct json_pool_stats pool_stats;
+    json_pool_get_stats(&pool_stats);
+    cJSON *pool = cJSON_AddObjectToObject(memory, "json_pool");
+    cJSON_AddNumberToObject(pool, "allocations", pool_stats.allocations);
+    cJSON_AddNumberToObject(pool, "fallbacks", pool_stats.fallbacks);
+    cJSON_AddNumberToObject(pool, "request_last", pool_stats.request_last);
+    cJSON_AddNumberToObject(pool, "request_max", pool_stats.request_max);
+    cJSON *classes = cJSON_AddArrayToObject(pool, "classes");
+    for (int i = 0; i < JSON_POOL_CLASS_ENUM_SIZE; i++)
+    {
+        struct json_pool_class_stats *cs = &pool_stats.classes[i];
+        cJSON *c = cJSON_CreateObject();
+        cJSON_AddItemToArray(classes, c);
+        cJSON_AddNumberToObject(c, "block_size", cs->block_size);
+        cJSON_AddNumberToObject(c, "block_count", cs->block_count);
+        cJSON_AddNumberToObject(c, "used", cs->used);
+        cJSON_AddNumberToObject(c, "high_water", cs->high_water);
+    }
+
+    // outputs restored after a warm reset, and time to first correct outputs
+    struct s2p_595_restore_stats rs;
+    s2p_595_get_restore_stats(&rs);
+    cJSON *restore = cJSON_AddObjectToObject(root, "warm_restore");
+    cJSON_AddNumberToObject(restore, "reset_reason", rs.reset_reason);
+    cJSON_AddBoolToObject(restore, "restored", rs.restored);
+    cJSON_AddNumberToObject(restore, "bit_count", rs.bit_count);
+    cJSON_AddNumberToObject(restore, "image_age", rs.image_age);
+    cJSON_AddNumberToObject(restore, "restore_us", rs.restore_us);
+    cJSON_AddNumberToObject(restore, "first_latch_us", rs.first_persist_us);
+
+    // webserver sessions, and their memory usage
+    struct webserver_stats ws;
+    webserver_get_stats(&ws);
+    cJSON *webserver = cJSON_AddObjectToObject(root, "webserver");
+    cJSON_AddNumberToObject(webserver, "max_sessions", ws.max_sessions);
+    cJSON_AddNumberToObject(webserver, "open_sessions", ws.open_sessions);
+    cJSON_AddNumberToObject(webserver, "peak_sessions", ws.peak_sessions);
+    cJSON_AddNumberToObject(webserver, "heap_per_session", ws.heap_per_session);
+    cJSON_AddNumberToObject(webserver, "estimated_capacity", ws.estimated_capacity);
+    cJSON_AddNumberToObject(webserver, "tls_full_handshakes", ws.tls_full_handshakes);
+    cJSON_AddNumberToObject(webserver, "tls_resumed_handshakes", ws.tls_resumed_handshakes);
+
+    // mqtt bridge
+    struct mqtt_bridge_stats ms;
+    mqtt_bridge_get_stats(&ms);
+    cJSON *mqtt = cJSON_AddObjectToObject(root, "mqtt");
+    cJSON_AddBoolToObject(mqtt, "connected", ms.connected);
+    cJSON_AddNumberToObject(mqtt, "published", ms.published);
+    cJSON_AddNumberToObject(mqtt, "dropped", ms.dropped);
+    cJSON_AddNumberToObject(mqtt, "commands", ms.commands);
+
+    // linky teleinfo and load shedding
+    struct linky_stats ls;
+    linky_get_stats(&ls);
+    cJSON *linky = cJSON_AddObjectToObject(root, "linky");
+    cJSON_AddNumberToObject(linky, "mode", ls.mode);
+    cJSON_AddNumberToObject(linky, "load_percent", ls.load_percent);
+    cJSON_AddNumberToObject(linky, "shed_zones", ls.shed_zones);
+    cJSON_AddNumberToObject(linky, "shed_events", ls.shed_events);
+    cJSON_AddNumberToObject(linky, "frames", ls.parser.frames);
+    cJSON_AddNumberToObject(linky, "invalid_frames", ls.parser.invalid_frames);
+    cJSON_AddNumberToObject(linky, "interrupted_frames", ls.parser.interrupted_frames);
+    cJSON_AddNumberToObject(linky, "groups", ls.parser.groups);
+    cJSON_AddNumberToObject(linky, "checksum_errors", ls.parser.checksum_errors);
+    cJSON_AddNumberToObject(linky, "format_errors", ls.parser.format_errors);
+    // parsing capacity, if the CPU did nothing else
+    double frames_per_second = 0;
+    if (ls.parse_us > 0)
+        frames_per_second = (double)ls.parser.frames * 1000000 / ls.parse_us;
+    cJSON_AddNumberToObject(linky, "frames_per_second", frames_per_second);
+
+    // order history
+    struct history_stats hs;
+    history_get_stats(&hs);
+    cJSON *history = cJSON_AddObjectToObject(root, "history");
+    cJSON_AddNumberToObject(history, "records", hs.records);
+    cJSON_AddNumberToObject(history, "pending", hs.pending);
+    cJSON_AddNumberToObject(history, "dropped", hs.dropped);
+    cJSON_AddNumberToObject(history, "checkpoints", hs.checkpoints);
+    cJSON_AddNumberToObject(history, "flash_sectors", hs.flash_sectors);
+
+    // control loop timing
+    struct loop_stats lps;
+    loop_stats_get(&lps);
+    cJSON *loop = cJSON_AddObjectToObject(root, "loop");
+    cJSON_AddNumberToObject(loop, "period_ms", lps.period_ms);
+    cJSON_AddNumberToObject(loop, "iterations", lps.iterations);
+    cJSON_AddNumberToObject(loop, "early_iterations", lps.early_iterations);
+    cJSON_AddNumberToObject(loop, "missed_deadlines", lps.missed_deadlines);
+    mgmt_add_histogram(loop, "compute_us", &lps.compute);
+    mgmt_add_histogram(loop, "apply_us", &lps.apply);
+    mgmt_add_histogram(loop, "lateness_us", &lps.lateness);
+
+    // output task
+    struct output_stats os;
+    output_get_stats(&os);
+    cJSON *output = cJSON_AddObjectToObject(root, "output");
+    cJSON_AddNumberToObject(output, "images", os.images);
+    cJSON_AddNumberToObject(output, "latches", os.latches);
+    mgmt_add_histogram(output, "latency_us", &os.latency);
+
+    // extended orders pulse edges
+    struct pulse_timer_stats pts;
+    pulse_timer_get_stats(&pts);
+    cJSON *pulse = cJSON_AddObjectToObject(root, "pulse");
+    cJSON_AddNumberToObject(pulse, "edges", pts.edges);
+    cJSON_AddNumberToObject(pulse, "last_error_us", pts.last_error_us);
+    cJSON_AddNumberToObject(pulse, "max_error_us", pts.max_error_us);
+
+    // boot stages timeline
+    struct boot_stage_timing timings[BOOT_MAX_STAGES];
+    int stage_count = boot_get_timeline(timings, BOOT_MAX_STAGES);
+    cJSON *boot = cJSON_AddArrayToObject(root, "boot");
+    for (int i = 0; i < stage_count; i++)
+    {
+        cJSON *stage = cJSON_CreateObject();
+        cJSON_AddItemToArray(boot, stage);
+        cJSON_AddStringToObject(stage, "stage", timings[i].name);
+        cJSON_AddNumberToObject(stage, "core", timings[i].core);
+        cJSON_AddNumberToObject(stage, "start_us", timings[i].start_us);
+        cJSON_AddNumberToObject(stage, "end_us", timings[i].end_us);
+    }
 
     // firmware and OTA versions and dates
     cJSON *ota = cJSON_AddObjectToObject(root, "firmware");
@@ -123,11 +294,11 @@ esp_err_t serve_api_get_reboot(httpd_req_t *req, struct re_result *captures)
     int version = re_get_int(captures, 1);
     ESP_LOGD(TAG, "serve_api_get_reboot version=%i", version);
     if (version != 1)
-        return httpd_resp_send_404(req);
+        return webserver_resp_send_404(req);
 
     // restrict access
     if (!ofp_session_user_is_admin(req))
-        return httpd_resp_send_err(req, HTTPD_403_FORBIDDEN, "Unauthorized");
+        return webserver_resp_send_err(req, HTTPD_403_FORBIDDEN, "Unauthorized");
 
     // dump some dev stats before rebooting
     uint32_t min = esp_get_minimum_free_heap_size();
@@ -140,6 +311,145 @@ esp_err_t serve_api_get_reboot(httpd_req_t *req, struct re_result *captures)
     return serve_static_ofp_wait_html(req);
 }
 
+/* trace lines are grouped in chunks, to limit the number of TLS records */
+struct mgmt_trace_dump
+{
+    httpd_req_t *req;
+    esp_err_t err;
+    // no separator before the first chrome event
+    bool first;
+    size_t len;
+    char buf[MGMT_TRACE_CHUNK_LEN];
+};
+
+static bool mgmt_trace_flush(struct mgmt_trace_dump *d)
+{
+    if (d->err == ESP_OK && d->len > 0)
+        d->err = webserver_resp_send_chunk(d->req, d->buf, d->len);
+    d->len = 0;
+    return d->err == ESP_OK;
+}
+
+static bool mgmt_trace_append(struct mgmt_trace_dump *d, const char *text, size_t len)
+{
+    if (d->len + len > sizeof(d->buf) && !mgmt_trace_flush(d))
+        return false;
+
+    memcpy(d->buf + d->len, text, len);
+    d->len += len;
+    return true;
+}
+
+static bool mgmt_trace_line(void *ctx, const char *line)
+{
+    struct mgmt_trace_dump *d = ctx;
+    return mgmt_trace_append(d, line, strlen(line)) && mgmt_trace_append(d, "\n", 1);
+}
+
+/* one trace_event object, tasks being threads of a single process */
+static bool mgmt_trace_chrome_event(void *ctx, const struct trace_event_data *record)
+{
+    struct mgmt_trace_dump *d = ctx;
+    char name[TRACE_LINE_MAX_LEN];
+    char event[TRACE_LINE_MAX_LEN + 128];
+
+    const char *phase;
+    switch (record->event)
+    {
+    case TRACE_EVENT_SPAN_BEGIN:
+        phase = "\"ph\":\"B\"";
+        snprintf(name, sizeof(name), "%s", trace_span_name(record->args[0]));
+        break;
+    case TRACE_EVENT_SPAN_END:
+        phase = "\"ph\":\"E\"";
+        snprintf(name, sizeof(name), "%s", trace_span_name(record->args[0]));
+        break;
+    default:
+        phase = "\"ph\":\"i\",\"s\":\"t\"";
+        trace_format(record, name, sizeof(name));
+        break;
+    }
+
+    int len = snprintf(event, sizeof(event), "%s{\"name\":\"%s\",\"cat\":\"ofp\",%s,\"ts\":%lli,\"pid\":1,\"tid\":%i,\"args\":{\"core\":%i}}",
+                       d->first ? "" : ",\n", name, phase, record->timestamp, record->task, record->core);
+    d->first = false;
+    return mgmt_trace_append(d, event, len);
+}
+
+/* names the threads of the timeline, only for tasks which still exist */
+static void mgmt_trace_chrome_task_names(struct mgmt_trace_dump *d)
+{
+#ifdef CONFIG_FREERTOS_USE_TRACE_FACILITY
+    UBaseType_t count = uxTaskGetNumberOfTasks();
+    TaskStatus_t *tasks = malloc(count * sizeof(TaskStatus_t));
+    if (tasks == NULL)
+        return;
+
+    count = uxTaskGetSystemState(tasks, count, NULL);
+    char event[128];
+    for (int i = 0; i < count; i++)
+    {
+        int len = snprintf(event, sizeof(event), "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                           d->first ? "" : ",\n", tasks[i].xTaskNumber, tasks[i].pcTaskName);
+        d->first = false;
+        if (!mgmt_trace_append(d, event, len))
+            break;
+    }
+    free(tasks);
+#endif /* CONFIG_FREERTOS_USE_TRACE_FACILITY */
+}
+
+esp_err_t serve_api_get_trace(httpd_req_t *req, struct re_result *captures)
+{
+    int version = re_get_int(captures, 1);
+    ESP_LOGD(TAG, "serve_api_get_trace version=%i", version);
+    if (version != 1)
+        return webserver_resp_send_404(req);
+
+    // restrict access
+    if (!ofp_session_user_is_admin(req))
+        return webserver_resp_send_err(req, HTTPD_403_FORBIDDEN, "Unauthorized");
+
+    // /chrome exports a timeline
+    bool chrome = re_get_string(captures, 2) != NULL;
+
+    // ?clear forgets dumped events
+    char query[MGMT_TRACE_QUERY_MAX_LEN];
+    char value[MGMT_TRACE_QUERY_MAX_LEN];
+    bool clear = httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK && httpd_query_key_value(query, "clear", value, sizeof(value)) != ESP_ERR_NOT_FOUND;
+
+    struct mgmt_trace_dump *d = calloc(1, sizeof(struct mgmt_trace_dump));
+    if (d == NULL)
+        return webserver_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Out of memory");
+    d->req = req;
+    d->first = true;
+
+    httpd_resp_set_hdr(req, str_cache_control, str_private_no_store);
+    if (chrome)
+    {
+        httpd_resp_set_type(req, http_content_type_json);
+        const char *header = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+        mgmt_trace_append(d, header, strlen(header));
+        mgmt_trace_chrome_task_names(d);
+        trace_export(mgmt_trace_chrome_event, d, clear);
+        mgmt_trace_append(d, "\n]}\n", 4);
+    }
+    else
+    {
+        httpd_resp_set_type(req, http_content_type_plain);
+        trace_dump(mgmt_trace_line, d, clear);
+    }
+    mgmt_trace_flush(d);
+
+    esp_err_t err = d->err;
+    free(d);
+    if (err != ESP_OK)
+        return err;
+
+    // terminate chunked response
+    return webserver_resp_send_chunk(req, NULL, 0);
+}
+
 /*
  * OTA driver for contiguous network data
  */
@@ -210,11 +520,11 @@ esp_err_t serve_api_post_upgrade(httpd_req_t *req, struct re_result *captures)
     int version = re_get_int(captures, 1);
     ESP_LOGD(TAG, "serve_api_post_upgrade version=%i", version);
     if (version != 1)
-        return httpd_resp_send_404(req);
+        return webserver_resp_send_404(req);
 
     // restrict access
     if (!ofp_session_user_is_admin(req))
-        return httpd_resp_send_err(req, HTTPD_403_FORBIDDEN, "Unauthorized");
+        return webserver_resp_send_err(req, HTTPD_403_FORBIDDEN, "Unauthorized");
 
     ESP_LOGD(TAG, "Content-length: %u", req->content_len);
 
@@ -239,15 +549,15 @@ esp_err_t serve_api_post_upgrade(httpd_req_t *req, struct re_result *captures)
         ESP_LOGI(TAG, "Firmware installation finished successfully");
         free(content_type_hdr_value);
 
-        return httpd_resp_sendstr(req, "firmware update successful");
+        return webserver_resp_sendstr(req, "firmware update successful");
     }
 
     free(content_type_hdr_value);
-    return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid request");
+    return webserver_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid request");
 
 cleanup:
     free(content_type_hdr_value);
-    return httpd_resp_send_500(req);
+    return webserver_resp_send_500(req);
 }
 
 esp_err_t serve_api_get_certificate(httpd_req_t *req, struct re_result *captures)
@@ -255,11 +565,11 @@ esp_err_t serve_api_get_certificate(httpd_req_t *req, struct re_result *captures
     int version = re_get_int(captures, 1);
     ESP_LOGD(TAG, "serve_api_get_certificate version=%i", version);
     if (version != 1)
-        return httpd_resp_send_404(req);
+        return webserver_resp_send_404(req);
 
     // restrict access
     if (!ofp_session_user_is_admin(req))
-        return httpd_resp_send_err(req, HTTPD_403_FORBIDDEN, "Unauthorized");
+        return webserver_resp_send_err(req, HTTPD_403_FORBIDDEN, "Unauthorized");
 
     cJSON *root = cJSON_CreateObject();
 
@@ -294,16 +604,16 @@ esp_err_t serve_api_delete_certificate(httpd_req_t *req, struct re_result *captu
     int version = re_get_int(captures, 1);
     ESP_LOGD(TAG, "serve_api_delete_certificate version=%i", version);
     if (version != 1)
-        return httpd_resp_send_404(req);
+        return webserver_resp_send_404(req);
 
     // restrict access
     if (!ofp_session_user_is_admin(req))
-        return httpd_resp_send_err(req, HTTPD_403_FORBIDDEN, "Unauthorized");
+        return webserver_resp_send_err(req, HTTPD_403_FORBIDDEN, "Unauthorized");
 
     kv_ns_delete_atomic(kv_get_ns_ofp(), stor_key_https_certs);
     kv_ns_delete_atomic(kv_get_ns_ofp(), stor_key_https_key);
 
-    return httpd_resp_sendstr(req, "Stored cert and key removed, only firmware-embedded cert and key remains. Please reboot.");
+    return webserver_resp_sendstr(req, "Stored cert and key removed, only firmware-embedded cert and key remains. Please reboot.");
 }
 
 /*
@@ -319,11 +629,11 @@ esp_err_t serve_api_post_certificate(httpd_req_t *req, struct re_result *capture
     int version = re_get_int(captures, 1);
     ESP_LOGD(TAG, "serve_api_post_upgrade version=%i", version);
     if (version != 1)
-        return httpd_resp_send_404(req);
+        return webserver_resp_send_404(req);
 
     // restrict access
     if (!ofp_session_user_is_admin(req))
-        return httpd_resp_send_err(req, HTTPD_403_FORBIDDEN, "Unauthorized");
+        return webserver_resp_send_err(req, HTTPD_403_FORBIDDEN, "Unauthorized");
 
     // result
     int code = 200;
@@ -497,7 +807,7 @@ esp_err_t serve_api_post_certificate(httpd_req_t *req, struct re_result *capture
     }
 
     // clean for reuse
-    free(buf);
+    scoped_free(buf);
     buf = NULL;
 
     // cleanup bundle iterator
@@ -646,12 +956,13 @@ cleanup:
         mbedtls_pk_free(pks[i].ctx);
     }
     certificate_bundle_iter_free(it);
-    free(buf);
+    // either from the request arena or from the heap
+    scoped_free(buf);
 
     if (code != 200)
-        return httpd_resp_send_err(req, code, msg);
+        return webserver_resp_send_err(req, code, msg);
 
-    return httpd_resp_sendstr(req, "Certificate bundle successfully loaded");
+    return webserver_resp_sendstr(req, "Certificate bundle successfully loaded");
 }
 
 esp_err_t serve_api_put_certificate_self_signed(httpd_req_t *req, struct re_result *captures)
@@ -659,11 +970,11 @@ esp_err_t serve_api_put_certificate_self_signed(httpd_req_t *req, struct re_resu
     int version = re_get_int(captures, 1);
     ESP_LOGD(TAG, "serve_api_put_certificate_self_signed version=%i", version);
     if (version != 1)
-        return httpd_resp_send_404(req);
+        return webserver_resp_send_404(req);
 
     // restrict access
     if (!ofp_session_user_is_admin(req))
-        return httpd_resp_send_err(req, HTTPD_403_FORBIDDEN, "Unauthorized");
+        return webserver_resp_send_err(req, HTTPD_403_FORBIDDEN, "Unauthorized");
 
     int ret = 0;
     unsigned char *output_buf = NULL;
@@ -848,7 +1159,7 @@ cleanup:
     mbedtls_ctr_drbg_free(&ctr_drbg);
 
     if (ret == 0)
-        return httpd_resp_sendstr(req, "self-signed certificate generated successfully");
+        return webserver_resp_sendstr(req, "self-signed certificate generated successfully");
     else
-        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Could not generate self-signed certificate");
+        return webserver_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Could not generate self-signed certificate");
 }
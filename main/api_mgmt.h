@@ -11,6 +11,8 @@ esp_err_t serve_api_post_upgrade(httpd_req_t *req, struct re_result *captures);
 
 esp_err_t serve_api_get_reboot(httpd_req_t *req, struct re_result *captures);
 
+esp_err_t serve_api_get_trace(httpd_req_t *req, struct re_result *captures);
+
 esp_err_t serve_api_get_certificate(httpd_req_t *req, struct re_result *captures);
 
 esp_err_t serve_api_delete_certificate(httpd_req_t *req, struct re_result *captures);
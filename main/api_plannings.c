@@ -1,30 +1,76 @@
+#include <string.h>
 #include <cjson.h>
 #include <esp_log.h>
 
+#include "sdkconfig.h"
+
 #include "str.h"
 #include "ofp.h"
 #include "webserver.h"
+#include "arena.h"
+#include "json_stream.h"
 #include "api_plannings.h"
 
 static const char TAG[] = "api_plannings";
 
-/***************************************************************************/
+// whole planning import, which never holds the request body in memory
+#define PLANNING_IMPORT_BLOCK_SIZE 128
+#define PLANNING_IMPORT_KEY_LEN 16
 
-esp_err_t serve_api_get_plannings(httpd_req_t *req, struct re_result *captures)
+enum planning_import_member
 {
-    int version = re_get_int(captures, 1);
-    ESP_LOGD(TAG, "serve_api_get_plannings version=%i", version);
-    if (version != 1)
-        return httpd_resp_send_404(req);
+    PLANNING_IMPORT_MEMBER_DOW = 1 << 0,
+    PLANNING_IMPORT_MEMBER_HOUR = 1 << 1,
+    PLANNING_IMPORT_MEMBER_MINUTE = 1 << 2,
+    PLANNING_IMPORT_MEMBER_ORDER = 1 << 3,
+    PLANNING_IMPORT_MEMBER_ALL = (1 << 4) - 1,
+};
+
+struct planning_import
+{
+    struct json_stream js;
+    const char *error;
+    // depth of an ignored container, 0 if none
+    int skip_depth;
+    bool in_slots;
+    bool slots_found;
+    char key[PLANNING_IMPORT_KEY_LEN];
+    int members;
+    struct ofp_planning_slot current;
+    int count;
+    struct ofp_planning_slot slots[OFP_MAX_PLANNING_SLOT_COUNT];
+};
 
-    struct ofp_planning_list *plan_list = ofp_planning_list_get();
-    if (plan_list == NULL)
+/***************************************************************************/
+
+void api_plannings_add_slots(cJSON *parent, struct ofp_planning *plan)
+{
+    cJSON *slots = cJSON_AddArrayToObject(parent, json_key_slots);
+    for (int i = 0; i < OFP_MAX_PLANNING_SLOT_COUNT; i++)
     {
-        ESP_LOGW(TAG, "No planning list available");
-        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Planning list not initialized");
+        struct ofp_planning_slot *slot = plan->slots[i];
+        if (slot == NULL)
+            continue;
+
+        const struct ofp_order_info *info = ofp_order_info_by_num_id(slot->order_id);
+        if (info == NULL)
+        {
+            ESP_LOGW(TAG, "Invalid order id %i found in slot %ih%i, skipping it", slot->order_id, slot->hour, slot->minute);
+            continue;
+        }
+
+        cJSON *s = cJSON_CreateObject();
+        cJSON_AddItemToArray(slots, s);
+        cJSON_AddNumberToObject(s, json_key_id, slot->id);
+        cJSON_AddNumberToObject(s, json_key_dow, slot->dow);
+        cJSON_AddNumberToObject(s, json_key_hour, slot->hour);
+        cJSON_AddNumberToObject(s, json_key_minute, slot->minute);
+        cJSON_AddStringToObject(s, json_key_order, info->id);
     }
+}
 
-    cJSON *root = cJSON_CreateObject();
+void api_plannings_add_plannings(cJSON *root, struct ofp_planning_list *plan_list, bool with_slots)
+{
     cJSON *plannings = cJSON_AddArrayToObject(root, json_key_plannings);
 
     for (int i = 0; i < OFP_MAX_PLANNING_COUNT; i++)
@@ -36,8 +82,30 @@ esp_err_t serve_api_get_plannings(httpd_req_t *req, struct re_result *captures)
         cJSON_AddItemToArray(plannings, planning);
         cJSON_AddNumberToObject(planning, stor_key_id, plan->id);
         cJSON_AddStringToObject(planning, stor_key_name, plan->description);
+        if (with_slots)
+            api_plannings_add_slots(planning, plan);
+    }
+}
+
+/***************************************************************************/
+
+esp_err_t serve_api_get_plannings(httpd_req_t *req, struct re_result *captures)
+{
+    int version = re_get_int(captures, 1);
+    ESP_LOGD(TAG, "serve_api_get_plannings version=%i", version);
+    if (version != 1)
+        return webserver_resp_send_404(req);
+
+    struct ofp_planning_list *plan_list = ofp_planning_list_get();
+    if (plan_list == NULL)
+    {
+        ESP_LOGW(TAG, "No planning list available");
+        return webserver_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Planning list not initialized");
     }
 
+    cJSON *root = cJSON_CreateObject();
+    api_plannings_add_plannings(root, plan_list, false);
+
     esp_err_t result = serve_json(req, root);
     cJSON_Delete(root);
     return result;
@@ -48,13 +116,13 @@ esp_err_t serve_api_post_plannings(httpd_req_t *req, struct re_result *captures)
     int version = re_get_int(captures, 1);
     ESP_LOGD(TAG, "serve_api_post_plannings version=%i", version);
     if (version != 1)
-        return httpd_resp_send_404(req);
+        return webserver_resp_send_404(req);
 
     struct ofp_planning_list *plan_list = ofp_planning_list_get();
     if (plan_list == NULL)
     {
         ESP_LOGW(TAG, "No planning list available");
-        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Planning list not initialized");
+        return webserver_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Planning list not initialized");
     }
 
     // read
@@ -69,11 +137,11 @@ esp_err_t serve_api_post_plannings(httpd_req_t *req, struct re_result *captures)
     cJSON *root = cJSON_Parse(buf);
 
     // cleanup
-    free(buf);
+    scoped_free(buf);
 
     // parse error
     if (root == NULL)
-        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Failed parsing JSON body");
+        return webserver_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Failed parsing JSON body");
 
     // name is required
     char *name = NULL;
@@ -81,7 +149,7 @@ esp_err_t serve_api_post_plannings(httpd_req_t *req, struct re_result *captures)
     {
         ESP_LOGD(TAG, "Invalid name");
         cJSON_Delete(root);
-        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid name");
+        return webserver_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid name");
     }
 
     ESP_LOGV(TAG, "name: %s", name);
@@ -89,14 +157,14 @@ esp_err_t serve_api_post_plannings(httpd_req_t *req, struct re_result *captures)
     {
         ESP_LOGW(TAG, "Could not create new planning '%s'", name);
         cJSON_Delete(root);
-        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Could not create new planning");
+        return webserver_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Could not create new planning");
     }
     ESP_LOGV(TAG, "Planning created.");
 
     // not providing any matching element is not an error
 
     cJSON_Delete(root);
-    return httpd_resp_sendstr(req, "");
+    return webserver_resp_sendstr(req, "");
 }
 
 esp_err_t serve_api_get_plannings_id(httpd_req_t *req, struct re_result *captures)
@@ -105,13 +173,13 @@ esp_err_t serve_api_get_plannings_id(httpd_req_t *req, struct re_result *capture
     int id = re_get_int(captures, 2);
     ESP_LOGD(TAG, "serve_api_get_plannings_id version=%i id=%i", version, id);
     if (version != 1)
-        return httpd_resp_send_404(req);
+        return webserver_resp_send_404(req);
 
     struct ofp_planning_list *plan_list = ofp_planning_list_get();
     if (plan_list == NULL)
     {
         ESP_LOGW(TAG, "No planning list available");
-        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Planning list not initialized");
+        return webserver_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Planning list not initialized");
     }
 
     ESP_LOGD(TAG, "planning_id %i", id);
@@ -119,32 +187,11 @@ esp_err_t serve_api_get_plannings_id(httpd_req_t *req, struct re_result *capture
     if (plan == NULL)
     {
         ESP_LOGD(TAG, "planning not found");
-        return httpd_resp_send_404(req);
+        return webserver_resp_send_404(req);
     }
 
     cJSON *root = cJSON_CreateObject();
-    cJSON *slots = cJSON_AddArrayToObject(root, json_key_slots);
-    for (int i = 0; i < OFP_MAX_PLANNING_SLOT_COUNT; i++)
-    {
-        struct ofp_planning_slot *slot = plan->slots[i];
-        if (slot == NULL)
-            continue;
-
-        const struct ofp_order_info *info = ofp_order_info_by_num_id(slot->order_id);
-        if (info == NULL)
-        {
-            ESP_LOGW(TAG, "Invalid order id %i found in slot %ih%i, skipping it", slot->order_id, slot->hour, slot->minute);
-            continue;
-        }
-
-        cJSON *s = cJSON_CreateObject();
-        cJSON_AddItemToArray(slots, s);
-        cJSON_AddNumberToObject(s, json_key_id, slot->id);
-        cJSON_AddNumberToObject(s, json_key_dow, slot->dow);
-        cJSON_AddNumberToObject(s, json_key_hour, slot->hour);
-        cJSON_AddNumberToObject(s, json_key_minute, slot->minute);
-        cJSON_AddStringToObject(s, json_key_order, info->id);
-    }
+    api_plannings_add_slots(root, plan);
 
     esp_err_t result = serve_json(req, root);
     cJSON_Delete(root);
@@ -157,11 +204,11 @@ esp_err_t serve_api_patch_plannings_id(httpd_req_t *req, struct re_result *captu
     int id = re_get_int(captures, 2);
     ESP_LOGD(TAG, "serve_api_patch_plannings_id version=%i id=%i", version, id);
     if (version != 1)
-        return httpd_resp_send_404(req);
+        return webserver_resp_send_404(req);
 
     struct ofp_planning *plan = ofp_planning_list_find_planning_by_id(id);
     if (plan == NULL)
-        return httpd_resp_send_404(req);
+        return webserver_resp_send_404(req);
 
     // read
     char *buf = webserver_get_request_data_atomic(req);
@@ -176,11 +223,11 @@ esp_err_t serve_api_patch_plannings_id(httpd_req_t *req, struct re_result *captu
     cJSON *root = cJSON_Parse(buf);
 
     // cleanup
-    free(buf);
+    scoped_free(buf);
 
     // parse error
     if (root == NULL)
-        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Failed parsing JSON body");
+        return webserver_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Failed parsing JSON body");
 
     // name is optional
     char *name = NULL;
@@ -188,20 +235,245 @@ esp_err_t serve_api_patch_plannings_id(httpd_req_t *req, struct re_result *captu
     {
         ESP_LOGD(TAG, "Invalid name");
         cJSON_Delete(root);
-        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid name");
+        return webserver_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid name");
     }
 
     if (name != NULL && !ofp_planning_change_description(plan->id, name))
     {
         ESP_LOGW(TAG, "Could not set description for planning %i: %s", plan->id, name);
         cJSON_Delete(root);
-        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Could not set description for planning");
+        return webserver_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Could not set description for planning");
     }
 
     // not providing any matching element is not an error
 
     cJSON_Delete(root);
-    return httpd_resp_sendstr(req, "");
+    return webserver_resp_sendstr(req, "");
+}
+
+static bool planning_import_fail(struct planning_import *imp, const char *error)
+{
+    ESP_LOGD(TAG, "Planning import failed: %s", error);
+    imp->error = error;
+    return false;
+}
+
+/* sets a member of the slot being parsed */
+static bool planning_import_slot_member(struct planning_import *imp, enum json_stream_token token, const char *value)
+{
+    int itmp;
+
+    if (strcmp(imp->key, json_key_order) == 0)
+    {
+        if (token != JSON_STREAM_TOKEN_STRING)
+            return planning_import_fail(imp, "Invalid order");
+
+        const struct ofp_order_info *info = ofp_order_info_by_str_id((char *)value);
+        if (info == NULL)
+            return planning_import_fail(imp, "Invalid order");
+
+        imp->current.order_id = info->order_id;
+        imp->members |= PLANNING_IMPORT_MEMBER_ORDER;
+        return true;
+    }
+
+    if (strcmp(imp->key, json_key_dow) == 0)
+    {
+        if (token != JSON_STREAM_TOKEN_NUMBER || !parse_int(value, &itmp) || !ofp_day_of_week_is_valid(itmp))
+            return planning_import_fail(imp, "Invalid dow");
+        imp->current.dow = itmp;
+        imp->members |= PLANNING_IMPORT_MEMBER_DOW;
+        return true;
+    }
+
+    if (strcmp(imp->key, json_key_hour) == 0)
+    {
+        if (token != JSON_STREAM_TOKEN_NUMBER || !parse_int(value, &itmp) || itmp < 0 || itmp >= 24)
+            return planning_import_fail(imp, "Invalid hour");
+        imp->current.hour = itmp;
+        imp->members |= PLANNING_IMPORT_MEMBER_HOUR;
+        return true;
+    }
+
+    if (strcmp(imp->key, json_key_minute) == 0)
+    {
+        if (token != JSON_STREAM_TOKEN_NUMBER || !parse_int(value, &itmp) || itmp < 0 || itmp >= 60)
+            return planning_import_fail(imp, "Invalid minute");
+        imp->current.minute = itmp;
+        imp->members |= PLANNING_IMPORT_MEMBER_MINUTE;
+        return true;
+    }
+
+    // other members (like exported slot IDs) are ignored
+    return true;
+}
+
+/*
+ * Expects { "slots": [ { "dow": 0, "hour": 0, "minute": 0, "order": "offload" }, ... ] }
+ *
+ * Depths: root members at 1, slots at 2, slot members at 3
+ */
+static bool planning_import_token(void *ctx, int depth, enum json_stream_token token, const char *value)
+{
+    struct planning_import *imp = ctx;
+
+    // ignore unknown containers entirely
+    if (imp->skip_depth > 0)
+    {
+        if (depth == imp->skip_depth && (token == JSON_STREAM_TOKEN_OBJECT_END || token == JSON_STREAM_TOKEN_ARRAY_END))
+            imp->skip_depth = 0;
+        return true;
+    }
+
+    bool begin = token == JSON_STREAM_TOKEN_OBJECT_BEGIN || token == JSON_STREAM_TOKEN_ARRAY_BEGIN;
+    bool end = token == JSON_STREAM_TOKEN_OBJECT_END || token == JSON_STREAM_TOKEN_ARRAY_END;
+
+    switch (depth)
+    {
+    case 0:
+        return planning_import_fail(imp, "Expected an object");
+
+    case 1:
+        if (token == JSON_STREAM_TOKEN_ARRAY_BEGIN)
+            return planning_import_fail(imp, "Expected an object");
+        if (token == JSON_STREAM_TOKEN_KEY)
+            strlcpy(imp->key, value, sizeof(imp->key));
+        return true;
+
+    case 2:
+        if (!imp->in_slots)
+        {
+            if (token == JSON_STREAM_TOKEN_ARRAY_BEGIN && strcmp(imp->key, json_key_slots) == 0 && !imp->slots_found)
+            {
+                imp->in_slots = true;
+                return true;
+            }
+            imp->skip_depth = depth;
+            return true;
+        }
+        if (token == JSON_STREAM_TOKEN_ARRAY_END)
+        {
+            imp->in_slots = false;
+            imp->slots_found = true;
+            return true;
+        }
+        return planning_import_fail(imp, "Invalid slot");
+
+    case 3:
+        if (token == JSON_STREAM_TOKEN_ARRAY_BEGIN)
+            return planning_import_fail(imp, "Invalid slot");
+        if (token == JSON_STREAM_TOKEN_OBJECT_BEGIN)
+        {
+            if (imp->count >= OFP_MAX_PLANNING_SLOT_COUNT)
+                return planning_import_fail(imp, "Too many slots");
+            memset(&imp->current, 0, sizeof(imp->current));
+            imp->members = 0;
+            return true;
+        }
+        if (token == JSON_STREAM_TOKEN_OBJECT_END)
+        {
+            if (imp->members != PLANNING_IMPORT_MEMBER_ALL)
+                return planning_import_fail(imp, "Missing slot value");
+            imp->slots[imp->count++] = imp->current;
+            return true;
+        }
+        if (token == JSON_STREAM_TOKEN_KEY)
+        {
+            strlcpy(imp->key, value, sizeof(imp->key));
+            return true;
+        }
+        return planning_import_slot_member(imp, token, value);
+
+    default:
+        if (begin)
+            imp->skip_depth = depth;
+        else if (end)
+            return planning_import_fail(imp, "Unbalanced document");
+        return true;
+    }
+}
+
+static bool planning_import_consume(void *ctx, const char *data, size_t len)
+{
+    struct planning_import *imp = ctx;
+    return json_stream_feed(&imp->js, data, len);
+}
+
+/*
+ * Replaces all slots of a planning
+ *
+ * The body is parsed while it is received, so that the request size
+ * is not bound by the size of the buffers used for single operations
+ */
+esp_err_t serve_api_put_plannings_id(httpd_req_t *req, struct re_result *captures)
+{
+    int version = re_get_int(captures, 1);
+    int id = re_get_int(captures, 2);
+    ESP_LOGD(TAG, "serve_api_put_plannings_id version=%i id=%i", version, id);
+    if (version != 1)
+        return webserver_resp_send_404(req);
+
+    if (ofp_planning_list_find_planning_by_id(id) == NULL)
+        return webserver_resp_send_404(req);
+
+    if (req->content_len > CONFIG_OFP_UI_WEBSERVER_DATA_MAX_SIZE_PLANNING)
+    {
+        ESP_LOGD(TAG, "Request body (%i) is too large", req->content_len);
+        return webserver_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Request body too large");
+    }
+
+    // alloc and zero members
+    struct planning_import *imp = calloc(1, sizeof(struct planning_import));
+    if (imp == NULL)
+    {
+        ESP_LOGW(TAG, "calloc failed");
+        return webserver_resp_send_500(req);
+    }
+    json_stream_init(&imp->js, planning_import_token, imp);
+
+    // read and parse
+    esp_err_t result;
+    char buf[PLANNING_IMPORT_BLOCK_SIZE];
+    esp_err_t err = webserver_stream_request_data(req, buf, sizeof(buf), planning_import_consume, imp);
+    if (err == ESP_ERR_INVALID_ARG)
+    {
+        result = webserver_resp_send_err(req, HTTPD_400_BAD_REQUEST, imp->error ? imp->error : "Failed parsing JSON body");
+        goto cleanup;
+    }
+    if (err != ESP_OK)
+    {
+        // response already sent
+        result = ESP_FAIL;
+        goto cleanup;
+    }
+
+    if (!json_stream_finish(&imp->js))
+    {
+        result = webserver_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Failed parsing JSON body");
+        goto cleanup;
+    }
+
+    if (!imp->slots_found)
+    {
+        result = webserver_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Missing slots");
+        goto cleanup;
+    }
+
+    ESP_LOGV(TAG, "Parsed %i slots", imp->count);
+
+    // replace
+    if (!ofp_planning_replace_slots(id, imp->slots, imp->count))
+    {
+        ESP_LOGD(TAG, "Could not replace slots of planning %i", id);
+        result = webserver_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid slots (duplicate or missing first slot)");
+        goto cleanup;
+    }
+
+    result = webserver_resp_sendstr(req, "");
+
+cleanup:
+    free(imp);
+    return result;
 }
 
 esp_err_t serve_api_delete_plannings_id(httpd_req_t *req, struct re_result *captures)
@@ -210,15 +482,15 @@ esp_err_t serve_api_delete_plannings_id(httpd_req_t *req, struct re_result *capt
     int id = re_get_int(captures, 2);
     ESP_LOGD(TAG, "serve_api_delete_plannings_id version=%i id=%i", version, id);
     if (version != 1)
-        return httpd_resp_send_404(req);
+        return webserver_resp_send_404(req);
 
     if (ofp_planning_list_find_planning_by_id(id) == NULL)
-        return httpd_resp_send_404(req);
+        return webserver_resp_send_404(req);
 
     if (!ofp_planning_list_remove_planning(id))
-        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Could not remove planning");
+        return webserver_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Could not remove planning");
 
-    return httpd_resp_sendstr(req, "");
+    return webserver_resp_sendstr(req, "");
 }
 
 esp_err_t serve_api_post_plannings_id_slots(httpd_req_t *req, struct re_result *captures)
@@ -227,7 +499,7 @@ esp_err_t serve_api_post_plannings_id_slots(httpd_req_t *req, struct re_result *
     int id = re_get_int(captures, 2);
     ESP_LOGD(TAG, "serve_api_post_plannings_id_slots version=%i id=%i", version, id);
     if (version != 1)
-        return httpd_resp_send_404(req);
+        return webserver_resp_send_404(req);
 
     // read
     char *buf = webserver_get_request_data_atomic(req);
@@ -242,7 +514,7 @@ esp_err_t serve_api_post_plannings_id_slots(httpd_req_t *req, struct re_result *
     cJSON *root = cJSON_Parse(buf);
 
     // cleanup
-    free(buf);
+    scoped_free(buf);
 
     int itmp;
 
@@ -251,7 +523,7 @@ esp_err_t serve_api_post_plannings_id_slots(httpd_req_t *req, struct re_result *
     {
         ESP_LOGD(TAG, "Invalid dow");
         cJSON_Delete(root);
-        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid dow");
+        return webserver_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid dow");
     }
     enum ofp_day_of_week dow = itmp;
     ESP_LOGV(TAG, "dow: %i", dow);
@@ -261,7 +533,7 @@ esp_err_t serve_api_post_plannings_id_slots(httpd_req_t *req, struct re_result *
     {
         ESP_LOGD(TAG, "Invalid hour");
         cJSON_Delete(root);
-        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid hour");
+        return webserver_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid hour");
     }
     int hour = itmp;
     ESP_LOGV(TAG, "hour: %i", hour);
@@ -271,7 +543,7 @@ esp_err_t serve_api_post_plannings_id_slots(httpd_req_t *req, struct re_result *
     {
         ESP_LOGD(TAG, "Invalid minute");
         cJSON_Delete(root);
-        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid minute");
+        return webserver_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid minute");
     }
     int minute = itmp;
     ESP_LOGV(TAG, "minute: %i", minute);
@@ -282,14 +554,14 @@ esp_err_t serve_api_post_plannings_id_slots(httpd_req_t *req, struct re_result *
     {
         ESP_LOGD(TAG, "Invalid order");
         cJSON_Delete(root);
-        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid order");
+        return webserver_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid order");
     }
 
     const struct ofp_order_info *info = ofp_order_info_by_str_id(order);
     if (info == NULL)
     {
         ESP_LOGD(TAG, "Invalid order %s", order);
-        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid order");
+        return webserver_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid order");
     }
 
     ESP_LOGV(TAG, "dow %i hour %i minute %i order_id %i", dow, hour, minute, info->order_id);
@@ -301,10 +573,10 @@ esp_err_t serve_api_post_plannings_id_slots(httpd_req_t *req, struct re_result *
     if (!ofp_planning_add_new_slot(id, dow, hour, minute, info->order_id))
     {
         ESP_LOGW(TAG, "Could not add new slot to planning %i", id);
-        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Could not add new slot to planning");
+        return webserver_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Could not add new slot to planning");
     }
 
-    return httpd_resp_sendstr(req, "");
+    return webserver_resp_sendstr(req, "");
 }
 
 esp_err_t serve_api_patch_plannings_id_slots_id(httpd_req_t *req, struct re_result *captures)
@@ -314,7 +586,7 @@ esp_err_t serve_api_patch_plannings_id_slots_id(httpd_req_t *req, struct re_resu
     int slot_id = re_get_int(captures, 3);
     ESP_LOGD(TAG, "serve_api_patch_plannings_id_slots_id version=%i id=%i slot_id=%i", version, id, slot_id);
     if (version != 1)
-        return httpd_resp_send_404(req);
+        return webserver_resp_send_404(req);
 
     // read
     char *buf = webserver_get_request_data_atomic(req);
@@ -328,11 +600,11 @@ esp_err_t serve_api_patch_plannings_id_slots_id(httpd_req_t *req, struct re_resu
     cJSON *root = cJSON_Parse(buf);
 
     // cleanup
-    free(buf);
+    scoped_free(buf);
 
     // parse error
     if (root == NULL)
-        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Failed parsing JSON body");
+        return webserver_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Failed parsing JSON body");
 
     int itmp;
 
@@ -345,7 +617,7 @@ esp_err_t serve_api_patch_plannings_id_slots_id(httpd_req_t *req, struct re_resu
         {
             ESP_LOGD(TAG, "Invalid dow");
             cJSON_Delete(root);
-            return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid dow");
+            return webserver_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid dow");
         }
         dow = itmp;
         ESP_LOGV(TAG, "dow: %i", dow);
@@ -353,7 +625,7 @@ esp_err_t serve_api_patch_plannings_id_slots_id(httpd_req_t *req, struct re_resu
         {
             ESP_LOGD(TAG, "Could not set planning dow %i", dow);
             cJSON_Delete(root);
-            return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Could not set slot dow");
+            return webserver_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Could not set slot dow");
         }
     }
 
@@ -366,7 +638,7 @@ esp_err_t serve_api_patch_plannings_id_slots_id(httpd_req_t *req, struct re_resu
         {
             ESP_LOGD(TAG, "Invalid hour");
             cJSON_Delete(root);
-            return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid hour");
+            return webserver_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid hour");
         }
         hour = itmp;
         ESP_LOGV(TAG, "hour: %i", hour);
@@ -374,7 +646,7 @@ esp_err_t serve_api_patch_plannings_id_slots_id(httpd_req_t *req, struct re_resu
         {
             ESP_LOGD(TAG, "Could not set planning hour %i", hour);
             cJSON_Delete(root);
-            return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Could not set slot hour");
+            return webserver_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Could not set slot hour");
         }
     }
 
@@ -387,7 +659,7 @@ esp_err_t serve_api_patch_plannings_id_slots_id(httpd_req_t *req, struct re_resu
         {
             ESP_LOGD(TAG, "Invalid minute");
             cJSON_Delete(root);
-            return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid minute");
+            return webserver_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid minute");
         }
         minute = itmp;
         ESP_LOGV(TAG, "minute: %i", minute);
@@ -395,7 +667,7 @@ esp_err_t serve_api_patch_plannings_id_slots_id(httpd_req_t *req, struct re_resu
         {
             ESP_LOGD(TAG, "Could not set planning minute %i", minute);
             cJSON_Delete(root);
-            return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Could not set slot minute");
+            return webserver_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Could not set slot minute");
         }
     }
 
@@ -408,14 +680,14 @@ esp_err_t serve_api_patch_plannings_id_slots_id(httpd_req_t *req, struct re_resu
         {
             ESP_LOGD(TAG, "Invalid order");
             cJSON_Delete(root);
-            return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid order");
+            return webserver_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid order");
         }
         ESP_LOGV(TAG, "order: %i", info->order_id);
         if (!ofp_planning_slot_set_order(id, slot_id, info->order_id))
         {
             ESP_LOGD(TAG, "Could not set slot order %i", info->order_id);
             cJSON_Delete(root);
-            return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Could not set slot order");
+            return webserver_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Could not set slot order");
         }
     }
 
@@ -423,7 +695,7 @@ esp_err_t serve_api_patch_plannings_id_slots_id(httpd_req_t *req, struct re_resu
 
     cJSON_Delete(root);
 
-    return httpd_resp_sendstr(req, "");
+    return webserver_resp_sendstr(req, "");
 }
 
 esp_err_t serve_api_delete_plannings_id_slots_id(httpd_req_t *req, struct re_result *captures)
@@ -433,13 +705,13 @@ esp_err_t serve_api_delete_plannings_id_slots_id(httpd_req_t *req, struct re_res
     int slot_id = re_get_int(captures, 3);
     ESP_LOGD(TAG, "serve_api_delete_plannings_id_slots_id version=%i id=%i slot_id=%i", version, id, slot_id);
     if (version != 1)
-        return httpd_resp_send_404(req);
+        return webserver_resp_send_404(req);
 
     if (!ofp_planning_remove_existing_slot(id, slot_id))
     {
         ESP_LOGW(TAG, "Could not remove slot %i from planning %i", slot_id, id);
-        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Could not remove slot");
+        return webserver_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Could not remove slot");
     }
 
-    return httpd_resp_sendstr(req, "");
+    return webserver_resp_sendstr(req, "");
 }
\ No newline at end of file
@@ -1,15 +1,23 @@
 #ifndef API_PLANNINGS_H
 #define API_PLANNINGS_H
 
+#include <stdbool.h>
+#include <cjson.h>
 #include <esp_https_server.h>
 
 #include "utils.h"
+#include "ofp.h"
+
+/* JSON builders, shared with the bootstrap entrypoint */
+void api_plannings_add_slots(cJSON *parent, struct ofp_planning *plan);
+void api_plannings_add_plannings(cJSON *root, struct ofp_planning_list *plan_list, bool with_slots);
 
 esp_err_t serve_api_get_plannings(httpd_req_t *req, struct re_result *captures);
 esp_err_t serve_api_post_plannings(httpd_req_t *req, struct re_result *captures);
 
 esp_err_t serve_api_get_plannings_id(httpd_req_t *req, struct re_result *captures);
 esp_err_t serve_api_patch_plannings_id(httpd_req_t *req, struct re_result *captures);
+esp_err_t serve_api_put_plannings_id(httpd_req_t *req, struct re_result *captures);
 esp_err_t serve_api_delete_plannings_id(httpd_req_t *req, struct re_result *captures);
 
 esp_err_t serve_api_post_plannings_id_slots(httpd_req_t *req, struct re_result *captures);
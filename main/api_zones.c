@@ -1,24 +1,45 @@
+#include <stdlib.h>
 #include <cjson.h>
 #include <esp_log.h>
 
 #include "str.h"
 #include "ofp.h"
 #include "webserver.h"
-#include "api_accounts.h"
+#include "arena.h"
+#include "api_zones.h"
 #include "storage.h"
+#include "history.h"
+#include "usage.h"
 
 static const char TAG[] = "api_zones";
 
-/***************************************************************************/
+#define API_ZONES_HISTORY_CHUNK_LEN 512
+#define API_ZONES_HISTORY_ENTRY_MAX_LEN 64
+#define API_ZONES_HISTORY_QUERY_MAX_LEN 64
 
-esp_err_t serve_api_get_orders(httpd_req_t *req, struct re_result *captures)
+#define API_ZONES_SECONDS_PER_HOUR 3600.0
+#define API_ZONES_WATTS_PER_KW 1000.0
+#define API_ZONES_MAX_POWER 10000
+
+/* streaming state of a history request */
+struct api_zones_history
 {
-    int version = re_get_int(captures, 1);
-    ESP_LOGD(TAG, "serve_api_get_orders version=%i", version);
-    if (version != 1)
-        return httpd_resp_send_404(req);
+    httpd_req_t *req;
+    uint32_t from;
+    uint32_t to;
+    // run in progress at 'from', sent before the first transition within range
+    bool has_previous;
+    struct history_record previous;
+    int sent_count;
+    esp_err_t err;
+    size_t len;
+    char buf[API_ZONES_HISTORY_CHUNK_LEN];
+};
 
-    cJSON *root = cJSON_CreateObject();
+/***************************************************************************/
+
+void api_zones_add_orders(cJSON *root)
+{
     cJSON *orders = cJSON_AddArrayToObject(root, json_key_orders);
 
     for (int i = 0; i < HW_OFP_ORDER_ID_ENUM_SIZE; i++)
@@ -30,31 +51,19 @@ esp_err_t serve_api_get_orders(httpd_req_t *req, struct re_result *captures)
         cJSON_AddStringToObject(order, stor_key_class, info->class);
         cJSON_AddItemToArray(orders, order);
     }
-
-    httpd_resp_set_hdr(req, str_cache_control, str_private_max_age_600);
-
-    esp_err_t result = serve_json(req, root);
-    cJSON_Delete(root);
-    return result;
 }
 
-esp_err_t serve_api_get_zones(httpd_req_t *req, struct re_result *captures)
+bool api_zones_add_zones(cJSON *root)
 {
-    int version = re_get_int(captures, 1);
-    ESP_LOGD(TAG, "serve_api_get_zones version=%i", version);
-    if (version != 1)
-        return httpd_resp_send_404(req);
+    cJSON *zones = cJSON_AddArrayToObject(root, "zones");
 
     struct ofp_hw *hw = ofp_hw_get_current();
-
     if (hw == NULL)
     {
         ESP_LOGD(TAG, "no zones");
-        return httpd_resp_sendstr(req, "{ \"zones\": [] }");
+        return true;
     }
 
-    cJSON *root = cJSON_CreateObject();
-    cJSON *zones = cJSON_AddArrayToObject(root, "zones");
     for (int i = 0; i < hw->zone_set.count; i++)
     {
         struct ofp_zone *z = &hw->zone_set.zones[i];
@@ -70,58 +79,324 @@ esp_err_t serve_api_get_zones(httpd_req_t *req, struct re_result *captures)
         cJSON_AddStringToObject(zone, json_key_current, info->id);
 
         // mode
-        char buf[24]; // ":fixed:cozyminus1\0" length is 20 but upgrade to avoid warning about id being 16
-        switch (z->mode)
+        char buf[API_ZONES_MODE_MAX_LEN];
+        if (!api_zones_format_mode(z, buf, sizeof(buf)))
+            return false;
+        cJSON_AddStringToObject(zone, json_key_mode, buf);
+    }
+
+    return true;
+}
+
+void api_zones_add_override(cJSON *root)
+{
+    // get zone override from common namespace
+    enum ofp_order_id order_id;
+    bool active = ofp_override_get_order_id(&order_id);
+    const struct ofp_order_info *info = NULL;
+    if (active)
+    {
+        ESP_LOGV(TAG, "override is active");
+        info = ofp_order_info_by_num_id(order_id);
+    }
+
+    cJSON_AddStringToObject(root, stor_key_zone_override, info ? info->id : stor_val_none);
+}
+
+struct ofp_zone *api_zones_find_zone_by_id(const char *id)
+{
+    struct ofp_hw *hw = ofp_hw_get_current();
+    if (hw == NULL)
+        return NULL;
+
+    for (int i = 0; i < hw->zone_set.count; i++)
+    {
+        struct ofp_zone *candidate = &hw->zone_set.zones[i];
+        if (strcmp(candidate->id, id) == 0)
         {
-        case HW_OFP_ZONE_MODE_FIXED:
-            info = ofp_order_info_by_num_id(z->mode_data.order_id);
-            snprintf(buf, sizeof(buf), ":fixed:%s", info->id);
-            break;
-        case HW_OFP_ZONE_MODE_PLANNING:
-            snprintf(buf, sizeof(buf), ":planning:%i", z->mode_data.planning_id);
-            break;
-        default:
-            break;
-            return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Unknown zone mode");
+            ESP_LOGV(TAG, "zone found %i", i);
+            return candidate;
         }
-        cJSON_AddStringToObject(zone, json_key_mode, buf);
     }
+    return NULL;
+}
+
+/* formats ":fixed:<order>" or ":planning:<id>" mode strings */
+bool api_zones_format_mode(const struct ofp_zone *z, char *buf, size_t len)
+{
+    const struct ofp_order_info *info;
+    switch (z->mode)
+    {
+    case HW_OFP_ZONE_MODE_FIXED:
+        info = ofp_order_info_by_num_id(z->mode_data.order_id);
+        snprintf(buf, len, ":fixed:%s", info->id);
+        return true;
+    case HW_OFP_ZONE_MODE_PLANNING:
+        snprintf(buf, len, ":planning:%i", z->mode_data.planning_id);
+        return true;
+    default:
+        ESP_LOGW(TAG, "Unknown mode %i for zone %s", z->mode, z->id);
+        return false;
+    }
+}
+
+/*
+ * parses ":fixed:<order>" or ":planning:<id>" mode strings
+ * value is set to the order id or planning id depending on mode
+ * planning existence is NOT checked
+ */
+bool api_zones_parse_mode(const char *str, enum ofp_zone_mode *mode, int *value)
+{
+    struct re_result *res = re_match(parse_zone_mode_re_str, str);
+    if (res == NULL)
+        return false;
+
+    bool result = false;
+    if (res->count != 6)
+        goto cleanup;
+
+    char *fix = res->strings[2];
+    char *fix_id = res->strings[3];
+    char *plan = res->strings[4];
+    char *plan_id = res->strings[5];
+
+    if (fix != NULL && fix_id != NULL)
+    {
+        const struct ofp_order_info *info = ofp_order_info_by_str_id(fix_id);
+        if (info == NULL)
+        {
+            ESP_LOGD(TAG, "Value %s is not an order id", fix_id);
+            goto cleanup;
+        }
+        *mode = HW_OFP_ZONE_MODE_FIXED;
+        *value = info->order_id;
+        result = true;
+    }
+    else if (plan != NULL && plan_id != NULL)
+    {
+        *mode = HW_OFP_ZONE_MODE_PLANNING;
+        *value = atoi(plan_id);
+        result = true;
+    }
+    // no other valid case according to REGEX
+
+cleanup:
+    re_free(res);
+    return result;
+}
+
+/* sets then stores the zone mode */
+bool api_zones_apply_mode(struct ofp_zone *zone, enum ofp_zone_mode mode, int value)
+{
+    assert(zone != NULL);
+
+    ofp_lock();
+    bool result;
+    if (mode == HW_OFP_ZONE_MODE_FIXED)
+        result = ofp_zone_set_mode_fixed(zone, value);
+    else
+        result = ofp_zone_set_mode_planning(zone, value);
+    ofp_unlock();
+
+    // storage is written outside of the lock, which the control loop waits for
+    if (result)
+        result = ofp_zone_store(zone);
+
+    return result;
+}
+
+/* enables the override with the provided order (disables it if NULL) then stores it */
+void api_zones_apply_override(const struct ofp_order_info *info)
+{
+    if (info == NULL)
+        ofp_override_disable();
+    else
+        ofp_override_enable(info->order_id);
+    ofp_override_store();
+}
+
+/***************************************************************************/
+
+esp_err_t serve_api_get_orders(httpd_req_t *req, struct re_result *captures)
+{
+    int version = re_get_int(captures, 1);
+    ESP_LOGD(TAG, "serve_api_get_orders version=%i", version);
+    if (version != 1)
+        return webserver_resp_send_404(req);
+
+    cJSON *root = cJSON_CreateObject();
+    api_zones_add_orders(root);
+
+    httpd_resp_set_hdr(req, str_cache_control, str_private_max_age_600);
 
     esp_err_t result = serve_json(req, root);
     cJSON_Delete(root);
     return result;
 }
 
-esp_err_t serve_api_patch_zones_id(httpd_req_t *req, struct re_result *captures)
+esp_err_t serve_api_get_zones(httpd_req_t *req, struct re_result *captures)
+{
+    int version = re_get_int(captures, 1);
+    ESP_LOGD(TAG, "serve_api_get_zones version=%i", version);
+    if (version != 1)
+        return webserver_resp_send_404(req);
+
+    cJSON *root = cJSON_CreateObject();
+    if (!api_zones_add_zones(root))
+    {
+        cJSON_Delete(root);
+        return webserver_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Unknown zone mode");
+    }
+
+    esp_err_t result = serve_json(req, root);
+    cJSON_Delete(root);
+    return result;
+}
+
+/* reads an optional unsigned query parameter, returns false if invalid */
+static bool api_zones_get_query_u32(const char *query, const char *key, uint32_t *value)
+{
+    char buf[OFP_MAX_LEN_INT32];
+    if (query == NULL || httpd_query_key_value(query, key, buf, sizeof(buf)) != ESP_OK)
+        return true;
+
+    char *end = NULL;
+    unsigned long v = strtoul(buf, &end, 10);
+    if (end == buf || *end != '\0' || v > UINT32_MAX)
+        return false;
+
+    *value = v;
+    return true;
+}
+
+static void api_zones_history_flush(struct api_zones_history *h)
+{
+    if (h->err != ESP_OK || h->len == 0)
+        return;
+
+    h->err = webserver_resp_send_chunk(h->req, h->buf, h->len);
+    h->len = 0;
+}
+
+static void api_zones_history_append(struct api_zones_history *h, const struct history_record *r)
+{
+    if (r->order >= HW_OFP_ORDER_ID_ENUM_SIZE)
+        return;
+
+    if (h->len + API_ZONES_HISTORY_ENTRY_MAX_LEN > sizeof(h->buf))
+        api_zones_history_flush(h);
+
+    const struct ofp_order_info *info = ofp_order_info_by_num_id(r->order);
+    h->len += snprintf(h->buf + h->len, sizeof(h->buf) - h->len, "%s{\"start\":%u,\"order\":\"%s\"}", h->sent_count > 0 ? "," : "", r->timestamp, info->id);
+    h->sent_count++;
+}
+
+static bool api_zones_history_record(void *ctx, const struct history_record *r)
+{
+    struct api_zones_history *h = ctx;
+
+    if (r->timestamp < h->from)
+    {
+        h->previous = *r;
+        h->has_previous = true;
+        return true;
+    }
+
+    // timestamps are not monotonic until the clock is synchronized, so keep iterating
+    if (r->timestamp > h->to)
+        return true;
+
+    if (h->has_previous)
+    {
+        api_zones_history_append(h, &h->previous);
+        h->has_previous = false;
+    }
+    api_zones_history_append(h, r);
+    return h->err == ESP_OK;
+}
+
+esp_err_t serve_api_get_zones_id_history(httpd_req_t *req, struct re_result *captures)
 {
     int version = re_get_int(captures, 1);
     char *id = re_get_string(captures, 2);
-    ESP_LOGD(TAG, "serve_api_patch_zones_id version=%i id=%s", version, id);
+    ESP_LOGD(TAG, "serve_api_get_zones_id_history version=%i id=%s", version, id);
     if (version != 1)
-        return httpd_resp_send_404(req);
+        return webserver_resp_send_404(req);
 
     // check zone
     struct ofp_hw *hw = ofp_hw_get_current();
     if (hw == NULL)
     {
         ESP_LOGD(TAG, "No hardware selected");
-        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "No hardware selected");
+        return webserver_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "No hardware selected");
     }
-    struct ofp_zone *zone = NULL, *candidate;
-    for (int i = 0; i < hw->zone_set.count; i++)
+    struct ofp_zone *zone = api_zones_find_zone_by_id(id);
+    if (zone == NULL)
     {
-        candidate = &hw->zone_set.zones[i];
-        if (strcmp(candidate->id, id) == 0)
-        {
-            ESP_LOGV(TAG, "zone found %i", i);
-            zone = candidate;
-            break;
-        }
+        ESP_LOGD(TAG, "zone not found");
+        return webserver_resp_send_404(req);
     }
+
+    // range, in seconds since epoch
+    uint32_t from = 0;
+    uint32_t to = UINT32_MAX;
+    char query[API_ZONES_HISTORY_QUERY_MAX_LEN];
+    bool has_query = httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK;
+    if (!api_zones_get_query_u32(has_query ? query : NULL, "from", &from) || !api_zones_get_query_u32(has_query ? query : NULL, "to", &to) || from > to)
+        return webserver_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid range");
+
+    struct api_zones_history *h = calloc(1, sizeof(struct api_zones_history));
+    if (h == NULL)
+        return webserver_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Out of memory");
+    h->req = req;
+    h->from = from;
+    h->to = to;
+
+    httpd_resp_set_type(req, http_content_type_json);
+    httpd_resp_set_hdr(req, str_cache_control, str_private_no_store);
+
+    // from here on, response is streamed and errors can only abort it
+    h->len = snprintf(h->buf, sizeof(h->buf), "{\"zone\":\"%s\",\"history\":[", zone->id);
+    history_query(zone - hw->zone_set.zones, api_zones_history_record, h);
+
+    // no transition within range, but one was in progress
+    if (h->has_previous)
+        api_zones_history_append(h, &h->previous);
+
+    if (h->len + 2 > sizeof(h->buf))
+        api_zones_history_flush(h);
+    h->len += snprintf(h->buf + h->len, sizeof(h->buf) - h->len, "]}");
+    api_zones_history_flush(h);
+
+    esp_err_t err = h->err;
+    free(h);
+    if (err != ESP_OK)
+        return err;
+
+    // terminate chunked response
+    return webserver_resp_send_chunk(req, NULL, 0);
+}
+
+esp_err_t serve_api_patch_zones_id(httpd_req_t *req, struct re_result *captures)
+{
+    int version = re_get_int(captures, 1);
+    char *id = re_get_string(captures, 2);
+    ESP_LOGD(TAG, "serve_api_patch_zones_id version=%i id=%s", version, id);
+    if (version != 1)
+        return webserver_resp_send_404(req);
+
+    // check zone
+    struct ofp_hw *hw = ofp_hw_get_current();
+    if (hw == NULL)
+    {
+        ESP_LOGD(TAG, "No hardware selected");
+        return webserver_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "No hardware selected");
+    }
+    struct ofp_zone *zone = api_zones_find_zone_by_id(id);
     if (zone == NULL)
     {
         ESP_LOGD(TAG, "zone not found");
-        return httpd_resp_send_404(req);
+        return webserver_resp_send_404(req);
     }
 
     // read
@@ -136,7 +411,7 @@ esp_err_t serve_api_patch_zones_id(httpd_req_t *req, struct re_result *captures)
     cJSON *root = cJSON_Parse(buf);
 
     // cleanup
-    free(buf);
+    scoped_free(buf);
 
     // parse error
     if (root == NULL)
@@ -155,104 +430,185 @@ esp_err_t serve_api_patch_zones_id(httpd_req_t *req, struct re_result *captures)
              */
             ESP_LOGD(TAG, "JSON parse error, before: %s", error_ptr);
         }
-        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Failed parsing JSON body");
+        return webserver_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Failed parsing JSON body");
     }
 
-    bool need_storing = false;
+    // every field is validated before anything changes, so that a PATCH applies entirely or not at all
 
     // optional description
-
-    // name is optional
     char *desc = NULL;
-    if (cjson_get_child_string(root, json_key_description, &desc) == JSON_HELPER_RESULT_INVALID)
+    if (cjson_get_child_string(root, json_key_description, &desc) == JSON_HELPER_RESULT_INVALID || (desc != NULL && strlen(desc) + 1 > OFP_MAX_LEN_DESCRIPTION))
     {
         ESP_LOGD(TAG, "Invalid description");
         cJSON_Delete(root);
-        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid description");
-    }
-    if (desc != NULL && !ofp_zone_set_description(zone, desc))
-    {
-        ESP_LOGW(TAG, "Could not set zone description");
-        cJSON_Delete(root);
-        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Could not set zone description");
+        return webserver_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid description");
     }
 
     // optional mode
     cJSON *mode = cJSON_GetObjectItemCaseSensitive(root, json_key_mode);
+    enum ofp_zone_mode zone_mode;
+    int mode_value;
     if (mode != NULL)
     {
         if (!cJSON_IsString(mode) || (mode->valuestring == NULL))
         {
             ESP_LOGD(TAG, "Invalid value for element %s", json_key_mode);
             cJSON_Delete(root);
-            return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid parameter");
+            return webserver_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid parameter");
         }
 
         ESP_LOGV(TAG, "mode: %s", mode->valuestring);
-        struct re_result *res = re_match(parse_zone_mode_re_str, mode->valuestring);
-        if (res == NULL || res->count != 6)
+        if (!api_zones_parse_mode(mode->valuestring, &zone_mode, &mode_value))
         {
-            ESP_LOGD(TAG, "No match for mode in value %s for element %s", mode->valuestring, json_key_mode);
+            ESP_LOGD(TAG, "Invalid mode %s for element %s", mode->valuestring, json_key_mode);
             cJSON_Delete(root);
-            return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid parameter");
+            return webserver_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid parameter");
         }
+    }
 
-        char *fix = res->strings[2];
-        char *fix_id = res->strings[3];
-        char *plan = res->strings[4];
-        char *plan_id = res->strings[5];
+    // optional heater power in watts, for energy estimates and load shedding
+    int power;
+    enum json_helper_result power_result = cjson_get_child_int(root, json_key_power, &power);
+    if (power_result == JSON_HELPER_RESULT_INVALID || (power_result == JSON_HELPER_RESULT_SUCCESS && (power < 0 || power > API_ZONES_MAX_POWER)))
+    {
+        ESP_LOGD(TAG, "Invalid power");
+        cJSON_Delete(root);
+        return webserver_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid power");
+    }
 
-        if (fix != NULL && fix_id != NULL)
+    // not providing any matching element is not an error
+    if (desc == NULL && mode == NULL && power_result != JSON_HELPER_RESULT_SUCCESS)
+    {
+        cJSON_Delete(root);
+        return webserver_resp_sendstr(req, "");
+    }
+
+    // the planning must still exist when applying, and other tasks see all changes at once
+    ofp_lock();
+    if (mode != NULL && zone_mode == HW_OFP_ZONE_MODE_PLANNING && ofp_planning_list_find_planning_by_id(mode_value) == NULL)
+    {
+        ofp_unlock();
+        ESP_LOGD(TAG, "Unknown planning %i", mode_value);
+        cJSON_Delete(root);
+        return webserver_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid parameter");
+    }
+
+    // setters cannot fail on validated values
+    if (desc != NULL)
+        ofp_zone_set_description(zone, desc);
+    if (mode != NULL && zone_mode == HW_OFP_ZONE_MODE_FIXED)
+        ofp_zone_set_mode_fixed(zone, mode_value);
+    else if (mode != NULL)
+        ofp_zone_set_mode_planning(zone, mode_value);
+    if (power_result == JSON_HELPER_RESULT_SUCCESS)
+        ofp_zone_set_power(zone, power);
+    ofp_unlock();
+
+    // cleanup
+    cJSON_Delete(root);
+
+    // storage is written outside of the lock, which the control loop waits for
+    bool stored = ofp_zone_store(zone);
+
+    if (!stored)
+    {
+        ESP_LOGW(TAG, "Could store updated zone");
+        return webserver_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Could store updated zone");
+    }
+
+    return webserver_resp_sendstr(req, "");
+}
+
+/* seconds spent in each order, in the order of the orders array */
+static void api_zones_add_usage_array(cJSON *node, const char *key, const uint32_t seconds[HW_OFP_ORDER_ID_ENUM_SIZE])
+{
+    cJSON *array = cJSON_AddArrayToObject(node, key);
+    for (int i = 0; i < HW_OFP_ORDER_ID_ENUM_SIZE; i++)
+        cJSON_AddItemToArray(array, cJSON_CreateNumber(seconds[i]));
+}
+
+/* upper bound, as heaters may draw power in any order but offload */
+static void api_zones_add_usage_kwh(cJSON *node, const char *key, const uint32_t seconds[HW_OFP_ORDER_ID_ENUM_SIZE], uint32_t power)
+{
+    uint32_t heating = 0;
+    for (int i = 0; i < HW_OFP_ORDER_ID_ENUM_SIZE; i++)
+        if (i != HW_OFP_ORDER_ID_STANDARD_OFFLOAD)
+            heating += seconds[i];
+
+    cJSON_AddNumberToObject(node, key, heating / API_ZONES_SECONDS_PER_HOUR * power / API_ZONES_WATTS_PER_KW);
+}
+
+esp_err_t serve_api_get_usage(httpd_req_t *req, struct re_result *captures)
+{
+    int version = re_get_int(captures, 1);
+    ESP_LOGD(TAG, "serve_api_get_usage version=%i", version);
+    if (version != 1)
+        return webserver_resp_send_404(req);
+
+    cJSON *root = cJSON_CreateObject();
+
+    // order ids, giving the meaning of the positions in arrays
+    cJSON *orders = cJSON_AddArrayToObject(root, json_key_orders);
+    for (int i = 0; i < HW_OFP_ORDER_ID_ENUM_SIZE; i++)
+        cJSON_AddItemToArray(orders, cJSON_CreateString(ofp_order_info_by_num_id(i)->id));
+
+    cJSON *zones = cJSON_AddArrayToObject(root, "zones");
+    struct ofp_hw *hw = ofp_hw_get_current();
+    for (int i = 0; hw != NULL && i < hw->zone_set.count; i++)
+    {
+        struct usage_zone u;
+        if (!usage_get_zone(i, &u))
+            continue;
+
+        cJSON *zone = cJSON_CreateObject();
+        cJSON_AddItemToArray(zones, zone);
+        uint32_t power = hw->zone_set.zones[i].power;
+        cJSON_AddStringToObject(zone, json_key_id, hw->zone_set.zones[i].id);
+        cJSON_AddNumberToObject(zone, json_key_power, power);
+
+        cJSON *kwh = (power > 0) ? cJSON_CreateObject() : NULL;
+        for (int p = 0; p < USAGE_PERIOD_ENUM_SIZE; p++)
         {
-            const struct ofp_order_info *info = ofp_order_info_by_str_id(fix_id);
-            if (info == NULL)
-            {
-                ESP_LOGD(TAG, "Value %s for element %s is not an order id", mode->valuestring, json_key_mode);
-                free(res);
-                cJSON_Delete(root);
-                return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid parameter");
-            }
+            char key[OFP_MAX_LEN_ID];
+            const char *name = usage_period_name(p);
+            snprintf(key, sizeof(key), "previous_%s", name);
 
-            if (!ofp_zone_set_mode_fixed(zone, info->order_id))
+            api_zones_add_usage_array(zone, name, u.current[p]);
+            api_zones_add_usage_array(zone, key, u.previous[p]);
+            if (kwh != NULL)
             {
-                ESP_LOGW(TAG, "Could not set zone fixed mode");
-                free(res);
-                cJSON_Delete(root);
-                return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Could not set zone fixed mode");
+                api_zones_add_usage_kwh(kwh, name, u.current[p], power);
+                api_zones_add_usage_kwh(kwh, key, u.previous[p], power);
             }
-
-            ESP_LOGV(TAG, "mode fix finished");
         }
-        else if (plan != NULL && plan_id != NULL)
+        api_zones_add_usage_array(zone, "total", u.total);
+        if (kwh != NULL)
         {
-            if (!ofp_zone_set_mode_planning(zone, atoi(plan_id)))
-            {
-                ESP_LOGW(TAG, "Could not set zone planning mode");
-                free(res);
-                cJSON_Delete(root);
-                return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Could not set zone planning mode");
-            }
-            ESP_LOGV(TAG, "mode plan finished");
+            api_zones_add_usage_kwh(kwh, "total", u.total, power);
+            cJSON_AddItemToObject(zone, "kwh", kwh);
         }
-        // no other valid case according to REGEX
-        free(res);
-
-        need_storing = true;
     }
 
-    // not providing any matching element is not an error
+    httpd_resp_set_hdr(req, str_cache_control, str_private_no_store);
 
-    // cleanup
+    esp_err_t result = serve_json(req, root);
     cJSON_Delete(root);
+    return result;
+}
 
-    // update storage if needed
-    if ((desc != NULL || need_storing) && !ofp_zone_store(zone))
-    {
-        ESP_LOGW(TAG, "Could store updated zone");
-        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Could store updated zone");
-    }
+esp_err_t serve_api_delete_usage(httpd_req_t *req, struct re_result *captures)
+{
+    int version = re_get_int(captures, 1);
+    ESP_LOGD(TAG, "serve_api_delete_usage version=%i", version);
+    if (version != 1)
+        return webserver_resp_send_404(req);
 
-    return httpd_resp_sendstr(req, "");
+    if (!ofp_session_user_is_admin(req))
+        return webserver_resp_send_err(req, HTTPD_403_FORBIDDEN, "Unauthorized");
+
+    usage_reset();
+
+    return webserver_resp_sendstr(req, "");
 }
 
 esp_err_t serve_api_get_override(httpd_req_t *req, struct re_result *captures)
@@ -260,20 +616,10 @@ esp_err_t serve_api_get_override(httpd_req_t *req, struct re_result *captures)
     int version = re_get_int(captures, 1);
     ESP_LOGD(TAG, "serve_api_get_override version=%i", version);
     if (version != 1)
-        return httpd_resp_send_404(req);
-
-    // get zone override from common namespace
-    enum ofp_order_id order_id;
-    bool active = ofp_override_get_order_id(&order_id);
-    const struct ofp_order_info *info = NULL;
-    if (active)
-    {
-        ESP_LOGV(TAG, "override is active");
-        info = ofp_order_info_by_num_id(order_id);
-    }
+        return webserver_resp_send_404(req);
 
     cJSON *root = cJSON_CreateObject();
-    cJSON_AddStringToObject(root, stor_key_zone_override, info ? info->id : stor_val_none);
+    api_zones_add_override(root);
 
     esp_err_t result = serve_json(req, root);
     cJSON_Delete(root);
@@ -285,7 +631,7 @@ esp_err_t serve_api_put_override(httpd_req_t *req, struct re_result *captures)
     int version = re_get_int(captures, 1);
     ESP_LOGD(TAG, "serve_api_put_override version=%i", version);
     if (version != 1)
-        return httpd_resp_send_404(req);
+        return webserver_resp_send_404(req);
 
     // read
     char *buf = webserver_get_request_data_atomic(req);
@@ -299,7 +645,7 @@ esp_err_t serve_api_put_override(httpd_req_t *req, struct re_result *captures)
     cJSON *root = cJSON_Parse(buf);
 
     // cleanup
-    free(buf);
+    scoped_free(buf);
 
     // parse error
     if (root == NULL)
@@ -309,7 +655,7 @@ esp_err_t serve_api_put_override(httpd_req_t *req, struct re_result *captures)
         {
             ESP_LOGD(TAG, "JSON parse error, before: %s", error_ptr);
         }
-        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Failed parsing JSON body");
+        return webserver_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Failed parsing JSON body");
     }
 
     // override is required
@@ -318,16 +664,17 @@ esp_err_t serve_api_put_override(httpd_req_t *req, struct re_result *captures)
     {
         ESP_LOGD(TAG, "Invalid override");
         cJSON_Delete(root);
-        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid override");
+        return webserver_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid override");
     }
 
     // special value
     if (strcmp(override, stor_val_none) == 0)
     {
+        cJSON_Delete(root);
+
         // set zone override in common namespace
-        ofp_override_disable();
-        ofp_override_store();
-        return httpd_resp_sendstr(req, "");
+        api_zones_apply_override(NULL);
+        return webserver_resp_sendstr(req, "");
     }
 
     // generic values
@@ -335,15 +682,16 @@ esp_err_t serve_api_put_override(httpd_req_t *req, struct re_result *captures)
     if (info == NULL)
     {
         ESP_LOGD(TAG, "Invalid order override %s", override);
-        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid parameter");
+        cJSON_Delete(root);
+        return webserver_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid parameter");
     }
+    cJSON_Delete(root);
 
     ESP_LOGD(TAG, "matched order %s", info->name);
 
     // set zone override in common namespace
-    ofp_override_enable(info->order_id);
-    ofp_override_store();
+    api_zones_apply_override(info);
 
     // return success
-    return httpd_resp_sendstr(req, "");
+    return webserver_resp_sendstr(req, "");
 }
\ No newline at end of file
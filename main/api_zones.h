@@ -1,9 +1,29 @@
 #ifndef API_ZONES_H
 #define API_ZONES_H
 
+#include <stdbool.h>
+#include <cjson.h>
 #include <esp_https_server.h>
 
 #include "utils.h"
+#include "ofp.h"
+
+/* JSON builders, shared with the bootstrap entrypoint */
+void api_zones_add_orders(cJSON *root);
+bool api_zones_add_zones(cJSON *root);
+void api_zones_add_override(cJSON *root);
+
+// ":fixed:cozyminus1\0" length is 20 but upgrade to avoid warning about id being 16
+#define API_ZONES_MODE_MAX_LEN 24
+
+/* helpers */
+struct ofp_zone *api_zones_find_zone_by_id(const char *id);
+bool api_zones_format_mode(const struct ofp_zone *z, char *buf, size_t len);
+bool api_zones_parse_mode(const char *str, enum ofp_zone_mode *mode, int *value);
+
+/* mutations shared with the MQTT bridge, atomic for the other tasks */
+bool api_zones_apply_mode(struct ofp_zone *zone, enum ofp_zone_mode mode, int value);
+void api_zones_apply_override(const struct ofp_order_info *info);
 
 esp_err_t serve_api_get_orders(httpd_req_t *req, struct re_result *captures);
 
@@ -11,6 +31,12 @@ esp_err_t serve_api_get_zones(httpd_req_t *req, struct re_result *captures);
 
 esp_err_t serve_api_patch_zones_id(httpd_req_t *req, struct re_result *captures);
 
+esp_err_t serve_api_get_zones_id_history(httpd_req_t *req, struct re_result *captures);
+
+esp_err_t serve_api_get_usage(httpd_req_t *req, struct re_result *captures);
+
+esp_err_t serve_api_delete_usage(httpd_req_t *req, struct re_result *captures);
+
 esp_err_t serve_api_get_override(httpd_req_t *req, struct re_result *captures);
 
 esp_err_t serve_api_put_override(httpd_req_t *req, struct re_result *captures);
@@ -0,0 +1,256 @@
+#include <string.h>
+#include <stdlib.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_log.h>
+
+#include "arena.h"
+
+static const char TAG[] = "arena";
+
+// every allocation is aligned on this size
+#define ARENA_ALIGN 8
+#define ARENA_ALIGN_UP(x) (((x) + (ARENA_ALIGN - 1)) & ~((size_t)ARENA_ALIGN - 1))
+
+/* current scope, only used by the task which entered it */
+static struct arena *scope_arena = NULL;
+static TaskHandle_t scope_task = NULL;
+
+/* statistics since boot */
+static struct arena_stats global_stats = {0};
+
+/* mutex variables */
+portMUX_TYPE mutex_arena_global_stats = portMUX_INITIALIZER_UNLOCKED;
+
+/***************************************************************************/
+
+static struct arena_block *arena_block_init(size_t size)
+{
+    struct arena_block *block = malloc(sizeof(struct arena_block) + size);
+    if (block == NULL)
+    {
+        ESP_LOGW(TAG, "Could not allocate %u bytes block", size);
+        return NULL;
+    }
+
+    block->next = NULL;
+    block->size = size;
+    block->used = 0;
+    return block;
+}
+
+struct arena *arena_init(size_t block_size)
+{
+    assert(block_size > 0);
+    ESP_LOGD(TAG, "arena_init block_size %u", block_size);
+
+    // alloc and zero members
+    struct arena *a = calloc(1, sizeof(struct arena));
+    if (a == NULL)
+    {
+        ESP_LOGW(TAG, "calloc failed");
+        return NULL;
+    }
+
+    a->stats.block_size = ARENA_ALIGN_UP(block_size);
+    a->first = arena_block_init(a->stats.block_size);
+    if (a->first == NULL)
+    {
+        free(a);
+        return NULL;
+    }
+
+    taskENTER_CRITICAL(&mutex_arena_global_stats);
+    global_stats.block_size = a->stats.block_size;
+    taskEXIT_CRITICAL(&mutex_arena_global_stats);
+
+    return a;
+}
+
+/* releases the overflow blocks, keeps the first one */
+static void arena_release_overflow(struct arena *a)
+{
+    struct arena_block *block = a->first->next;
+    while (block != NULL)
+    {
+        struct arena_block *next = block->next;
+        free(block);
+        block = next;
+    }
+    a->first->next = NULL;
+}
+
+void arena_free(struct arena *a)
+{
+    if (a == NULL)
+        return;
+
+    ESP_LOGD(TAG, "arena_free %p", a);
+    assert(scope_arena != a);
+
+    arena_release_overflow(a);
+    free(a->first);
+    free(a);
+}
+
+void arena_reset(struct arena *a)
+{
+    assert(a != NULL);
+    ESP_LOGV(TAG, "arena_reset %p used %u peak %u", a, a->used, a->stats.peak);
+
+    arena_release_overflow(a);
+    a->first->used = 0;
+    a->used = 0;
+    a->last = NULL;
+    a->last_size = 0;
+    a->stats.resets++;
+
+    taskENTER_CRITICAL(&mutex_arena_global_stats);
+    global_stats.resets++;
+    taskEXIT_CRITICAL(&mutex_arena_global_stats);
+}
+
+void *arena_alloc(struct arena *a, size_t size)
+{
+    assert(a != NULL);
+
+    size = ARENA_ALIGN_UP(size > 0 ? size : 1);
+
+    // the most recent block is always right after the first one
+    struct arena_block *block = a->first->next ? a->first->next : a->first;
+    if (block->used + size > block->size)
+    {
+        // new overflow blocks are inserted at the head of the overflow list
+        size_t block_size = size > a->stats.block_size ? size : a->stats.block_size;
+        struct arena_block *overflow = arena_block_init(block_size);
+        if (overflow == NULL)
+            return NULL;
+
+        overflow->next = a->first->next;
+        a->first->next = overflow;
+        block = overflow;
+
+        a->stats.overflows++;
+        taskENTER_CRITICAL(&mutex_arena_global_stats);
+        global_stats.overflows++;
+        taskEXIT_CRITICAL(&mutex_arena_global_stats);
+        ESP_LOGV(TAG, "arena %p overflow block of %u bytes", a, block_size);
+    }
+
+    void *ptr = block->data + block->used;
+    block->used += size;
+    a->last = ptr;
+    a->last_size = size;
+
+    a->used += size;
+    if (a->used > a->stats.peak)
+        a->stats.peak = a->used;
+
+    taskENTER_CRITICAL(&mutex_arena_global_stats);
+    if (a->used > global_stats.peak)
+        global_stats.peak = a->used;
+    taskEXIT_CRITICAL(&mutex_arena_global_stats);
+
+    return ptr;
+}
+
+bool arena_owns(struct arena *a, const void *ptr)
+{
+    assert(a != NULL);
+
+    const char *p = ptr;
+    for (struct arena_block *block = a->first; block != NULL; block = block->next)
+        if (p >= block->data && p < block->data + block->size)
+            return true;
+    return false;
+}
+
+void arena_release(struct arena *a, void *ptr)
+{
+    assert(a != NULL);
+
+    if (ptr == NULL || ptr != a->last)
+        return;
+
+    // the most recent block is always right after the first one
+    struct arena_block *block = a->first->next ? a->first->next : a->first;
+    block->used -= a->last_size;
+    a->used -= a->last_size;
+    a->last = NULL;
+    a->last_size = 0;
+}
+
+/***************************************************************************/
+
+void arena_scope_enter(struct arena *a)
+{
+    assert(a != NULL);
+
+    // no nested scopes
+    assert(scope_arena == NULL);
+
+    scope_task = xTaskGetCurrentTaskHandle();
+    scope_arena = a;
+}
+
+void arena_scope_leave(void)
+{
+    assert(scope_task == xTaskGetCurrentTaskHandle());
+
+    scope_arena = NULL;
+    scope_task = NULL;
+}
+
+static struct arena *arena_scope_get(void)
+{
+    if (scope_arena == NULL || scope_task != xTaskGetCurrentTaskHandle())
+        return NULL;
+    return scope_arena;
+}
+
+void *scoped_malloc(size_t size)
+{
+    struct arena *a = arena_scope_get();
+    if (a == NULL)
+        return malloc(size);
+
+    return arena_alloc(a, size);
+}
+
+void *scoped_calloc(size_t count, size_t size)
+{
+    struct arena *a = arena_scope_get();
+    if (a == NULL)
+        return calloc(count, size);
+
+    // arena memory is recycled, so it has to be zeroed
+    void *ptr = arena_alloc(a, count * size);
+    if (ptr != NULL)
+        memset(ptr, 0, count * size);
+    return ptr;
+}
+
+void scoped_free(void *ptr)
+{
+    if (ptr == NULL)
+        return;
+
+    // arena memory is released on reset, except for the most recent allocation
+    struct arena *a = arena_scope_get();
+    if (a != NULL && arena_owns(a, ptr))
+    {
+        arena_release(a, ptr);
+        return;
+    }
+
+    free(ptr);
+}
+
+void arena_get_global_stats(struct arena_stats *stats)
+{
+    assert(stats != NULL);
+
+    taskENTER_CRITICAL(&mutex_arena_global_stats);
+    *stats = global_stats;
+    taskEXIT_CRITICAL(&mutex_arena_global_stats);
+}
\ No newline at end of file
@@ -0,0 +1,72 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Bump allocator
+ *
+ * Allocations are carved from a first block, kept for the whole life of
+ * the arena, and from overflow blocks added when it is full. Memory is
+ * never released individually : every allocation is dropped at once
+ * on reset, which also releases the overflow blocks.
+ */
+
+struct arena_block
+{
+    struct arena_block *next;
+    size_t size;
+    size_t used;
+    char data[];
+};
+
+struct arena_stats
+{
+    size_t block_size;
+    size_t peak;
+    unsigned int resets;
+    unsigned int overflows;
+};
+
+struct arena
+{
+    struct arena_block *first;
+    // most recent allocation, which can be given back
+    void *last;
+    size_t last_size;
+    size_t used;
+    struct arena_stats stats;
+};
+
+/* returns NULL on failure */
+struct arena *arena_init(size_t block_size);
+void arena_free(struct arena *a);
+void arena_reset(struct arena *a);
+
+/* returns NULL on failure */
+void *arena_alloc(struct arena *a, size_t size);
+bool arena_owns(struct arena *a, const void *ptr);
+
+/* gives back the memory if ptr is the most recent allocation, does nothing otherwise */
+void arena_release(struct arena *a, void *ptr);
+
+/*
+ * Scoped allocation helpers
+ *
+ * While a scope is entered, allocations made BY THE SAME TASK come from the
+ * scope arena, and allocations made by other tasks come from the heap.
+ * Every memory obtained from these functions MUST BE FREED using scoped_free(),
+ * and memory obtained inside a scope MUST NOT outlive it.
+ */
+void arena_scope_enter(struct arena *a);
+void arena_scope_leave(void);
+
+void *scoped_malloc(size_t size);
+void *scoped_calloc(size_t count, size_t size);
+void scoped_free(void *ptr);
+
+/* cumulated statistics of every arena since boot */
+void arena_get_global_stats(struct arena_stats *stats);
+
+#endif /* ARENA_H */
\ No newline at end of file
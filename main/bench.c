@@ -0,0 +1,325 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <esp_log.h>
+#include <rom/ets_sys.h>
+#include <esp_cpu.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "str.h"
+#include "ofp.h"
+#include "utils.h"
+#include "storage.h"
+#include "api_zones.h"
+#include "output.h"
+#include "trace.h"
+#include "bench.h"
+
+static const char TAG[] = "bench";
+
+#define BENCH_TASK_STACK_SIZE 6144
+#define BENCH_TASK_PRIORITY 1
+#define BENCH_OUTPUT_TIMEOUT_MS 1000
+
+// every commit writes flash
+#define BENCH_NVS_MAX_SAMPLES 20
+// every verification runs all the iterations of the password hash
+#define BENCH_PASSWORD_MAX_SAMPLES 20
+
+// synthetic plannings, with 4 slots per day
+#define BENCH_PLANNING_COUNT 4
+#define BENCH_SLOTS_PER_PLANNING 28
+
+struct bench_route
+{
+    const char **re;
+    const char *uri;
+};
+
+/* a matching request for every route */
+static const struct bench_route routes[] = {
+    {&route_api_bootstrap, "/ofp-api/v1/bootstrap"},
+    {&route_api_batch, "/ofp-api/v1/batch"},
+    {&route_api_hardware, "/ofp-api/v1/hardware"},
+    {&route_api_hardware_id_parameters, "/ofp-api/v1/hardware/M1E1/parameters"},
+    {&route_api_accounts, "/ofp-api/v1/accounts"},
+    {&route_api_accounts_id, "/ofp-api/v1/accounts/admin"},
+    {&route_api_orders, "/ofp-api/v1/orders"},
+    {&route_api_override, "/ofp-api/v1/override"},
+    {&route_api_zones, "/ofp-api/v1/zones"},
+    {&route_api_zones_id, "/ofp-api/v1/zones/E01Z01"},
+    {&route_api_zones_id_history, "/ofp-api/v1/zones/E01Z01/history?from=0&to=4294967295"},
+    {&route_api_usage, "/ofp-api/v1/usage"},
+    {&route_api_upgrade, "/ofp-api/v1/upgrade"},
+    {&route_api_status, "/ofp-api/v1/status"},
+    {&route_api_reboot, "/ofp-api/v1/reboot"},
+    {&route_api_trace, "/ofp-api/v1/trace?clear"},
+    {&route_api_certificate, "/ofp-api/v1/certificate"},
+    {&route_api_certificate_self_signed, "/ofp-api/v1/certificate/selfsigned"},
+    {&route_api_plannings, "/ofp-api/v1/plannings"},
+    {&route_api_planning_id, "/ofp-api/v1/plannings/1"},
+    {&route_api_planning_id_slots, "/ofp-api/v1/plannings/1/slots"},
+    {&route_api_planning_id_slots_id, "/ofp-api/v1/plannings/1/slots/12"},
+};
+
+struct bench_params
+{
+    int samples;
+    int zones;
+    TaskHandle_t caller;
+};
+
+/***************************************************************************/
+
+static int bench_compare(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void bench_report(const char *name, uint32_t *cycles, int count)
+{
+    if (count == 0)
+    {
+        printf("%-40s no sample\r\n", name);
+        return;
+    }
+
+    // nearest rank percentile
+    qsort(cycles, count, sizeof(uint32_t), bench_compare);
+    int p99 = (count * 99 + 99) / 100 - 1;
+    printf("%-40s n=%4i min=%10u median=%10u p99=%10u\r\n", name, count, cycles[0], cycles[count / 2], cycles[p99]);
+}
+
+static void bench_re_match(uint32_t *cycles, int samples)
+{
+    char name[48];
+    for (int r = 0; r < sizeof(routes) / sizeof(routes[0]); r++)
+    {
+        for (int i = 0; i < samples; i++)
+        {
+            uint32_t start = esp_cpu_get_ccount();
+            struct re_result *res = re_match(*routes[r].re, routes[r].uri);
+            cycles[i] = esp_cpu_get_ccount() - start;
+            re_free(res);
+        }
+        snprintf(name, sizeof(name), "re_match %s", routes[r].uri);
+        bench_report(name, cycles, samples);
+    }
+}
+
+static void bench_password_verify(uint32_t *cycles, int samples)
+{
+    if (samples > BENCH_PASSWORD_MAX_SAMPLES)
+        samples = BENCH_PASSWORD_MAX_SAMPLES;
+
+    struct password_data *pwd = password_init("benchmark");
+    if (pwd == NULL)
+    {
+        printf("Could not hash password\r\n");
+        return;
+    }
+
+    for (int i = 0; i < samples; i++)
+    {
+        uint32_t start = esp_cpu_get_ccount();
+        password_verify(pwd, "benchmark");
+        cycles[i] = esp_cpu_get_ccount() - start;
+    }
+    password_free(pwd);
+    bench_report("password_verify", cycles, samples);
+}
+
+static void bench_free_plannings(struct ofp_planning_list *list)
+{
+    for (int p = 0; p < OFP_MAX_PLANNING_COUNT; p++)
+    {
+        struct ofp_planning *plan = list->plannings[p];
+        if (plan == NULL)
+            continue;
+        for (int s = 0; s < OFP_MAX_PLANNING_SLOT_COUNT; s++)
+            free(plan->slots[s]);
+        free(plan);
+    }
+    free(list);
+}
+
+/* plannings are not registered anywhere, so that nothing else sees them */
+static struct ofp_planning_list *bench_create_plannings(void)
+{
+    struct ofp_planning_list *list = calloc(1, sizeof(struct ofp_planning_list));
+    if (list == NULL)
+        return NULL;
+
+    for (int p = 0; p < BENCH_PLANNING_COUNT; p++)
+    {
+        struct ofp_planning *plan = calloc(1, sizeof(struct ofp_planning));
+        if (plan == NULL)
+        {
+            bench_free_plannings(list);
+            return NULL;
+        }
+        list->plannings[p] = plan;
+        plan->id = p;
+
+        for (int s = 0; s < BENCH_SLOTS_PER_PLANNING; s++)
+        {
+            struct ofp_planning_slot *slot = calloc(1, sizeof(struct ofp_planning_slot));
+            if (slot == NULL)
+            {
+                bench_free_plannings(list);
+                return NULL;
+            }
+            plan->slots[s] = slot;
+            slot->id = s;
+            slot->dow = s / 4;
+            slot->hour = (s % 4) * 6;
+            slot->minute = p * 15;
+            slot->order_id = (s + p) % HW_OFP_ORDER_ID_ENUM_SIZE;
+        }
+    }
+    return list;
+}
+
+static void bench_compute_orders(uint32_t *cycles, int samples, int zone_count)
+{
+    struct ofp_planning_list *list = bench_create_plannings();
+    struct ofp_zone *zones = calloc(zone_count, sizeof(struct ofp_zone));
+    if (list == NULL || zones == NULL)
+    {
+        printf("Could not allocate synthetic zones and plannings\r\n");
+        if (list != NULL)
+            bench_free_plannings(list);
+        free(zones);
+        return;
+    }
+
+    for (int i = 0; i < zone_count; i++)
+    {
+        snprintf(zones[i].id, sizeof(zones[i].id), "bench%02i", i);
+        zones[i].mode = HW_OFP_ZONE_MODE_PLANNING;
+        zones[i].mode_data.planning_id = i % BENCH_PLANNING_COUNT;
+    }
+    struct ofp_zone_set zone_set = {.count = zone_count, .zones = zones};
+
+    time_t now;
+    struct tm ti;
+    time(&now);
+    time_to_localtime(&now, &ti);
+
+    for (int i = 0; i < samples; i++)
+    {
+        uint32_t start = esp_cpu_get_ccount();
+        ofp_zone_set_compute_orders(&zone_set, list, &ti);
+        cycles[i] = esp_cpu_get_ccount() - start;
+    }
+
+    char name[48];
+    enum ofp_order_id override_order_id;
+    snprintf(name, sizeof(name), "compute_orders %i zones%s", zone_count, ofp_override_get_order_id(&override_order_id) ? " (override)" : "");
+    bench_report(name, cycles, samples);
+
+    free(zones);
+    bench_free_plannings(list);
+}
+
+static void bench_output_apply(uint32_t *cycles, int samples)
+{
+    struct ofp_hw *hw = ofp_hw_get_current();
+    if (hw == NULL)
+        return;
+
+    int count = 0;
+    for (int i = 0; i < samples; i++)
+    {
+        struct output_probe probe = {0};
+        if (!output_probe(&probe, pdMS_TO_TICKS(BENCH_OUTPUT_TIMEOUT_MS)))
+            continue;
+        cycles[count++] = probe.cycles;
+    }
+
+    char name[48];
+    snprintf(name, sizeof(name), "apply %s %i zones", hw->id, hw->zone_set.count);
+    bench_report(name, cycles, count);
+}
+
+static void bench_zones_json(uint32_t *cycles, int samples)
+{
+    for (int i = 0; i < samples; i++)
+    {
+        uint32_t start = esp_cpu_get_ccount();
+        cJSON *root = cJSON_CreateObject();
+        api_zones_add_zones(root);
+        char *txt = cJSON_Print(root);
+        cJSON_free(txt);
+        cJSON_Delete(root);
+        cycles[i] = esp_cpu_get_ccount() - start;
+    }
+    bench_report("zones response json", cycles, samples);
+}
+
+static void bench_nvs_commit(uint32_t *cycles, int samples)
+{
+    if (samples > BENCH_NVS_MAX_SAMPLES)
+        samples = BENCH_NVS_MAX_SAMPLES;
+
+    const char *ns = kv_get_ns_ofp();
+    for (int i = 0; i < samples; i++)
+    {
+        uint32_t start = esp_cpu_get_ccount();
+        nvs_handle_t handle = kv_open_ns(ns);
+        kv_set_u32(handle, stor_key_bench, i);
+        kv_commit(handle);
+        kv_close(handle);
+        cycles[i] = esp_cpu_get_ccount() - start;
+    }
+    kv_ns_delete_atomic(ns, stor_key_bench);
+    bench_report("nvs set+commit", cycles, samples);
+}
+
+static void bench_task(void *pvParameters)
+{
+    struct bench_params *params = pvParameters;
+
+    uint32_t *cycles = malloc(params->samples * sizeof(uint32_t));
+    if (cycles == NULL)
+    {
+        printf("Could not allocate %i samples\r\n", params->samples);
+    }
+    else
+    {
+        printf("CPU cycles, at %u MHz\r\n", ets_get_cpu_frequency());
+        bench_re_match(cycles, params->samples);
+        bench_password_verify(cycles, params->samples);
+        bench_compute_orders(cycles, params->samples, params->zones);
+        bench_output_apply(cycles, params->samples);
+        bench_zones_json(cycles, params->samples);
+        bench_nvs_commit(cycles, params->samples);
+        free(cycles);
+    }
+
+    xTaskNotifyGive(params->caller);
+    vTaskDelete(NULL);
+}
+
+/***************************************************************************/
+
+void bench_run(int samples, int zones)
+{
+    struct bench_params params = {
+        .samples = samples,
+        .zones = zones,
+        .caller = xTaskGetCurrentTaskHandle(),
+    };
+    ESP_LOGD(TAG, "bench_run samples=%i zones=%i", samples, zones);
+
+    // keep the ring for real traffic, and do not measure recording as well
+    trace_suspend();
+
+    TaskHandle_t xHandle = NULL;
+    xTaskCreatePinnedToCore(bench_task, "bench", BENCH_TASK_STACK_SIZE, &params, BENCH_TASK_PRIORITY, &xHandle, 1);
+    configASSERT(xHandle);
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+    trace_resume();
+}
\ No newline at end of file
@@ -0,0 +1,24 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "ofp.h"
+
+/*
+ * Micro-benchmarks of the hot paths
+ *
+ * Each benchmark is run the requested number of times, measuring CPU cycles,
+ * and its minimum, median and 99th percentile are printed, so that firmware
+ * builds can be compared on identical hardware.
+ *
+ * Benchmarks run in a task pinned to core 1, where the network stack does
+ * not run, and the output stage is measured in the output task itself.
+ * Tracing is suspended meanwhile.
+ */
+
+#define BENCH_MAX_SAMPLES 1000
+#define BENCH_MAX_ZONES OFP_MAX_ZONE_COUNT
+
+/* blocks until every benchmark is done */
+void bench_run(int samples, int zones);
+
+#endif /* BENCH_H */
\ No newline at end of file
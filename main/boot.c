@@ -0,0 +1,114 @@
+#include <string.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/event_groups.h>
+
+#include "sdkconfig.h"
+
+#include "boot.h"
+
+static const char TAG[] = "boot";
+
+/* background stages (PBKDF2, console, wifi) used to run on the main task,
+ * keep at least its stack with some margin ; check the logged high water mark */
+#define BOOT_BACKGROUND_STACK_SIZE (CONFIG_ESP_MAIN_TASK_STACK_SIZE + 512)
+
+/* global variables */
+static const struct boot_stage *boot_stages = NULL;
+static int boot_stage_count = 0;
+static struct boot_stage_timing boot_timings[BOOT_MAX_STAGES];
+static EventGroupHandle_t boot_done = NULL;
+
+/* mutex variables */
+portMUX_TYPE mutex_boot_timings = portMUX_INITIALIZER_UNLOCKED;
+
+/***************************************************************************/
+
+static void boot_run_stage(int index)
+{
+    const struct boot_stage *stage = &boot_stages[index];
+
+    if (stage->depends != 0)
+    {
+        ESP_LOGV(TAG, "Stage %s waiting for 0x%08x", stage->name, stage->depends);
+        xEventGroupWaitBits(boot_done, stage->depends, pdFALSE, pdTRUE, portMAX_DELAY);
+    }
+
+    int64_t start = esp_timer_get_time();
+    taskENTER_CRITICAL(&mutex_boot_timings);
+    boot_timings[index].core = xPortGetCoreID();
+    boot_timings[index].start_us = start;
+    taskEXIT_CRITICAL(&mutex_boot_timings);
+
+    stage->run();
+
+    int64_t end = esp_timer_get_time();
+    taskENTER_CRITICAL(&mutex_boot_timings);
+    boot_timings[index].end_us = end;
+    taskEXIT_CRITICAL(&mutex_boot_timings);
+
+    ESP_LOGI(TAG, "Stage %s done at %lli us (took %lli us)", stage->name, end, end - start);
+    xEventGroupSetBits(boot_done, BOOT_DEPENDS(index));
+}
+
+static void boot_run_runner(enum boot_runner runner)
+{
+    for (int i = 0; i < boot_stage_count; i++)
+        if (boot_stages[i].runner == runner)
+            boot_run_stage(i);
+}
+
+static void boot_background_task(void *pvParameters)
+{
+    boot_run_runner(BOOT_RUNNER_BACKGROUND);
+
+    // stack unit is bytes on this port
+    ESP_LOGI(TAG, "Background stages finished, %u of %u stack bytes never used", uxTaskGetStackHighWaterMark(NULL), BOOT_BACKGROUND_STACK_SIZE);
+    vTaskDelete(NULL);
+}
+
+/***************************************************************************/
+
+void boot_run(const struct boot_stage *stages, int count)
+{
+    assert(stages != NULL);
+    assert(count > 0 && count <= BOOT_MAX_STAGES);
+    assert(boot_stages == NULL);
+    ESP_LOGD(TAG, "boot_run %i stages", count);
+
+    boot_done = xEventGroupCreate();
+    configASSERT(boot_done);
+
+    boot_stages = stages;
+    boot_stage_count = count;
+    memset(boot_timings, 0, sizeof(boot_timings));
+    for (int i = 0; i < count; i++)
+    {
+        // dependencies are listed before the stages which need them
+        assert((stages[i].depends & ~(BOOT_DEPENDS(i) - 1)) == 0);
+        boot_timings[i].name = stages[i].name;
+        boot_timings[i].core = -1;
+    }
+
+    // background stages run on the other core
+    TaskHandle_t xHandle = NULL;
+    int core = xPortGetCoreID() ? 0 : 1;
+    xTaskCreatePinnedToCore(boot_background_task, "boot", BOOT_BACKGROUND_STACK_SIZE, NULL, 1, &xHandle, core);
+    configASSERT(xHandle);
+
+    boot_run_runner(BOOT_RUNNER_MAIN);
+}
+
+int boot_get_timeline(struct boot_stage_timing *timings, int max)
+{
+    assert(timings != NULL);
+
+    taskENTER_CRITICAL(&mutex_boot_timings);
+    int count = boot_stage_count < max ? boot_stage_count : max;
+    memcpy(timings, boot_timings, count * sizeof(struct boot_stage_timing));
+    taskEXIT_CRITICAL(&mutex_boot_timings);
+
+    return count;
+}
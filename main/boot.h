@@ -0,0 +1,50 @@
+#ifndef BOOT_H
+#define BOOT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Staged boot
+ *
+ * Each stage runs once, after every stage it depends on has finished.
+ * Main stages run in order on the calling task, background stages
+ * run in order on a dedicated task pinned to the other core.
+ */
+
+// limited by the bits available in a FreeRTOS event group
+#define BOOT_MAX_STAGES 24
+
+#define BOOT_DEPENDS(stage_index) (1UL << (stage_index))
+
+enum boot_runner
+{
+    BOOT_RUNNER_MAIN = 0,
+    BOOT_RUNNER_BACKGROUND,
+};
+
+struct boot_stage
+{
+    const char *name;
+    void (*run)(void);
+    enum boot_runner runner;
+    // bitmask of BOOT_DEPENDS(index) of the prerequisite stages
+    uint32_t depends;
+};
+
+struct boot_stage_timing
+{
+    const char *name;
+    int core;
+    // microseconds since boot, 0 if not started/finished yet
+    int64_t start_us;
+    int64_t end_us;
+};
+
+/* returns once every main stage is done, background ones may still be running */
+void boot_run(const struct boot_stage *stages, int count);
+
+/* copies at most max entries, returns the number of entries copied */
+int boot_get_timeline(struct boot_stage_timing *timings, int max);
+
+#endif /* BOOT_H */
\ No newline at end of file
@@ -1,3 +1,4 @@
+#include <stdlib.h>
 #include <string.h>
 #include <esp_log.h>
 #include <esp_console.h>
@@ -7,6 +8,7 @@
 #include <esp_heap_caps.h>
 #include <esp_partition.h>
 #include <argtable3/argtable3.h>
+#include <http_parser.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 
@@ -14,6 +16,22 @@
 
 #include "ofp.h"
 #include "storage.h"
+#include "utils.h"
+#include "arena.h"
+#include "json_pool.h"
+#include "history.h"
+#include "usage.h"
+#include "trace.h"
+#include "loop_stats.h"
+#include "output.h"
+#include "pulse_timer.h"
+#include "vcd.h"
+#include "sim_595.h"
+#include "hw_m1e1.h"
+#include "bench.h"
+#include "top.h"
+#include "heap_profiler.h"
+#include "webserver.h"
 
 #define CONSOLE_MAX_COMMAND_LINE_LENGTH 512
 
@@ -87,6 +105,8 @@ static void register_version(void)
 static int restart(int argc, char **argv)
 {
     ESP_LOGI(TAG, "Restarting");
+    history_checkpoint();
+    usage_save();
     esp_restart();
 }
 
@@ -120,11 +140,26 @@ static void register_free(void)
     ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));
 }
 
-// 'heap' command prints minumum heap size
+// 'heap' command prints minumum heap size and fragmentation
 static int heap_size(int argc, char **argv)
 {
     uint32_t heap_size = heap_caps_get_minimum_free_size(MALLOC_CAP_DEFAULT);
     printf("min heap size: %u bytes\n", heap_size);
+    printf("largest free block: %u bytes\n", heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+    printf("fragmentation: %i%%\n", heap_get_fragmentation());
+
+    struct arena_stats stats;
+    arena_get_global_stats(&stats);
+    printf("request arena: block %u bytes, peak %u bytes, %u resets, %u overflows\n", stats.block_size, stats.peak, stats.resets, stats.overflows);
+
+    struct json_pool_stats pool_stats;
+    json_pool_get_stats(&pool_stats);
+    printf("json pool: %u allocations, %u fallbacks, last request %u, busiest request %u\n", pool_stats.allocations, pool_stats.fallbacks, pool_stats.request_last, pool_stats.request_max);
+    for (int i = 0; i < JSON_POOL_CLASS_ENUM_SIZE; i++)
+    {
+        struct json_pool_class_stats *cs = &pool_stats.classes[i];
+        printf("json pool class %u bytes: %i/%i used, high water %i\n", cs->block_size, cs->used, cs->block_count, cs->high_water);
+    }
     return 0;
 }
 
@@ -132,7 +167,7 @@ static void register_heap(void)
 {
     const esp_console_cmd_t heap_cmd = {
         .command = "heap",
-        .help = "Get minimum size of free heap memory that was available during program execution",
+        .help = "Get minimum size of free heap memory that was available during program execution, and heap fragmentation",
         .hint = NULL,
         .func = &heap_size,
     };
@@ -255,6 +290,175 @@ static void register_task_stats(void)
         .func = &task_stats};
     ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));
 }
+
+// 'top' command refreshes per-task cpu usage and stacks, and heap trends
+
+#define CONSOLE_TOP_DEFAULT_COUNT 10
+#define CONSOLE_TOP_DEFAULT_DELAY_S 2
+#define CONSOLE_TOP_MAX_COUNT 1000
+#define CONSOLE_TOP_MAX_DELAY_S 60
+// room for tasks created between two samples
+#define CONSOLE_TOP_EXTRA_TASKS 8
+
+static struct // argument order defined by struct ordering
+{
+    struct arg_int *count;
+    struct arg_int *delay;
+    struct arg_end *end;
+} top_args;
+
+struct top_line
+{
+    TaskStatus_t *task;
+    uint32_t runtime;
+};
+
+static int compare_top_lines(const void *a, const void *b)
+{
+    uint32_t x = ((const struct top_line *)a)->runtime, y = ((const struct top_line *)b)->runtime;
+    return (y > x) - (y < x);
+}
+
+static void print_top(TaskStatus_t *cur, int cur_count, uint32_t cur_total, TaskStatus_t *prev, int prev_count, uint32_t prev_total, struct top_line *lines)
+{
+    // runtime since the previous sample, counters wrapping around
+    for (int i = 0; i < cur_count; i++)
+    {
+        uint32_t before = 0;
+        for (int j = 0; j < prev_count; j++)
+        {
+            if (prev[j].xTaskNumber == cur[i].xTaskNumber)
+            {
+                before = prev[j].ulRunTimeCounter;
+                break;
+            }
+        }
+        lines[i].task = &cur[i];
+        lines[i].runtime = cur[i].ulRunTimeCounter - before;
+    }
+    qsort(lines, cur_count, sizeof(struct top_line), compare_top_lines);
+
+    // each core runs for the whole elapsed time
+    uint32_t elapsed = cur_total - prev_total;
+    printf("Num\tCore\tPrio\tCPU%%\tStack used/size\t\tName\r\n");
+    for (int i = 0; i < cur_count; i++)
+    {
+        TaskStatus_t *t = lines[i].task;
+        uint32_t permille = elapsed == 0 ? 0 : (uint64_t)lines[i].runtime * 1000 / elapsed;
+        uint32_t size = top_get_stack_size(t->pcTaskName);
+        printf("%i\t%i\t%i\t%3u.%u\t",
+               t->xTaskNumber,
+               t->xCoreID == tskNO_AFFINITY ? -1 : t->xCoreID,
+               t->uxCurrentPriority,
+               permille / 10, permille % 10);
+        if (size == 0)
+            printf("free %5u\t\t%s\r\n", t->usStackHighWaterMark, t->pcTaskName);
+        else
+        {
+            uint32_t reclaimable = top_stack_reclaimable(size, t->usStackHighWaterMark);
+            printf("%5u/%5u\t\t%s", size - t->usStackHighWaterMark, size, t->pcTaskName);
+            if (reclaimable > 0)
+                printf(" (over-provisioned, %u bytes reclaimable)", reclaimable);
+            printf("\r\n");
+        }
+    }
+}
+
+static int show_top(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **)&top_args);
+    if (nerrors != 0)
+    {
+        arg_print_errors(stderr, top_args.end, argv[0]);
+        return 1;
+    }
+
+    int count = top_args.count->count > 0 ? top_args.count->ival[0] : CONSOLE_TOP_DEFAULT_COUNT;
+    int delay_s = top_args.delay->count > 0 ? top_args.delay->ival[0] : CONSOLE_TOP_DEFAULT_DELAY_S;
+
+    printf("\r\n");
+    if (count < 1 || count > CONSOLE_TOP_MAX_COUNT)
+    {
+        printf("Count must be between 1 and %i\r\n", CONSOLE_TOP_MAX_COUNT);
+        return -1;
+    }
+    if (delay_s < 1 || delay_s > CONSOLE_TOP_MAX_DELAY_S)
+    {
+        printf("Delay must be between 1 and %i seconds\r\n", CONSOLE_TOP_MAX_DELAY_S);
+        return -1;
+    }
+
+    int max_tasks = uxTaskGetNumberOfTasks() + CONSOLE_TOP_EXTRA_TASKS;
+    TaskStatus_t *prev = malloc(max_tasks * sizeof(TaskStatus_t));
+    TaskStatus_t *cur = malloc(max_tasks * sizeof(TaskStatus_t));
+    struct top_line *lines = malloc(max_tasks * sizeof(struct top_line));
+    if (prev == NULL || cur == NULL || lines == NULL)
+    {
+        printf("Could not allocate %i task samples\r\n", max_tasks);
+        free(prev);
+        free(cur);
+        free(lines);
+        return -1;
+    }
+
+    uint32_t prev_total, cur_total;
+    int prev_count = uxTaskGetSystemState(prev, max_tasks, &prev_total);
+    uint32_t first_free = esp_get_free_heap_size();
+    uint32_t first_largest = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+    uint32_t last_free = first_free, last_largest = first_largest;
+
+    for (int n = 1; n <= count; n++)
+    {
+        vTaskDelay(pdMS_TO_TICKS(delay_s * 1000));
+        int cur_count = uxTaskGetSystemState(cur, max_tasks, &cur_total);
+        if (cur_count == 0)
+        {
+            printf("Too many tasks\r\n");
+            break;
+        }
+
+        uint32_t heap_free = esp_get_free_heap_size();
+        uint32_t heap_largest = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+
+        // clear screen, and move the cursor home
+        printf("\033[2J\033[H");
+        printf("top %i/%i, every %i s, CPU in %% of one core\r\n", n, count, delay_s);
+        printf("heap free %u (%+i, %+i since start) min %u largest %u (%+i, %+i since start)\r\n\r\n",
+               heap_free, (int)(heap_free - last_free), (int)(heap_free - first_free),
+               heap_caps_get_minimum_free_size(MALLOC_CAP_DEFAULT),
+               heap_largest, (int)(heap_largest - last_largest), (int)(heap_largest - first_largest));
+        print_top(cur, cur_count, cur_total, prev, prev_count, prev_total, lines);
+
+        last_free = heap_free;
+        last_largest = heap_largest;
+        TaskStatus_t *swap = prev;
+        prev = cur;
+        cur = swap;
+        prev_count = cur_count;
+        prev_total = cur_total;
+    }
+
+    free(prev);
+    free(cur);
+    free(lines);
+    return 0;
+}
+
+static void register_top(void)
+{
+    top_args.count = arg_int0("n", "count", "<n>", "Number of refreshes (default 10)");
+    top_args.delay = arg_int0("d", "delay", "<seconds>", "Delay between refreshes (default 2)");
+    top_args.end = arg_end(2);
+
+    const esp_console_cmd_t cmd = {
+        .command = "top",
+        .help = "Refresh per-task CPU usage and stack high-water marks, and heap trends",
+        .hint = NULL,
+        .func = &show_top,
+        .argtable = &top_args,
+    };
+    ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));
+}
 #endif /* CONFIG_FREERTOS_USE_TRACE_FACILITY */
 
 // 'partitions' command prints partition layout
@@ -505,6 +709,376 @@ static void register_nvs(void)
     ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));
 }
 
+// 'trace' command dumps the binary trace log
+
+static struct // argument order defined by struct ordering
+{
+    struct arg_lit *clear;
+    struct arg_end *end;
+} trace_args;
+
+static bool print_trace_line(void *ctx, const char *line)
+{
+    printf("%s\r\n", line);
+    return true;
+}
+
+static int show_trace(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **)&trace_args);
+    if (nerrors != 0)
+    {
+        arg_print_errors(stderr, trace_args.end, argv[0]);
+        return 1;
+    }
+
+    printf("\r\n");
+    trace_dump(print_trace_line, NULL, trace_args.clear->count > 0);
+    return 0;
+}
+
+static void register_trace(void)
+{
+    trace_args.clear = arg_lit0("c", "clear", "Forget dumped events");
+    trace_args.end = arg_end(1);
+
+    const esp_console_cmd_t cmd = {
+        .command = "trace",
+        .help = "Dump the binary trace log (timestamp in microseconds, core, event)",
+        .hint = NULL,
+        .func = &show_trace,
+        .argtable = &trace_args,
+    };
+    ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));
+}
+
+// 'loop' command prints control loop timing
+
+static void print_histogram(const char *name, const struct histogram *h)
+{
+    printf("%s: count=%u mean=%u max=%u (us)\r\n", name, h->count, histogram_mean(h), h->max);
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++)
+    {
+        if (h->buckets[i] == 0)
+            continue;
+        printf("\t>= %u: %u\r\n", histogram_bucket_min(i), h->buckets[i]);
+    }
+}
+
+static int show_loop(int argc, char **argv)
+{
+    struct loop_stats stats;
+    loop_stats_get(&stats);
+
+    printf("\r\nperiod=%u ms iterations=%u early=%u missed_deadlines=%u\r\n", stats.period_ms, stats.iterations, stats.early_iterations, stats.missed_deadlines);
+    print_histogram("compute", &stats.compute);
+    print_histogram("apply", &stats.apply);
+    print_histogram("lateness", &stats.lateness);
+
+    struct output_stats os;
+    output_get_stats(&os);
+    printf("output: images=%u latches=%u\r\n", os.images, os.latches);
+    print_histogram("latch latency", &os.latency);
+    return 0;
+}
+
+static void register_loop(void)
+{
+    const esp_console_cmd_t cmd = {
+        .command = "loop",
+        .help = "Show control loop and output timing",
+        .hint = NULL,
+        .func = &show_loop,
+    };
+    ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));
+}
+
+// 'bus' command captures the next latch of the M1E1 595 chain
+
+#define CONSOLE_BUS_MAX_EDGES 1024
+#define CONSOLE_BUS_TIMEOUT_MS 2000
+
+static struct // argument order defined by struct ordering
+{
+    struct arg_lit *vcd;
+    struct arg_end *end;
+} bus_args;
+
+static void print_vcd(void *ctx, const char *text)
+{
+    // VCD lines end with LF only
+    for (const char *c = text; *c != '\0'; c++)
+    {
+        if (*c == '\n')
+            putchar('\r');
+        putchar(*c);
+    }
+}
+
+static int show_bus(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **)&bus_args);
+    if (nerrors != 0)
+    {
+        arg_print_errors(stderr, bus_args.end, argv[0]);
+        return 1;
+    }
+
+    printf("\r\n");
+    struct ofp_hw *hw = ofp_hw_get_current();
+    if (hw == NULL || strcmp(hw->id, hw_m1e1_get_definition()->id) != 0)
+    {
+        printf("Only available with M1E1 hardware\r\n");
+        return -1;
+    }
+
+    struct vcd_edge *edges = malloc(CONSOLE_BUS_MAX_EDGES * sizeof(struct vcd_edge));
+    if (edges == NULL)
+    {
+        printf("Could not allocate capture\r\n");
+        return -1;
+    }
+
+    const struct s2p_595 *chain = hw_m1e1_get_chain();
+    struct vcd_capture capture;
+    vcd_capture_init(&capture, edges, CONSOLE_BUS_MAX_EDGES);
+    vcd_capture_add_signal(&capture, "SER", chain->pin_serial_in);
+    vcd_capture_add_signal(&capture, "SRCLK", chain->pin_shift_clock);
+    vcd_capture_add_signal(&capture, "RCLK", chain->pin_latch_clock);
+    vcd_capture_add_signal(&capture, "SRCLR", chain->pin_reset);
+    vcd_capture_add_signal(&capture, "OE", chain->pin_output_enable);
+
+    struct output_probe probe = {.capture = &capture};
+    if (!output_probe(&probe, pdMS_TO_TICKS(CONSOLE_BUS_TIMEOUT_MS)))
+    {
+        printf("No latch captured\r\n");
+        free(edges);
+        return -1;
+    }
+    int64_t wall_us = pulse_timer_wall_clock_us();
+
+    // replay the capture through a model of the chain, each zone using two outputs
+    struct sim_595 sim;
+    sim_595_init(&sim, (hw->zone_set.count * 2 + 7) / 8, chain->pin_serial_in, chain->pin_shift_clock, chain->pin_latch_clock, chain->pin_reset, chain->pin_output_enable);
+    // outputs already enabled, and reset inactive
+    sim_595_pin(&sim, chain->pin_output_enable, 0);
+    for (int i = 0; i < capture.count; i++)
+    {
+        const struct vcd_signal *signal = &capture.signals[capture.edges[i].signal];
+        sim_595_pin(&sim, signal->pin, capture.edges[i].value);
+    }
+
+    uint32_t hold_ns = (capture.count > 0) ? capture.edges[capture.count - 1].time_ns - capture.edges[0].time_ns : 0;
+    printf("edges=%i dropped=%u shifts=%u latches=%u bus_hold_ns=%u\r\n", capture.count, capture.dropped, sim.shifts, sim.latches, hold_ns);
+
+    // compare latched outputs with current orders (which may differ on a pulse edge)
+    for (int i = 0; i < hw->zone_set.count; i++)
+    {
+        struct ofp_zone *zone = &hw->zone_set.zones[i];
+        bool pos = false, neg = false;
+        ofp_order_to_half_waves(zone->current, &pos, &neg, wall_us);
+        bool latched_pos = sim_595_output(&sim, i * 2);
+        bool latched_neg = sim_595_output(&sim, i * 2 + 1);
+        printf("\t%s %s P=%i N=%i%s\r\n", zone->id, ofp_order_info_by_num_id(zone->current)->id, latched_pos, latched_neg, (pos != latched_pos || neg != latched_neg) ? " MISMATCH" : "");
+    }
+
+    if (bus_args.vcd->count > 0)
+        vcd_write(&capture, print_vcd, NULL);
+
+    free(edges);
+    return 0;
+}
+
+static void register_bus(void)
+{
+    bus_args.vcd = arg_lit0("v", "vcd", "Print the capture as a VCD file");
+    bus_args.end = arg_end(1);
+
+    const esp_console_cmd_t cmd = {
+        .command = "bus",
+        .help = "Capture the next latch of the M1E1 595 chain, and decode it",
+        .hint = NULL,
+        .func = &show_bus,
+        .argtable = &bus_args,
+    };
+    ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));
+}
+
+// 'bench' command measures the hot paths in CPU cycles
+
+#define CONSOLE_BENCH_DEFAULT_SAMPLES 100
+#define CONSOLE_BENCH_DEFAULT_ZONES 16
+
+static struct // argument order defined by struct ordering
+{
+    struct arg_int *samples;
+    struct arg_int *zones;
+    struct arg_end *end;
+} bench_args;
+
+static int run_bench(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **)&bench_args);
+    if (nerrors != 0)
+    {
+        arg_print_errors(stderr, bench_args.end, argv[0]);
+        return 1;
+    }
+
+    int samples = bench_args.samples->count > 0 ? bench_args.samples->ival[0] : CONSOLE_BENCH_DEFAULT_SAMPLES;
+    int zones = bench_args.zones->count > 0 ? bench_args.zones->ival[0] : CONSOLE_BENCH_DEFAULT_ZONES;
+
+    printf("\r\n");
+    if (samples < 1 || samples > BENCH_MAX_SAMPLES)
+    {
+        printf("Samples must be between 1 and %i\r\n", BENCH_MAX_SAMPLES);
+        return -1;
+    }
+    if (zones < 1 || zones > BENCH_MAX_ZONES)
+    {
+        printf("Zones must be between 1 and %i\r\n", BENCH_MAX_ZONES);
+        return -1;
+    }
+
+    bench_run(samples, zones);
+    return 0;
+}
+
+static void register_bench(void)
+{
+    bench_args.samples = arg_int0("n", "samples", "<n>", "Runs of each benchmark (default 100, at most 20 for password and NVS)");
+    bench_args.zones = arg_int0("z", "zones", "<n>", "Synthetic zones for order computation (default 16)");
+    bench_args.end = arg_end(2);
+
+    const esp_console_cmd_t cmd = {
+        .command = "bench",
+        .help = "Measure hot paths in CPU cycles (min, median, p99)",
+        .hint = NULL,
+        .func = &run_bench,
+        .argtable = &bench_args,
+    };
+    ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));
+}
+
+// 'reqheap' command prints the heap usage of web requests, per route
+
+static struct // argument order defined by struct ordering
+{
+    struct arg_lit *clear;
+    struct arg_end *end;
+} reqheap_args;
+
+static int show_reqheap(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **)&reqheap_args);
+    if (nerrors != 0)
+    {
+        arg_print_errors(stderr, reqheap_args.end, argv[0]);
+        return 1;
+    }
+
+    printf("\r\n");
+#ifndef CONFIG_OFP_UI_WEBSERVER_HEAP_PROFILER
+    printf("Heap profiler is disabled\r\n");
+    return -1;
+#else
+    struct heap_profiler_route *routes = malloc(HEAP_PROFILER_MAX_ROUTES * sizeof(struct heap_profiler_route));
+    if (routes == NULL)
+    {
+        printf("Could not allocate routes\r\n");
+        return -1;
+    }
+
+    int count = heap_profiler_get_routes(routes, HEAP_PROFILER_MAX_ROUTES);
+    printf("Calls\tAllocs\tMaxAll\tMaxPeak\tNet\tLastNet\tLeaking\tRoute\r\n");
+    for (int i = 0; i < count; i++)
+    {
+        struct heap_profiler_route *r = &routes[i];
+        printf("%u\t%u\t%u\t%u\t%i\t%i\t%u\t%s %s%s\r\n",
+               r->calls,
+               r->allocations,
+               r->max_allocations,
+               r->max_peak,
+               r->net,
+               r->last_net,
+               r->leaking_calls,
+               http_method_str(r->method),
+               r->route != NULL ? r->route : "(no route)",
+               r->leaking_calls >= CONFIG_OFP_UI_WEBSERVER_HEAP_PROFILER_LEAK_CALLS ? " LEAKING" : "");
+    }
+    free(routes);
+
+    if (reqheap_args.clear->count > 0)
+        heap_profiler_clear();
+    return 0;
+#endif /* CONFIG_OFP_UI_WEBSERVER_HEAP_PROFILER */
+}
+
+static void register_reqheap(void)
+{
+    reqheap_args.clear = arg_lit0("c", "clear", "Forget every route after printing");
+    reqheap_args.end = arg_end(1);
+
+    const esp_console_cmd_t cmd = {
+        .command = "reqheap",
+        .help = "Show allocations, peak and net heap use of web requests, per route",
+        .hint = NULL,
+        .func = &show_reqheap,
+        .argtable = &reqheap_args,
+    };
+    ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));
+}
+
+// 'server_timing' command switches the Server-Timing header of web responses
+
+static struct // argument order defined by struct ordering
+{
+    struct arg_str *state;
+    struct arg_end *end;
+} server_timing_args;
+
+static int server_timing_cmd(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **)&server_timing_args);
+    if (nerrors != 0)
+    {
+        arg_print_errors(stderr, server_timing_args.end, argv[0]);
+        return 1;
+    }
+
+    printf("\r\n");
+    if (server_timing_args.state->count > 0)
+    {
+        const char *state = server_timing_args.state->sval[0];
+        if (strcmp(state, "on") == 0)
+            webserver_set_server_timing(true);
+        else if (strcmp(state, "off") == 0)
+            webserver_set_server_timing(false);
+        else
+        {
+            printf("Invalid state '%s', choose from on|off\r\n", state);
+            return 1;
+        }
+    }
+    printf("Server-Timing header %s\r\n", webserver_get_server_timing() ? "enabled" : "disabled");
+    return 0;
+}
+
+static void register_server_timing(void)
+{
+    server_timing_args.state = arg_str0(NULL, NULL, "<on|off>", "Enable or disable the header, shows the current state if omitted");
+    server_timing_args.end = arg_end(1);
+
+    const esp_console_cmd_t cmd = {
+        .command = "server_timing",
+        .help = "Add per-phase durations of web requests in a Server-Timing response header",
+        .hint = NULL,
+        .func = &server_timing_cmd,
+        .argtable = &server_timing_args,
+    };
+    ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));
+}
+
 // 'hardware' command prints in-memory hardware definition
 static int show_hardware(int argc, char **argv)
 {
@@ -725,6 +1299,7 @@ void console_init(void)
     register_log_level();
 #ifdef CONFIG_FREERTOS_USE_TRACE_FACILITY
     register_task_stats();
+    register_top();
 #endif /* CONFIG_FREERTOS_USE_TRACE_FACILITY */
     register_hardware();
     register_zones();
@@ -734,7 +1309,14 @@ void console_init(void)
     register_nvs_delete();
     register_plannings();
     register_accounts();
-
+    register_trace();
+    register_loop();
+    register_bus();
+    register_bench();
+    register_reqheap();
+    register_server_timing();
+
+    top_register_stack("console_repl", repl_config.task_stack_size);
     esp_console_dev_uart_config_t hw_config = ESP_CONSOLE_DEV_UART_CONFIG_DEFAULT();
     ESP_ERROR_CHECK(esp_console_new_repl_uart(&hw_config, &repl_config, &repl));
     ESP_ERROR_CHECK(esp_console_start_repl(repl));
@@ -0,0 +1,239 @@
+#include <stdlib.h>
+#include <string.h>
+#include <reent.h>
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "sdkconfig.h"
+
+#include "heap_profiler.h"
+
+#ifdef CONFIG_OFP_UI_WEBSERVER_HEAP_PROFILER
+
+static const char TAG[] = "heap_profiler";
+
+struct heap_profiler_request
+{
+    unsigned int allocations;
+    // bytes allocated minus bytes freed since the beginning of the request
+    int32_t live;
+    int32_t peak;
+    const char *route;
+};
+
+/* global variables */
+static struct heap_profiler_route routes[HEAP_PROFILER_MAX_ROUTES];
+static int route_count = 0;
+
+// only changed by the profiled task, counters are not shared
+static TaskHandle_t profiled_task = NULL;
+static struct heap_profiler_request request;
+
+/* mutex variables */
+portMUX_TYPE mutex_heap_profiler = portMUX_INITIALIZER_UNLOCKED;
+
+/***************************************************************************/
+
+/* provided by the linker, see CMakeLists.txt */
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+void *__real__malloc_r(struct _reent *r, size_t size);
+void *__real__calloc_r(struct _reent *r, size_t count, size_t size);
+void *__real__realloc_r(struct _reent *r, void *ptr, size_t size);
+void __real__free_r(struct _reent *r, void *ptr);
+
+/*
+ * These run for every allocation of the firmware : they MUST NOT allocate,
+ * log or block, and only look at the calling task
+ */
+static inline bool heap_profiler_is_profiled(void)
+{
+    return profiled_task != NULL && profiled_task == xTaskGetCurrentTaskHandle();
+}
+
+static inline void heap_profiler_allocated(void *ptr)
+{
+    if (ptr == NULL || !heap_profiler_is_profiled())
+        return;
+    request.allocations++;
+    request.live += heap_caps_get_allocated_size(ptr);
+    if (request.live > request.peak)
+        request.peak = request.live;
+}
+
+static inline void heap_profiler_freeing(void *ptr)
+{
+    if (ptr == NULL || !heap_profiler_is_profiled())
+        return;
+    request.live -= heap_caps_get_allocated_size(ptr);
+}
+
+void *__wrap_malloc(size_t size)
+{
+    void *ptr = __real_malloc(size);
+    heap_profiler_allocated(ptr);
+    return ptr;
+}
+
+void *__wrap_calloc(size_t count, size_t size)
+{
+    void *ptr = __real_calloc(count, size);
+    heap_profiler_allocated(ptr);
+    return ptr;
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    // on failure the original block is kept, so accounting is only done on success
+    size_t before = (ptr != NULL && heap_profiler_is_profiled()) ? heap_caps_get_allocated_size(ptr) : 0;
+    void *result = __real_realloc(ptr, size);
+    if (result == NULL && size != 0)
+        return NULL;
+    if (heap_profiler_is_profiled())
+    {
+        request.live -= before;
+        heap_profiler_allocated(result);
+    }
+    return result;
+}
+
+void __wrap_free(void *ptr)
+{
+    heap_profiler_freeing(ptr);
+    __real_free(ptr);
+}
+
+void *__wrap__malloc_r(struct _reent *r, size_t size)
+{
+    void *ptr = __real__malloc_r(r, size);
+    heap_profiler_allocated(ptr);
+    return ptr;
+}
+
+void *__wrap__calloc_r(struct _reent *r, size_t count, size_t size)
+{
+    void *ptr = __real__calloc_r(r, count, size);
+    heap_profiler_allocated(ptr);
+    return ptr;
+}
+
+void *__wrap__realloc_r(struct _reent *r, void *ptr, size_t size)
+{
+    size_t before = (ptr != NULL && heap_profiler_is_profiled()) ? heap_caps_get_allocated_size(ptr) : 0;
+    void *result = __real__realloc_r(r, ptr, size);
+    if (result == NULL && size != 0)
+        return NULL;
+    if (heap_profiler_is_profiled())
+    {
+        request.live -= before;
+        heap_profiler_allocated(result);
+    }
+    return result;
+}
+
+void __wrap__free_r(struct _reent *r, void *ptr)
+{
+    heap_profiler_freeing(ptr);
+    __real__free_r(r, ptr);
+}
+
+/***************************************************************************/
+
+/* MUST be called with the mutex held */
+static struct heap_profiler_route *heap_profiler_find_route(int method, const char *route)
+{
+    for (int i = 0; i < route_count; i++)
+    {
+        if (routes[i].method == method && routes[i].route == route)
+            return &routes[i];
+    }
+    if (route_count == HEAP_PROFILER_MAX_ROUTES)
+        return NULL;
+
+    struct heap_profiler_route *r = &routes[route_count++];
+    memset(r, 0, sizeof(struct heap_profiler_route));
+    r->method = method;
+    r->route = route;
+    return r;
+}
+
+#endif /* CONFIG_OFP_UI_WEBSERVER_HEAP_PROFILER */
+
+/***************************************************************************/
+
+void heap_profiler_request_begin(void)
+{
+#ifdef CONFIG_OFP_UI_WEBSERVER_HEAP_PROFILER
+    memset(&request, 0, sizeof(request));
+    profiled_task = xTaskGetCurrentTaskHandle();
+#endif /* CONFIG_OFP_UI_WEBSERVER_HEAP_PROFILER */
+}
+
+void heap_profiler_set_route(const char *route)
+{
+#ifdef CONFIG_OFP_UI_WEBSERVER_HEAP_PROFILER
+    if (heap_profiler_is_profiled())
+        request.route = route;
+#endif /* CONFIG_OFP_UI_WEBSERVER_HEAP_PROFILER */
+}
+
+void heap_profiler_request_end(int method)
+{
+#ifdef CONFIG_OFP_UI_WEBSERVER_HEAP_PROFILER
+    if (!heap_profiler_is_profiled())
+        return;
+    profiled_task = NULL;
+
+    bool warn = false;
+    unsigned int leaking_calls = 0;
+    int32_t net = 0;
+    taskENTER_CRITICAL(&mutex_heap_profiler);
+    struct heap_profiler_route *r = heap_profiler_find_route(method, request.route);
+    if (r != NULL)
+    {
+        r->calls++;
+        r->allocations += request.allocations;
+        if (request.allocations > r->max_allocations)
+            r->max_allocations = request.allocations;
+        if ((uint32_t)request.peak > r->max_peak)
+            r->max_peak = request.peak;
+        r->net += request.live;
+        r->last_net = request.live;
+        r->leaking_calls = (request.live > 0) ? r->leaking_calls + 1 : 0;
+        leaking_calls = r->leaking_calls;
+        net = r->net;
+        warn = leaking_calls > 0 && leaking_calls % CONFIG_OFP_UI_WEBSERVER_HEAP_PROFILER_LEAK_CALLS == 0;
+    }
+    taskEXIT_CRITICAL(&mutex_heap_profiler);
+
+    if (r == NULL)
+        ESP_LOGD(TAG, "No room to profile route %s", request.route ? request.route : "(none)");
+    if (warn)
+        ESP_LOGW(TAG, "Route %s (method %i) kept memory on its last %u calls, %i bytes in total", request.route ? request.route : "(none)", method, leaking_calls, net);
+#endif /* CONFIG_OFP_UI_WEBSERVER_HEAP_PROFILER */
+}
+
+int heap_profiler_get_routes(struct heap_profiler_route *out, int max)
+{
+    int count = 0;
+#ifdef CONFIG_OFP_UI_WEBSERVER_HEAP_PROFILER
+    taskENTER_CRITICAL(&mutex_heap_profiler);
+    count = route_count < max ? route_count : max;
+    memcpy(out, routes, count * sizeof(struct heap_profiler_route));
+    taskEXIT_CRITICAL(&mutex_heap_profiler);
+#endif /* CONFIG_OFP_UI_WEBSERVER_HEAP_PROFILER */
+    return count;
+}
+
+void heap_profiler_clear(void)
+{
+#ifdef CONFIG_OFP_UI_WEBSERVER_HEAP_PROFILER
+    taskENTER_CRITICAL(&mutex_heap_profiler);
+    route_count = 0;
+    taskEXIT_CRITICAL(&mutex_heap_profiler);
+#endif /* CONFIG_OFP_UI_WEBSERVER_HEAP_PROFILER */
+}
\ No newline at end of file
@@ -0,0 +1,53 @@
+#ifndef HEAP_PROFILER_H
+#define HEAP_PROFILER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "sdkconfig.h"
+
+/*
+ * Per-route heap usage of web requests
+ *
+ * The allocator functions are wrapped at link time (see CMakeLists.txt),
+ * and only the allocations made by the task serving a request are counted,
+ * from its beginning to its end : count, peak heap use above the start of
+ * the request, and bytes still allocated at its end (net).
+ *
+ * Requests are aggregated per method and route in a fixed table. A warning
+ * is logged whenever a route has a positive net on OFP_UI_WEBSERVER_HEAP_PROFILER_LEAK_CALLS
+ * consecutive calls, as memory kept on purpose (a new planning, a session)
+ * only shows up on some calls.
+ *
+ * Everything does nothing if OFP_UI_WEBSERVER_HEAP_PROFILER is disabled
+ */
+
+#define HEAP_PROFILER_MAX_ROUTES 48
+
+struct heap_profiler_route
+{
+    int method;
+    // route regex, or NULL for requests not matching any api route
+    const char *route;
+    unsigned int calls;
+    unsigned int allocations;
+    unsigned int max_allocations;
+    uint32_t max_peak;
+    // cumulated net of every call, which can be negative
+    int32_t net;
+    int32_t last_net;
+    // consecutive calls with a positive net
+    unsigned int leaking_calls;
+};
+
+/* MUST be called by the task serving the request, which is the only one profiled */
+void heap_profiler_request_begin(void);
+/* route matched by the request, a string which is never freed */
+void heap_profiler_set_route(const char *route);
+void heap_profiler_request_end(int method);
+
+/* returns the number of routes copied */
+int heap_profiler_get_routes(struct heap_profiler_route *routes, int max);
+void heap_profiler_clear(void);
+
+#endif /* HEAP_PROFILER_H */
\ No newline at end of file
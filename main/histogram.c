@@ -0,0 +1,24 @@
+#include "histogram.h"
+
+void histogram_add(struct histogram *h, uint32_t value)
+{
+    int bucket = (value < 2) ? 0 : 31 - __builtin_clz(value);
+    if (bucket >= HISTOGRAM_BUCKETS)
+        bucket = HISTOGRAM_BUCKETS - 1;
+
+    h->buckets[bucket]++;
+    h->count++;
+    h->sum += value;
+    if (value > h->max)
+        h->max = value;
+}
+
+uint32_t histogram_bucket_min(int bucket)
+{
+    return (bucket == 0) ? 0 : (1u << bucket);
+}
+
+uint32_t histogram_mean(const struct histogram *h)
+{
+    return (h->count == 0) ? 0 : h->sum / h->count;
+}
\ No newline at end of file
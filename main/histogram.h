@@ -0,0 +1,34 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdint.h>
+
+/*
+ * Fixed-size histogram of durations
+ *
+ * Bucket 0 counts values below 2, bucket i (i > 0) values in [2^i, 2^(i+1)),
+ * and the last bucket every larger value. Adding a value is O(1) and never
+ * allocates, so that it can be used from the control loop.
+ *
+ * Not thread-safe, callers protect it if needed
+ */
+
+#define HISTOGRAM_BUCKETS 20
+
+struct histogram
+{
+    uint32_t count;
+    uint32_t max;
+    uint64_t sum;
+    uint32_t buckets[HISTOGRAM_BUCKETS];
+};
+
+void histogram_add(struct histogram *h, uint32_t value);
+
+/* smallest value counted in a bucket */
+uint32_t histogram_bucket_min(int bucket);
+
+/* 0 if empty */
+uint32_t histogram_mean(const struct histogram *h);
+
+#endif /* HISTOGRAM_H */
\ No newline at end of file
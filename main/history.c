@@ -0,0 +1,365 @@
+#include <string.h>
+#include <time.h>
+#include <esp_log.h>
+#include <esp_partition.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+
+#include "sdkconfig.h"
+
+#include "ofp.h"
+#include "history.h"
+#include "top.h"
+
+static const char TAG[] = "history";
+
+#define HISTORY_SECTOR_SIZE 4096
+#define HISTORY_MAGIC 0x48495354 // HIST
+#define HISTORY_ERASED_TIMESTAMP 0xFFFFFFFF
+
+// first slot of every sector holds the header
+#define HISTORY_RECORDS_PER_SECTOR (HISTORY_SECTOR_SIZE / sizeof(struct history_record) - 1)
+#define HISTORY_READ_BATCH 32
+#define HISTORY_TASK_STACK_SIZE 3072
+
+struct history_sector_header
+{
+    uint32_t magic;
+    uint32_t seq;
+};
+
+/* RAM ring, record n is at ring[n % size] */
+static struct history_record ring[CONFIG_OFP_HISTORY_RAM_RECORDS];
+static uint32_t head = 0;
+static uint32_t checkpointed = 0;
+
+/* flash partition, none if NULL */
+static const esp_partition_t *part = NULL;
+static int sector_count = 0;
+static int current_sector = 0;
+static uint32_t current_seq = 0; // 0 if no sector was ever written
+static int sector_used = 0;
+static bool ram_only = false;
+
+/* last recorded orders, only used by the control loop */
+static bool tracked[OFP_MAX_ZONE_COUNT];
+static uint8_t last_order[OFP_MAX_ZONE_COUNT];
+
+/* statistics */
+static unsigned int dropped = 0;
+static unsigned int checkpoints = 0;
+
+/* global variables */
+static TaskHandle_t checkpoint_task = NULL;
+static SemaphoreHandle_t checkpoint_lock = NULL;
+
+/* mutex variables */
+portMUX_TYPE mutex_history = portMUX_INITIALIZER_UNLOCKED;
+
+/***************************************************************************/
+
+static uint16_t history_check(const struct history_record *r)
+{
+    uint32_t v = r->timestamp ^ ((uint32_t)r->zone << 8 | r->order) ^ 0xA5A5A5A5;
+    return (v ^ (v >> 16)) & 0xFFFF;
+}
+
+static uint32_t history_sector_offset(int sector)
+{
+    return sector * HISTORY_SECTOR_SIZE;
+}
+
+static uint32_t history_record_offset(int sector, int index)
+{
+    return history_sector_offset(sector) + (index + 1) * sizeof(struct history_record);
+}
+
+static bool history_read_header(int sector, struct history_sector_header *header)
+{
+    esp_err_t err = esp_partition_read(part, history_sector_offset(sector), header, sizeof(struct history_sector_header));
+    if (err != ESP_OK)
+    {
+        ESP_LOGW(TAG, "Could not read header of sector %i: %s", sector, esp_err_to_name(err));
+        return false;
+    }
+    return header->magic == HISTORY_MAGIC;
+}
+
+/* number of records written in a sector, stops at the first erased one */
+static int history_count_records(int sector)
+{
+    struct history_record batch[HISTORY_READ_BATCH];
+    for (int i = 0; i < HISTORY_RECORDS_PER_SECTOR; i += HISTORY_READ_BATCH)
+    {
+        int count = HISTORY_RECORDS_PER_SECTOR - i;
+        if (count > HISTORY_READ_BATCH)
+            count = HISTORY_READ_BATCH;
+
+        if (esp_partition_read(part, history_record_offset(sector, i), batch, count * sizeof(struct history_record)) != ESP_OK)
+            return i;
+
+        for (int j = 0; j < count; j++)
+            if (batch[j].timestamp == HISTORY_ERASED_TIMESTAMP)
+                return i + j;
+    }
+    return HISTORY_RECORDS_PER_SECTOR;
+}
+
+/* reuses the oldest sector */
+static bool history_open_next_sector(void)
+{
+    int next = (current_seq == 0) ? 0 : (current_sector + 1) % sector_count;
+    struct history_sector_header header = {.magic = HISTORY_MAGIC, .seq = current_seq + 1};
+
+    esp_err_t err = esp_partition_erase_range(part, history_sector_offset(next), HISTORY_SECTOR_SIZE);
+    if (err == ESP_OK)
+        err = esp_partition_write(part, history_sector_offset(next), &header, sizeof(header));
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Could not prepare sector %i: %s", next, esp_err_to_name(err));
+        return false;
+    }
+
+    ESP_LOGD(TAG, "Sector %i opened with seq %u", next, header.seq);
+    taskENTER_CRITICAL(&mutex_history);
+    current_sector = next;
+    current_seq = header.seq;
+    sector_used = 0;
+    taskEXIT_CRITICAL(&mutex_history);
+    return true;
+}
+
+/* only called by the task, or with the checkpoint lock held */
+static void history_write_pending(void)
+{
+    taskENTER_CRITICAL(&mutex_history);
+    uint32_t start = checkpointed;
+    uint32_t end = head;
+    taskEXIT_CRITICAL(&mutex_history);
+
+    if (start == end)
+        return;
+
+    // pending records are never overwritten, so they are written straight from the ring
+    while (start != end)
+    {
+        if (current_seq == 0 || sector_used == HISTORY_RECORDS_PER_SECTOR)
+        {
+            if (!history_open_next_sector())
+                return;
+        }
+
+        uint32_t index = start % CONFIG_OFP_HISTORY_RAM_RECORDS;
+        uint32_t count = end - start;
+        if (count > CONFIG_OFP_HISTORY_RAM_RECORDS - index)
+            count = CONFIG_OFP_HISTORY_RAM_RECORDS - index;
+        if (count > HISTORY_RECORDS_PER_SECTOR - sector_used)
+            count = HISTORY_RECORDS_PER_SECTOR - sector_used;
+
+        esp_err_t err = esp_partition_write(part, history_record_offset(current_sector, sector_used), &ring[index], count * sizeof(struct history_record));
+        if (err != ESP_OK)
+        {
+            ESP_LOGE(TAG, "Could not write %u records: %s", count, esp_err_to_name(err));
+            return;
+        }
+
+        start += count;
+        taskENTER_CRITICAL(&mutex_history);
+        sector_used += count;
+        checkpointed = start;
+        taskEXIT_CRITICAL(&mutex_history);
+    }
+
+    taskENTER_CRITICAL(&mutex_history);
+    checkpoints++;
+    taskEXIT_CRITICAL(&mutex_history);
+    ESP_LOGD(TAG, "Checkpoint done up to record %u", end);
+}
+
+static void history_task(void *pvParameters)
+{
+    while (true)
+    {
+        // woken up early when the ring is half full
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(CONFIG_OFP_HISTORY_CHECKPOINT_MINUTES * 60 * 1000));
+        history_checkpoint();
+    }
+}
+
+/***************************************************************************/
+
+void history_init(void)
+{
+    part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, HISTORY_PARTITION_LABEL);
+    if (part == NULL)
+    {
+        ESP_LOGW(TAG, "No %s partition, history will only be kept in memory", HISTORY_PARTITION_LABEL);
+        taskENTER_CRITICAL(&mutex_history);
+        ram_only = true;
+        checkpointed = head;
+        taskEXIT_CRITICAL(&mutex_history);
+        return;
+    }
+
+    // resume writing in the most recent sector
+    int count = part->size / HISTORY_SECTOR_SIZE;
+    int best_sector = 0;
+    uint32_t best_seq = 0;
+    for (int i = 0; i < count; i++)
+    {
+        struct history_sector_header header;
+        if (history_read_header(i, &header) && header.seq > best_seq)
+        {
+            best_seq = header.seq;
+            best_sector = i;
+        }
+    }
+    int used = (best_seq == 0) ? 0 : history_count_records(best_sector);
+    ESP_LOGI(TAG, "%i sectors, resuming in sector %i (seq %u) at record %i", count, best_sector, best_seq, used);
+
+    checkpoint_lock = xSemaphoreCreateMutex();
+    configASSERT(checkpoint_lock);
+
+    // records taken until now are pending, and kept as such
+    taskENTER_CRITICAL(&mutex_history);
+    sector_count = count;
+    current_sector = best_sector;
+    current_seq = best_seq;
+    sector_used = used;
+    taskEXIT_CRITICAL(&mutex_history);
+
+    TaskHandle_t xHandle = NULL;
+    top_register_stack("history", HISTORY_TASK_STACK_SIZE);
+    xTaskCreatePinnedToCore(history_task, "history", HISTORY_TASK_STACK_SIZE, NULL, 1, &xHandle, 0);
+    configASSERT(xHandle);
+    checkpoint_task = xHandle;
+}
+
+void history_track_zones(struct ofp_hw *hw)
+{
+    uint32_t now = (uint32_t)time(NULL);
+    bool notify = false;
+
+    for (int i = 0; i < hw->zone_set.count; i++)
+    {
+        uint8_t order = hw->zone_set.zones[i].current;
+        if (tracked[i] && last_order[i] == order)
+            continue;
+
+        struct history_record r = {.timestamp = now, .zone = i, .order = order};
+        r.check = history_check(&r);
+
+        taskENTER_CRITICAL(&mutex_history);
+        bool full = (head - checkpointed) >= CONFIG_OFP_HISTORY_RAM_RECORDS;
+        if (full)
+        {
+            // keep pending records, retried on next call
+            dropped++;
+        }
+        else
+        {
+            ring[head % CONFIG_OFP_HISTORY_RAM_RECORDS] = r;
+            head++;
+            // without partition, the ring only keeps the most recent records
+            if (ram_only)
+                checkpointed = head;
+            notify |= (head - checkpointed) == CONFIG_OFP_HISTORY_RAM_RECORDS / 2;
+        }
+        taskEXIT_CRITICAL(&mutex_history);
+
+        if (full)
+            continue;
+
+        tracked[i] = true;
+        last_order[i] = order;
+    }
+
+    if (notify && checkpoint_task != NULL)
+        xTaskNotifyGive(checkpoint_task);
+}
+
+void history_checkpoint(void)
+{
+    if (checkpoint_lock == NULL)
+        return;
+
+    xSemaphoreTake(checkpoint_lock, portMAX_DELAY);
+    history_write_pending();
+    xSemaphoreGive(checkpoint_lock);
+}
+
+void history_query(int zone, history_record_callback callback, void *ctx)
+{
+    taskENTER_CRITICAL(&mutex_history);
+    int snap_sector = current_sector;
+    uint32_t snap_seq = current_seq;
+    int snap_used = sector_used;
+    int snap_count = sector_count;
+    uint32_t snap_checkpointed = checkpointed;
+    uint32_t snap_head = head;
+    taskEXIT_CRITICAL(&mutex_history);
+
+    // flash, from the sector after the current one (oldest) to the current one
+    struct history_record batch[HISTORY_READ_BATCH];
+    for (int k = 1; snap_seq != 0 && k <= snap_count; k++)
+    {
+        int sector = (snap_sector + k) % snap_count;
+        struct history_sector_header header;
+        if (!history_read_header(sector, &header) || header.seq > snap_seq || header.seq + snap_count <= snap_seq)
+            continue;
+
+        int limit = (sector == snap_sector) ? snap_used : HISTORY_RECORDS_PER_SECTOR;
+        for (int i = 0; i < limit; i += HISTORY_READ_BATCH)
+        {
+            int count = min_int(limit - i, HISTORY_READ_BATCH);
+            if (esp_partition_read(part, history_record_offset(sector, i), batch, count * sizeof(struct history_record)) != ESP_OK)
+                break;
+
+            for (int j = 0; j < count; j++)
+            {
+                if (batch[j].timestamp == HISTORY_ERASED_TIMESTAMP)
+                    break;
+                if (batch[j].check != history_check(&batch[j]))
+                    continue;
+                if (zone >= 0 && batch[j].zone != zone)
+                    continue;
+                if (!callback(ctx, &batch[j]))
+                    return;
+            }
+        }
+    }
+
+    // then records only available in memory
+    uint32_t n = snap_checkpointed;
+    if (snap_count == 0)
+        n = (snap_head > CONFIG_OFP_HISTORY_RAM_RECORDS) ? snap_head - CONFIG_OFP_HISTORY_RAM_RECORDS : 0;
+
+    for (; n != snap_head; n++)
+    {
+        struct history_record r;
+        bool available;
+        taskENTER_CRITICAL(&mutex_history);
+        available = (head - n) <= CONFIG_OFP_HISTORY_RAM_RECORDS;
+        r = ring[n % CONFIG_OFP_HISTORY_RAM_RECORDS];
+        taskEXIT_CRITICAL(&mutex_history);
+
+        if (!available || (zone >= 0 && r.zone != zone))
+            continue;
+        if (!callback(ctx, &r))
+            return;
+    }
+}
+
+void history_get_stats(struct history_stats *stats)
+{
+    assert(stats != NULL);
+
+    taskENTER_CRITICAL(&mutex_history);
+    stats->records = head;
+    stats->pending = head - checkpointed;
+    stats->dropped = dropped;
+    stats->checkpoints = checkpoints;
+    stats->flash_sectors = sector_count;
+    taskEXIT_CRITICAL(&mutex_history);
+}
\ No newline at end of file
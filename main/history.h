@@ -0,0 +1,59 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ofp.h"
+
+/*
+ * Per-zone order history
+ *
+ * Only transitions are recorded (run-length encoding : a run lasts until the
+ * next record of the same zone), 8 bytes each, in a RAM ring which is
+ * periodically appended to the "history" data partition, in batches.
+ *
+ * The partition is a circular list of sectors, each one starting with a
+ * header holding a sequence number, so that the oldest sector is reused
+ * once every sector is full. Without the partition, history is RAM only.
+ */
+
+#define HISTORY_PARTITION_LABEL "history"
+
+/* timestamps are seconds since epoch, which are small until the clock is synchronized */
+struct history_record
+{
+    uint32_t timestamp;
+    uint8_t zone;
+    uint8_t order;
+    // detects partially written records after a power loss
+    uint16_t check;
+};
+
+/* return false to stop iterating */
+typedef bool (*history_record_callback)(void *ctx, const struct history_record *record);
+
+/* zones can be tracked before the partition is loaded */
+void history_init(void);
+
+/* records the current order of zones which changed since the last call */
+void history_track_zones(struct ofp_hw *hw);
+
+/* writes pending records to flash now, for example before a reboot */
+void history_checkpoint(void);
+
+/* iterates over the records of a zone, oldest first, every record if zone is negative */
+void history_query(int zone, history_record_callback callback, void *ctx);
+
+struct history_stats
+{
+    unsigned int records;
+    unsigned int pending;
+    unsigned int dropped;
+    unsigned int checkpoints;
+    int flash_sectors;
+};
+
+void history_get_stats(struct history_stats *stats);
+
+#endif /* HISTORY_H */
\ No newline at end of file
@@ -15,7 +15,7 @@ static const char *str_zone_count = "zone_count";
 
 /* forward definitions */
 static bool hw_esp32_zone_set_init(struct ofp_hw *hw);
-static bool hw_esp32_zone_set_apply(struct ofp_hw *hw, struct tm *timeinfo);
+static bool hw_esp32_zone_set_apply(struct ofp_hw *hw, const enum ofp_order_id *orders, int64_t wall_us);
 
 /* hardware properties */
 static struct ofp_hw hw_esp32 = {
@@ -104,12 +104,12 @@ static bool hw_esp32_zone_set_init(struct ofp_hw *hw)
 }
 
 /* apply dynamic state to hardware */
-static bool hw_esp32_zone_set_apply(struct ofp_hw *hw, struct tm *timeinfo)
+static bool hw_esp32_zone_set_apply(struct ofp_hw *hw, const enum ofp_order_id *orders, int64_t wall_us)
 {
     ESP_LOGD(TAG, "hw_esp32_zone_set_apply %p", hw);
     assert(hw != NULL);
     /*
-        INFO: apply zone current state to hardware
+        INFO: apply zone orders to hardware
         Return true if hardware was successfully updated
     */
     return false;
@@ -0,0 +1,185 @@
+#include <stddef.h>
+#include <stdio.h>
+#include <esp_log.h>
+#include <soc/soc.h>
+#include <soc/gpio_reg.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "str.h"
+#include "hw_gpio.h"
+#include "pin_map.h"
+
+static const char TAG[] = "gpio";
+
+/* defines */
+#define HW_GPIO_ZONE_ID_FORMAT "D%02i"
+
+/* consts */
+static const char *str_pins_pos = "pins_pos";
+static const char *str_pins_neg = "pins_neg";
+
+/* forward definitions */
+static bool hw_gpio_zone_set_init(struct ofp_hw *hw);
+static bool hw_gpio_zone_set_apply(struct ofp_hw *hw, const enum ofp_order_id *orders, int64_t wall_us);
+
+/* hardware properties */
+static struct ofp_hw hw_gpio = {
+    .id = "GPIO",
+    .description = "Any ESP32 driving the opto-couplers of each zone directly from two GPIO",
+    .param_count = 2,
+    .params = {
+        {
+            .id = "pins_pos",
+            .description = "Positive half-wave pin of each zone, comma separated (ex: 25,27)",
+            .type = HW_OFP_PARAM_TYPE_STRING,
+            .value = {.string_ = ""},
+        },
+        {
+            .id = "pins_neg",
+            .description = "Negative half-wave pin of each zone, comma separated (ex: 26,14)",
+            .type = HW_OFP_PARAM_TYPE_STRING,
+            .value = {.string_ = ""},
+        },
+    },
+    .zone_set = {
+        .count = 0,
+        .zones = NULL,
+    },
+    .hw_hooks = {
+        .init = hw_gpio_zone_set_init,
+        .apply = hw_gpio_zone_set_apply,
+    },
+};
+
+/* pin mapping */
+static uint8_t pins_pos[PIN_MAP_MAX_PINS];
+static uint8_t pins_neg[PIN_MAP_MAX_PINS];
+static uint32_t output_mask = 0;
+
+/* mutex variables */
+portMUX_TYPE mutex_hw_gpio_output = portMUX_INITIALIZER_UNLOCKED;
+
+/* used for registering available hardware */
+struct ofp_hw *hw_gpio_get_definition(void)
+{
+    return &hw_gpio;
+}
+
+/* init dynamic data and setup hardware (PLEASE READ ofp_hw_hooks in ofp.h) */
+static bool hw_gpio_zone_set_init(struct ofp_hw *hw)
+{
+    ESP_LOGD(TAG, "hw_gpio_zone_set_init %p", hw);
+    assert(hw != NULL);
+
+    // read the pin mapping, which gives the number of zones
+    struct ofp_hw_param *param_pins_pos = ofp_hw_param_find_by_id(hw, str_pins_pos);
+    struct ofp_hw_param *param_pins_neg = ofp_hw_param_find_by_id(hw, str_pins_neg);
+    assert(param_pins_pos != NULL);
+    assert(param_pins_neg != NULL);
+
+    int count_pos, count_neg;
+    if (!pin_map_parse(param_pins_pos->value.string_, pins_pos, PIN_MAP_MAX_PINS, &count_pos))
+    {
+        ESP_LOGW(TAG, "Invalid positive pins '%s'", param_pins_pos->value.string_);
+        return false;
+    }
+    if (!pin_map_parse(param_pins_neg->value.string_, pins_neg, PIN_MAP_MAX_PINS, &count_neg))
+    {
+        ESP_LOGW(TAG, "Invalid negative pins '%s'", param_pins_neg->value.string_);
+        return false;
+    }
+    if (count_pos != count_neg)
+    {
+        ESP_LOGW(TAG, "%i positive pins but %i negative pins", count_pos, count_neg);
+        return false;
+    }
+    uint32_t mask_pos = pin_map_mask(pins_pos, count_pos);
+    uint32_t mask_neg = pin_map_mask(pins_neg, count_neg);
+    if ((mask_pos & mask_neg) != 0)
+    {
+        ESP_LOGW(TAG, "Pins used for both half-waves (mask %08x)", mask_pos & mask_neg);
+        return false;
+    }
+
+    // allocate memory for the total number of zones available
+    int zone_count = count_pos;
+    if (!ofp_zone_set_allocate(&hw->zone_set, zone_count))
+    {
+        ESP_LOGW(TAG, "Could not allocate %i zones", zone_count);
+        return false;
+    }
+
+    // setup zone names & descriptions
+    char buf[OFP_MAX_LEN_VALUE];
+    for (int i = 0; i < hw->zone_set.count; i++)
+    {
+        int res = snprintf(buf, sizeof(buf), HW_GPIO_ZONE_ID_FORMAT, i + 1);
+        if (res < 0 || res > sizeof(buf))
+        {
+            ESP_LOGW(TAG, "Zone id too long (for %i)", i);
+            return false;
+        }
+        struct ofp_zone *zone = &hw->zone_set.zones[i];
+        if (!ofp_zone_set_id(zone, buf))
+        {
+            ESP_LOGW(TAG, "Could not set zone id %s", buf);
+            return false;
+        }
+        if (!ofp_zone_set_description(zone, buf))
+        {
+            ESP_LOGW(TAG, "Could not set zone description %s", buf);
+            return false;
+        }
+    }
+
+    // initialize hardware, every output low (cozy) until the first apply
+    output_mask = mask_pos | mask_neg;
+    REG_WRITE(GPIO_OUT_W1TC_REG, output_mask);
+    for (int i = 0; i < zone_count; i++)
+    {
+        if (!ofp_pin_setup_output_no_pull(pins_pos[i]) || !ofp_pin_setup_output_no_pull(pins_neg[i]))
+        {
+            ESP_LOGW(TAG, "Could not setup the pins of zone %i", i + 1);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* apply dynamic state to hardware */
+static bool hw_gpio_zone_set_apply(struct ofp_hw *hw, const enum ofp_order_id *orders, int64_t wall_us)
+{
+    assert(hw != NULL);
+    assert(orders != NULL);
+
+    // build the whole output image first
+    uint32_t value = 0;
+    for (int i = 0; i < hw->zone_set.count; i++)
+    {
+        bool pos, neg;
+        if (!ofp_order_to_half_waves(orders[i], &pos, &neg, wall_us))
+            continue;
+
+        if (pos)
+            value |= (1u << pins_pos[i]);
+        if (neg)
+            value |= (1u << pins_neg[i]);
+    }
+
+    /*
+        Then change every output with two stores, clearing the low pins then
+        setting the high ones. The set and clear registers only touch the
+        given bits, so other pins are never rewritten, whichever core drives
+        them. Clearing first means a zone may only pass by cozy (both halves
+        low) on its way, and the critical section keeps both stores back to
+        back, a few cycles apart.
+    */
+    taskENTER_CRITICAL(&mutex_hw_gpio_output);
+    REG_WRITE(GPIO_OUT_W1TC_REG, output_mask & ~value);
+    REG_WRITE(GPIO_OUT_W1TS_REG, value);
+    taskEXIT_CRITICAL(&mutex_hw_gpio_output);
+
+    return true;
+}
\ No newline at end of file
@@ -0,0 +1,9 @@
+#ifndef HW_GPIO_H
+#define HW_GPIO_H
+
+#include "ofp.h"
+
+/* provides the definition for the hardware */
+struct ofp_hw *hw_gpio_get_definition(void);
+
+#endif /* HW_GPIO_H */
\ No newline at end of file
@@ -5,6 +5,7 @@
 #include "str.h"
 #include "hw_m1e1.h"
 #include "s2p_595.h"
+#include "trace.h"
 
 static const char TAG[] = "m1e1";
 
@@ -32,13 +33,16 @@ struct s2p_595 global_s2p_595 = {
     .pin_output_enable = M1_PIN_595_OE,
 };
 
+/* set up early by a warm restore */
+static bool chain_ready = false;
+
 /* consts */
 static const char *str_e1_count = "e1_count";
 static const int zones_per_extension_board = 4;
 
 /* forward definitions */
 static bool hw_m1e1_zone_set_init(struct ofp_hw *hw);
-static bool hw_m1e1_zone_set_apply(struct ofp_hw *hw, struct tm *timeinfo);
+static bool hw_m1e1_zone_set_apply(struct ofp_hw *hw, const enum ofp_order_id *orders, int64_t wall_us);
 
 /* hardware properties */
 static struct ofp_hw hw_m1e1 = {
@@ -66,6 +70,24 @@ struct ofp_hw *hw_m1e1_get_definition(void)
     return &hw_m1e1;
 }
 
+const struct s2p_595 *hw_m1e1_get_chain(void)
+{
+    return &global_s2p_595;
+}
+
+/* before the configuration is loaded : a valid image means the chain is attached */
+bool hw_m1e1_warm_restore(void)
+{
+    if (!s2p_595_setup(&global_s2p_595))
+    {
+        ESP_LOGW(TAG, "Could not setup the 595 pins");
+        return false;
+    }
+    chain_ready = true;
+
+    return s2p_595_restore(&global_s2p_595);
+}
+
 /* init dynamic data and setup hardware (PLEASE READ ofp_hw_hooks in ofp.h) */
 static bool hw_m1e1_zone_set_init(struct ofp_hw *hw)
 {
@@ -108,30 +130,32 @@ static bool hw_m1e1_zone_set_init(struct ofp_hw *hw)
         }
     }
 
-    // initialize hardware
-    s2p_595_setup(&global_s2p_595);
-    ofp_pin_setup_input_no_pull(M1_PIN_CONFIG);
+    // initialize hardware, keeping the restored outputs if any
+    if ((!chain_ready && !s2p_595_setup(&global_s2p_595)) || !ofp_pin_setup_input_no_pull(M1_PIN_CONFIG))
+    {
+        ESP_LOGW(TAG, "Could not setup the pins");
+        return false;
+    }
+    chain_ready = true;
 
     return true;
 }
 
 /* apply dynamic state to hardware */
-static bool hw_m1e1_zone_set_apply(struct ofp_hw *hw, struct tm *timeinfo)
+static bool hw_m1e1_zone_set_apply(struct ofp_hw *hw, const enum ofp_order_id *orders, int64_t wall_us)
 {
-    ESP_LOGD(TAG, "hw_m1e1_zone_set_apply %p", hw);
     assert(hw != NULL);
+    assert(orders != NULL);
 
-    // push zone current state last to first
+    // push zone orders last to first
     s2p_595_reset(&global_s2p_595);
     for (int i = hw->zone_set.count - 1; i >= 0; i--)
     {
-        struct ofp_zone *zone = &hw->zone_set.zones[i];
-
         bool pos, neg;
-        if (!ofp_order_to_half_waves(zone->current, &pos, &neg, timeinfo))
+        if (!ofp_order_to_half_waves(orders[i], &pos, &neg, wall_us))
             continue;
 
-        ESP_LOGV(TAG, "index %i name %s min %i sec %i current %i pos %i neg %i", i, zone->id, timeinfo->tm_min, timeinfo->tm_sec, zone->current, pos, neg);
+        TRACE(TRACE_EVENT_M1E1_ZONE, i, orders[i], pos, neg);
 
         /*
             From highest-numbered board (furthest from M board) to lowest-numbered board (nearest to M board)
@@ -154,6 +178,11 @@ static bool hw_m1e1_zone_set_apply(struct ofp_hw *hw, struct tm *timeinfo)
         s2p_595_shift_edge(&global_s2p_595);
     }
     s2p_595_latch_edge(&global_s2p_595);
+    s2p_595_persist(&global_s2p_595);
+
+    // disabled since setup, unless an image was restored
+    if (!global_s2p_595.output_enabled)
+        s2p_595_enable_output(&global_s2p_595);
 
     return false;
 }
\ No newline at end of file
@@ -2,8 +2,15 @@
 #define HW_M1E1_H
 
 #include "ofp.h"
+#include "s2p_595.h"
 
 /* provides the definition for the hardware */
 struct ofp_hw *hw_m1e1_get_definition(void);
 
+/* pins of the 595 chain, for bus captures */
+const struct s2p_595 *hw_m1e1_get_chain(void);
+
+/* latches the outputs persisted before a warm reset, before storage is available */
+bool hw_m1e1_warm_restore(void);
+
 #endif /* HW_M1E1_H */
\ No newline at end of file
@@ -0,0 +1,183 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cjson.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_log.h>
+
+#include "sdkconfig.h"
+
+#include "json_pool.h"
+
+static const char TAG[] = "json_pool";
+
+// keys and most values fit in small blocks, nodes have their own
+#define JSON_POOL_ALIGN_UP(x) (((x) + 7) & ~((size_t)7))
+#define JSON_POOL_SMALL_BLOCK_SIZE 24
+#define JSON_POOL_NODE_BLOCK_SIZE JSON_POOL_ALIGN_UP(sizeof(cJSON))
+
+struct json_pool_blocks
+{
+    uint8_t *storage;
+    void *free_list;
+    struct json_pool_class_stats stats;
+};
+
+/* statistics */
+static unsigned int allocations = 0;
+static unsigned int fallbacks = 0;
+static unsigned int request_start = 0;
+static unsigned int request_last = 0;
+static unsigned int request_max = 0;
+
+/* mutex variables */
+portMUX_TYPE mutex_json_pool = portMUX_INITIALIZER_UNLOCKED;
+
+#ifdef CONFIG_OFP_JSON_POOL
+
+/* reserved once and for all */
+static uint8_t small_storage[CONFIG_OFP_JSON_POOL_SMALL_COUNT * JSON_POOL_SMALL_BLOCK_SIZE] __attribute__((aligned(8)));
+static uint8_t node_storage[CONFIG_OFP_JSON_POOL_NODE_COUNT * JSON_POOL_NODE_BLOCK_SIZE] __attribute__((aligned(8)));
+
+/* ordered by block size, so that the smallest fitting block is used first */
+static struct json_pool_blocks pool_classes[JSON_POOL_CLASS_ENUM_SIZE] = {
+    {.storage = small_storage, .stats = {.block_size = JSON_POOL_SMALL_BLOCK_SIZE, .block_count = CONFIG_OFP_JSON_POOL_SMALL_COUNT}},
+    {.storage = node_storage, .stats = {.block_size = JSON_POOL_NODE_BLOCK_SIZE, .block_count = CONFIG_OFP_JSON_POOL_NODE_COUNT}},
+};
+
+/***************************************************************************/
+
+static void json_pool_class_init(struct json_pool_blocks *pc)
+{
+    // chain every block into the free list, using the first word of each block
+    pc->free_list = NULL;
+    for (int i = pc->stats.block_count - 1; i >= 0; i--)
+    {
+        void **block = (void **)(pc->storage + i * pc->stats.block_size);
+        *block = pc->free_list;
+        pc->free_list = block;
+    }
+}
+
+static bool json_pool_class_owns(struct json_pool_blocks *pc, void *ptr)
+{
+    uint8_t *p = ptr;
+    return p >= pc->storage && p < pc->storage + pc->stats.block_count * pc->stats.block_size;
+}
+
+static void *json_pool_malloc(size_t size)
+{
+    void *ptr = NULL;
+    bool pooled = false;
+
+    taskENTER_CRITICAL(&mutex_json_pool);
+    allocations++;
+    for (int i = 0; i < JSON_POOL_CLASS_ENUM_SIZE && ptr == NULL; i++)
+    {
+        struct json_pool_blocks *pc = &pool_classes[i];
+        if (size > pc->stats.block_size)
+            continue;
+
+        // larger classes serve exhausted smaller ones
+        pooled = true;
+        if (pc->free_list == NULL)
+            continue;
+
+        ptr = pc->free_list;
+        pc->free_list = *(void **)ptr;
+        pc->stats.used++;
+        if (pc->stats.used > pc->stats.high_water)
+            pc->stats.high_water = pc->stats.used;
+    }
+    if (pooled && ptr == NULL)
+        fallbacks++;
+    taskEXIT_CRITICAL(&mutex_json_pool);
+
+    if (ptr != NULL)
+        return ptr;
+
+    // too large for any pool, or pools exhausted
+    return malloc(size);
+}
+
+static void json_pool_free(void *ptr)
+{
+    if (ptr == NULL)
+        return;
+
+    for (int i = 0; i < JSON_POOL_CLASS_ENUM_SIZE; i++)
+    {
+        struct json_pool_blocks *pc = &pool_classes[i];
+        if (!json_pool_class_owns(pc, ptr))
+            continue;
+
+        taskENTER_CRITICAL(&mutex_json_pool);
+        *(void **)ptr = pc->free_list;
+        pc->free_list = ptr;
+        pc->stats.used--;
+        taskEXIT_CRITICAL(&mutex_json_pool);
+        return;
+    }
+
+    free(ptr);
+}
+
+#endif /* CONFIG_OFP_JSON_POOL */
+
+/***************************************************************************/
+
+void json_pool_init(void)
+{
+#ifdef CONFIG_OFP_JSON_POOL
+    ESP_LOGD(TAG, "json_pool_init small %i x %u node %i x %u", CONFIG_OFP_JSON_POOL_SMALL_COUNT, JSON_POOL_SMALL_BLOCK_SIZE, CONFIG_OFP_JSON_POOL_NODE_COUNT, JSON_POOL_NODE_BLOCK_SIZE);
+
+    for (int i = 0; i < JSON_POOL_CLASS_ENUM_SIZE; i++)
+        json_pool_class_init(&pool_classes[i]);
+
+    cJSON_Hooks hooks = {
+        .malloc_fn = json_pool_malloc,
+        .free_fn = json_pool_free,
+    };
+    cJSON_InitHooks(&hooks);
+#else
+    ESP_LOGD(TAG, "json_pool_init disabled");
+#endif /* CONFIG_OFP_JSON_POOL */
+}
+
+void json_pool_request_begin(void)
+{
+    taskENTER_CRITICAL(&mutex_json_pool);
+    request_start = allocations;
+    taskEXIT_CRITICAL(&mutex_json_pool);
+}
+
+/* returns the number of allocations since begin (including the ones of other tasks) */
+unsigned int json_pool_request_end(void)
+{
+    taskENTER_CRITICAL(&mutex_json_pool);
+    request_last = allocations - request_start;
+    if (request_last > request_max)
+        request_max = request_last;
+    unsigned int result = request_last;
+    taskEXIT_CRITICAL(&mutex_json_pool);
+    return result;
+}
+
+void json_pool_get_stats(struct json_pool_stats *stats)
+{
+    assert(stats != NULL);
+    memset(stats, 0, sizeof(struct json_pool_stats));
+
+    taskENTER_CRITICAL(&mutex_json_pool);
+#ifdef CONFIG_OFP_JSON_POOL
+    for (int i = 0; i < JSON_POOL_CLASS_ENUM_SIZE; i++)
+        stats->classes[i] = pool_classes[i].stats;
+#endif /* CONFIG_OFP_JSON_POOL */
+    stats->allocations = allocations;
+    stats->fallbacks = fallbacks;
+    stats->request_last = request_last;
+    stats->request_max = request_max;
+    taskEXIT_CRITICAL(&mutex_json_pool);
+}
\ No newline at end of file
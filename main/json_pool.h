@@ -0,0 +1,51 @@
+#ifndef JSON_POOL_H
+#define JSON_POOL_H
+
+#include <stddef.h>
+
+/*
+ * Fixed-block pools for cJSON allocations
+ *
+ * cJSON allocates every node, key and value separately : these small
+ * allocations are served from statically reserved blocks, and larger
+ * ones (or any allocation once a pool is exhausted) fall back to the heap.
+ *
+ * As cJSON uses these hooks for its output buffers too, anything returned
+ * by cJSON (like cJSON_Print) MUST BE FREED using cJSON_free()
+ */
+
+enum json_pool_class
+{
+    JSON_POOL_CLASS_SMALL = 0,
+    JSON_POOL_CLASS_NODE,
+    JSON_POOL_CLASS_ENUM_SIZE
+};
+
+struct json_pool_class_stats
+{
+    size_t block_size;
+    int block_count;
+    int used;
+    int high_water;
+};
+
+struct json_pool_stats
+{
+    struct json_pool_class_stats classes[JSON_POOL_CLASS_ENUM_SIZE];
+    unsigned int allocations;
+    unsigned int fallbacks;
+    // allocations made during the last and the busiest requests
+    unsigned int request_last;
+    unsigned int request_max;
+};
+
+/* installs the cJSON hooks, MUST BE CALLED before any cJSON usage */
+void json_pool_init(void);
+
+/* per-request allocation counting */
+void json_pool_request_begin(void);
+unsigned int json_pool_request_end(void);
+
+void json_pool_get_stats(struct json_pool_stats *stats);
+
+#endif /* JSON_POOL_H */
\ No newline at end of file
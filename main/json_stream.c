@@ -0,0 +1,301 @@
+#include <string.h>
+#include <stdlib.h>
+#include <esp_log.h>
+
+#include "utils.h"
+#include "json_stream.h"
+
+static const char TAG[] = "json_stream";
+
+/***************************************************************************/
+
+static bool json_stream_fail(struct json_stream *js, const char *reason)
+{
+    ESP_LOGD(TAG, "Invalid JSON at depth %i: %s", js->depth, reason);
+    js->failed = true;
+    return false;
+}
+
+static bool json_stream_append(struct json_stream *js, char c)
+{
+    // keep room for the NULL terminator
+    if (js->len >= JSON_STREAM_MAX_TOKEN_LEN - 1)
+        return json_stream_fail(js, "token too long");
+
+    js->buf[js->len++] = c;
+    return true;
+}
+
+static bool json_stream_emit(struct json_stream *js, enum json_stream_token token, const char *value)
+{
+    ESP_LOGV(TAG, "depth %i token %i value %s", js->depth, token, value ? value : "");
+    if (!js->callback(js->ctx, js->depth, token, value))
+    {
+        js->failed = true;
+        return false;
+    }
+    return true;
+}
+
+static void json_stream_after_value(struct json_stream *js)
+{
+    js->expect = (js->depth == 0) ? JSON_STREAM_EXPECT_NOTHING : JSON_STREAM_EXPECT_COMMA_OR_END;
+}
+
+/* strings are keys or values depending on the context, other scalars are values */
+static bool json_stream_scalar(struct json_stream *js, enum json_stream_token token, const char *value)
+{
+    if (token == JSON_STREAM_TOKEN_STRING && (js->expect == JSON_STREAM_EXPECT_KEY || js->expect == JSON_STREAM_EXPECT_KEY_OR_END))
+    {
+        js->expect = JSON_STREAM_EXPECT_COLON;
+        return json_stream_emit(js, JSON_STREAM_TOKEN_KEY, value);
+    }
+
+    if (js->expect != JSON_STREAM_EXPECT_VALUE && js->expect != JSON_STREAM_EXPECT_VALUE_OR_END)
+        return json_stream_fail(js, "unexpected value");
+
+    json_stream_after_value(js);
+    return json_stream_emit(js, token, value);
+}
+
+static bool json_stream_begin(struct json_stream *js, bool is_object)
+{
+    if (js->expect != JSON_STREAM_EXPECT_VALUE && js->expect != JSON_STREAM_EXPECT_VALUE_OR_END)
+        return json_stream_fail(js, "unexpected container");
+
+    if (js->depth >= JSON_STREAM_MAX_DEPTH)
+        return json_stream_fail(js, "too deep");
+
+    js->is_object[js->depth++] = is_object;
+    js->expect = is_object ? JSON_STREAM_EXPECT_KEY_OR_END : JSON_STREAM_EXPECT_VALUE_OR_END;
+    return json_stream_emit(js, is_object ? JSON_STREAM_TOKEN_OBJECT_BEGIN : JSON_STREAM_TOKEN_ARRAY_BEGIN, NULL);
+}
+
+static bool json_stream_end(struct json_stream *js, bool is_object)
+{
+    if (js->depth == 0 || js->is_object[js->depth - 1] != is_object)
+        return json_stream_fail(js, "unbalanced container");
+
+    enum json_stream_expect empty = is_object ? JSON_STREAM_EXPECT_KEY_OR_END : JSON_STREAM_EXPECT_VALUE_OR_END;
+    if (js->expect != empty && js->expect != JSON_STREAM_EXPECT_COMMA_OR_END)
+        return json_stream_fail(js, "unexpected end");
+
+    if (!json_stream_emit(js, is_object ? JSON_STREAM_TOKEN_OBJECT_END : JSON_STREAM_TOKEN_ARRAY_END, NULL))
+        return false;
+
+    js->depth--;
+    json_stream_after_value(js);
+    return true;
+}
+
+/* encodes a \uXXXX escape as UTF-8, surrogate pairs are not supported */
+static bool json_stream_append_unicode(struct json_stream *js, int cp)
+{
+    if (cp == 0 || (cp >= 0xD800 && cp <= 0xDFFF))
+        return json_stream_fail(js, "unsupported unicode escape");
+
+    if (cp < 0x80)
+        return json_stream_append(js, cp);
+
+    if (cp < 0x800)
+        return json_stream_append(js, 0xC0 | (cp >> 6)) && json_stream_append(js, 0x80 | (cp & 0x3F));
+
+    return json_stream_append(js, 0xE0 | (cp >> 12)) && json_stream_append(js, 0x80 | ((cp >> 6) & 0x3F)) && json_stream_append(js, 0x80 | (cp & 0x3F));
+}
+
+static bool json_stream_end_number(struct json_stream *js)
+{
+    js->buf[js->len] = '\0';
+    js->lexer = JSON_STREAM_LEXER_IDLE;
+
+    char *end = NULL;
+    strtod(js->buf, &end);
+    if (end == js->buf || *end != '\0')
+        return json_stream_fail(js, "invalid number");
+
+    return json_stream_scalar(js, JSON_STREAM_TOKEN_NUMBER, js->buf);
+}
+
+static bool json_stream_end_literal(struct json_stream *js)
+{
+    js->buf[js->len] = '\0';
+    js->lexer = JSON_STREAM_LEXER_IDLE;
+
+    if (strcmp(js->buf, "true") == 0)
+        return json_stream_scalar(js, JSON_STREAM_TOKEN_TRUE, NULL);
+    if (strcmp(js->buf, "false") == 0)
+        return json_stream_scalar(js, JSON_STREAM_TOKEN_FALSE, NULL);
+    if (strcmp(js->buf, "null") == 0)
+        return json_stream_scalar(js, JSON_STREAM_TOKEN_NULL, NULL);
+
+    return json_stream_fail(js, "invalid literal");
+}
+
+static bool json_stream_process(struct json_stream *js, char c)
+{
+    int tmp;
+
+    switch (js->lexer)
+    {
+    case JSON_STREAM_LEXER_STRING:
+        if (c == '"')
+        {
+            js->buf[js->len] = '\0';
+            js->lexer = JSON_STREAM_LEXER_IDLE;
+            return json_stream_scalar(js, JSON_STREAM_TOKEN_STRING, js->buf);
+        }
+        if (c == '\\')
+        {
+            js->lexer = JSON_STREAM_LEXER_STRING_ESCAPE;
+            return true;
+        }
+        if ((unsigned char)c < 0x20)
+            return json_stream_fail(js, "control character in string");
+        return json_stream_append(js, c);
+
+    case JSON_STREAM_LEXER_STRING_ESCAPE:
+        js->lexer = JSON_STREAM_LEXER_STRING;
+        switch (c)
+        {
+        case '"':
+        case '\\':
+        case '/':
+            return json_stream_append(js, c);
+        case 'b':
+            return json_stream_append(js, '\b');
+        case 'f':
+            return json_stream_append(js, '\f');
+        case 'n':
+            return json_stream_append(js, '\n');
+        case 'r':
+            return json_stream_append(js, '\r');
+        case 't':
+            return json_stream_append(js, '\t');
+        case 'u':
+            js->lexer = JSON_STREAM_LEXER_STRING_UNICODE;
+            js->unicode_digits = 0;
+            js->unicode_value = 0;
+            return true;
+        default:
+            return json_stream_fail(js, "invalid escape");
+        }
+
+    case JSON_STREAM_LEXER_STRING_UNICODE:
+        tmp = hex_char_to_val(c);
+        if (tmp == -1)
+            return json_stream_fail(js, "invalid unicode escape");
+        js->unicode_value = (js->unicode_value << 4) | tmp;
+        if (++js->unicode_digits < 4)
+            return true;
+        js->lexer = JSON_STREAM_LEXER_STRING;
+        return json_stream_append_unicode(js, js->unicode_value);
+
+    case JSON_STREAM_LEXER_NUMBER:
+        if ((c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E')
+            return json_stream_append(js, c);
+        // current character terminates the number and is processed below
+        if (!json_stream_end_number(js))
+            return false;
+        break;
+
+    case JSON_STREAM_LEXER_LITERAL:
+        if (c >= 'a' && c <= 'z')
+            return json_stream_append(js, c);
+        // current character terminates the literal and is processed below
+        if (!json_stream_end_literal(js))
+            return false;
+        break;
+
+    case JSON_STREAM_LEXER_IDLE:
+        break;
+    }
+
+    switch (c)
+    {
+    case ' ':
+    case '\t':
+    case '\r':
+    case '\n':
+        return true;
+    case '{':
+        return json_stream_begin(js, true);
+    case '}':
+        return json_stream_end(js, true);
+    case '[':
+        return json_stream_begin(js, false);
+    case ']':
+        return json_stream_end(js, false);
+    case ',':
+        if (js->expect != JSON_STREAM_EXPECT_COMMA_OR_END)
+            return json_stream_fail(js, "unexpected comma");
+        js->expect = js->is_object[js->depth - 1] ? JSON_STREAM_EXPECT_KEY : JSON_STREAM_EXPECT_VALUE;
+        return true;
+    case ':':
+        if (js->expect != JSON_STREAM_EXPECT_COLON)
+            return json_stream_fail(js, "unexpected colon");
+        js->expect = JSON_STREAM_EXPECT_VALUE;
+        return true;
+    case '"':
+        js->lexer = JSON_STREAM_LEXER_STRING;
+        js->len = 0;
+        return true;
+    default:
+        break;
+    }
+
+    js->len = 0;
+    if ((c >= '0' && c <= '9') || c == '-')
+    {
+        js->lexer = JSON_STREAM_LEXER_NUMBER;
+        return json_stream_append(js, c);
+    }
+    if (c >= 'a' && c <= 'z')
+    {
+        js->lexer = JSON_STREAM_LEXER_LITERAL;
+        return json_stream_append(js, c);
+    }
+
+    return json_stream_fail(js, "unexpected character");
+}
+
+/***************************************************************************/
+
+void json_stream_init(struct json_stream *js, json_stream_callback callback, void *ctx)
+{
+    assert(js != NULL);
+    assert(callback != NULL);
+
+    memset(js, 0, sizeof(struct json_stream));
+    js->callback = callback;
+    js->ctx = ctx;
+    js->lexer = JSON_STREAM_LEXER_IDLE;
+    js->expect = JSON_STREAM_EXPECT_VALUE;
+}
+
+bool json_stream_feed(struct json_stream *js, const char *data, size_t len)
+{
+    assert(js != NULL);
+    assert(data != NULL || len == 0);
+
+    for (size_t i = 0; i < len && !js->failed; i++)
+        json_stream_process(js, data[i]);
+
+    return !js->failed;
+}
+
+bool json_stream_finish(struct json_stream *js)
+{
+    assert(js != NULL);
+
+    // a root scalar has no terminating character
+    if (!js->failed && (js->lexer == JSON_STREAM_LEXER_NUMBER || js->lexer == JSON_STREAM_LEXER_LITERAL))
+        json_stream_process(js, ' ');
+
+    if (js->failed)
+        return false;
+
+    if (js->lexer != JSON_STREAM_LEXER_IDLE || js->expect != JSON_STREAM_EXPECT_NOTHING)
+        return json_stream_fail(js, "truncated document");
+
+    return true;
+}
\ No newline at end of file
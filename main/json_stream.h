@@ -0,0 +1,92 @@
+#ifndef JSON_STREAM_H
+#define JSON_STREAM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Incremental JSON tokenizer
+ *
+ * Data is fed in chunks of any size (as received from the network) and
+ * tokens are reported through a callback as soon as they are complete,
+ * so that a document never has to be held in memory as a whole.
+ *
+ * Only scalar tokens (keys, strings, numbers) need buffering, which
+ * limits their length to JSON_STREAM_MAX_TOKEN_LEN - 1 bytes.
+ */
+
+#define JSON_STREAM_MAX_TOKEN_LEN 64
+#define JSON_STREAM_MAX_DEPTH 8
+
+enum json_stream_token
+{
+    JSON_STREAM_TOKEN_OBJECT_BEGIN = 0,
+    JSON_STREAM_TOKEN_OBJECT_END,
+    JSON_STREAM_TOKEN_ARRAY_BEGIN,
+    JSON_STREAM_TOKEN_ARRAY_END,
+    JSON_STREAM_TOKEN_KEY,
+    JSON_STREAM_TOKEN_STRING,
+    JSON_STREAM_TOKEN_NUMBER,
+    JSON_STREAM_TOKEN_TRUE,
+    JSON_STREAM_TOKEN_FALSE,
+    JSON_STREAM_TOKEN_NULL,
+};
+
+/*
+ * Called for every token
+ *
+ * - depth is the nesting level of the token (the root value is at depth 0,
+ *   members of the root container at depth 1...), begin/end tokens report
+ *   the depth of the members of the container they open/close
+ * - value is only set for keys, strings and numbers, and is only valid
+ *   during the call
+ *
+ * Returning false aborts parsing
+ */
+typedef bool (*json_stream_callback)(void *ctx, int depth, enum json_stream_token token, const char *value);
+
+enum json_stream_lexer_state
+{
+    JSON_STREAM_LEXER_IDLE = 0,
+    JSON_STREAM_LEXER_STRING,
+    JSON_STREAM_LEXER_STRING_ESCAPE,
+    JSON_STREAM_LEXER_STRING_UNICODE,
+    JSON_STREAM_LEXER_NUMBER,
+    JSON_STREAM_LEXER_LITERAL,
+};
+
+enum json_stream_expect
+{
+    JSON_STREAM_EXPECT_VALUE = 0,
+    JSON_STREAM_EXPECT_VALUE_OR_END,
+    JSON_STREAM_EXPECT_KEY,
+    JSON_STREAM_EXPECT_KEY_OR_END,
+    JSON_STREAM_EXPECT_COLON,
+    JSON_STREAM_EXPECT_COMMA_OR_END,
+    JSON_STREAM_EXPECT_NOTHING,
+};
+
+struct json_stream
+{
+    json_stream_callback callback;
+    void *ctx;
+    bool failed;
+    enum json_stream_lexer_state lexer;
+    enum json_stream_expect expect;
+    int depth;
+    bool is_object[JSON_STREAM_MAX_DEPTH];
+    int unicode_digits;
+    int unicode_value;
+    int len;
+    char buf[JSON_STREAM_MAX_TOKEN_LEN];
+};
+
+void json_stream_init(struct json_stream *js, json_stream_callback callback, void *ctx);
+
+/* returns false as soon as the document is invalid or the callback aborted */
+bool json_stream_feed(struct json_stream *js, const char *data, size_t len);
+
+/* returns true if a complete document was parsed */
+bool json_stream_finish(struct json_stream *js);
+
+#endif /* JSON_STREAM_H */
\ No newline at end of file
@@ -0,0 +1,275 @@
+#include <stdlib.h>
+#include <string.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "sdkconfig.h"
+
+#ifdef CONFIG_OFP_LINKY
+#include <driver/uart.h>
+#endif /* CONFIG_OFP_LINKY */
+
+#include "ofp.h"
+#include "tic.h"
+#include "linky.h"
+#include "top.h"
+
+static const char TAG[] = "linky";
+
+/* statistics */
+static struct linky_stats stats = {.load_percent = -1};
+
+/* mutex variables */
+portMUX_TYPE mutex_linky_stats = portMUX_INITIALIZER_UNLOCKED;
+
+#ifdef CONFIG_OFP_LINKY
+
+#define LINKY_UART_BUFFER_SIZE 256
+#define LINKY_READ_BUFFER_SIZE 64
+#define LINKY_TASK_STACK_SIZE 3072
+
+#ifdef CONFIG_OFP_LINKY_MODE_STANDARD
+#define LINKY_BAUD_RATE 9600
+#else
+#define LINKY_BAUD_RATE 1200
+#endif /* CONFIG_OFP_LINKY_MODE_STANDARD */
+
+// historic mode loads are in amperes, heater powers in watts
+#define LINKY_NOMINAL_VOLTAGE 230
+
+/* values gathered from the groups of the current frame */
+struct linky_frame
+{
+    enum tic_mode mode;
+    // historic : amperes, standard : VA
+    int subscribed;
+    int load;
+    // historic only, sent while the subscribed intensity is exceeded
+    bool overload;
+};
+
+/* only used by the linky task */
+static struct linky_frame frame;
+static struct ofp_zone *shed_order[OFP_MAX_ZONE_COUNT];
+static int shed_order_count = 0;
+static int shed_count = 0;
+static int frames_below = 0;
+static linky_change_callback change_callback = NULL;
+
+/***************************************************************************/
+
+static void linky_on_group(void *ctx, const struct tic_group *group)
+{
+    frame.mode = group->mode;
+    int value = atoi(group->value);
+
+    if (group->mode == TIC_MODE_HISTORIC)
+    {
+        if (strcmp(group->label, "ISOUSC") == 0)
+            frame.subscribed = value;
+        // single phase IINST, or three-phase IINST1 to IINST3
+        else if (strncmp(group->label, "IINST", 5) == 0 && value > frame.load)
+            frame.load = value;
+        else if (strcmp(group->label, "ADPS") == 0)
+            frame.overload = true;
+    }
+    else
+    {
+        // reference power is in kVA
+        if (strcmp(group->label, "PREF") == 0)
+            frame.subscribed = value * 1000;
+        else if (strcmp(group->label, "SINSTS") == 0)
+            frame.load = value;
+    }
+}
+
+/*
+ * Zones to shed at once so that their heater power covers the excess over
+ * the shedding threshold : at least one, and zones of unknown power end the
+ * pass as what they remove cannot be known
+ */
+static int linky_zones_to_shed(void)
+{
+    int excess = frame.load - frame.subscribed * CONFIG_OFP_LINKY_SHED_PERCENT / 100;
+    if (frame.mode == TIC_MODE_HISTORIC)
+        excess *= LINKY_NOMINAL_VOLTAGE;
+
+    int count = 0;
+    uint32_t covered = 0;
+    while (shed_count + count < shed_order_count)
+    {
+        uint32_t power = shed_order[shed_count + count]->power;
+        count++;
+        covered += power;
+        if (power == 0 || (int)covered > excess)
+            break;
+    }
+    return count;
+}
+
+static void linky_apply_shedding(void)
+{
+    // the control loop sees every zone change at once
+    ofp_lock();
+    for (int i = 0; i < shed_order_count; i++)
+        ofp_zone_set_shed(shed_order[i], i < shed_count);
+    ofp_unlock();
+
+    if (change_callback != NULL)
+        change_callback();
+}
+
+static void linky_on_frame(void *ctx, bool valid)
+{
+    int percent = -1;
+    if (frame.subscribed > 0)
+        percent = frame.load * 100 / frame.subscribed;
+    if (frame.overload && percent < CONFIG_OFP_LINKY_SHED_PERCENT)
+        percent = CONFIG_OFP_LINKY_SHED_PERCENT;
+
+    // frames with errors may lack values, they are only used to shed
+    bool changed = false;
+    if (percent >= CONFIG_OFP_LINKY_SHED_PERCENT)
+    {
+        frames_below = 0;
+        if (shed_count < shed_order_count)
+        {
+            shed_count += linky_zones_to_shed();
+            changed = true;
+        }
+    }
+    else if (valid && percent >= 0 && percent < CONFIG_OFP_LINKY_RESTORE_PERCENT)
+    {
+        if (shed_count > 0 && ++frames_below >= CONFIG_OFP_LINKY_RESTORE_FRAMES)
+        {
+            frames_below = 0;
+            shed_count--;
+            changed = true;
+        }
+    }
+    else
+    {
+        frames_below = 0;
+    }
+
+    ESP_LOGV(TAG, "frame valid %i mode %i load %i/%i (%i%%) shed %i", valid, frame.mode, frame.load, frame.subscribed, percent, shed_count);
+
+    taskENTER_CRITICAL(&mutex_linky_stats);
+    stats.mode = frame.mode;
+    stats.load_percent = percent;
+    stats.shed_zones = shed_count;
+    if (changed)
+        stats.shed_events++;
+    taskEXIT_CRITICAL(&mutex_linky_stats);
+
+    if (changed)
+    {
+        ESP_LOGI(TAG, "Load at %i%%, shedding %i zones", percent, shed_count);
+        linky_apply_shedding();
+    }
+
+    memset(&frame, 0, sizeof(frame));
+}
+
+/***************************************************************************/
+
+/* zones listed in OFP_LINKY_SHED_ZONES, or every zone from the last one */
+static void linky_build_shed_order(void)
+{
+    struct ofp_hw *hw = ofp_hw_get_current();
+    if (hw == NULL)
+        return;
+
+    char ids[] = CONFIG_OFP_LINKY_SHED_ZONES;
+    if (strlen(ids) == 0)
+    {
+        for (int i = hw->zone_set.count - 1; i >= 0; i--)
+            shed_order[shed_order_count++] = &hw->zone_set.zones[i];
+        return;
+    }
+
+    char *saveptr = NULL;
+    for (char *id = strtok_r(ids, ",", &saveptr); id != NULL; id = strtok_r(NULL, ",", &saveptr))
+    {
+        struct ofp_zone *zone = NULL;
+        for (int i = 0; i < hw->zone_set.count && zone == NULL; i++)
+            if (strcmp(hw->zone_set.zones[i].id, id) == 0)
+                zone = &hw->zone_set.zones[i];
+
+        if (zone == NULL || shed_order_count >= OFP_MAX_ZONE_COUNT)
+        {
+            ESP_LOGW(TAG, "Ignoring zone %s for load shedding", id);
+            continue;
+        }
+        shed_order[shed_order_count++] = zone;
+    }
+}
+
+static void linky_task(void *pvParameters)
+{
+    struct tic_parser parser;
+    tic_init(&parser, linky_on_group, linky_on_frame, NULL);
+
+    uint8_t buf[LINKY_READ_BUFFER_SIZE];
+    while (true)
+    {
+        int len = uart_read_bytes(CONFIG_OFP_LINKY_UART_NUM, buf, sizeof(buf), pdMS_TO_TICKS(100));
+        if (len <= 0)
+            continue;
+
+        // parsed directly from the read buffer
+        int64_t start = esp_timer_get_time();
+        tic_feed(&parser, buf, len);
+        int64_t elapsed = esp_timer_get_time() - start;
+
+        taskENTER_CRITICAL(&mutex_linky_stats);
+        stats.parser = parser.stats;
+        stats.bytes += len;
+        stats.parse_us += elapsed;
+        taskEXIT_CRITICAL(&mutex_linky_stats);
+    }
+}
+
+#endif /* CONFIG_OFP_LINKY */
+
+/***************************************************************************/
+
+void linky_start(linky_change_callback on_change)
+{
+#ifdef CONFIG_OFP_LINKY
+    ESP_LOGI(TAG, "Starting teleinfo on UART %i pin %i at %i bauds", CONFIG_OFP_LINKY_UART_NUM, CONFIG_OFP_LINKY_RX_PIN, LINKY_BAUD_RATE);
+
+    change_callback = on_change;
+    linky_build_shed_order();
+    ESP_LOGD(TAG, "%i zones available for load shedding", shed_order_count);
+
+    // 7 bits, even parity, 1 stop bit
+    const uart_config_t uart_config = {
+        .baud_rate = LINKY_BAUD_RATE,
+        .data_bits = UART_DATA_7_BITS,
+        .parity = UART_PARITY_EVEN,
+        .stop_bits = UART_STOP_BITS_1,
+        .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
+        .source_clk = UART_SCLK_APB,
+    };
+    ESP_ERROR_CHECK(uart_driver_install(CONFIG_OFP_LINKY_UART_NUM, LINKY_UART_BUFFER_SIZE, 0, 0, NULL, 0));
+    ESP_ERROR_CHECK(uart_param_config(CONFIG_OFP_LINKY_UART_NUM, &uart_config));
+    ESP_ERROR_CHECK(uart_set_pin(CONFIG_OFP_LINKY_UART_NUM, UART_PIN_NO_CHANGE, CONFIG_OFP_LINKY_RX_PIN, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE));
+
+    TaskHandle_t xHandle = NULL;
+    top_register_stack("linky", LINKY_TASK_STACK_SIZE);
+    xTaskCreatePinnedToCore(linky_task, "linky", LINKY_TASK_STACK_SIZE, NULL, 5, &xHandle, 1);
+    configASSERT(xHandle);
+#endif /* CONFIG_OFP_LINKY */
+}
+
+void linky_get_stats(struct linky_stats *out)
+{
+    assert(out != NULL);
+
+    taskENTER_CRITICAL(&mutex_linky_stats);
+    *out = stats;
+    taskEXIT_CRITICAL(&mutex_linky_stats);
+}
\ No newline at end of file
@@ -0,0 +1,41 @@
+#ifndef LINKY_H
+#define LINKY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "tic.h"
+
+/*
+ * Linky tele-information ingestion and load shedding
+ *
+ * At the end of each frame, the load is compared to the subscribed power :
+ * one more zone is forced to offload (in OFP_LINKY_SHED_ZONES order) for each
+ * frame above OFP_LINKY_SHED_PERCENT, and one zone is restored after each
+ * OFP_LINKY_RESTORE_FRAMES consecutive frames below OFP_LINKY_RESTORE_PERCENT.
+ *
+ * Every function does nothing if OFP_LINKY is disabled
+ */
+
+/* called from the linky task whenever shed zones change */
+typedef void (*linky_change_callback)(void);
+
+/* zones MUST have been initialized */
+void linky_start(linky_change_callback on_change);
+
+struct linky_stats
+{
+    enum tic_mode mode;
+    // percentage of the subscribed power, -1 if unknown
+    int load_percent;
+    int shed_zones;
+    unsigned int shed_events;
+    struct tic_stats parser;
+    // time spent parsing, to compute the frames per second capacity
+    uint64_t bytes;
+    uint64_t parse_us;
+};
+
+void linky_get_stats(struct linky_stats *stats);
+
+#endif /* LINKY_H */
\ No newline at end of file
@@ -0,0 +1,55 @@
+#include <assert.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "loop_stats.h"
+
+/* statistics */
+static struct loop_stats stats = {0};
+
+/* mutex variables */
+portMUX_TYPE mutex_loop_stats = portMUX_INITIALIZER_UNLOCKED;
+
+/***************************************************************************/
+
+void loop_stats_set_period(uint32_t period_ms)
+{
+    taskENTER_CRITICAL(&mutex_loop_stats);
+    stats.period_ms = period_ms;
+    taskEXIT_CRITICAL(&mutex_loop_stats);
+}
+
+void loop_stats_record_iteration(uint32_t compute_us, uint32_t apply_us, bool scheduled)
+{
+    taskENTER_CRITICAL(&mutex_loop_stats);
+    histogram_add(&stats.compute, compute_us);
+    histogram_add(&stats.apply, apply_us);
+    if (scheduled)
+        stats.iterations++;
+    else
+        stats.early_iterations++;
+    taskEXIT_CRITICAL(&mutex_loop_stats);
+}
+
+void loop_stats_record_lateness(uint32_t lateness_us)
+{
+    taskENTER_CRITICAL(&mutex_loop_stats);
+    histogram_add(&stats.lateness, lateness_us);
+    taskEXIT_CRITICAL(&mutex_loop_stats);
+}
+
+void loop_stats_record_missed(uint32_t count)
+{
+    taskENTER_CRITICAL(&mutex_loop_stats);
+    stats.missed_deadlines += count;
+    taskEXIT_CRITICAL(&mutex_loop_stats);
+}
+
+void loop_stats_get(struct loop_stats *out)
+{
+    assert(out != NULL);
+
+    taskENTER_CRITICAL(&mutex_loop_stats);
+    *out = stats;
+    taskEXIT_CRITICAL(&mutex_loop_stats);
+}
\ No newline at end of file
@@ -0,0 +1,40 @@
+#ifndef LOOP_STATS_H
+#define LOOP_STATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "histogram.h"
+
+/*
+ * Control loop timing
+ *
+ * Durations are in microseconds :
+ * - compute : ofp_zone_update_current_orders
+ * - apply : handing the orders to the output task
+ * - lateness : between the scheduled and the actual wake up time
+ *
+ * Iterations run on a fixed schedule, an iteration ending after the next
+ * scheduled time makes it (and maybe more) missed.
+ */
+
+struct loop_stats
+{
+    uint32_t period_ms;
+    uint32_t iterations;
+    // applied out of schedule, when woken up by load shedding
+    uint32_t early_iterations;
+    uint32_t missed_deadlines;
+    struct histogram compute;
+    struct histogram apply;
+    struct histogram lateness;
+};
+
+void loop_stats_set_period(uint32_t period_ms);
+void loop_stats_record_iteration(uint32_t compute_us, uint32_t apply_us, bool scheduled);
+void loop_stats_record_lateness(uint32_t lateness_us);
+void loop_stats_record_missed(uint32_t count);
+
+void loop_stats_get(struct loop_stats *stats);
+
+#endif /* LOOP_STATS_H */
\ No newline at end of file
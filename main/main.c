@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <esp_log.h>
+#include <esp_timer.h>
 #include <esp_netif.h>
 
 /* wifi manager */
@@ -18,16 +19,30 @@
 #include "storage.h"
 #include "console.h"
 #include "fwupd.h"
+#include "json_pool.h"
+#include "boot.h"
+#include "mqtt_bridge.h"
+#include "linky.h"
+#include "history.h"
+#include "usage.h"
+#include "loop_stats.h"
+#include "pulse_timer.h"
+#include "output.h"
+#include "trace.h"
 
 // hardware
 #include "hw_esp32.h"
 #include "hw_m1e1.h"
+#include "hw_gpio.h"
 
 static const char TAG[] = "main";
 
 /* defines */
 #define MAIN_LOOP_WAIT_MILLISECONDS (1000)
 
+/* main loop, woken up early when orders need to be applied at once */
+static TaskHandle_t main_task = NULL;
+
 /***************************************************************************/
 
 static void display_ip(ip_event_got_ip_t *param, char *msg)
@@ -50,6 +65,7 @@ static void wifi_manager_connected_callback(void *pvParameter)
     uptime_track_wifi_success();
     mdns_start();
     webserver_start();
+    mqtt_bridge_start();
     sntp_task_start();
     ESP_LOGV(TAG, "Connection processing finished.");
 }
@@ -59,7 +75,7 @@ static void wifi_manager_disconnected_callback(void *pvParameter)
     ESP_LOGI(TAG, "STA Disconnected");
     uptime_track_wifi_disconnect();
     mdns_stop();
-    webserver_stop();
+    // webserver is kept, and serves again as soon as the link is back
     sntp_task_stop();
     ESP_LOGV(TAG, "Disconnection processing finished.");
 }
@@ -70,39 +86,80 @@ static void register_hardware(void)
 {
     ofp_hw_register(hw_esp32_get_definition());
     ofp_hw_register(hw_m1e1_get_definition());
+    ofp_hw_register(hw_gpio_get_definition());
 }
 
 /***************************************************************************/
 
-void app_main()
+static void apply_current_orders(struct ofp_hw *current_hw, bool scheduled)
 {
-    // use default partition for NVS content
-    kv_init(NULL);
+    // current time
+    time_t now;
+    struct tm ti;
+    time(&now);
+    time_to_localtime(&now, &ti);
 
-    // initialize accounts
-    ofp_account_list_init();
+    // track time
+    char buf[LOCALTIME_TO_STRING_BUFFER_LENGTH];
+    localtime_to_string(&ti, buf, sizeof(buf));
+    ESP_LOGV(TAG, "current time: %s", buf);
 
-    // compensate uptime according to clock leap from SNTP
-    uptime_sync_start();
+    // compute orders
+    TRACE_BEGIN(TRACE_SPAN_LOOP_ITERATION);
+    int64_t start_us = esp_timer_get_time();
+    ofp_zone_update_current_orders(current_hw, &ti);
+    // hand them to the output task, which latches them
+    int64_t computed_us = esp_timer_get_time();
+    TRACE_BEGIN(TRACE_SPAN_OUTPUT_SUBMIT);
+    output_submit(current_hw);
+    TRACE_END(TRACE_SPAN_OUTPUT_SUBMIT);
+    int64_t applied_us = esp_timer_get_time();
+
+    loop_stats_record_iteration(computed_us - start_us, applied_us - computed_us, scheduled);
+
+    // record transitions, never blocks
+    history_track_zones(current_hw);
+
+    // publish changes, never blocks
+    mqtt_bridge_notify(current_hw);
+    TRACE_END(TRACE_SPAN_LOOP_ITERATION);
+}
+
+/***************************************************************************/
+
+/* boot stages */
 
-    // initialize plannings
-    ofp_override_load();
+static void boot_restore(void)
+{
+    // only the M1E1 chain persists its outputs
+    hw_m1e1_warm_restore();
+}
 
-    // initialize plannings
-    ofp_planning_list_init();
+static void boot_storage(void)
+{
+    // use default partition for NVS content
+    kv_init(NULL);
+}
 
+static void boot_hardware(void)
+{
     // register every hardware available at compilation time
     register_hardware();
 
     // initialize global hardware reference if successful
     ofp_hw_initialize();
+}
 
-    // initialize terminal
-    console_init();
-
-    // confirm OTA update if pending
-    fwupd_confirm();
+static void boot_first_apply(void)
+{
+    // so that outputs are correct as soon as possible
+    struct ofp_hw *current_hw = ofp_hw_get_current();
+    if (current_hw != NULL)
+        apply_current_orders(current_hw, false);
+}
 
+static void boot_network(void)
+{
 #ifndef OFP_DISABLE_NETWORKING
     /* start the wifi manager */
     wifi_manager_start();
@@ -112,31 +169,126 @@ void app_main()
     wifi_manager_set_callback(WM_EVENT_STA_GOT_IP, &wifi_manager_connected_callback);
     wifi_manager_set_callback(WM_EVENT_STA_DISCONNECTED, &wifi_manager_disconnected_callback);
 #endif /* OFP_NO_NETWORKING */
+}
+
+static void wake_main_loop(void)
+{
+    if (main_task != NULL)
+        xTaskNotifyGive(main_task);
+}
+
+static void boot_linky(void)
+{
+    linky_start(wake_main_loop);
+}
+
+static void boot_pulse(void)
+{
+    pulse_timer_start(output_request_latch);
+    // the output task arms the timer on its next latch
+    output_request_latch();
+}
+
+enum main_boot_stage
+{
+    MAIN_BOOT_RESTORE = 0,
+    MAIN_BOOT_JSON_POOL,
+    MAIN_BOOT_STORAGE,
+    MAIN_BOOT_OVERRIDE,
+    MAIN_BOOT_PLANNINGS,
+    MAIN_BOOT_HARDWARE,
+    MAIN_BOOT_USAGE,
+    MAIN_BOOT_OUTPUT,
+    MAIN_BOOT_FIRST_APPLY,
+    MAIN_BOOT_UPTIME,
+    MAIN_BOOT_ACCOUNTS,
+    MAIN_BOOT_CERTIFICATES,
+    MAIN_BOOT_CONSOLE,
+    MAIN_BOOT_FIRMWARE,
+    MAIN_BOOT_NETWORK,
+    MAIN_BOOT_LINKY,
+    MAIN_BOOT_HISTORY,
+    MAIN_BOOT_PULSE,
+    MAIN_BOOT_ENUM_SIZE
+};
+
+/* outputs first, then everything else on the other core */
+static const struct boot_stage boot_stages[MAIN_BOOT_ENUM_SIZE] = {
+    // on warm reset, latch last known outputs until the first orders are computed
+    [MAIN_BOOT_RESTORE] = {.name = "restore", .run = boot_restore, .runner = BOOT_RUNNER_MAIN, .depends = 0},
+    // cJSON allocation hooks, before anything uses cJSON
+    [MAIN_BOOT_JSON_POOL] = {.name = "json_pool", .run = json_pool_init, .runner = BOOT_RUNNER_MAIN, .depends = 0},
+    [MAIN_BOOT_STORAGE] = {.name = "storage", .run = boot_storage, .runner = BOOT_RUNNER_MAIN, .depends = BOOT_DEPENDS(MAIN_BOOT_RESTORE) | BOOT_DEPENDS(MAIN_BOOT_JSON_POOL)},
+    [MAIN_BOOT_OVERRIDE] = {.name = "override", .run = ofp_override_load, .runner = BOOT_RUNNER_MAIN, .depends = BOOT_DEPENDS(MAIN_BOOT_STORAGE)},
+    [MAIN_BOOT_PLANNINGS] = {.name = "plannings", .run = ofp_planning_list_init, .runner = BOOT_RUNNER_MAIN, .depends = BOOT_DEPENDS(MAIN_BOOT_STORAGE)},
+    [MAIN_BOOT_HARDWARE] = {.name = "hardware", .run = boot_hardware, .runner = BOOT_RUNNER_MAIN, .depends = BOOT_DEPENDS(MAIN_BOOT_STORAGE)},
+    // accumulators are updated from the first apply on
+    [MAIN_BOOT_USAGE] = {.name = "usage", .run = usage_init, .runner = BOOT_RUNNER_MAIN, .depends = BOOT_DEPENDS(MAIN_BOOT_HARDWARE)},
+    [MAIN_BOOT_OUTPUT] = {.name = "output", .run = output_start, .runner = BOOT_RUNNER_MAIN, .depends = BOOT_DEPENDS(MAIN_BOOT_HARDWARE)},
+    [MAIN_BOOT_FIRST_APPLY] = {.name = "first_apply", .run = boot_first_apply, .runner = BOOT_RUNNER_MAIN, .depends = BOOT_DEPENDS(MAIN_BOOT_OVERRIDE) | BOOT_DEPENDS(MAIN_BOOT_PLANNINGS) | BOOT_DEPENDS(MAIN_BOOT_USAGE) | BOOT_DEPENDS(MAIN_BOOT_OUTPUT)},
+    // compensate uptime according to clock leap from SNTP
+    [MAIN_BOOT_UPTIME] = {.name = "uptime", .run = uptime_sync_start, .runner = BOOT_RUNNER_BACKGROUND, .depends = 0},
+    [MAIN_BOOT_ACCOUNTS] = {.name = "accounts", .run = ofp_account_list_init, .runner = BOOT_RUNNER_BACKGROUND, .depends = BOOT_DEPENDS(MAIN_BOOT_STORAGE)},
+    [MAIN_BOOT_CERTIFICATES] = {.name = "certificates", .run = webserver_load_certificates, .runner = BOOT_RUNNER_BACKGROUND, .depends = BOOT_DEPENDS(MAIN_BOOT_STORAGE)},
+    [MAIN_BOOT_CONSOLE] = {.name = "console", .run = console_init, .runner = BOOT_RUNNER_BACKGROUND, .depends = BOOT_DEPENDS(MAIN_BOOT_ACCOUNTS) | BOOT_DEPENDS(MAIN_BOOT_PLANNINGS) | BOOT_DEPENDS(MAIN_BOOT_HARDWARE)},
+    // confirm OTA update if pending, once outputs are known to work
+    [MAIN_BOOT_FIRMWARE] = {.name = "firmware", .run = fwupd_confirm, .runner = BOOT_RUNNER_BACKGROUND, .depends = BOOT_DEPENDS(MAIN_BOOT_FIRST_APPLY)},
+    [MAIN_BOOT_NETWORK] = {.name = "network", .run = boot_network, .runner = BOOT_RUNNER_BACKGROUND, .depends = BOOT_DEPENDS(MAIN_BOOT_UPTIME) | BOOT_DEPENDS(MAIN_BOOT_ACCOUNTS) | BOOT_DEPENDS(MAIN_BOOT_CERTIFICATES)},
+    // load shedding acts on zones, which must be applied first
+    [MAIN_BOOT_LINKY] = {.name = "linky", .run = boot_linky, .runner = BOOT_RUNNER_BACKGROUND, .depends = BOOT_DEPENDS(MAIN_BOOT_FIRST_APPLY)},
+    // transitions recorded until then are kept pending in memory
+    [MAIN_BOOT_HISTORY] = {.name = "history", .run = history_init, .runner = BOOT_RUNNER_BACKGROUND, .depends = 0},
+    // until then, pulse edges are applied by the main loop
+    [MAIN_BOOT_PULSE] = {.name = "pulse", .run = boot_pulse, .runner = BOOT_RUNNER_BACKGROUND, .depends = BOOT_DEPENDS(MAIN_BOOT_FIRST_APPLY)},
+};
+
+/***************************************************************************/
+
+void app_main()
+{
+    main_task = xTaskGetCurrentTaskHandle();
+
+    // zones and plannings are mutated from several tasks once booted
+    ofp_lock_init();
+
+    // returns once the first orders have been applied
+    boot_run(boot_stages, MAIN_BOOT_ENUM_SIZE);
 
     // use global hardware reference
     struct ofp_hw *current_hw = ofp_hw_get_current();
 
-    /* main loop */
+    /* main loop, on absolute deadlines so that its period does not drift */
+    const int64_t period_us = MAIN_LOOP_WAIT_MILLISECONDS * 1000LL;
+    int64_t deadline_us = esp_timer_get_time() + period_us;
+    loop_stats_set_period(MAIN_LOOP_WAIT_MILLISECONDS);
     while (current_hw != NULL)
     {
-        // current time
-        time_t now;
-        struct tm ti;
-        time(&now);
-        time_to_localtime(&now, &ti);
-
-        // track time
-        char buf[LOCALTIME_TO_STRING_BUFFER_LENGTH];
-        localtime_to_string(&ti, buf, sizeof(buf));
-        ESP_LOGV(TAG, "current time: %s", buf);
-
-        // compute orders
-        ofp_zone_update_current_orders(current_hw, &ti);
-        // apply orders
-        current_hw->hw_hooks.apply(current_hw, &ti);
-
-        // sleep
-        vTaskDelay(pdMS_TO_TICKS(MAIN_LOOP_WAIT_MILLISECONDS));
+        // sleep until the deadline, rounding up to the next tick
+        int64_t now_us = esp_timer_get_time();
+        if (now_us < deadline_us)
+        {
+            TickType_t ticks = (deadline_us - now_us + portTICK_PERIOD_MS * 1000 - 1) / (portTICK_PERIOD_MS * 1000);
+            // woken up early when load shedding changed, without moving the schedule
+            if (ulTaskNotifyTake(pdTRUE, ticks) > 0)
+            {
+                apply_current_orders(current_hw, false);
+                continue;
+            }
+            now_us = esp_timer_get_time();
+        }
+
+        loop_stats_record_lateness(now_us > deadline_us ? now_us - deadline_us : 0);
+        apply_current_orders(current_hw, true);
+
+        // skip the deadlines which already passed, instead of catching up
+        deadline_us += period_us;
+        now_us = esp_timer_get_time();
+        if (now_us >= deadline_us)
+        {
+            uint32_t missed = (now_us - deadline_us) / period_us + 1;
+            loop_stats_record_missed(missed);
+            deadline_us += missed * period_us;
+        }
     }
     ESP_LOGD(TAG, "app_main finished");
 }
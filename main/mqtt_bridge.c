@@ -0,0 +1,377 @@
+#include <stdio.h>
+#include <string.h>
+#include <esp_log.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+
+#include "sdkconfig.h"
+
+#ifdef CONFIG_OFP_MQTT
+#include <mqtt_client.h>
+#endif /* CONFIG_OFP_MQTT */
+
+#include "str.h"
+#include "ofp.h"
+#include "api_zones.h"
+#include "mqtt_bridge.h"
+#include "top.h"
+
+static const char TAG[] = "mqtt_bridge";
+
+/* statistics */
+static struct mqtt_bridge_stats stats = {0};
+
+/* mutex variables */
+portMUX_TYPE mutex_mqtt_bridge_stats = portMUX_INITIALIZER_UNLOCKED;
+
+#ifdef CONFIG_OFP_MQTT
+
+#define MQTT_BRIDGE_TOPIC_MAX_LEN 96
+#define MQTT_BRIDGE_PAYLOAD_MAX_LEN API_ZONES_MODE_MAX_LEN
+#define MQTT_BRIDGE_TASK_STACK_SIZE 3072
+
+#define MQTT_BRIDGE_TOPIC_ZONES "zones"
+#define MQTT_BRIDGE_TOPIC_ZONE_FORMAT "%s/" MQTT_BRIDGE_TOPIC_ZONES "/%s/%s"
+#define MQTT_BRIDGE_TOPIC_ROOT_FORMAT "%s/%s"
+#define MQTT_BRIDGE_COMMAND_SUFFIX "/set"
+
+struct mqtt_bridge_message
+{
+    char topic[MQTT_BRIDGE_TOPIC_MAX_LEN];
+    char payload[MQTT_BRIDGE_PAYLOAD_MAX_LEN];
+};
+
+/* last published state, only used by the control loop */
+struct mqtt_bridge_zone_state
+{
+    bool valid;
+    enum ofp_order_id current;
+    enum ofp_zone_mode mode;
+    union ofp_zone_mode_data mode_data;
+};
+
+static struct mqtt_bridge_zone_state published_zones[OFP_MAX_ZONE_COUNT];
+static bool published_override_valid = false;
+static bool published_override_active = false;
+static enum ofp_order_id published_override_order;
+
+/* global variables */
+static esp_mqtt_client_handle_t client = NULL;
+static QueueHandle_t outbound = NULL;
+static volatile bool republish_all = false;
+
+/***************************************************************************/
+
+static void mqtt_bridge_stats_add(unsigned int *counter)
+{
+    taskENTER_CRITICAL(&mutex_mqtt_bridge_stats);
+    (*counter)++;
+    taskEXIT_CRITICAL(&mutex_mqtt_bridge_stats);
+}
+
+/* never blocks, returns false if the message was dropped */
+static bool mqtt_bridge_enqueue(const char *topic, const char *payload)
+{
+    struct mqtt_bridge_message msg;
+    snprintf(msg.topic, sizeof(msg.topic), "%s", topic);
+    snprintf(msg.payload, sizeof(msg.payload), "%s", payload);
+
+    if (xQueueSend(outbound, &msg, 0) != pdTRUE)
+    {
+        mqtt_bridge_stats_add(&stats.dropped);
+        ESP_LOGD(TAG, "Queue full, dropping %s", topic);
+        return false;
+    }
+    return true;
+}
+
+static void mqtt_bridge_publish_task(void *pvParameters)
+{
+    struct mqtt_bridge_message msg;
+    while (true)
+    {
+        if (xQueueReceive(outbound, &msg, portMAX_DELAY) != pdTRUE)
+            continue;
+
+        // retained so that subscribers get the current state immediately,
+        // and QoS 1 so that messages are kept until delivered if disconnected
+        int msg_id = esp_mqtt_client_publish(client, msg.topic, msg.payload, 0, 1, 1);
+        ESP_LOGV(TAG, "Published %s = %s (%i)", msg.topic, msg.payload, msg_id);
+        if (msg_id >= 0)
+            mqtt_bridge_stats_add(&stats.published);
+    }
+}
+
+/***************************************************************************/
+
+static bool mqtt_bridge_notify_zone(int index, struct ofp_zone *zone)
+{
+    struct mqtt_bridge_zone_state *state = &published_zones[index];
+    char topic[MQTT_BRIDGE_TOPIC_MAX_LEN];
+
+    if (!state->valid || state->current != zone->current)
+    {
+        const struct ofp_order_info *info = ofp_order_info_by_num_id(zone->current);
+        if (info == NULL)
+        {
+            // not retried, so that it does not hold back the other zones
+            ESP_LOGW(TAG, "Unknown order %i for zone %s, not published", zone->current, zone->id);
+        }
+        else
+        {
+            snprintf(topic, sizeof(topic), MQTT_BRIDGE_TOPIC_ZONE_FORMAT, CONFIG_OFP_MQTT_TOPIC_PREFIX, zone->id, json_key_current);
+            if (!mqtt_bridge_enqueue(topic, info->id))
+                return false;
+        }
+        state->current = zone->current;
+    }
+
+    // comparing the int member covers both union members
+    if (!state->valid || state->mode != zone->mode || state->mode_data.planning_id != zone->mode_data.planning_id)
+    {
+        char buf[API_ZONES_MODE_MAX_LEN];
+        if (!api_zones_format_mode(zone, buf, sizeof(buf)))
+            return false;
+        snprintf(topic, sizeof(topic), MQTT_BRIDGE_TOPIC_ZONE_FORMAT, CONFIG_OFP_MQTT_TOPIC_PREFIX, zone->id, json_key_mode);
+        if (!mqtt_bridge_enqueue(topic, buf))
+            return false;
+        state->mode = zone->mode;
+        state->mode_data = zone->mode_data;
+    }
+
+    state->valid = true;
+    return true;
+}
+
+static void mqtt_bridge_notify_override(void)
+{
+    enum ofp_order_id order_id = HW_OFP_ORDER_ID_STANDARD_OFFLOAD;
+    bool active = ofp_override_get_order_id(&order_id);
+
+    if (published_override_valid && published_override_active == active && (!active || published_override_order == order_id))
+        return;
+
+    const struct ofp_order_info *info = active ? ofp_order_info_by_num_id(order_id) : NULL;
+    char topic[MQTT_BRIDGE_TOPIC_MAX_LEN];
+    snprintf(topic, sizeof(topic), MQTT_BRIDGE_TOPIC_ROOT_FORMAT, CONFIG_OFP_MQTT_TOPIC_PREFIX, stor_key_zone_override);
+    if (!mqtt_bridge_enqueue(topic, info ? info->id : stor_val_none))
+        return;
+
+    published_override_valid = true;
+    published_override_active = active;
+    published_override_order = order_id;
+}
+
+/***************************************************************************/
+
+static void mqtt_bridge_command_zone_mode(const char *zone_id, const char *payload)
+{
+    struct ofp_zone *zone = api_zones_find_zone_by_id(zone_id);
+    if (zone == NULL)
+    {
+        ESP_LOGD(TAG, "Zone %s not found", zone_id);
+        return;
+    }
+
+    enum ofp_zone_mode zone_mode;
+    int mode_value;
+    if (!api_zones_parse_mode(payload, &zone_mode, &mode_value))
+    {
+        ESP_LOGD(TAG, "Invalid mode %s for zone %s", payload, zone_id);
+        return;
+    }
+
+    // same path as the web API, serialized with the other tasks
+    if (!api_zones_apply_mode(zone, zone_mode, mode_value))
+    {
+        ESP_LOGW(TAG, "Could not set mode %s for zone %s", payload, zone_id);
+        return;
+    }
+
+    mqtt_bridge_stats_add(&stats.commands);
+}
+
+static void mqtt_bridge_command_override(const char *payload)
+{
+    const struct ofp_order_info *info = NULL;
+    if (strcmp(payload, stor_val_none) != 0)
+    {
+        info = ofp_order_info_by_str_id((char *)payload);
+        if (info == NULL)
+        {
+            ESP_LOGD(TAG, "Invalid order override %s", payload);
+            return;
+        }
+    }
+    api_zones_apply_override(info);
+
+    mqtt_bridge_stats_add(&stats.commands);
+}
+
+/* topic and payload are NOT null-terminated */
+static void mqtt_bridge_command(const char *topic_data, int topic_len, const char *payload_data, int payload_len)
+{
+    char topic[MQTT_BRIDGE_TOPIC_MAX_LEN];
+    char payload[MQTT_BRIDGE_PAYLOAD_MAX_LEN];
+    if (topic_len >= sizeof(topic) || payload_len >= sizeof(payload))
+    {
+        ESP_LOGD(TAG, "Command too long");
+        return;
+    }
+    memcpy(topic, topic_data, topic_len);
+    topic[topic_len] = '\0';
+    memcpy(payload, payload_data, payload_len);
+    payload[payload_len] = '\0';
+    ESP_LOGD(TAG, "Command %s = %s", topic, payload);
+
+    // strip prefix and suffix
+    size_t prefix_len = strlen(CONFIG_OFP_MQTT_TOPIC_PREFIX);
+    size_t suffix_len = strlen(MQTT_BRIDGE_COMMAND_SUFFIX);
+    if (topic_len < prefix_len + 1 + suffix_len || strncmp(topic, CONFIG_OFP_MQTT_TOPIC_PREFIX "/", prefix_len + 1) != 0 || strcmp(topic + topic_len - suffix_len, MQTT_BRIDGE_COMMAND_SUFFIX) != 0)
+    {
+        ESP_LOGD(TAG, "Unexpected topic %s", topic);
+        return;
+    }
+    char *path = topic + prefix_len + 1;
+    topic[topic_len - suffix_len] = '\0';
+
+    // "override" or "zones/<id>/mode"
+    if (strcmp(path, stor_key_zone_override) == 0)
+    {
+        mqtt_bridge_command_override(payload);
+        return;
+    }
+
+    char *zone_id = NULL, *key = NULL;
+    char *slash = strchr(path, '/');
+    if (slash != NULL && slash - path == strlen(MQTT_BRIDGE_TOPIC_ZONES) && strncmp(path, MQTT_BRIDGE_TOPIC_ZONES, slash - path) == 0)
+    {
+        zone_id = slash + 1;
+        key = strchr(zone_id, '/');
+    }
+    if (key == NULL || strcmp(key + 1, json_key_mode) != 0)
+    {
+        ESP_LOGD(TAG, "Unknown command %s", path);
+        return;
+    }
+    *key = '\0';
+    mqtt_bridge_command_zone_mode(zone_id, payload);
+}
+
+static void mqtt_bridge_subscribe(const char *format, const char *key)
+{
+    char topic[MQTT_BRIDGE_TOPIC_MAX_LEN];
+    if (format == NULL)
+        snprintf(topic, sizeof(topic), MQTT_BRIDGE_TOPIC_ROOT_FORMAT MQTT_BRIDGE_COMMAND_SUFFIX, CONFIG_OFP_MQTT_TOPIC_PREFIX, key);
+    else
+        snprintf(topic, sizeof(topic), format, CONFIG_OFP_MQTT_TOPIC_PREFIX, "+", key);
+    esp_mqtt_client_subscribe(client, topic, 1);
+    ESP_LOGD(TAG, "Subscribed to %s", topic);
+}
+
+static void mqtt_bridge_event_handler(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data)
+{
+    esp_mqtt_event_handle_t event = event_data;
+
+    switch ((esp_mqtt_event_id_t)event_id)
+    {
+    case MQTT_EVENT_CONNECTED:
+        ESP_LOGI(TAG, "Connected to broker");
+        taskENTER_CRITICAL(&mutex_mqtt_bridge_stats);
+        stats.connected = true;
+        taskEXIT_CRITICAL(&mutex_mqtt_bridge_stats);
+        mqtt_bridge_subscribe(MQTT_BRIDGE_TOPIC_ZONE_FORMAT MQTT_BRIDGE_COMMAND_SUFFIX, json_key_mode);
+        mqtt_bridge_subscribe(NULL, stor_key_zone_override);
+        // the broker may have lost retained messages
+        republish_all = true;
+        break;
+
+    case MQTT_EVENT_DISCONNECTED:
+        ESP_LOGI(TAG, "Disconnected from broker");
+        taskENTER_CRITICAL(&mutex_mqtt_bridge_stats);
+        stats.connected = false;
+        taskEXIT_CRITICAL(&mutex_mqtt_bridge_stats);
+        break;
+
+    case MQTT_EVENT_DATA:
+        // commands are short, ignore fragmented messages
+        if (event->current_data_offset != 0 || event->data_len != event->total_data_len)
+        {
+            ESP_LOGD(TAG, "Ignoring fragmented message");
+            break;
+        }
+        mqtt_bridge_command(event->topic, event->topic_len, event->data, event->data_len);
+        break;
+
+    default:
+        ESP_LOGV(TAG, "Event %i", event_id);
+        break;
+    }
+}
+
+#endif /* CONFIG_OFP_MQTT */
+
+/***************************************************************************/
+
+void mqtt_bridge_start(void)
+{
+#ifdef CONFIG_OFP_MQTT
+    if (client != NULL)
+        return;
+
+    ESP_LOGI(TAG, "Starting MQTT bridge to %s", CONFIG_OFP_MQTT_BROKER_URI);
+
+    outbound = xQueueCreate(CONFIG_OFP_MQTT_QUEUE_LENGTH, sizeof(struct mqtt_bridge_message));
+    configASSERT(outbound);
+
+    const esp_mqtt_client_config_t mqtt_cfg = {
+        .uri = CONFIG_OFP_MQTT_BROKER_URI,
+        .client_id = CONFIG_OFP_HOSTNAME,
+        .username = strlen(CONFIG_OFP_MQTT_USERNAME) ? CONFIG_OFP_MQTT_USERNAME : NULL,
+        .password = strlen(CONFIG_OFP_MQTT_PASSWORD) ? CONFIG_OFP_MQTT_PASSWORD : NULL,
+    };
+    client = esp_mqtt_client_init(&mqtt_cfg);
+    configASSERT(client);
+    ESP_ERROR_CHECK(esp_mqtt_client_register_event(client, ESP_EVENT_ANY_ID, mqtt_bridge_event_handler, NULL));
+    ESP_ERROR_CHECK(esp_mqtt_client_start(client));
+
+    TaskHandle_t xHandle = NULL;
+    top_register_stack("mqtt_pub", MQTT_BRIDGE_TASK_STACK_SIZE);
+    xTaskCreatePinnedToCore(mqtt_bridge_publish_task, "mqtt_pub", MQTT_BRIDGE_TASK_STACK_SIZE, NULL, 1, &xHandle, 1);
+    configASSERT(xHandle);
+#endif /* CONFIG_OFP_MQTT */
+}
+
+void mqtt_bridge_notify(struct ofp_hw *hw)
+{
+#ifdef CONFIG_OFP_MQTT
+    assert(hw != NULL);
+
+    if (outbound == NULL)
+        return;
+
+    if (republish_all)
+    {
+        republish_all = false;
+        memset(published_zones, 0, sizeof(published_zones));
+        published_override_valid = false;
+    }
+
+    // stop at the first dropped message, the rest will be done next time
+    for (int i = 0; i < hw->zone_set.count && i < OFP_MAX_ZONE_COUNT; i++)
+        if (!mqtt_bridge_notify_zone(i, &hw->zone_set.zones[i]))
+            return;
+
+    mqtt_bridge_notify_override();
+#endif /* CONFIG_OFP_MQTT */
+}
+
+void mqtt_bridge_get_stats(struct mqtt_bridge_stats *out)
+{
+    assert(out != NULL);
+
+    taskENTER_CRITICAL(&mutex_mqtt_bridge_stats);
+    *out = stats;
+    taskEXIT_CRITICAL(&mutex_mqtt_bridge_stats);
+}
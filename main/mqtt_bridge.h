@@ -0,0 +1,33 @@
+#ifndef MQTT_BRIDGE_H
+#define MQTT_BRIDGE_H
+
+#include "ofp.h"
+
+/*
+ * MQTT bridge (see docs/mqtt.txt for topics)
+ *
+ * Zone states are published (retained) when they change, through a
+ * bounded queue emptied by a dedicated task, so that the control loop
+ * is never blocked by the broker : messages are dropped when it is full.
+ * Commands received on subscribed topics act like the matching API calls.
+ *
+ * Every function does nothing if OFP_MQTT is disabled
+ */
+
+/* starts the client once, it then reconnects by itself */
+void mqtt_bridge_start(void);
+
+/* to be called by the control loop after each order computation */
+void mqtt_bridge_notify(struct ofp_hw *hw);
+
+struct mqtt_bridge_stats
+{
+    bool connected;
+    unsigned int published;
+    unsigned int dropped;
+    unsigned int commands;
+};
+
+void mqtt_bridge_get_stats(struct mqtt_bridge_stats *stats);
+
+#endif /* MQTT_BRIDGE_H */
\ No newline at end of file
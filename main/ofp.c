@@ -1,18 +1,26 @@
 #include <string.h>
 #include <driver/gpio.h>
 #include <rom/ets_sys.h>
+#include <esp_cpu.h>
 #include <esp_log.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
 
 #include "str.h"
 #include "ofp.h"
 #include "storage.h"
 #include "api_hw.h"
+#include "usage.h"
+#include "trace.h"
+#include "pulse.h"
+#include "vcd.h"
 
 static const char TAG[] = "ofp";
 
 /* defines */
 #define DEFAULT_FIXED_ORDER_FOR_ZONES HW_OFP_ORDER_ID_STANDARD_COZY
 #define OFP_MAX_LEN_PLANNING_SLOT_VALUE 10 // dow:hour:minute:order_id
+#define OFP_STALE_SLOT_BATCH 8
 
 /* constants */
 
@@ -42,6 +50,15 @@ static struct ofp_planning_list *plan_list_global = NULL;
 /* where the registered hardware are stored */
 static struct ofp_hw_list hw_list = {.hw_count = 0, .hw = {NULL}};
 
+/* in-progress transaction, if any (see ofp_transaction_begin) */
+static struct ofp_transaction *transaction_global = NULL;
+
+/* serializes mutations, recursive so that mutators can call each other */
+static SemaphoreHandle_t ofp_mutex = NULL;
+
+/* serializes storage, which may be written after releasing ofp_mutex (see ofp_store_lock) */
+static SemaphoreHandle_t ofp_store_mutex = NULL;
+
 /* const definition */
 static const struct ofp_order_info order_info[] = {
     {
@@ -119,6 +136,48 @@ bool ofp_day_of_week_is_valid(enum ofp_day_of_week dow)
     return (dow >= 0 && dow < OFP_DOW_ENUM_SIZE);
 }
 
+/* locking */
+void ofp_lock_init(void)
+{
+    assert(ofp_mutex == NULL);
+    ofp_mutex = xSemaphoreCreateRecursiveMutex();
+    configASSERT(ofp_mutex);
+    assert(ofp_store_mutex == NULL);
+    ofp_store_mutex = xSemaphoreCreateRecursiveMutex();
+    configASSERT(ofp_store_mutex);
+}
+
+void ofp_lock(void)
+{
+    assert(ofp_mutex != NULL);
+    xSemaphoreTakeRecursive(ofp_mutex, portMAX_DELAY);
+}
+
+void ofp_unlock(void)
+{
+    assert(ofp_mutex != NULL);
+    xSemaphoreGiveRecursive(ofp_mutex);
+}
+
+/*
+ * Storage may be written after releasing the ofp lock, so that the control
+ * loop never waits for the flash. Writers take this lock BEFORE the ofp lock
+ * and keep it until written, so that storage follows the order of the changes.
+ */
+static void ofp_store_lock(void)
+{
+    assert(ofp_store_mutex != NULL);
+    // its holder may be waiting for the ofp lock
+    assert(xSemaphoreGetMutexHolder(ofp_store_mutex) == xTaskGetCurrentTaskHandle() || xSemaphoreGetMutexHolder(ofp_mutex) != xTaskGetCurrentTaskHandle());
+    xSemaphoreTakeRecursive(ofp_store_mutex, portMAX_DELAY);
+}
+
+static void ofp_store_unlock(void)
+{
+    assert(ofp_store_mutex != NULL);
+    xSemaphoreGiveRecursive(ofp_store_mutex);
+}
+
 /* override */
 void ofp_override_load(void)
 {
@@ -136,43 +195,53 @@ void ofp_override_store(void)
 {
     ESP_LOGD(TAG, "ofp_override_store");
 
-    if (!override_global.active)
-    {
+    // storage is written outside of the lock
+    ofp_store_lock();
+    enum ofp_order_id order_id;
+    bool active = ofp_override_get_order_id(&order_id);
+    if (!active)
         kv_ns_delete_atomic(kv_get_ns_ofp(), stor_key_zone_override);
-        return;
-    }
-
-    kv_ns_set_i32_atomic(kv_get_ns_ofp(), stor_key_zone_override, override_global.order_id);
+    else
+        kv_ns_set_i32_atomic(kv_get_ns_ofp(), stor_key_zone_override, order_id);
+    ofp_store_unlock();
 }
 
 void ofp_override_enable(enum ofp_order_id order_id)
 {
     ESP_LOGD(TAG, "ofp_override_enable order_id %i", order_id);
     assert(ofp_order_id_is_valid(order_id));
+    ofp_lock();
     override_global.active = true;
     override_global.order_id = order_id;
+    ofp_unlock();
 }
 
 void ofp_override_disable(void)
 {
     ESP_LOGD(TAG, "ofp_override_disable");
+    ofp_lock();
     override_global.active = false;
     override_global.order_id = DEFAULT_FIXED_ORDER_FOR_ZONES;
+    ofp_unlock();
 }
 
 bool ofp_override_get_order_id(enum ofp_order_id *order_id)
 {
     assert(order_id != NULL);
 
-    if (!override_global.active)
-        return false;
-
-    *order_id = override_global.order_id;
-    return true;
+    ofp_lock();
+    bool active = override_global.active;
+    if (active)
+        *order_id = override_global.order_id;
+    ofp_unlock();
+    return active;
 }
 
 /* private forward declarations */
 static void ofp_planning_list_load_plannings(void);
+static bool ofp_transaction_backup_planning(struct ofp_planning *plan);
+static bool ofp_transaction_defer_planning(int planning_id, bool slots);
+static bool ofp_transaction_owned(void);
 
 /*
  * Make a hardware available to the system.
@@ -299,7 +368,22 @@ static bool ofp_hw_param_load_value(const char *hw_id, struct ofp_hw_param *para
     }
 }
 
-bool ofp_order_to_half_waves(enum ofp_order_id order_id, bool *positive_half, bool *negative_half, struct tm *timeinfo)
+int64_t ofp_order_pulse_length_us(enum ofp_order_id order_id)
+{
+    switch (order_id)
+    {
+    case HW_OFP_ORDER_ID_EXTENDED_COZYMINUS1:
+        return 3 * 1000000LL;
+
+    case HW_OFP_ORDER_ID_EXTENDED_COZYMINUS2:
+        return 7 * 1000000LL;
+
+    default:
+        return 0;
+    }
+}
+
+bool ofp_order_to_half_waves(enum ofp_order_id order_id, bool *positive_half, bool *negative_half, int64_t wall_us)
 {
     assert(positive_half != NULL);
     assert(negative_half != NULL);
@@ -310,7 +394,7 @@ bool ofp_order_to_half_waves(enum ofp_order_id order_id, bool *positive_half, bo
         Nofreeze = N
         offload = P
         cosyminus1 = economy for 3 seconds every 5 minutes, cozy otherwise
-        cosyminus1 = economy for 7 seconds every 5 minutes, cozy otherwise
+        cosyminus2 = economy for 7 seconds every 5 minutes, cozy otherwise
     */
 
     switch (order_id)
@@ -336,12 +420,9 @@ bool ofp_order_to_half_waves(enum ofp_order_id order_id, bool *positive_half, bo
         return true;
 
     case HW_OFP_ORDER_ID_EXTENDED_COZYMINUS1:
-        *positive_half = (timeinfo->tm_min % 5 == 0 && timeinfo->tm_sec < 3);
-        *negative_half = *positive_half;
-        return true;
-
     case HW_OFP_ORDER_ID_EXTENDED_COZYMINUS2:
-        *positive_half = (timeinfo->tm_min % 5 == 0 && timeinfo->tm_sec < 7);
+        // edges are scheduled by pulse_timer
+        *positive_half = pulse_level_at(ofp_order_pulse_length_us(order_id), wall_us, NULL);
         *negative_half = *positive_half;
         return true;
 
@@ -376,7 +457,9 @@ bool ofp_zone_set_description(struct ofp_zone *zone, const char *description)
     if (len + 1 > OFP_MAX_LEN_DESCRIPTION)
         return false;
 
+    ofp_lock();
     strcpy(zone->description, description);
+    ofp_unlock();
 
     return true;
 }
@@ -388,8 +471,10 @@ bool ofp_zone_set_mode_fixed(struct ofp_zone *zone, enum ofp_order_id order_id)
         ESP_LOGW(TAG, "Invalid ofp_order_id value (%i)", order_id);
         return false;
     }
+    ofp_lock();
     zone->mode = HW_OFP_ZONE_MODE_FIXED;
     zone->mode_data.order_id = order_id;
+    ofp_unlock();
     ESP_LOGV(TAG, "zone %s mode %i order_id %i", zone->id, zone->mode, zone->mode_data.order_id);
 
     return true;
@@ -397,18 +482,33 @@ bool ofp_zone_set_mode_fixed(struct ofp_zone *zone, enum ofp_order_id order_id)
 
 bool ofp_zone_set_mode_planning(struct ofp_zone *zone, int planning_id)
 {
+    // the planning must not be removed in between
+    ofp_lock();
     if (ofp_planning_list_find_planning_by_id(planning_id) == NULL)
     {
+        ofp_unlock();
         ESP_LOGW(TAG, "Invalid planning_id value (%i)", planning_id);
         return false;
     }
     zone->mode = HW_OFP_ZONE_MODE_PLANNING;
     zone->mode_data.planning_id = planning_id;
+    ofp_unlock();
     ESP_LOGV(TAG, "zone %s mode %i order_id %i", zone->id, zone->mode, zone->mode_data.planning_id);
 
     return true;
 }
 
+/* only used for energy estimates and load shedding */
+void ofp_zone_set_power(struct ofp_zone *zone, uint32_t power)
+{
+    assert(zone != NULL);
+
+    ofp_lock();
+    zone->power = power;
+    ofp_unlock();
+    ESP_LOGV(TAG, "zone %s power %u", zone->id, power);
+}
+
 /* generic function to set the zone mode */
 static bool ofp_zone_set_mode(struct ofp_zone *zone, enum ofp_zone_mode mode, int value)
 {
@@ -482,18 +582,25 @@ static bool ofp_zone_load_mode(const char *hw_id, struct ofp_zone *zone)
     return result;
 }
 
-bool ofp_zone_store(struct ofp_zone *zone)
+/* load zone heater power from NVS, 0 (unknown) if none */
+static void ofp_zone_load_power(struct ofp_zone *zone)
 {
     assert(zone != NULL);
-    ESP_LOGD(TAG, "ofp_zone_store zone id %s", zone->id);
 
+    zone->power = kv_ns_get_u32_atomic(kv_get_ns_zone_power(), zone->id, 0);
+    ESP_LOGV(TAG, "zone %s power %u", zone->id, zone->power);
+}
+
+/* build the stored zone value, result MUST BE FREED by caller */
+static char *ofp_zone_build_value(struct ofp_zone *zone)
+{
     // mmmmmmmmm:vvvvvvvvv:ddddddddddddd....dd\0
     int len = strlen(zone->description) + 2 /* : */ + 2 * 9 /* int32 */ + 1 /* \0 */;
     char *buf = malloc(len);
     if (buf == NULL)
     {
         ESP_LOGE(TAG, "Memory allocation failed while storing zone %i", zone->mode);
-        return false;
+        return NULL;
     }
 
     switch (zone->mode)
@@ -507,10 +614,45 @@ bool ofp_zone_store(struct ofp_zone *zone)
     default:
         ESP_LOGE(TAG, "Unknown zone mode: %i", zone->mode);
         free(buf);
+        return NULL;
+    }
+
+    return buf;
+}
+
+bool ofp_zone_store(struct ofp_zone *zone)
+{
+    assert(zone != NULL);
+    ESP_LOGD(TAG, "ofp_zone_store zone id %s", zone->id);
+
+    ofp_store_lock();
+    ofp_lock();
+
+    // deferred until the transaction is committed
+    if (ofp_transaction_owned())
+    {
+        assert(hw_global != NULL);
+        int index = zone - hw_global->zone_set.zones;
+        assert(index >= 0 && index < hw_global->zone_set.count);
+        transaction_global->zones_dirty |= (1ULL << index);
+        ofp_unlock();
+        ofp_store_unlock();
+        ESP_LOGV(TAG, "zone %i marked dirty", index);
+        return true;
+    }
+
+    char *buf = ofp_zone_build_value(zone);
+    uint32_t power = zone->power;
+    ofp_unlock();
+    if (buf == NULL)
+    {
+        ofp_store_unlock();
         return false;
     }
 
     kv_ns_set_str_atomic(kv_get_ns_zone(), zone->id, buf);
+    kv_ns_set_u32_atomic(kv_get_ns_zone_power(), zone->id, power);
+    ofp_store_unlock();
 
     free(buf);
     return true;
@@ -539,7 +681,8 @@ static void ofp_zone_check_deleted_planning(int planning_id)
 
 const struct ofp_order_info *ofp_order_info_by_num_id(enum ofp_order_id order_id)
 {
-    assert(order_id < HW_OFP_ORDER_ID_ENUM_SIZE);
+    if (!ofp_order_id_is_valid(order_id))
+        return NULL;
     return &order_info[order_id];
 }
 
@@ -627,9 +770,9 @@ void ofp_hw_initialize(void)
         return;
     }
 
-    if (!kv_set_ns_zone_for_hardware(current_hw->id))
+    if (!kv_set_ns_zone_for_hardware(current_hw->id) || !kv_set_ns_zone_power_for_hardware(current_hw->id))
     {
-        ESP_LOGE(TAG, "Could not set zone namespace, disabling hardware");
+        ESP_LOGE(TAG, "Could not set zone namespaces, disabling hardware");
         return;
     }
 
@@ -639,6 +782,7 @@ void ofp_hw_initialize(void)
     {
         ESP_LOGV(TAG, "zone %i", i);
         struct ofp_zone *zone = &current_hw->zone_set.zones[i];
+        ofp_zone_load_power(zone);
         if (!ofp_zone_load_mode(current_hw->id, zone))
         {
             ESP_LOGI(TAG, "No configuration stored for zone %s, reverting to default", zone->id);
@@ -650,12 +794,10 @@ void ofp_hw_initialize(void)
     hw_global = current_hw;
 }
 
-static bool ofp_zone_update_from_planning(struct ofp_zone *zone, struct tm *timeinfo)
+static bool ofp_zone_update_from_planning(struct ofp_zone *zone, struct ofp_planning_list *plan_list, struct tm *timeinfo)
 {
-    ESP_LOGD(TAG, "ofp_zone_update_from_planning");
-
     // planning exists
-    struct ofp_planning *plan = ofp_planning_list_find_planning_by_id(zone->mode_data.planning_id);
+    struct ofp_planning *plan = ofp_planning_list_find_in(plan_list, zone->mode_data.planning_id);
     if (plan == NULL)
     {
         ESP_LOGW(TAG, "Unknown planning %i for zone %s", zone->mode_data.planning_id, zone->id);
@@ -669,7 +811,6 @@ static bool ofp_zone_update_from_planning(struct ofp_zone *zone, struct tm *time
         timeinfo->tm_hour * 60 * 60 +
         timeinfo->tm_min * 60 +
         timeinfo->tm_sec;
-    ESP_LOGV(TAG, "current since start of week: %i", current_since_start_of_week);
     struct ofp_planning_slot *most_recent_slot = NULL;
     for (int i = 0; i < OFP_MAX_PLANNING_SLOT_COUNT; i++)
     {
@@ -678,26 +819,22 @@ static bool ofp_zone_update_from_planning(struct ofp_zone *zone, struct tm *time
         if (slot == NULL)
             continue;
 
-        ESP_LOGV(TAG, "planning %i slot %i dow %i hour %i minute %i", plan->id, slot->id, slot->dow, slot->hour, slot->minute);
-
         int slot_since_start_of_week =
             slot->dow * 24 * 60 * 60 +
             slot->hour * 60 * 60 +
             slot->minute * 60;
-        ESP_LOGV(TAG, "slot since start of week: %i", slot_since_start_of_week);
 
         int delta = current_since_start_of_week - slot_since_start_of_week;
-        ESP_LOGV(TAG, "delta %i min_delta is %i", delta, min_delta);
 
         // reject future slots and slots older than current
         if (delta < 0 || delta > min_delta)
         {
-            ESP_LOGV(TAG, "Skipping slot");
+            TRACE(TRACE_EVENT_PLANNING_SLOT, plan->id, slot->id, delta, false);
             continue;
         }
 
         // keep
-        ESP_LOGV(TAG, "Retaining as better");
+        TRACE(TRACE_EVENT_PLANNING_SLOT, plan->id, slot->id, delta, true);
         min_delta = delta;
         most_recent_slot = slot;
     }
@@ -712,27 +849,43 @@ static bool ofp_zone_update_from_planning(struct ofp_zone *zone, struct tm *time
 
     // apply slot order
     zone->current = most_recent_slot->order_id;
-    ESP_LOGV(TAG, "zone %s planning %i order %i", zone->id, plan->id, zone->current);
+    TRACE(TRACE_EVENT_PLANNING_ORDER, plan->id, most_recent_slot->id, zone->current, 0);
     return true;
 }
 
-void ofp_zone_update_current_orders(struct ofp_hw *hw, struct tm *timeinfo)
+/* only flags the zone, orders are computed and applied by the control loop */
+void ofp_zone_set_shed(struct ofp_zone *zone, bool shed)
 {
-    ESP_LOGD(TAG, "ofp_zone_update_current_orders");
+    assert(zone != NULL);
 
+    ofp_lock();
+    if (zone->shed != shed)
+        ESP_LOGI(TAG, "Zone %s load shedding %s", zone->id, shed ? "started" : "ended");
+    zone->shed = shed;
+    ofp_unlock();
+}
+
+void ofp_zone_set_compute_orders(struct ofp_zone_set *zone_set, struct ofp_planning_list *plan_list, struct tm *timeinfo)
+{
     enum ofp_order_id override_order_id;
     bool override_active = ofp_override_get_order_id(&override_order_id);
 
     // compute current zone orders
-    for (int i = 0; i < hw->zone_set.count; i++)
+    for (int i = 0; i < zone_set->count; i++)
     {
-        struct ofp_zone *zone = &hw->zone_set.zones[i];
+        struct ofp_zone *zone = &zone_set->zones[i];
+
+        // load shedding has precedence over everything
+        if (zone->shed)
+        {
+            zone->current = HW_OFP_ORDER_ID_STANDARD_OFFLOAD;
+            continue;
+        }
 
         // if there is an active override
         if (override_active)
         {
             zone->current = override_order_id;
-            ESP_LOGV(TAG, "overriding zone %s with order %i", zone->id, zone->current);
             continue;
         }
 
@@ -741,12 +894,11 @@ void ofp_zone_update_current_orders(struct ofp_hw *hw, struct tm *timeinfo)
         case HW_OFP_ZONE_MODE_FIXED:
             // if the zone has a fixed configuration
             zone->current = zone->mode_data.order_id;
-            ESP_LOGV(TAG, "fixed zone %s with order %i", zone->id, zone->current);
             break;
 
         case HW_OFP_ZONE_MODE_PLANNING:
             // if the zone is driven by a planning
-            if (!ofp_zone_update_from_planning(zone, timeinfo))
+            if (!ofp_zone_update_from_planning(zone, plan_list, timeinfo))
             {
                 zone->current = DEFAULT_FIXED_ORDER_FOR_ZONES;
                 ESP_LOGW(TAG, "Could not update zone %s from planning, using default order %i", zone->id, zone->current);
@@ -758,9 +910,30 @@ void ofp_zone_update_current_orders(struct ofp_hw *hw, struct tm *timeinfo)
             ESP_LOGW(TAG, "Unknown mode %i for zone %s", zone->mode, zone->id);
             break;
         }
+    }
+}
 
-        ESP_LOGV(TAG, "zone %s current %i", zone->id, zone->current);
+void ofp_zone_update_current_orders(struct ofp_hw *hw, struct tm *timeinfo)
+{
+    TRACE_SCOPE(TRACE_SPAN_ORDERS_COMPUTE);
+
+    // plannings and zones must not change while being read
+    ofp_lock();
+    ofp_zone_set_compute_orders(&hw->zone_set, ofp_planning_list_get(), timeinfo);
+
+    enum ofp_order_id override_order_id;
+    bool override_active = ofp_override_get_order_id(&override_order_id);
+
+    // time spent in each order, only does work on transitions
+    for (int i = 0; i < hw->zone_set.count; i++)
+    {
+        struct ofp_zone *zone = &hw->zone_set.zones[i];
+        TRACE(TRACE_EVENT_ZONE_ORDER, i, zone->current, zone->shed, override_active);
+        usage_zone_order(i, zone->current);
     }
+    ofp_unlock();
+
+    usage_tick(timeinfo);
 }
 
 /* access the global hardware instance */
@@ -805,9 +978,16 @@ struct ofp_planning *ofp_planning_list_find_planning_by_id(int planning_id)
     assert(plan_list_global);
     ESP_LOGD(TAG, "ofp_planning_list_find_planning_by_id %i", planning_id);
 
+    return ofp_planning_list_find_in(plan_list_global, planning_id);
+}
+
+struct ofp_planning *ofp_planning_list_find_in(struct ofp_planning_list *plan_list, int planning_id)
+{
+    assert(plan_list);
+
     for (int i = 0; i < OFP_MAX_PLANNING_COUNT; i++)
     {
-        struct ofp_planning *plan = plan_list_global->plannings[i];
+        struct ofp_planning *plan = plan_list->plannings[i];
         if (plan == NULL)
             continue;
         if (plan->id == planning_id)
@@ -868,6 +1048,9 @@ static void ofp_planning_store(struct ofp_planning *plan)
     assert(plan->id >= 0);
     ESP_LOGD(TAG, "ofp_planning_store planning_id %i", plan->id);
 
+    if (ofp_transaction_defer_planning(plan->id, false))
+        return;
+
     char buf[OFP_MAX_LEN_INT32];
     snprintf(buf, sizeof(buf), "%i", plan->id);
     kv_ns_set_str_atomic(kv_get_ns_plan(), buf, plan->description);
@@ -924,19 +1107,27 @@ static void ofp_planning_slot_free(struct ofp_planning_slot *slot)
     free(slot);
 }
 
+/* key buffer is OFP_MAX_LEN_INT32 long, value buffer is OFP_MAX_LEN_PLANNING_SLOT_VALUE long */
+static void ofp_planning_slot_build_key_value(const struct ofp_planning_slot *slot, char *key, char *val)
+{
+    snprintf(key, OFP_MAX_LEN_INT32, "%i", slot->id);
+    snprintf(val, OFP_MAX_LEN_PLANNING_SLOT_VALUE, str_planning_slot_value_printf, slot->dow, slot->hour, slot->minute, slot->order_id);
+}
+
 static void ofp_planning_slot_store(int planning_id, struct ofp_planning_slot *slot)
 {
     assert(slot != NULL);
     ESP_LOGD(TAG, "ofp_planning_slot_store planning_id %i slot_id %i", planning_id, slot->id);
 
+    if (ofp_transaction_defer_planning(planning_id, true))
+        return;
+
     if (!kv_set_ns_slots_for_planning(planning_id))
         return;
 
     char key[OFP_MAX_LEN_INT32];
-    snprintf(key, sizeof(key), "%i", slot->id);
-
     char val[OFP_MAX_LEN_PLANNING_SLOT_VALUE];
-    snprintf(val, sizeof(val), str_planning_slot_value_printf, slot->dow, slot->hour, slot->minute, slot->order_id);
+    ofp_planning_slot_build_key_value(slot, key, val);
 
     kv_ns_set_str_atomic(kv_get_ns_slots(), key, val);
 }
@@ -946,6 +1137,9 @@ static void ofp_planning_slot_purge(int planning_id, struct ofp_planning_slot *s
     assert(slot != NULL);
     ESP_LOGD(TAG, "ofp_planning_slot_purge planning_id %i slot_id %i", planning_id, slot->id);
 
+    if (ofp_transaction_defer_planning(planning_id, true))
+        return;
+
     if (!kv_set_ns_slots_for_planning(planning_id))
         return;
 
@@ -954,6 +1148,109 @@ static void ofp_planning_slot_purge(int planning_id, struct ofp_planning_slot *s
     kv_ns_delete_atomic(kv_get_ns_slots(), key);
 }
 
+/* copies the slots of the planning, returns their count */
+static int ofp_planning_copy_slots(struct ofp_planning *plan, struct ofp_planning_slot slots[OFP_MAX_PLANNING_SLOT_COUNT])
+{
+    int count = 0;
+    for (int i = 0; i < OFP_MAX_PLANNING_SLOT_COUNT; i++)
+    {
+        struct ofp_planning_slot *slot = plan->slots[i];
+        if (slot == NULL)
+            continue;
+        slots[count++] = *slot;
+    }
+    return count;
+}
+
+static bool ofp_planning_slots_have_key(const struct ofp_planning_slot *slots, int count, const char *key)
+{
+    char buf[OFP_MAX_LEN_INT32];
+    for (int i = 0; i < count; i++)
+    {
+        snprintf(buf, sizeof(buf), "%i", slots[i].id);
+        if (strcmp(buf, key) == 0)
+            return true;
+    }
+    return false;
+}
+
+/*
+ * Replaces every stored slot of the planning, using a single handle and commit
+ *
+ * New slots are written before stale ones are deleted, so that an interrupted
+ * write never leaves the planning without slots. Does not use the ofp state,
+ * so that it can run outside of the ofp lock.
+ */
+static bool ofp_planning_slots_write(int planning_id, const struct ofp_planning_slot *slots, int count)
+{
+    ESP_LOGD(TAG, "ofp_planning_slots_write planning_id %i count %i", planning_id, count);
+
+    char ns[NVS_NS_NAME_MAX_SIZE];
+    if (!kv_build_ns_slots_for_planning(planning_id, ns))
+        return false;
+
+    nvs_handle_t h;
+    esp_err_t err = kv_try_open_ns(ns, &h);
+    if (err != ESP_OK)
+    {
+        ESP_LOGW(TAG, "Could not open slots of planning %i: %s", planning_id, esp_err_to_name(err));
+        return false;
+    }
+
+    for (int i = 0; i < count && err == ESP_OK; i++)
+    {
+        char key[OFP_MAX_LEN_INT32];
+        char val[OFP_MAX_LEN_PLANNING_SLOT_VALUE];
+        ofp_planning_slot_build_key_value(&slots[i], key, val);
+        err = kv_try_set_str(h, key, val);
+    }
+
+    // collected by batches, the iterator is not kept across deletions
+    int stale_count = OFP_STALE_SLOT_BATCH;
+    while (err == ESP_OK && stale_count == OFP_STALE_SLOT_BATCH)
+    {
+        char stale[OFP_STALE_SLOT_BATCH][NVS_KEY_NAME_MAX_SIZE];
+        stale_count = 0;
+        nvs_iterator_t it = nvs_entry_find(default_nvs_partition_name, ns, NVS_TYPE_ANY);
+        for (; it != NULL && stale_count < OFP_STALE_SLOT_BATCH; it = nvs_entry_next(it))
+        {
+            nvs_entry_info_t info;
+            nvs_entry_info(it, &info);
+            if (!ofp_planning_slots_have_key(slots, count, info.key))
+                strcpy(stale[stale_count++], info.key);
+        }
+        nvs_release_iterator(it);
+
+        for (int i = 0; i < stale_count && err == ESP_OK; i++)
+            err = kv_try_delete_key(h, stale[i]);
+    }
+
+    if (err == ESP_OK)
+        err = kv_try_commit(h);
+    kv_close(h);
+
+    if (err != ESP_OK)
+        ESP_LOGW(TAG, "Could not store slots of planning %i: %s", planning_id, esp_err_to_name(err));
+    return err == ESP_OK;
+}
+
+static void ofp_planning_slots_rewrite(struct ofp_planning *plan)
+{
+    assert(plan != NULL);
+    ESP_LOGD(TAG, "ofp_planning_slots_rewrite planning_id %i", plan->id);
+
+    struct ofp_planning_slot *slots = malloc(OFP_MAX_PLANNING_SLOT_COUNT * sizeof(struct ofp_planning_slot));
+    if (slots == NULL)
+    {
+        ESP_LOGW(TAG, "malloc failed");
+        return;
+    }
+
+    int count = ofp_planning_copy_slots(plan, slots);
+    ofp_planning_slots_write(plan->id, slots, count);
+    free(slots);
+}
+
 static bool ofp_planning_add_slot(struct ofp_planning *planning, struct ofp_planning_slot *slot)
 {
     assert(planning != NULL);
@@ -1021,7 +1318,8 @@ static struct ofp_planning_slot *ofp_planning_slot_find_by_values(struct ofp_pla
     return NULL;
 }
 
-bool ofp_planning_add_new_slot(int planning_id, enum ofp_day_of_week dow, int hour, int minute, enum ofp_order_id order_id)
+/* public planning mutators run their *_locked variant under the ofp lock */
+static bool ofp_planning_add_new_slot_locked(int planning_id, enum ofp_day_of_week dow, int hour, int minute, enum ofp_order_id order_id)
 {
     ESP_LOGD(TAG, "ofp_planning_add_new_slot planning_id %i dow %i hour %i minute %i order_id %i", planning_id, dow, hour, minute, order_id);
 
@@ -1032,6 +1330,9 @@ bool ofp_planning_add_new_slot(int planning_id, enum ofp_day_of_week dow, int ho
         return false;
     }
 
+    if (!ofp_transaction_backup_planning(plan))
+        return false;
+
     // duplicates
     struct ofp_planning_slot *slot = ofp_planning_slot_find_by_values(plan, dow, hour, minute);
     if (slot != NULL)
@@ -1061,6 +1362,16 @@ bool ofp_planning_add_new_slot(int planning_id, enum ofp_day_of_week dow, int ho
     return true;
 }
 
+bool ofp_planning_add_new_slot(int planning_id, enum ofp_day_of_week dow, int hour, int minute, enum ofp_order_id order_id)
+{
+    ofp_store_lock();
+    ofp_lock();
+    bool result = ofp_planning_add_new_slot_locked(planning_id, dow, hour, minute, order_id);
+    ofp_unlock();
+    ofp_store_unlock();
+    return result;
+}
+
 static bool ofp_planning_remove_slot(struct ofp_planning *plan, int slot_id)
 {
     assert(plan != NULL);
@@ -1103,7 +1414,7 @@ static bool ofp_planning_remove_slot(struct ofp_planning *plan, int slot_id)
     return true;
 }
 
-bool ofp_planning_remove_existing_slot(int planning_id, int slot_id)
+static bool ofp_planning_remove_existing_slot_locked(int planning_id, int slot_id)
 {
     ESP_LOGD(TAG, "ofp_planning_remove_slot planning %i slot %i", planning_id, slot_id);
 
@@ -1114,9 +1425,114 @@ bool ofp_planning_remove_existing_slot(int planning_id, int slot_id)
         return false;
     }
 
+    if (!ofp_transaction_backup_planning(plan))
+        return false;
+
     return ofp_planning_remove_slot(plan, slot_id);
 }
 
+bool ofp_planning_remove_existing_slot(int planning_id, int slot_id)
+{
+    ofp_store_lock();
+    ofp_lock();
+    bool result = ofp_planning_remove_existing_slot_locked(planning_id, slot_id);
+    ofp_unlock();
+    ofp_store_unlock();
+    return result;
+}
+
+/*
+ * Replaces all slots of a planning at once
+ *
+ * The new slots are fully validated before the planning is modified,
+ * and the planning must keep its first slot (sunday, midnight).
+ * Provided slot IDs are ignored, new ones are allocated.
+ */
+static bool ofp_planning_replace_slots_locked(int planning_id, const struct ofp_planning_slot *slots, int count)
+{
+    ESP_LOGD(TAG, "ofp_planning_replace_slots planning_id %i count %i", planning_id, count);
+
+    struct ofp_planning *plan = ofp_planning_list_find_planning_by_id(planning_id);
+    if (plan == NULL)
+    {
+        ESP_LOGW(TAG, "Could not find planning %i", planning_id);
+        return false;
+    }
+
+    if (count <= 0 || count > OFP_MAX_PLANNING_SLOT_COUNT)
+    {
+        ESP_LOGD(TAG, "Invalid slot count %i", count);
+        return false;
+    }
+
+    // validate
+    bool has_first = false;
+    for (int i = 0; i < count; i++)
+    {
+        const struct ofp_planning_slot *slot = &slots[i];
+        if (!ofp_day_of_week_is_valid(slot->dow) || slot->hour < 0 || slot->hour >= 24 || slot->minute < 0 || slot->minute >= 60 || !ofp_order_id_is_valid(slot->order_id))
+        {
+            ESP_LOGD(TAG, "Invalid slot %i", i);
+            return false;
+        }
+
+        if (slot->dow == OFP_DOW_SUNDAY /* 0 */ && slot->hour == 0 && slot->minute == 0)
+            has_first = true;
+
+        for (int j = 0; j < i; j++)
+        {
+            if (slots[j].dow == slot->dow && slots[j].hour == slot->hour && slots[j].minute == slot->minute)
+            {
+                ESP_LOGD(TAG, "Duplicate slots %i and %i", j, i);
+                return false;
+            }
+        }
+    }
+
+    if (!has_first)
+    {
+        ESP_LOGD(TAG, "Missing first slot");
+        return false;
+    }
+
+    if (!ofp_transaction_backup_planning(plan))
+        return false;
+
+    // replace
+    for (int i = 0; i < OFP_MAX_PLANNING_SLOT_COUNT; i++)
+    {
+        if (plan->slots[i] == NULL)
+            continue;
+        ofp_planning_slot_free(plan->slots[i]);
+        plan->slots[i] = NULL;
+    }
+
+    // stored slots are rewritten, so IDs can start over
+    plan->max_slot_id = -1;
+    for (int i = 0; i < count; i++)
+    {
+        const struct ofp_planning_slot *slot = &slots[i];
+        int slot_id = ofp_planning_get_next_slot_id(plan);
+        plan->slots[i] = ofp_planning_slot_init(slot_id, slot->dow, slot->hour, slot->minute, slot->order_id);
+    }
+
+    // store
+    if (!ofp_transaction_defer_planning(plan->id, true))
+        ofp_planning_slots_rewrite(plan);
+
+    return true;
+}
+
+bool ofp_planning_replace_slots(int planning_id, const struct ofp_planning_slot *slots, int count)
+{
+    ofp_store_lock();
+    ofp_lock();
+    bool result = ofp_planning_replace_slots_locked(planning_id, slots, count);
+    ofp_unlock();
+    ofp_store_unlock();
+    return result;
+}
+
 /*
  * IMPORTANT:
  *
@@ -1323,11 +1739,14 @@ static struct ofp_planning *ofp_planning_list_find_planning_by_description(const
     return NULL;
 }
 
-bool ofp_planning_list_add_new_planning(char *description)
+static bool ofp_planning_list_add_new_planning_locked(char *description)
 {
     assert(description != NULL);
     ESP_LOGD(TAG, "ofp_planning_list_add_new_planning desc %s", description);
 
+    // plannings list is not covered by transactions
+    assert(transaction_global == NULL);
+
     // TODO: strip and check length
 
     // check for duplicate description
@@ -1376,10 +1795,23 @@ bool ofp_planning_list_add_new_planning(char *description)
     return true;
 }
 
-bool ofp_planning_list_remove_planning(int planning_id)
+bool ofp_planning_list_add_new_planning(char *description)
+{
+    ofp_store_lock();
+    ofp_lock();
+    bool result = ofp_planning_list_add_new_planning_locked(description);
+    ofp_unlock();
+    ofp_store_unlock();
+    return result;
+}
+
+static bool ofp_planning_list_remove_planning_locked(int planning_id)
 {
     ESP_LOGD(TAG, "ofp_planning_list_remove_planning planning_id %i", planning_id);
 
+    // plannings list is not covered by transactions
+    assert(transaction_global == NULL);
+
     // search and prune
     struct ofp_planning *plan = NULL;
     for (int i = 0; i < OFP_MAX_PLANNING_COUNT; i++)
@@ -1426,7 +1858,17 @@ bool ofp_planning_list_remove_planning(int planning_id)
     return plan;
 }
 
-bool ofp_planning_change_description(int planning_id, char *description)
+bool ofp_planning_list_remove_planning(int planning_id)
+{
+    ofp_store_lock();
+    ofp_lock();
+    bool result = ofp_planning_list_remove_planning_locked(planning_id);
+    ofp_unlock();
+    ofp_store_unlock();
+    return result;
+}
+
+static bool ofp_planning_change_description_locked(int planning_id, char *description)
 {
     assert(description != NULL);
     ESP_LOGD(TAG, "ofp_planning_change_description planning_id %i description %s", planning_id, description);
@@ -1447,6 +1889,9 @@ bool ofp_planning_change_description(int planning_id, char *description)
         return false;
     }
 
+    if (!ofp_transaction_backup_planning(plan))
+        return false;
+
     if (plan->description != NULL)
         free(plan->description);
     plan->description = strdup(description);
@@ -1457,6 +1902,16 @@ bool ofp_planning_change_description(int planning_id, char *description)
     return true;
 }
 
+bool ofp_planning_change_description(int planning_id, char *description)
+{
+    ofp_store_lock();
+    ofp_lock();
+    bool result = ofp_planning_change_description_locked(planning_id, description);
+    ofp_unlock();
+    ofp_store_unlock();
+    return result;
+}
+
 static bool ofp_planning_slot_set_without_duplicates(struct ofp_planning *plan, struct ofp_planning_slot *slot, enum ofp_day_of_week dow, int hour, int minute, enum ofp_order_id order_id)
 {
     ESP_LOGD(TAG, "ofp_planning_slot_set_without_duplicates planning_id %i slot_id %i dow %i hour %i minute %i order_id %i", plan->id, slot->id, dow, hour, minute, order_id);
@@ -1467,7 +1922,7 @@ static bool ofp_planning_slot_set_without_duplicates(struct ofp_planning *plan,
     for (int i = 0; i < OFP_MAX_PLANNING_SLOT_COUNT; i++)
     {
         struct ofp_planning_slot *candidate = plan->slots[i];
-        if (candidate == NULL)
+        if (candidate == NULL || candidate == slot)
             continue;
         if (candidate->dow == dow && candidate->hour == hour && candidate->minute == minute)
         {
@@ -1484,7 +1939,7 @@ static bool ofp_planning_slot_set_without_duplicates(struct ofp_planning *plan,
     return true;
 }
 
-bool ofp_planning_slot_set_order(int planning_id, int slot_id, enum ofp_order_id order_id)
+static bool ofp_planning_slot_set_order_locked(int planning_id, int slot_id, enum ofp_order_id order_id)
 {
     ESP_LOGD(TAG, "ofp_planning_slot_set_order planning_id %i slot_id %i order_id %i", planning_id, slot_id, order_id);
 
@@ -1504,6 +1959,9 @@ bool ofp_planning_slot_set_order(int planning_id, int slot_id, enum ofp_order_id
         return false;
     }
 
+    if (!ofp_transaction_backup_planning(plan))
+        return false;
+
     if (slot->order_id == order_id)
     {
         ESP_LOGV(TAG, "order_id not changed");
@@ -1521,7 +1979,17 @@ bool ofp_planning_slot_set_order(int planning_id, int slot_id, enum ofp_order_id
     return true;
 }
 
-bool ofp_planning_slot_set_dow(int planning_id, int slot_id, enum ofp_day_of_week dow)
+bool ofp_planning_slot_set_order(int planning_id, int slot_id, enum ofp_order_id order_id)
+{
+    ofp_store_lock();
+    ofp_lock();
+    bool result = ofp_planning_slot_set_order_locked(planning_id, slot_id, order_id);
+    ofp_unlock();
+    ofp_store_unlock();
+    return result;
+}
+
+static bool ofp_planning_slot_set_dow_locked(int planning_id, int slot_id, enum ofp_day_of_week dow)
 {
     ESP_LOGD(TAG, "ofp_planning_slot_set_dow planning_id %i slot_id %i dow %i", planning_id, slot_id, dow);
 
@@ -1541,6 +2009,9 @@ bool ofp_planning_slot_set_dow(int planning_id, int slot_id, enum ofp_day_of_wee
         return false;
     }
 
+    if (!ofp_transaction_backup_planning(plan))
+        return false;
+
     if (slot->dow == dow)
     {
         ESP_LOGV(TAG, "dow not changed");
@@ -1564,7 +2035,17 @@ bool ofp_planning_slot_set_dow(int planning_id, int slot_id, enum ofp_day_of_wee
     return true;
 }
 
-bool ofp_planning_slot_set_hour(int planning_id, int slot_id, int hour)
+bool ofp_planning_slot_set_dow(int planning_id, int slot_id, enum ofp_day_of_week dow)
+{
+    ofp_store_lock();
+    ofp_lock();
+    bool result = ofp_planning_slot_set_dow_locked(planning_id, slot_id, dow);
+    ofp_unlock();
+    ofp_store_unlock();
+    return result;
+}
+
+static bool ofp_planning_slot_set_hour_locked(int planning_id, int slot_id, int hour)
 {
     ESP_LOGD(TAG, "ofp_planning_slot_set_hour planning_id %i slot_id %i hour %i", planning_id, slot_id, hour);
 
@@ -1584,6 +2065,9 @@ bool ofp_planning_slot_set_hour(int planning_id, int slot_id, int hour)
         return false;
     }
 
+    if (!ofp_transaction_backup_planning(plan))
+        return false;
+
     if (slot->hour == hour)
     {
         ESP_LOGV(TAG, "hour not changed");
@@ -1607,7 +2091,17 @@ bool ofp_planning_slot_set_hour(int planning_id, int slot_id, int hour)
     return true;
 }
 
-bool ofp_planning_slot_set_minute(int planning_id, int slot_id, int minute)
+bool ofp_planning_slot_set_hour(int planning_id, int slot_id, int hour)
+{
+    ofp_store_lock();
+    ofp_lock();
+    bool result = ofp_planning_slot_set_hour_locked(planning_id, slot_id, hour);
+    ofp_unlock();
+    ofp_store_unlock();
+    return result;
+}
+
+static bool ofp_planning_slot_set_minute_locked(int planning_id, int slot_id, int minute)
 {
     ESP_LOGD(TAG, "ofp_planning_slot_set_minute planning_id %i slot_id %i minute %i", planning_id, slot_id, minute);
 
@@ -1627,6 +2121,9 @@ bool ofp_planning_slot_set_minute(int planning_id, int slot_id, int minute)
         return false;
     }
 
+    if (!ofp_transaction_backup_planning(plan))
+        return false;
+
     if (slot->minute == minute)
     {
         ESP_LOGV(TAG, "minute not changed");
@@ -1650,6 +2147,375 @@ bool ofp_planning_slot_set_minute(int planning_id, int slot_id, int minute)
     return true;
 }
 
+bool ofp_planning_slot_set_minute(int planning_id, int slot_id, int minute)
+{
+    ofp_store_lock();
+    ofp_lock();
+    bool result = ofp_planning_slot_set_minute_locked(planning_id, slot_id, minute);
+    ofp_unlock();
+    ofp_store_unlock();
+    return result;
+}
+
+/* transaction functions */
+
+static int ofp_planning_list_get_index(struct ofp_planning *plan)
+{
+    for (int i = 0; i < OFP_MAX_PLANNING_COUNT; i++)
+        if (plan_list_global->plannings[i] == plan)
+            return i;
+    return -1;
+}
+
+/* true if the calling task owns the in-progress transaction */
+static bool ofp_transaction_owned(void)
+{
+    return transaction_global != NULL && transaction_global->owner == xTaskGetCurrentTaskHandle();
+}
+
+bool ofp_transaction_begin(void)
+{
+    ESP_LOGD(TAG, "ofp_transaction_begin");
+
+    // held until commit or rollback, other tasks wait for the end
+    ofp_store_lock();
+    ofp_lock();
+
+    // no nested transactions
+    assert(transaction_global == NULL);
+
+    // alloc and zero members
+    struct ofp_transaction *tr = calloc(1, sizeof(struct ofp_transaction));
+    if (tr == NULL)
+    {
+        ESP_LOGW(TAG, "calloc failed");
+        ofp_unlock();
+        ofp_store_unlock();
+        return false;
+    }
+    tr->owner = xTaskGetCurrentTaskHandle();
+
+    // zones are few and small, backup them all
+    if (hw_global != NULL && hw_global->zone_set.count > 0)
+    {
+        size_t size = hw_global->zone_set.count * sizeof(struct ofp_zone);
+        tr->zones_backup = malloc(size);
+        if (tr->zones_backup == NULL)
+        {
+            ESP_LOGW(TAG, "malloc failed");
+            free(tr);
+            ofp_unlock();
+            ofp_store_unlock();
+            return false;
+        }
+        memcpy(tr->zones_backup, hw_global->zone_set.zones, size);
+        tr->zone_count = hw_global->zone_set.count;
+    }
+
+    transaction_global = tr;
+    return true;
+}
+
+/* plannings are backed up only when first modified during the transaction */
+static bool ofp_transaction_backup_planning(struct ofp_planning *plan)
+{
+    assert(plan != NULL);
+
+    if (!ofp_transaction_owned())
+        return true;
+
+    int index = ofp_planning_list_get_index(plan);
+    assert(index >= 0);
+
+    if (transaction_global->plannings[index] != NULL)
+        return true;
+
+    ESP_LOGD(TAG, "ofp_transaction_backup_planning planning_id %i", plan->id);
+
+    struct ofp_transaction_planning *backup = calloc(1, sizeof(struct ofp_transaction_planning));
+    if (backup == NULL)
+    {
+        ESP_LOGW(TAG, "calloc failed");
+        return false;
+    }
+
+    backup->description = strdup(plan->description);
+    if (backup->description == NULL)
+    {
+        ESP_LOGW(TAG, "strdup failed");
+        free(backup);
+        return false;
+    }
+
+    backup->planning_id = plan->id;
+    backup->max_slot_id = plan->max_slot_id;
+    backup->slot_count = ofp_planning_copy_slots(plan, backup->slots);
+
+    transaction_global->plannings[index] = backup;
+    return true;
+}
+
+/* returns true if storage was deferred to the transaction commit */
+static bool ofp_transaction_defer_planning(int planning_id, bool slots)
+{
+    if (!ofp_transaction_owned())
+        return false;
+
+    struct ofp_planning *plan = ofp_planning_list_find_planning_by_id(planning_id);
+    assert(plan != NULL);
+
+    int index = ofp_planning_list_get_index(plan);
+    assert(index >= 0);
+
+    // mutators MUST backup the planning before storing it
+    struct ofp_transaction_planning *backup = transaction_global->plannings[index];
+    assert(backup != NULL);
+
+    if (slots)
+        backup->slots_dirty = true;
+    else
+        backup->description_dirty = true;
+
+    ESP_LOGV(TAG, "planning %i marked dirty (slots %i)", planning_id, slots);
+    return true;
+}
+
+/* ends the transaction, releasing the ofp lock taken at its beginning */
+static struct ofp_transaction *ofp_transaction_end(void)
+{
+    assert(ofp_transaction_owned());
+
+    struct ofp_transaction *tr = transaction_global;
+    transaction_global = NULL;
+    ofp_unlock();
+    return tr;
+}
+
+static void ofp_transaction_free(struct ofp_transaction *tr)
+{
+    for (int i = 0; i < OFP_MAX_PLANNING_COUNT; i++)
+    {
+        struct ofp_transaction_planning *backup = tr->plannings[i];
+        if (backup == NULL)
+            continue;
+        if (backup->description)
+            free(backup->description);
+        free(backup);
+    }
+
+    if (tr->zones_backup)
+        free(tr->zones_backup);
+
+    free(tr);
+}
+
+/* zones, a single handle per namespace */
+static bool ofp_transaction_store_zones(struct ofp_transaction *tr)
+{
+    nvs_handle_t h, h_power;
+    esp_err_t err = kv_try_open_ns(kv_get_ns_zone(), &h);
+    if (err != ESP_OK)
+    {
+        ESP_LOGW(TAG, "Could not open zones: %s", esp_err_to_name(err));
+        return false;
+    }
+    err = kv_try_open_ns(kv_get_ns_zone_power(), &h_power);
+    if (err != ESP_OK)
+    {
+        ESP_LOGW(TAG, "Could not open zone powers: %s", esp_err_to_name(err));
+        kv_close(h);
+        return false;
+    }
+
+    for (int i = 0; i < tr->zone_count && err == ESP_OK; i++)
+    {
+        if ((tr->zones_dirty & (1ULL << i)) == 0)
+            continue;
+
+        struct ofp_zone *zone = &tr->zones_backup[i];
+        char *buf = ofp_zone_build_value(zone);
+        if (buf == NULL)
+        {
+            err = ESP_ERR_NO_MEM;
+            break;
+        }
+        err = kv_try_set_str(h, zone->id, buf);
+        if (err == ESP_OK)
+            err = kv_try_set_u32(h_power, zone->id, zone->power);
+        free(buf);
+    }
+
+    if (err == ESP_OK)
+        err = kv_try_commit(h);
+    if (err == ESP_OK)
+        err = kv_try_commit(h_power);
+    kv_close(h);
+    kv_close(h_power);
+
+    if (err != ESP_OK)
+        ESP_LOGW(TAG, "Could not store zones: %s", esp_err_to_name(err));
+    return err == ESP_OK;
+}
+
+/* planning descriptions, in a single namespace */
+static bool ofp_transaction_store_descriptions(struct ofp_transaction *tr)
+{
+    nvs_handle_t h = 0;
+    bool opened = false;
+    esp_err_t err = ESP_OK;
+    for (int i = 0; i < OFP_MAX_PLANNING_COUNT && err == ESP_OK; i++)
+    {
+        struct ofp_transaction_planning *backup = tr->plannings[i];
+        if (backup == NULL || !backup->description_dirty)
+            continue;
+
+        if (!opened)
+        {
+            err = kv_try_open_ns(kv_get_ns_plan(), &h);
+            if (err != ESP_OK)
+                break;
+            opened = true;
+        }
+
+        char buf[OFP_MAX_LEN_INT32];
+        snprintf(buf, sizeof(buf), "%i", backup->planning_id);
+        err = kv_try_set_str(h, buf, backup->description);
+    }
+
+    if (opened)
+    {
+        if (err == ESP_OK)
+            err = kv_try_commit(h);
+        kv_close(h);
+    }
+
+    if (err != ESP_OK)
+        ESP_LOGW(TAG, "Could not store planning descriptions: %s", esp_err_to_name(err));
+    return err == ESP_OK;
+}
+
+bool ofp_transaction_commit(void)
+{
+    ESP_LOGD(TAG, "ofp_transaction_commit");
+    assert(ofp_transaction_owned());
+
+    struct ofp_transaction *tr = transaction_global;
+    bool result = true;
+
+    // backups are not needed anymore, what must be stored is copied in their place
+    for (int i = 0; i < tr->zone_count; i++)
+    {
+        if ((tr->zones_dirty & (1ULL << i)) != 0)
+            tr->zones_backup[i] = hw_global->zone_set.zones[i];
+    }
+
+    for (int i = 0; i < OFP_MAX_PLANNING_COUNT; i++)
+    {
+        struct ofp_transaction_planning *backup = tr->plannings[i];
+        if (backup == NULL)
+            continue;
+
+        struct ofp_planning *plan = plan_list_global->plannings[i];
+        if (backup->description_dirty)
+        {
+            free(backup->description);
+            backup->description = strdup(plan->description);
+            if (backup->description == NULL)
+            {
+                ESP_LOGW(TAG, "strdup failed");
+                backup->description_dirty = false;
+                result = false;
+            }
+        }
+        if (backup->slots_dirty)
+            backup->slot_count = ofp_planning_copy_slots(plan, backup->slots);
+    }
+
+    // written without the ofp lock, the store lock keeps other writers waiting
+    ofp_transaction_end();
+
+    if (tr->zones_dirty != 0 && !ofp_transaction_store_zones(tr))
+        result = false;
+
+    if (!ofp_transaction_store_descriptions(tr))
+        result = false;
+
+    // slots, one namespace per planning
+    for (int i = 0; i < OFP_MAX_PLANNING_COUNT; i++)
+    {
+        struct ofp_transaction_planning *backup = tr->plannings[i];
+        if (backup == NULL || !backup->slots_dirty)
+            continue;
+
+        if (!ofp_planning_slots_write(backup->planning_id, backup->slots, backup->slot_count))
+            result = false;
+    }
+
+    ofp_transaction_free(tr);
+    ofp_store_unlock();
+    return result;
+}
+
+void ofp_transaction_rollback(void)
+{
+    ESP_LOGD(TAG, "ofp_transaction_rollback");
+    assert(ofp_transaction_owned());
+
+    // zones, only their settings : current orders and load shedding are runtime state
+    for (int i = 0; i < transaction_global->zone_count; i++)
+    {
+        struct ofp_zone *zone = &hw_global->zone_set.zones[i];
+        const struct ofp_zone *backup = &transaction_global->zones_backup[i];
+        strcpy(zone->description, backup->description);
+        zone->mode = backup->mode;
+        zone->mode_data = backup->mode_data;
+        zone->power = backup->power;
+    }
+
+    // plannings
+    for (int i = 0; i < OFP_MAX_PLANNING_COUNT; i++)
+    {
+        struct ofp_transaction_planning *backup = transaction_global->plannings[i];
+        if (backup == NULL)
+            continue;
+
+        struct ofp_planning *plan = plan_list_global->plannings[i];
+        ESP_LOGV(TAG, "restoring planning %i", plan->id);
+
+        // take ownership of the backup description
+        if (plan->description)
+            free(plan->description);
+        plan->description = backup->description;
+        backup->description = NULL;
+
+        for (int j = 0; j < OFP_MAX_PLANNING_SLOT_COUNT; j++)
+        {
+            if (plan->slots[j] == NULL)
+                continue;
+            ofp_planning_slot_free(plan->slots[j]);
+            plan->slots[j] = NULL;
+        }
+
+        int restored = 0;
+        for (int j = 0; j < backup->slot_count; j++)
+        {
+            struct ofp_planning_slot *b = &backup->slots[j];
+            struct ofp_planning_slot *slot = ofp_planning_slot_init(b->id, b->dow, b->hour, b->minute, b->order_id);
+            if (slot == NULL)
+            {
+                // storage was untouched, the slot comes back on next boot
+                ESP_LOGW(TAG, "Could not restore slot %i of planning %i", b->id, plan->id);
+                continue;
+            }
+            plan->slots[restored++] = slot;
+        }
+        plan->max_slot_id = backup->max_slot_id;
+    }
+
+    ofp_transaction_free(ofp_transaction_end());
+    ofp_store_unlock();
+}
+
 /* account functions */
 
 static bool ofp_account_store(struct ofp_account *account)
@@ -1974,7 +2840,11 @@ bool ofp_account_list_reset_password_account(const char *username, const char *n
 
 /* gpio pin functions */
 
-static void ofp_pin_setup_no_pull(uint8_t pin, gpio_mode_t mode)
+/* pin changes are recorded there while not NULL, with the cycle count at start */
+static struct vcd_capture *pin_capture = NULL;
+static uint32_t pin_capture_start = 0;
+
+static bool ofp_pin_setup_no_pull(uint8_t pin, gpio_mode_t mode)
 {
     gpio_config_t io_conf = {0};
 
@@ -1985,25 +2855,47 @@ static void ofp_pin_setup_no_pull(uint8_t pin, gpio_mode_t mode)
 
     io_conf.pin_bit_mask = (1ULL << pin);
 
-    gpio_config(&io_conf);
+    esp_err_t err = gpio_config(&io_conf);
+    if (err != ESP_OK)
+    {
+        ESP_LOGW(TAG, "Could not setup pin %i: %s", pin, esp_err_to_name(err));
+        return false;
+    }
+    return true;
 }
 
-void ofp_pin_setup_output_no_pull(uint8_t pin)
+bool ofp_pin_setup_output_no_pull(uint8_t pin)
 {
-    ofp_pin_setup_no_pull(pin, GPIO_MODE_OUTPUT);
+    return ofp_pin_setup_no_pull(pin, GPIO_MODE_OUTPUT);
 }
 
-void ofp_pin_setup_input_no_pull(uint8_t pin)
+bool ofp_pin_setup_input_no_pull(uint8_t pin)
 {
-    ofp_pin_setup_no_pull(pin, GPIO_MODE_INPUT);
+    return ofp_pin_setup_no_pull(pin, GPIO_MODE_INPUT);
 }
 
 void ofp_pin_set_value_wait_1us(uint8_t pin, uint8_t value)
 {
     gpio_set_level(pin, value);
+    if (pin_capture != NULL)
+    {
+        uint32_t cycles = esp_cpu_get_ccount() - pin_capture_start;
+        vcd_capture_pin(pin_capture, pin, value, (uint64_t)cycles * 1000 / ets_get_cpu_frequency());
+    }
     ets_delay_us(1);
 }
 
+void ofp_pin_capture_start(struct vcd_capture *capture)
+{
+    pin_capture_start = esp_cpu_get_ccount();
+    pin_capture = capture;
+}
+
+void ofp_pin_capture_stop(void)
+{
+    pin_capture = NULL;
+}
+
 uint8_t ofp_pin_get_value(uint8_t pin)
 {
     return gpio_get_level(pin);
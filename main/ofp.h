@@ -2,9 +2,12 @@
 #define OFP_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <time.h>
 #include <utils.h>
 #include <lwip/inet.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
 
 /* limits */
 #define OFP_MAX_ACCOUNT_COUNT 16
@@ -91,6 +94,10 @@ struct ofp_zone
     enum ofp_zone_mode mode;
     union ofp_zone_mode_data mode_data;
     enum ofp_order_id current;
+    // heater power in watts, 0 if unknown
+    uint32_t power;
+    // forced offload by load shedding, whatever the mode and override
+    bool shed;
 };
 
 struct ofp_zone_set
@@ -103,7 +110,8 @@ struct ofp_zone_set
 
 struct ofp_hw; // forward declaration
 typedef bool (*ofp_hw_init_func)(struct ofp_hw *hw);
-typedef bool (*ofp_hw_apply_func)(struct ofp_hw *hw, struct tm *timeinfo);
+// orders holds one order per zone, pulses being sampled at wall_us (microseconds since epoch)
+typedef bool (*ofp_hw_apply_func)(struct ofp_hw *hw, const enum ofp_order_id *orders, int64_t wall_us);
 
 struct ofp_hw_hooks
 {
@@ -194,6 +202,31 @@ struct ofp_planning_list
     struct ofp_planning *plannings[OFP_MAX_PLANNING_COUNT];
 };
 
+/* transactions */
+
+struct ofp_transaction_planning
+{
+    int planning_id;
+    char *description;
+    int max_slot_id;
+    int slot_count;
+    struct ofp_planning_slot slots[OFP_MAX_PLANNING_SLOT_COUNT];
+    bool description_dirty;
+    bool slots_dirty;
+};
+
+struct ofp_transaction
+{
+    // only this task's mutations are deferred, others wait for the end
+    TaskHandle_t owner;
+    // zones (one dirty bit per zone index, see OFP_MAX_ZONE_COUNT)
+    int zone_count;
+    struct ofp_zone *zones_backup;
+    uint64_t zones_dirty;
+    // plannings (same index as in planning list, NULL if untouched)
+    struct ofp_transaction_planning *plannings[OFP_MAX_PLANNING_COUNT];
+};
+
 /* accounts */
 
 struct ofp_account
@@ -218,11 +251,21 @@ struct ofp_session_context
 /* day of week */
 bool ofp_day_of_week_is_valid(enum ofp_day_of_week dow);
 
-/* order accessors */
+/* order accessors, NULL if not found */
 const struct ofp_order_info *ofp_order_info_by_num_id(enum ofp_order_id order_id);
 const struct ofp_order_info *ofp_order_info_by_str_id(char *order_id);
 bool ofp_order_id_is_valid(enum ofp_order_id order_id);
 
+/*
+ * Zones, override and plannings are mutated from several tasks (web
+ * server, MQTT, linky, control loop) : every mutator takes this recursive
+ * lock, callers take it too around sequences which must appear atomic
+ * (ex: set the mode then store the zone). Created once before boot.
+ */
+void ofp_lock_init(void);
+void ofp_lock(void);
+void ofp_unlock(void);
+
 /* override */
 void ofp_override_load(void);
 void ofp_override_store(void);
@@ -244,16 +287,23 @@ struct ofp_hw *ofp_hw_list_find_hw_by_id(char *hw_id);
 struct ofp_hw_param *ofp_hw_param_find_by_id(struct ofp_hw *hw, const char *param_id);
 bool ofp_hw_param_set_value_string(struct ofp_hw_param *param, const char *str);
 
-/* order to opto driver */
-bool ofp_order_to_half_waves(enum ofp_order_id order_id, bool *positive_half, bool *negative_half, struct tm *timeinfo);
+/* order to opto driver, at a wall clock time in microseconds since epoch */
+bool ofp_order_to_half_waves(enum ofp_order_id order_id, bool *positive_half, bool *negative_half, int64_t wall_us);
+/* economy pulse length of extended orders, 0 for the others */
+int64_t ofp_order_pulse_length_us(enum ofp_order_id order_id);
 
 /* zone accessors */
 bool ofp_zone_set_id(struct ofp_zone *zone, const char *id);
 bool ofp_zone_set_description(struct ofp_zone *zone, const char *description);
 bool ofp_zone_set_mode_fixed(struct ofp_zone *zone, enum ofp_order_id order_id);
 bool ofp_zone_set_mode_planning(struct ofp_zone *zone, int planning_id);
+void ofp_zone_set_power(struct ofp_zone *zone, uint32_t power);
+/* stores the zone configuration and its heater power */
 bool ofp_zone_store(struct ofp_zone *zone);
+void ofp_zone_set_shed(struct ofp_zone *zone, bool shed);
 void ofp_zone_update_current_orders(struct ofp_hw *hw, struct tm *timeinfo);
+/* only computes the orders of the zones, plannings being looked up in plan_list */
+void ofp_zone_set_compute_orders(struct ofp_zone_set *zone_set, struct ofp_planning_list *plan_list, struct tm *timeinfo);
 
 /* allocate new space for zones set */
 bool ofp_zone_set_allocate(struct ofp_zone_set *zone_set, int zone_count);
@@ -268,16 +318,40 @@ void ofp_hw_initialize(void);
 void ofp_planning_list_init(void);
 struct ofp_planning_list *ofp_planning_list_get(void);
 struct ofp_planning *ofp_planning_list_find_planning_by_id(int planning_id);
+struct ofp_planning *ofp_planning_list_find_in(struct ofp_planning_list *plan_list, int planning_id);
 bool ofp_planning_list_add_new_planning(char *description);
 bool ofp_planning_list_remove_planning(int planning_id);
 bool ofp_planning_add_new_slot(int planning_id, enum ofp_day_of_week dow, int hour, int minute, enum ofp_order_id order_id);
 bool ofp_planning_remove_existing_slot(int planning_id, int slot_id);
+bool ofp_planning_replace_slots(int planning_id, const struct ofp_planning_slot *slots, int count);
 bool ofp_planning_change_description(int planning_id, char *description);
 bool ofp_planning_slot_set_dow(int planning_id, int slot_id, enum ofp_day_of_week dow);
 bool ofp_planning_slot_set_hour(int planning_id, int slot_id, int hour);
 bool ofp_planning_slot_set_minute(int planning_id, int slot_id, int minute);
 bool ofp_planning_slot_set_order(int planning_id, int slot_id, enum ofp_order_id order_id);
 
+/*
+ * transaction functions
+ *
+ * While a transaction is in progress, zone and planning mutators only
+ * update memory: storage is deferred until commit, which writes every
+ * modified item using a single handle and commit per namespace.
+ * Rollback restores the in-memory state as it was when the transaction began.
+ *
+ * Plannings cannot be created or removed while a transaction is in progress.
+ *
+ * The transaction holds the ofp lock from begin to commit or rollback, so
+ * that mutations from other tasks wait for its end instead of being mixed
+ * into it. Commit copies what must be stored and releases the ofp lock
+ * before writing, so that the control loop does not wait for the flash.
+ *
+ * Commit returns false if storage failed: the changes stay in memory, but
+ * may be partially stored.
+ */
+bool ofp_transaction_begin(void);
+bool ofp_transaction_commit(void);
+void ofp_transaction_rollback(void);
+
 /* account functions */
 struct ofp_account **ofp_account_list_get(void);
 struct ofp_account *ofp_account_list_find_account_by_id(const char *username);
@@ -287,9 +361,15 @@ bool ofp_account_list_remove_existing_account(const char *username);
 bool ofp_account_list_reset_password_account(const char *username, const char *new_cleartext);
 
 /* gpio functions */
-void ofp_pin_setup_output_no_pull(uint8_t pin);
-void ofp_pin_setup_input_no_pull(uint8_t pin);
+/* return false if the pin could not be configured */
+bool ofp_pin_setup_output_no_pull(uint8_t pin);
+bool ofp_pin_setup_input_no_pull(uint8_t pin);
 void ofp_pin_set_value_wait_1us(uint8_t pin, uint8_t value);
 uint8_t ofp_pin_get_value(uint8_t pin);
 
+/* records changes made with ofp_pin_set_value_wait_1us, MUST be called by the task driving the pins */
+struct vcd_capture; // forward declaration
+void ofp_pin_capture_start(struct vcd_capture *capture);
+void ofp_pin_capture_stop(void);
+
 #endif /* OFP_H */
@@ -0,0 +1,175 @@
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_cpu.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+
+#include "sdkconfig.h"
+
+#include "output.h"
+#include "pulse_timer.h"
+#include "trace.h"
+#include "top.h"
+
+static const char TAG[] = "output";
+
+#define OUTPUT_TASK_STACK_SIZE 3072
+
+// buffer index in the low bits of the shared slot, and whether it was not consumed yet
+#define OUTPUT_INDEX_MASK 0x3
+#define OUTPUT_FRESH 0x4
+
+/* triple buffer, each index being owned by a single side */
+static struct output_image buffers[3];
+static int back = 0;  // written by the producer
+static int front = 1; // read by the consumer
+static uint32_t middle = 2;
+
+/* truncated esp_timer time of the first pending request, 0 if none */
+static uint32_t requested_us = 0;
+
+static TaskHandle_t output_task_handle = NULL;
+
+/* probe of the next latch, given when done */
+static struct output_probe *pending_probe = NULL;
+static SemaphoreHandle_t probe_done = NULL;
+
+/* statistics */
+static struct output_stats stats = {0};
+
+/* mutex variables */
+portMUX_TYPE mutex_output_stats = portMUX_INITIALIZER_UNLOCKED;
+
+/***************************************************************************/
+
+static void output_request(void)
+{
+    uint32_t now = (uint32_t)esp_timer_get_time();
+    uint32_t none = 0;
+    // keep the oldest request
+    __atomic_compare_exchange_n(&requested_us, &none, now != 0 ? now : 1, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+
+    if (output_task_handle != NULL)
+        xTaskNotifyGive(output_task_handle);
+}
+
+static void output_task(void *pvParameters)
+{
+    struct ofp_hw *hw = pvParameters;
+    while (true)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        uint32_t requested = __atomic_exchange_n(&requested_us, 0, __ATOMIC_RELAXED);
+
+        // take the latest image, if any was published since last time
+        bool fresh = (__atomic_load_n(&middle, __ATOMIC_RELAXED) & OUTPUT_FRESH) != 0;
+        if (fresh)
+            front = __atomic_exchange_n(&middle, front, __ATOMIC_ACQ_REL) & OUTPUT_INDEX_MASK;
+
+        // nothing submitted yet
+        struct output_image *image = &buffers[front];
+        if (image->count != hw->zone_set.count)
+            continue;
+
+        struct output_probe *probe = __atomic_exchange_n(&pending_probe, NULL, __ATOMIC_ACQUIRE);
+        if (probe != NULL && probe->capture != NULL)
+            ofp_pin_capture_start(probe->capture);
+        uint32_t start = esp_cpu_get_ccount();
+
+        int64_t wall_us = pulse_timer_wall_clock_us();
+        TRACE_BEGIN(TRACE_SPAN_OUTPUT_APPLY);
+        hw->hw_hooks.apply(hw, image->orders, wall_us);
+        TRACE_END(TRACE_SPAN_OUTPUT_APPLY);
+
+        if (probe != NULL)
+        {
+            probe->cycles = esp_cpu_get_ccount() - start;
+            ofp_pin_capture_stop();
+            xSemaphoreGive(probe_done);
+        }
+
+        // follow the pulses of what was just latched
+        pulse_timer_schedule(image->orders, image->count, wall_us);
+        uint32_t latency = (requested == 0) ? 0 : (uint32_t)esp_timer_get_time() - requested;
+
+        taskENTER_CRITICAL(&mutex_output_stats);
+        if (fresh)
+            stats.images++;
+        stats.latches++;
+        histogram_add(&stats.latency, latency);
+        taskEXIT_CRITICAL(&mutex_output_stats);
+    }
+}
+
+/***************************************************************************/
+
+void output_start(void)
+{
+    struct ofp_hw *hw = ofp_hw_get_current();
+    if (hw == NULL)
+        return;
+
+    probe_done = xSemaphoreCreateBinary();
+    configASSERT(probe_done);
+
+    // core 1 does not run the wifi and network stacks
+    TaskHandle_t xHandle = NULL;
+    top_register_stack("output", OUTPUT_TASK_STACK_SIZE);
+    xTaskCreatePinnedToCore(output_task, "output", OUTPUT_TASK_STACK_SIZE, hw, CONFIG_OFP_OUTPUT_TASK_PRIORITY, &xHandle, 1);
+    configASSERT(xHandle);
+    output_task_handle = xHandle;
+    ESP_LOGI(TAG, "Output task started with priority %i", CONFIG_OFP_OUTPUT_TASK_PRIORITY);
+}
+
+void output_submit(struct ofp_hw *hw)
+{
+    assert(hw != NULL);
+
+    struct output_image *image = &buffers[back];
+    image->count = hw->zone_set.count;
+    for (int i = 0; i < hw->zone_set.count; i++)
+        image->orders[i] = hw->zone_set.zones[i].current;
+
+    // publish, and get the previous slot back to write the next image
+    back = __atomic_exchange_n(&middle, back | OUTPUT_FRESH, __ATOMIC_ACQ_REL) & OUTPUT_INDEX_MASK;
+    output_request();
+}
+
+void output_request_latch(void)
+{
+    output_request();
+}
+
+bool output_probe(struct output_probe *probe, TickType_t timeout)
+{
+    assert(probe != NULL);
+
+    if (output_task_handle == NULL)
+        return false;
+
+    // only one probe at a time
+    struct output_probe *none = NULL;
+    if (!__atomic_compare_exchange_n(&pending_probe, &none, probe, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+        return false;
+
+    output_request();
+    if (xSemaphoreTake(probe_done, timeout) == pdTRUE)
+        return true;
+
+    // withdraw it, unless the latch started meanwhile
+    none = probe;
+    if (__atomic_compare_exchange_n(&pending_probe, &none, NULL, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        return false;
+    xSemaphoreTake(probe_done, portMAX_DELAY);
+    return true;
+}
+
+void output_get_stats(struct output_stats *out)
+{
+    assert(out != NULL);
+
+    taskENTER_CRITICAL(&mutex_output_stats);
+    *out = stats;
+    taskEXIT_CRITICAL(&mutex_output_stats);
+}
\ No newline at end of file
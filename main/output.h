@@ -0,0 +1,65 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <stdint.h>
+
+#include <freertos/FreeRTOS.h>
+
+#include "ofp.h"
+#include "histogram.h"
+#include "vcd.h"
+
+/*
+ * Output stage
+ *
+ * Orders are computed by the main loop, then handed as an image to a
+ * dedicated high priority task pinned to core 1, which is the only one to
+ * latch outputs. The handoff is a lock-free triple buffer : the producer
+ * always has a buffer to write, and the consumer always gets the latest
+ * complete image, none of them ever waiting for the other.
+ *
+ * The pulse timer is armed again by that task, after every latch.
+ *
+ * Latency is measured from the first pending request (image submitted or
+ * pulse edge) to the end of the latch. Its worst case under HTTPS load has
+ * not been measured yet : the histogram given by /ofp-api/v1/status, read
+ * while TLS handshakes are running, is the way to get it.
+ */
+
+struct output_image
+{
+    int count;
+    enum ofp_order_id orders[OFP_MAX_ZONE_COUNT];
+};
+
+struct output_stats
+{
+    uint32_t images;
+    uint32_t latches;
+    struct histogram latency;
+};
+
+/* hardware MUST have been initialized */
+void output_start(void);
+
+/* snapshots the current orders of the zones, MUST only be called from the main loop */
+void output_submit(struct ofp_hw *hw);
+
+/* latches the latest image again, for example on pulse edges */
+void output_request_latch(void);
+
+/* observes the next latch */
+struct output_probe
+{
+    // pin changes are recorded there, if not NULL
+    struct vcd_capture *capture;
+    // CPU cycles spent in the apply hook
+    uint32_t cycles;
+};
+
+/* returns false if the next latch did not happen in time */
+bool output_probe(struct output_probe *probe, TickType_t timeout);
+
+void output_get_stats(struct output_stats *stats);
+
+#endif /* OUTPUT_H */
\ No newline at end of file
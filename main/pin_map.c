@@ -0,0 +1,49 @@
+#include <stddef.h>
+
+#include "pin_map.h"
+
+bool pin_map_parse(const char *str, uint8_t *pins, int max, int *count)
+{
+    if (str == NULL || pins == NULL || count == NULL)
+        return false;
+
+    int n = 0;
+    uint32_t used = 0;
+    const char *p = str;
+    while (*p != '\0')
+    {
+        // number
+        if (*p < '0' || *p > '9')
+            return false;
+        int pin = 0;
+        while (*p >= '0' && *p <= '9')
+        {
+            pin = pin * 10 + (*p - '0');
+            if (pin >= PIN_MAP_MAX_PINS)
+                return false;
+            p++;
+        }
+
+        if ((PIN_MAP_OUTPUT_PINS & (1u << pin)) == 0 || (used & (1u << pin)) != 0 || n >= max)
+            return false;
+        used |= (1u << pin);
+        pins[n++] = pin;
+
+        // separator, not trailing
+        if (*p == ',' && *(p + 1) != '\0')
+            p++;
+        else if (*p != '\0')
+            return false;
+    }
+
+    *count = n;
+    return true;
+}
+
+uint32_t pin_map_mask(const uint8_t *pins, int count)
+{
+    uint32_t mask = 0;
+    for (int i = 0; i < count; i++)
+        mask |= (1u << pins[i]);
+    return mask;
+}
\ No newline at end of file
@@ -0,0 +1,28 @@
+#ifndef PIN_MAP_H
+#define PIN_MAP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Pin lists of direct-drive hardware
+ *
+ * Pins are given as a comma separated list of GPIO numbers ("25,26,27"),
+ * one per zone, and must all be driven by the first GPIO output register,
+ * so that a single write changes them at once.
+ *
+ * This file does not depend on ESP-IDF, so that it can be built on a host.
+ */
+
+#define PIN_MAP_MAX_PINS 32
+
+// GPIO 0, 2, 4, 5, 12 to 19, 21 to 23 and 25 to 27 : 1 and 3 are the console UART, 6 to 11 the SPI flash, others do not exist or are inputs only
+#define PIN_MAP_OUTPUT_PINS ((1u << 0) | (1u << 2) | (1u << 4) | (1u << 5) | (0xFFu << 12) | (0x7u << 21) | (0x7u << 25))
+
+/* returns false if the list is malformed, or has unusable or duplicate pins (empty means no pin) */
+bool pin_map_parse(const char *str, uint8_t *pins, int max, int *count);
+
+/* bit mask of the pins */
+uint32_t pin_map_mask(const uint8_t *pins, int count);
+
+#endif /* PIN_MAP_H */
\ No newline at end of file
@@ -0,0 +1,38 @@
+#include <stddef.h>
+
+#include "pulse.h"
+
+bool pulse_level_at(int64_t length_us, int64_t wall_us, int64_t *next_edge_us)
+{
+    // constant levels
+    if (length_us <= 0 || length_us >= PULSE_PERIOD_US)
+    {
+        if (next_edge_us != NULL)
+            *next_edge_us = 0;
+        return length_us > 0;
+    }
+
+    // position in the current period, even before the epoch
+    int64_t offset = wall_us % PULSE_PERIOD_US;
+    if (offset < 0)
+        offset += PULSE_PERIOD_US;
+    int64_t start = wall_us - offset;
+
+    bool level = offset < length_us;
+    if (next_edge_us != NULL)
+        *next_edge_us = level ? start + length_us : start + PULSE_PERIOD_US;
+    return level;
+}
+
+int64_t pulse_next_edge(const int64_t *lengths_us, int count, int64_t wall_us)
+{
+    int64_t earliest = 0;
+    for (int i = 0; i < count; i++)
+    {
+        int64_t edge;
+        pulse_level_at(lengths_us[i], wall_us, &edge);
+        if (edge != 0 && (earliest == 0 || edge < earliest))
+            earliest = edge;
+    }
+    return earliest;
+}
\ No newline at end of file
@@ -0,0 +1,35 @@
+#ifndef PULSE_H
+#define PULSE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Pulse schedule of the extended orders
+ *
+ * Heaters understand cozy-1 and cozy-2 as economy pulses of 3 and 7 seconds,
+ * repeated every 5 minutes. Instead of sampling the level once per control
+ * loop iteration (pulse widths would then be quantized to the loop period,
+ * and stretched or dropped by its jitter), the level is computed from a wall
+ * clock in microseconds, along with the time of the next edge, so that a
+ * timer can be armed exactly there.
+ *
+ * Pulses start on every 5 minutes boundary since the epoch, which are local
+ * time boundaries as well (time zone offsets are multiples of 5 minutes).
+ *
+ * This file does not depend on ESP-IDF, so that it can be built on a host
+ * and driven by a virtual clock.
+ */
+
+#define PULSE_PERIOD_US (5 * 60 * 1000000LL)
+
+/*
+ * Level of a pulse of length_us at wall_us (microseconds since epoch), and
+ * wall clock time of its next edge (0 if the level never changes)
+ */
+bool pulse_level_at(int64_t length_us, int64_t wall_us, int64_t *next_edge_us);
+
+/* earliest next edge of several pulses, 0 if none of them ever changes */
+int64_t pulse_next_edge(const int64_t *lengths_us, int count, int64_t wall_us);
+
+#endif /* PULSE_H */
\ No newline at end of file
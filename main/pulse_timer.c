@@ -0,0 +1,119 @@
+#include <sys/time.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "pulse.h"
+#include "pulse_timer.h"
+
+static const char TAG[] = "pulse";
+
+/* global variables */
+static esp_timer_handle_t timer = NULL;
+static pulse_timer_edge_callback edge_callback = NULL;
+// set by the timer, consumed by the next schedule
+static bool edge_fired = false;
+
+/* only accessed by the task latching the outputs */
+// wall clock time of the armed edge, 0 if not armed
+static int64_t armed_edge_us = 0;
+
+/* statistics */
+static struct pulse_timer_stats stats = {0};
+
+/* mutex variables */
+portMUX_TYPE mutex_pulse_timer_stats = portMUX_INITIALIZER_UNLOCKED;
+
+/***************************************************************************/
+
+static void pulse_timer_arm(int64_t edge_us, int64_t now_us)
+{
+    if (edge_us == armed_edge_us)
+        return;
+
+    esp_timer_stop(timer);
+    armed_edge_us = edge_us;
+    if (edge_us == 0)
+        return;
+
+    ESP_ERROR_CHECK(esp_timer_start_once(timer, edge_us > now_us ? edge_us - now_us : 0));
+}
+
+/* runs on the esp_timer task, which MUST never block */
+static void pulse_timer_fire(void *arg)
+{
+    __atomic_store_n(&edge_fired, true, __ATOMIC_RELEASE);
+    edge_callback();
+}
+
+/***************************************************************************/
+
+void pulse_timer_start(pulse_timer_edge_callback callback)
+{
+    assert(callback != NULL);
+
+    esp_timer_handle_t handle = NULL;
+    const esp_timer_create_args_t args = {
+        .callback = pulse_timer_fire,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "pulse",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&args, &handle));
+    edge_callback = callback;
+
+    // scheduling is ignored until the timer exists
+    __atomic_store_n(&timer, handle, __ATOMIC_RELEASE);
+    ESP_LOGD(TAG, "Pulse timer created");
+}
+
+void pulse_timer_schedule(const enum ofp_order_id *orders, int count, int64_t now_us)
+{
+    assert(orders != NULL);
+    assert(count <= OFP_MAX_ZONE_COUNT);
+
+    if (__atomic_load_n(&timer, __ATOMIC_ACQUIRE) == NULL)
+        return;
+
+    // a fired timer is no longer armed, even if the wall clock has not reached
+    // the edge yet (drift against the timer clock, or clock set back) : the
+    // same edge must then be armed again below
+    if (__atomic_exchange_n(&edge_fired, false, __ATOMIC_ACQUIRE) && armed_edge_us != 0)
+    {
+        int64_t edge_us = armed_edge_us;
+        armed_edge_us = 0;
+
+        if (now_us >= edge_us)
+        {
+            uint32_t error_us = now_us - edge_us;
+
+            taskENTER_CRITICAL(&mutex_pulse_timer_stats);
+            stats.edges++;
+            stats.last_error_us = error_us;
+            if (error_us > stats.max_error_us)
+                stats.max_error_us = error_us;
+            taskEXIT_CRITICAL(&mutex_pulse_timer_stats);
+        }
+    }
+
+    int64_t lengths_us[OFP_MAX_ZONE_COUNT];
+    for (int i = 0; i < count; i++)
+        lengths_us[i] = ofp_order_pulse_length_us(orders[i]);
+    pulse_timer_arm(pulse_next_edge(lengths_us, count, now_us), now_us);
+}
+
+int64_t pulse_timer_wall_clock_us(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000000LL + tv.tv_usec;
+}
+
+void pulse_timer_get_stats(struct pulse_timer_stats *out)
+{
+    assert(out != NULL);
+
+    taskENTER_CRITICAL(&mutex_pulse_timer_stats);
+    *out = stats;
+    taskEXIT_CRITICAL(&mutex_pulse_timer_stats);
+}
\ No newline at end of file
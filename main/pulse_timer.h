@@ -0,0 +1,41 @@
+#ifndef PULSE_TIMER_H
+#define PULSE_TIMER_H
+
+#include <stdint.h>
+
+#include "ofp.h"
+
+/*
+ * Edges of the extended orders pulses
+ *
+ * A one-shot esp_timer is armed on the next edge of every zone with an
+ * extended order, and wakes the task latching the outputs right there,
+ * instead of waiting for the next control loop iteration. That task then
+ * arms the timer again, the timer callback itself never blocks.
+ */
+
+/* called from the esp_timer task, on every edge, MUST NOT block */
+typedef void (*pulse_timer_edge_callback)(void);
+
+struct pulse_timer_stats
+{
+    uint32_t edges;
+    // between the scheduled edge and the callback, in microseconds
+    uint32_t last_error_us;
+    uint32_t max_error_us;
+};
+
+void pulse_timer_start(pulse_timer_edge_callback callback);
+
+/*
+ * (re)arms the timer on the next edge of the latched orders, MUST only be
+ * called from the task latching the outputs, after every latch
+ */
+void pulse_timer_schedule(const enum ofp_order_id *orders, int count, int64_t now_us);
+
+/* microseconds since epoch */
+int64_t pulse_timer_wall_clock_us(void);
+
+void pulse_timer_get_stats(struct pulse_timer_stats *stats);
+
+#endif /* PULSE_TIMER_H */
\ No newline at end of file
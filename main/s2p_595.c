@@ -1,17 +1,52 @@
+#include <stddef.h>
+#include <string.h>
+#include <esp_attr.h>
+#include <esp_log.h>
+#include <esp_system.h>
+#include <esp_timer.h>
+#include <esp_rom_crc.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "sdkconfig.h"
+
 #include "ofp.h"
 #include "s2p_595.h"
 
 #include <driver/gpio.h>
 
-void s2p_595_setup(struct s2p_595 *s2p)
+static const char TAG[] = "s2p_595";
+
+#define S2P_595_IMAGE_MAGIC 0x4F465036 // "OFP6"
+
+/* last latched image, not initialized on reset */
+struct s2p_595_image
+{
+    uint32_t magic;
+    time_t timestamp;
+    int bit_count;
+    uint8_t bits[S2P_595_IMAGE_MAX_BYTES];
+    uint32_t checksum;
+};
+
+static RTC_NOINIT_ATTR struct s2p_595_image rtc_image;
+
+/* statistics */
+static struct s2p_595_restore_stats restore_stats = {0};
+
+/* mutex variables */
+portMUX_TYPE mutex_s2p_595_restore_stats = portMUX_INITIALIZER_UNLOCKED;
+
+bool s2p_595_setup(struct s2p_595 *s2p)
 {
     assert(s2p != NULL);
 
-    ofp_pin_setup_output_no_pull(s2p->pin_serial_in);
-    ofp_pin_setup_output_no_pull(s2p->pin_shift_clock);
-    ofp_pin_setup_output_no_pull(s2p->pin_latch_clock);
-    ofp_pin_setup_output_no_pull(s2p->pin_reset);
-    ofp_pin_setup_output_no_pull(s2p->pin_output_enable);
+    if (!ofp_pin_setup_output_no_pull(s2p->pin_serial_in) ||
+        !ofp_pin_setup_output_no_pull(s2p->pin_shift_clock) ||
+        !ofp_pin_setup_output_no_pull(s2p->pin_latch_clock) ||
+        !ofp_pin_setup_output_no_pull(s2p->pin_reset) ||
+        !ofp_pin_setup_output_no_pull(s2p->pin_output_enable))
+        return false;
 
     // disable output while setting up
     s2p_595_disable_output(s2p);
@@ -24,20 +59,29 @@ void s2p_595_setup(struct s2p_595 *s2p)
     // reset shift registers
     s2p_595_reset(s2p);
 
-    // snapshot reset'ed registers
-    s2p_595_latch_edge(s2p);
-
-    // enable output
-    s2p_595_enable_output(s2p);
+    // nothing latched : outputs stay disabled until a restored or computed image is
+    return true;
 }
 
 void s2p_595_set_input(struct s2p_595 *s2p, int input)
 {
+    s2p->input = input ? 1 : 0;
     ofp_pin_set_value_wait_1us(s2p->pin_serial_in, input);
 }
 
 void s2p_595_shift_edge(struct s2p_595 *s2p)
 {
+    // track shifted bits, ignoring those which do not fit
+    if (s2p->bit_count < S2P_595_IMAGE_MAX_BYTES * 8)
+    {
+        int byte = s2p->bit_count / 8, bit = s2p->bit_count % 8;
+        if (s2p->input)
+            s2p->bits[byte] |= (1 << bit);
+        else
+            s2p->bits[byte] &= ~(1 << bit);
+    }
+    s2p->bit_count++;
+
     ofp_pin_set_value_wait_1us(s2p->pin_shift_clock, 0);
     ofp_pin_set_value_wait_1us(s2p->pin_shift_clock, 1); // trigger on rising edge
     ofp_pin_set_value_wait_1us(s2p->pin_shift_clock, 0);
@@ -52,16 +96,155 @@ void s2p_595_latch_edge(struct s2p_595 *s2p)
 
 void s2p_595_reset(struct s2p_595 *s2p)
 {
+    s2p->bit_count = 0;
     ofp_pin_set_value_wait_1us(s2p->pin_reset, 0); // active low
     ofp_pin_set_value_wait_1us(s2p->pin_reset, 1);
 }
 
 void s2p_595_disable_output(struct s2p_595 *s2p)
 {
+    s2p->output_enabled = false;
     ofp_pin_set_value_wait_1us(s2p->pin_output_enable, 1);
 }
 
 void s2p_595_enable_output(struct s2p_595 *s2p)
 {
+    s2p->output_enabled = true;
     ofp_pin_set_value_wait_1us(s2p->pin_output_enable, 0);
 }
+
+/***************************************************************************/
+
+static uint32_t s2p_595_image_checksum(const struct s2p_595_image *image)
+{
+    return esp_rom_crc32_le(0, (const uint8_t *)image, offsetof(struct s2p_595_image, checksum));
+}
+
+#ifdef CONFIG_OFP_WARM_RESTORE
+static bool s2p_595_warm_reset(esp_reset_reason_t reason)
+{
+    switch (reason)
+    {
+    case ESP_RST_SW:
+    case ESP_RST_PANIC:
+    case ESP_RST_INT_WDT:
+    case ESP_RST_TASK_WDT:
+    case ESP_RST_WDT:
+        return true;
+    default:
+        return false;
+    }
+}
+#endif /* CONFIG_OFP_WARM_RESTORE */
+
+/* to be called after each latch of a complete image */
+void s2p_595_persist(struct s2p_595 *s2p)
+{
+    assert(s2p != NULL);
+
+    if (s2p->bit_count > S2P_595_IMAGE_MAX_BYTES * 8)
+    {
+        // do not restore a partial image
+        rtc_image.magic = 0;
+        return;
+    }
+
+    rtc_image.magic = S2P_595_IMAGE_MAGIC;
+    time(&rtc_image.timestamp);
+    rtc_image.bit_count = s2p->bit_count;
+    memcpy(rtc_image.bits, s2p->bits, sizeof(rtc_image.bits));
+    rtc_image.checksum = s2p_595_image_checksum(&rtc_image);
+
+    if (restore_stats.first_persist_us == 0)
+    {
+        int64_t now = esp_timer_get_time();
+
+        taskENTER_CRITICAL(&mutex_s2p_595_restore_stats);
+        restore_stats.first_persist_us = now;
+        taskEXIT_CRITICAL(&mutex_s2p_595_restore_stats);
+
+        ESP_LOGI(TAG, "First image latched %lli us after boot", now);
+    }
+}
+
+/* to be called before storing another hardware configuration */
+void s2p_595_forget(void)
+{
+    rtc_image.magic = 0;
+}
+
+/* to be called after s2p_595_setup, returns true if the previous image was latched again */
+bool s2p_595_restore(struct s2p_595 *s2p)
+{
+    assert(s2p != NULL);
+
+    esp_reset_reason_t reason = esp_reset_reason();
+
+    taskENTER_CRITICAL(&mutex_s2p_595_restore_stats);
+    restore_stats.reset_reason = reason;
+    taskEXIT_CRITICAL(&mutex_s2p_595_restore_stats);
+
+#ifdef CONFIG_OFP_WARM_RESTORE
+    // content is random after a power-on
+    if (!s2p_595_warm_reset(reason))
+    {
+        ESP_LOGD(TAG, "No warm reset (reason %i), not restoring", reason);
+        return false;
+    }
+
+    if (rtc_image.magic != S2P_595_IMAGE_MAGIC || rtc_image.checksum != s2p_595_image_checksum(&rtc_image))
+    {
+        ESP_LOGW(TAG, "No valid image to restore");
+        return false;
+    }
+
+    // only complete images are persisted
+    if (rtc_image.bit_count < 0 || rtc_image.bit_count > S2P_595_IMAGE_MAX_BYTES * 8)
+    {
+        ESP_LOGW(TAG, "Image has %i bits, not restoring", rtc_image.bit_count);
+        return false;
+    }
+
+    time_t now;
+    time(&now);
+    time_t age = now - rtc_image.timestamp;
+    if (age < 0 || age > CONFIG_OFP_WARM_RESTORE_MAX_AGE)
+    {
+        ESP_LOGW(TAG, "Image is %li seconds old, not restoring", age);
+        return false;
+    }
+
+    // replay shifts in the same order
+    s2p_595_reset(s2p);
+    for (int i = 0; i < rtc_image.bit_count; i++)
+    {
+        s2p_595_set_input(s2p, (rtc_image.bits[i / 8] >> (i % 8)) & 1);
+        s2p_595_shift_edge(s2p);
+    }
+    s2p_595_latch_edge(s2p);
+    s2p_595_enable_output(s2p);
+
+    int64_t elapsed = esp_timer_get_time();
+
+    taskENTER_CRITICAL(&mutex_s2p_595_restore_stats);
+    restore_stats.restored = true;
+    restore_stats.bit_count = rtc_image.bit_count;
+    restore_stats.image_age = age;
+    restore_stats.restore_us = elapsed;
+    taskEXIT_CRITICAL(&mutex_s2p_595_restore_stats);
+
+    ESP_LOGI(TAG, "Restored %i bits image from %li seconds ago, %lli us after boot", rtc_image.bit_count, age, elapsed);
+    return true;
+#else
+    return false;
+#endif /* CONFIG_OFP_WARM_RESTORE */
+}
+
+void s2p_595_get_restore_stats(struct s2p_595_restore_stats *stats)
+{
+    assert(stats != NULL);
+
+    taskENTER_CRITICAL(&mutex_s2p_595_restore_stats);
+    *stats = restore_stats;
+    taskEXIT_CRITICAL(&mutex_s2p_595_restore_stats);
+}
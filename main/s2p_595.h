@@ -1,7 +1,12 @@
 #ifndef S2P_595
 #define S2P_595
 
+#include <stdbool.h>
 #include <stdint.h>
+#include <time.h>
+
+// 32 chained 595, ie. 128 fil-pilote zones
+#define S2P_595_IMAGE_MAX_BYTES 32
 
 struct s2p_595
 {
@@ -10,9 +15,26 @@ struct s2p_595
     uint8_t pin_latch_clock;   // latch clock (rising)
     uint8_t pin_reset;         // reset (active low)
     uint8_t pin_output_enable; // output enable (active low)
+    bool output_enabled;
+    // bits shifted since last reset, in shift order
+    uint8_t input;
+    int bit_count;
+    uint8_t bits[S2P_595_IMAGE_MAX_BYTES];
 };
 
-void s2p_595_setup(struct s2p_595 *s2p);
+struct s2p_595_restore_stats
+{
+    int reset_reason;
+    bool restored;
+    int bit_count;
+    time_t image_age;
+    // microseconds since boot
+    int64_t restore_us;
+    int64_t first_persist_us;
+};
+
+/* returns false if the pins could not be configured, outputs are left disabled */
+bool s2p_595_setup(struct s2p_595 *s2p);
 
 void s2p_595_set_input(struct s2p_595 *s2p, int input);
 void s2p_595_shift_edge(struct s2p_595 *s2p);
@@ -22,4 +44,18 @@ void s2p_595_reset(struct s2p_595 *s2p);
 void s2p_595_disable_output(struct s2p_595 *s2p);
 void s2p_595_enable_output(struct s2p_595 *s2p);
 
+/*
+ * Warm restart restore
+ *
+ * The latched image is kept in memory which survives software resets,
+ * so that outputs can be restored right after a warm reboot, long
+ * before the first orders are computed. Only one chain is supported,
+ * and the image must be forgotten when the hardware configuration
+ * changes, as it is restored before the configuration is loaded.
+ */
+void s2p_595_persist(struct s2p_595 *s2p);
+void s2p_595_forget(void);
+bool s2p_595_restore(struct s2p_595 *s2p);
+void s2p_595_get_restore_stats(struct s2p_595_restore_stats *stats);
+
 #endif /* S2P_595 */
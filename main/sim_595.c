@@ -0,0 +1,74 @@
+#include <string.h>
+
+#include "sim_595.h"
+
+/***************************************************************************/
+
+static void sim_595_shift(struct sim_595 *sim)
+{
+    // Q7' of each chip feeds the serial input of the next one
+    for (int c = sim->chips - 1; c >= 0; c--)
+    {
+        uint8_t in = (c == 0) ? sim->serial_in : (sim->shift[c - 1] >> 7);
+        sim->shift[c] = (uint8_t)(sim->shift[c] << 1) | in;
+    }
+    sim->shifts++;
+}
+
+/***************************************************************************/
+
+void sim_595_init(struct sim_595 *sim, int chips, uint8_t pin_serial_in, uint8_t pin_shift_clock, uint8_t pin_latch_clock, uint8_t pin_reset, uint8_t pin_output_enable)
+{
+    memset(sim, 0, sizeof(struct sim_595));
+    sim->chips = (chips > SIM_595_MAX_CHIPS) ? SIM_595_MAX_CHIPS : chips;
+    sim->pin_serial_in = pin_serial_in;
+    sim->pin_shift_clock = pin_shift_clock;
+    sim->pin_latch_clock = pin_latch_clock;
+    sim->pin_reset = pin_reset;
+    sim->pin_output_enable = pin_output_enable;
+    sim->reset = 1;
+    sim->output_enable = 1;
+}
+
+void sim_595_pin(struct sim_595 *sim, uint8_t pin, uint8_t value)
+{
+    value = value ? 1 : 0;
+
+    if (pin == sim->pin_serial_in)
+    {
+        sim->serial_in = value;
+    }
+    else if (pin == sim->pin_shift_clock)
+    {
+        // shift registers are held cleared while reset is active
+        if (value && !sim->shift_clock && sim->reset)
+            sim_595_shift(sim);
+        sim->shift_clock = value;
+    }
+    else if (pin == sim->pin_latch_clock)
+    {
+        if (value && !sim->latch_clock)
+        {
+            memcpy(sim->latched, sim->shift, sizeof(sim->latched));
+            sim->latches++;
+        }
+        sim->latch_clock = value;
+    }
+    else if (pin == sim->pin_reset)
+    {
+        if (!value)
+            memset(sim->shift, 0, sizeof(sim->shift));
+        sim->reset = value;
+    }
+    else if (pin == sim->pin_output_enable)
+    {
+        sim->output_enable = value;
+    }
+}
+
+bool sim_595_output(const struct sim_595 *sim, int bit)
+{
+    if (bit < 0 || bit >= sim->chips * 8)
+        return false;
+    return (sim->latched[bit / 8] >> (bit % 8)) & 1;
+}
\ No newline at end of file
@@ -0,0 +1,47 @@
+#ifndef SIM_595_H
+#define SIM_595_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Model of a chain of 74HC595 shift registers
+ *
+ * Fed with the pin changes seen by the chain (for example replayed from a
+ * vcd_capture), it shifts on serial clock rising edges, clears on reset low
+ * and copies the shift registers to the outputs on latch clock rising edges,
+ * so that latched outputs can be compared with what was meant to be sent.
+ *
+ * Bit 0 is the output Q0 of the first chip (the one wired to the ESP32),
+ * the last bit shifted in.
+ *
+ * This file does not depend on ESP-IDF, so that it can be built on a host.
+ */
+
+#define SIM_595_MAX_CHIPS 32
+
+struct sim_595
+{
+    uint8_t pin_serial_in;
+    uint8_t pin_shift_clock;
+    uint8_t pin_latch_clock;
+    uint8_t pin_reset;
+    uint8_t pin_output_enable;
+    int chips;
+    // last level of each pin above
+    uint8_t serial_in, shift_clock, latch_clock, reset, output_enable;
+    uint8_t shift[SIM_595_MAX_CHIPS];
+    uint8_t latched[SIM_595_MAX_CHIPS];
+    uint32_t shifts;
+    uint32_t latches;
+};
+
+/* starts with every register cleared, reset inactive and outputs disabled */
+void sim_595_init(struct sim_595 *sim, int chips, uint8_t pin_serial_in, uint8_t pin_shift_clock, uint8_t pin_latch_clock, uint8_t pin_reset, uint8_t pin_output_enable);
+
+/* changes of other pins are ignored */
+void sim_595_pin(struct sim_595 *sim, uint8_t pin, uint8_t value);
+
+bool sim_595_output(const struct sim_595 *sim, int bit);
+
+#endif /* SIM_595_H */
\ No newline at end of file
@@ -7,6 +7,7 @@
 
 #include "str.h"
 #include "storage.h"
+#include "trace.h"
 
 static const char TAG[] = "storage";
 
@@ -69,6 +70,7 @@ static const char ns_ofp_ac[] = "ofp_ac";
 
 static char ns_ofp_hw[NVS_NS_NAME_MAX_SIZE] = {0};
 static char ns_ofp_zn[NVS_NS_NAME_MAX_SIZE] = {0};
+static char ns_ofp_zp[NVS_NS_NAME_MAX_SIZE] = {0};
 static char ns_ofp_pl_sl[NVS_NS_NAME_MAX_SIZE] = {0};
 
 bool kv_build_ns_hardware(const char *hw_id, char *buf)
@@ -109,7 +111,26 @@ const char *kv_get_ns_zone(void)
     return ns_ofp_zn;
 }
 
-static bool kv_build_ns_slots_for_planning(int planning_id, char *buf)
+static bool kv_build_ns_zone_power_for_hardware(const char *hw_id, char *buf)
+{
+    int n = snprintf(buf, NVS_NS_NAME_MAX_SIZE, "ofp_zp_%s", hw_id);
+    bool result = (n >= 0 && n < NVS_NS_NAME_MAX_SIZE);
+    if (!result)
+        ESP_LOGW(TAG, "Could not set zone power namespace for hardware %s", hw_id);
+    return result;
+}
+
+bool kv_set_ns_zone_power_for_hardware(const char *hw_id)
+{
+    return kv_build_ns_zone_power_for_hardware(hw_id, ns_ofp_zp);
+}
+
+const char *kv_get_ns_zone_power(void)
+{
+    return ns_ofp_zp;
+}
+
+bool kv_build_ns_slots_for_planning(int planning_id, char *buf)
 {
     int n = snprintf(buf, NVS_NS_NAME_MAX_SIZE, "ofp_sl_%i", planning_id);
     bool result = (n >= 0 && n < NVS_NS_NAME_MAX_SIZE);
@@ -210,24 +231,38 @@ void kv_ns_delete_atomic(const char *ns, const char *key)
     kv_close(handle);
 }
 
-nvs_handle_t kv_open_ns(const char *ns)
+esp_err_t kv_try_open_ns(const char *ns, nvs_handle_t *handle)
 {
     ESP_LOGD(TAG, "Open namespace %s", (ns != NULL) ? ns : null_str);
     assert(ns != NULL);
+    assert(handle != NULL);
     assert(kv_is_ns_len_valid(ns));
+    *handle = 0;
+    esp_err_t err = nvs_open(ns, NVS_READWRITE, handle);
+    ESP_LOGV(TAG, "nvs_open: %s handle %u", esp_err_to_name(err), *handle);
+    return err;
+}
+
+nvs_handle_t kv_open_ns(const char *ns)
+{
     nvs_handle_t handle;
-    esp_err_t err = nvs_open(ns, NVS_READWRITE, &handle);
-    ESP_LOGV(TAG, "nvs_open: %s handle %u", esp_err_to_name(err), handle);
-    ESP_ERROR_CHECK(err);
+    ESP_ERROR_CHECK(kv_try_open_ns(ns, &handle));
     return handle;
 }
 
-void kv_commit(nvs_handle_t handle)
+esp_err_t kv_try_commit(nvs_handle_t handle)
 {
     ESP_LOGD(TAG, "Committing handle %u", handle);
+    TRACE_BEGIN(TRACE_SPAN_NVS_COMMIT);
     esp_err_t err = nvs_commit(handle);
+    TRACE_END(TRACE_SPAN_NVS_COMMIT);
     ESP_LOGV(TAG, "nvs_commit: %s", esp_err_to_name(err));
-    ESP_ERROR_CHECK(err);
+    return err;
+}
+
+void kv_commit(nvs_handle_t handle)
+{
+    ESP_ERROR_CHECK(kv_try_commit(handle));
 }
 
 void kv_close(nvs_handle_t handle)
@@ -236,7 +271,7 @@ void kv_close(nvs_handle_t handle)
     nvs_close(handle);
 }
 
-void kv_delete_key(nvs_handle_t handle, const char *key)
+esp_err_t kv_try_delete_key(nvs_handle_t handle, const char *key)
 {
     assert(key != NULL);
     assert(strlen(key) != 0);
@@ -247,9 +282,14 @@ void kv_delete_key(nvs_handle_t handle, const char *key)
     if (err == ESP_ERR_NVS_NOT_FOUND)
     {
         ESP_LOGV(TAG, "NVS delete key %s not found", key);
-        return;
+        return ESP_OK;
     }
-    ESP_ERROR_CHECK(err);
+    return err;
+}
+
+void kv_delete_key(nvs_handle_t handle, const char *key)
+{
+    ESP_ERROR_CHECK(kv_try_delete_key(handle, key));
 }
 
 void kv_clear(nvs_handle_t handle)
@@ -306,13 +346,18 @@ void kv_set_i32(nvs_handle_t handle, const char *key, int32_t value)
     ESP_ERROR_CHECK(err);
 }
 
-void kv_set_u32(nvs_handle_t handle, const char *key, uint32_t value)
+esp_err_t kv_try_set_u32(nvs_handle_t handle, const char *key, uint32_t value)
 {
     ESP_LOGD(TAG, "kv_set_u32 key=%s value=%u", key, value);
     assert(kv_is_key_len_valid(key));
     esp_err_t err = nvs_set_u32(handle, key, value);
     ESP_LOGV(TAG, "nvs_set_u32 %s", esp_err_to_name(err));
-    ESP_ERROR_CHECK(err);
+    return err;
+}
+
+void kv_set_u32(nvs_handle_t handle, const char *key, uint32_t value)
+{
+    ESP_ERROR_CHECK(kv_try_set_u32(handle, key, value));
 }
 
 void kv_set_i64(nvs_handle_t handle, const char *key, int64_t value)
@@ -333,14 +378,19 @@ void kv_set_u64(nvs_handle_t handle, const char *key, uint64_t value)
     ESP_ERROR_CHECK(err);
 }
 
-void kv_set_str(nvs_handle_t handle, const char *key, const char *value)
+esp_err_t kv_try_set_str(nvs_handle_t handle, const char *key, const char *value)
 {
     ESP_LOGD(TAG, "kv_set_str key=%s value=%s", key, (value != NULL) ? value : null_str);
     assert(value != NULL);
     assert(kv_is_key_len_valid(key));
     esp_err_t err = nvs_set_str(handle, key, value);
     ESP_LOGV(TAG, "nvs_set_str %s", esp_err_to_name(err));
-    ESP_ERROR_CHECK(err);
+    return err;
+}
+
+void kv_set_str(nvs_handle_t handle, const char *key, const char *value)
+{
+    ESP_ERROR_CHECK(kv_try_set_str(handle, key, value));
 }
 
 void kv_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length)
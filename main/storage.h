@@ -23,6 +23,10 @@ const char *kv_get_ns_ofp(void);
 bool kv_set_ns_zone_for_hardware(const char *hw_id);
 const char *kv_get_ns_zone(void);
 
+bool kv_set_ns_zone_power_for_hardware(const char *hw_id);
+const char *kv_get_ns_zone_power(void);
+
+bool kv_build_ns_slots_for_planning(int planning_id, char *buf);
 bool kv_set_ns_slots_for_planning(int planning_id);
 const char *kv_get_ns_slots(void);
 
@@ -63,6 +67,13 @@ void kv_set_u64(nvs_handle_t handle, const char *key, uint64_t value);
 void kv_set_str(nvs_handle_t handle, const char *key, const char *value);
 void kv_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length);
 
+/* same as above, returning errors instead of aborting */
+esp_err_t kv_try_open_ns(const char *ns, nvs_handle_t *handle);
+esp_err_t kv_try_commit(nvs_handle_t handle);
+esp_err_t kv_try_delete_key(nvs_handle_t handle, const char *key);
+esp_err_t kv_try_set_u32(nvs_handle_t handle, const char *key, uint32_t value);
+esp_err_t kv_try_set_str(nvs_handle_t handle, const char *key, const char *value);
+
 int8_t kv_get_i8(nvs_handle_t handle, const char *key, int8_t def_value);
 uint8_t kv_get_u8(nvs_handle_t handle, const char *key, uint8_t def_value);
 int16_t kv_get_i16(nvs_handle_t handle, const char *key, int16_t def_value);
@@ -35,17 +35,29 @@ const char *json_key_value = "value";
 const char *json_key_mode = "mode";
 const char *json_key_plannings = "plannings";
 const char *json_key_orders = "orders";
+const char *json_key_hardware = "hardware";
 const char *json_key_slots = "slots";
 const char *json_key_order = "order";
 const char *json_key_dow = "dow";
 const char *json_key_hour = "hour";
 const char *json_key_minute = "minute";
 const char *json_key_source_ip = "source_ip";
+const char *json_key_operations = "operations";
+const char *json_key_op = "op";
+const char *json_key_zone = "zone";
+const char *json_key_power = "power";
+const char *json_key_planning = "planning";
+const char *json_key_slot = "slot";
+const char *json_key_results = "results";
+const char *json_key_status = "status";
+const char *json_key_error = "error";
 
 const char *json_type_number = "number";
 const char *json_type_string = "string";
 
 const char *stor_key_zone_override = "override";
+const char *stor_key_zone_usage = "zone_usage";
+const char *stor_key_bench = "bench";
 const char *stor_key_id = "id";
 const char *stor_key_name = "name";
 const char *stor_key_class = "class";
@@ -57,6 +69,7 @@ const char *stor_val_none = "none";
 
 const char *http_content_type_html = HTTPD_TYPE_TEXT;
 const char *http_content_type_js = "text/javascript";
+const char *http_content_type_plain = "text/plain";
 const char *http_content_type_json = HTTPD_TYPE_JSON;
 
 const char *str_cache_control = "Cache-Control";
@@ -69,6 +82,9 @@ const char *route_root = "/";
 const char *route_ofp_html = "/ofp.html";
 const char *route_ofp_js = "/ofp.js";
 
+const char *route_api_bootstrap = "^/ofp-api/v([[:digit:]]+)/bootstrap$";
+const char *route_api_batch = "^/ofp-api/v([[:digit:]]+)/batch$";
+
 const char *route_api_hardware = "^/ofp-api/v([[:digit:]]+)/hardware$";
 const char *route_api_hardware_id_parameters = "^/ofp-api/v([[:digit:]]+)/hardware/([[:alnum:]]+)/parameters$";
 
@@ -79,10 +95,13 @@ const char *route_api_orders = "^/ofp-api/v([[:digit:]]+)/orders$";
 const char *route_api_override = "^/ofp-api/v([[:digit:]]+)/override$";
 const char *route_api_zones = "^/ofp-api/v([[:digit:]]+)/zones$";
 const char *route_api_zones_id = "^/ofp-api/v([[:digit:]]+)/zones/([[:alnum:]]+)$";
+const char *route_api_usage = "^/ofp-api/v([[:digit:]]+)/usage$";
+const char *route_api_zones_id_history = "^/ofp-api/v([[:digit:]]+)/zones/([[:alnum:]]+)/history(\\?.*)?$";
 
 const char *route_api_upgrade = "^/ofp-api/v([[:digit:]]+)/upgrade$";
 const char *route_api_status = "^/ofp-api/v([[:digit:]]+)/status$";
 const char *route_api_reboot = "^/ofp-api/v([[:digit:]]+)/reboot$";
+const char *route_api_trace = "^/ofp-api/v([[:digit:]]+)/trace(/chrome)?(\\?.*)?$";
 const char *route_api_certificate = "^/ofp-api/v([[:digit:]]+)/certificate$";
 const char *route_api_certificate_self_signed = "^/ofp-api/v([[:digit:]]+)/certificate/selfsigned$";
 
@@ -91,13 +110,17 @@ const char *route_api_planning_id = "^/ofp-api/v([[:digit:]]+)/plannings/([[:dig
 const char *route_api_planning_id_slots = "^/ofp-api/v([[:digit:]]+)/plannings/([[:digit:]]+)/slots$";
 const char *route_api_planning_id_slots_id = "^/ofp-api/v([[:digit:]]+)/plannings/([[:digit:]]+)/slots/([[:digit:]]+)$";
 
+const char *http_200_hdr = "200 OK";
 const char *http_302_hdr = "302 Found";
+const char *http_400_hdr = "400 Bad Request";
 const char *http_401_hdr = "401 Unauthorized";
+const char *http_409_hdr = "409 Conflict";
 
 const char *http_location_hdr = "Location";
 const char *http_authorization_hdr = "Authorization";
 const char *http_www_authenticate_hdr = "WWW-Authenticate";
 const char *http_content_type_hdr = "Content-Type";
+const char *http_server_timing_hdr = "Server-Timing";
 
 const char *pem_cert_begin = "-----BEGIN CERTIFICATE-----";
 const char *pem_cert_end = "-----END CERTIFICATE-----";
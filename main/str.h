@@ -33,17 +33,29 @@ const char *json_key_value;
 const char *json_key_mode;
 const char *json_key_plannings;
 const char *json_key_orders;
+const char *json_key_hardware;
 const char *json_key_slots;
 const char *json_key_order;
 const char *json_key_dow;
 const char *json_key_hour;
 const char *json_key_minute;
 const char *json_key_source_ip;
+const char *json_key_operations;
+const char *json_key_op;
+const char *json_key_zone;
+const char *json_key_power;
+const char *json_key_planning;
+const char *json_key_slot;
+const char *json_key_results;
+const char *json_key_status;
+const char *json_key_error;
 
 const char *json_type_number;
 const char *json_type_string;
 
 const char *stor_key_zone_override;
+const char *stor_key_zone_usage;
+const char *stor_key_bench;
 const char *stor_key_id;
 const char *stor_key_name;
 const char *stor_key_class;
@@ -55,6 +67,7 @@ const char *stor_val_none;
 
 const char *http_content_type_html;
 const char *http_content_type_js;
+const char *http_content_type_plain;
 const char *http_content_type_json;
 
 const char *str_cache_control;
@@ -67,6 +80,9 @@ const char *route_root;
 const char *route_ofp_html;
 const char *route_ofp_js;
 
+const char *route_api_bootstrap;
+const char *route_api_batch;
+
 const char *route_api_hardware;
 const char *route_api_hardware_id_parameters;
 
@@ -77,10 +93,13 @@ const char *route_api_orders;
 const char *route_api_override;
 const char *route_api_zones;
 const char *route_api_zones_id;
+const char *route_api_zones_id_history;
+const char *route_api_usage;
 
 const char *route_api_upgrade;
 const char *route_api_status;
 const char *route_api_reboot;
+const char *route_api_trace;
 const char *route_api_certificate;
 const char *route_api_certificate_self_signed;
 
@@ -89,13 +108,17 @@ const char *route_api_planning_id;
 const char *route_api_planning_id_slots;
 const char *route_api_planning_id_slots_id;
 
+const char *http_200_hdr;
 const char *http_302_hdr;
+const char *http_400_hdr;
 const char *http_401_hdr;
+const char *http_409_hdr;
 
 const char *http_location_hdr;
 const char *http_authorization_hdr;
 const char *http_www_authenticate_hdr;
 const char *http_content_type_hdr;
+const char *http_server_timing_hdr;
 
 const char *pem_cert_begin;
 const char *pem_cert_end;
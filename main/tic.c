@@ -0,0 +1,196 @@
+#include <string.h>
+
+#include "tic.h"
+
+/* control characters */
+#define TIC_STX 0x02 // start of frame
+#define TIC_ETX 0x03 // end of frame
+#define TIC_EOT 0x04 // frame interrupted
+#define TIC_LF 0x0A  // start of group
+#define TIC_CR 0x0D  // end of group
+
+/* separators */
+#define TIC_SEP_HISTORIC ' '
+#define TIC_SEP_STANDARD '\t'
+
+/***************************************************************************/
+
+static void tic_group_error(struct tic_parser *p, unsigned int *counter)
+{
+    (*counter)++;
+    p->frame_valid = false;
+}
+
+static char tic_checksum(unsigned int sum)
+{
+    return (sum & 0x3F) + 0x20;
+}
+
+/* buffer is "label SEP [timestamp SEP] value SEP checksum" */
+static void tic_end_group(struct tic_parser *p)
+{
+    // shortest is "L SEP SEP C" (empty value)
+    if (p->len < 4)
+    {
+        tic_group_error(p, &p->stats.format_errors);
+        return;
+    }
+
+    char checksum = p->buf[p->len - 1];
+    char sep = p->buf[p->len - 2];
+    unsigned int sum = p->sum - (unsigned char)checksum;
+
+    struct tic_group group = {0};
+    if (sep == TIC_SEP_STANDARD)
+    {
+        // sum includes the separator before the checksum
+        group.mode = TIC_MODE_STANDARD;
+    }
+    else if (sep == TIC_SEP_HISTORIC)
+    {
+        // sum excludes the separator before the checksum
+        group.mode = TIC_MODE_HISTORIC;
+        sum -= (unsigned char)sep;
+    }
+    else
+    {
+        tic_group_error(p, &p->stats.format_errors);
+        return;
+    }
+
+    if (tic_checksum(sum) != checksum)
+    {
+        tic_group_error(p, &p->stats.checksum_errors);
+        return;
+    }
+
+    // split in place, dropping the checksum
+    p->buf[p->len - 2] = '\0';
+    char *label = p->buf;
+    char *first = strchr(label, sep);
+    if (first == NULL || first == label)
+    {
+        tic_group_error(p, &p->stats.format_errors);
+        return;
+    }
+    *first = '\0';
+    group.label = label;
+    group.value = first + 1;
+
+    // standard mode values never contain the separator, historic ones may contain spaces
+    if (group.mode == TIC_MODE_STANDARD)
+    {
+        char *second = strchr(group.value, sep);
+        if (second != NULL)
+        {
+            *second = '\0';
+            group.timestamp = group.value;
+            group.value = second + 1;
+            if (strchr(group.value, sep) != NULL)
+            {
+                tic_group_error(p, &p->stats.format_errors);
+                return;
+            }
+        }
+    }
+
+    p->stats.groups++;
+    if (p->on_group)
+        p->on_group(p->ctx, &group);
+}
+
+static void tic_end_frame(struct tic_parser *p, bool valid)
+{
+    p->stats.frames++;
+    if (!valid)
+        p->stats.invalid_frames++;
+    if (p->on_frame)
+        p->on_frame(p->ctx, valid);
+}
+
+static void tic_process(struct tic_parser *p, char c)
+{
+    // framing characters are handled the same in every state
+    switch (c)
+    {
+    case TIC_STX:
+        // previous frame did not end properly
+        if (p->state != TIC_STATE_WAIT_FRAME)
+            p->stats.interrupted_frames++;
+        p->state = TIC_STATE_WAIT_GROUP;
+        p->frame_valid = true;
+        return;
+
+    case TIC_ETX:
+        if (p->state == TIC_STATE_WAIT_FRAME)
+            return;
+        // unterminated group
+        if (p->state == TIC_STATE_IN_GROUP)
+            tic_group_error(p, &p->stats.format_errors);
+        tic_end_frame(p, p->frame_valid);
+        p->state = TIC_STATE_WAIT_FRAME;
+        return;
+
+    case TIC_EOT:
+        if (p->state != TIC_STATE_WAIT_FRAME)
+            p->stats.interrupted_frames++;
+        p->state = TIC_STATE_WAIT_FRAME;
+        return;
+
+    default:
+        break;
+    }
+
+    switch (p->state)
+    {
+    case TIC_STATE_WAIT_FRAME:
+        return;
+
+    case TIC_STATE_WAIT_GROUP:
+        if (c == TIC_LF)
+        {
+            p->state = TIC_STATE_IN_GROUP;
+            p->len = 0;
+            p->sum = 0;
+        }
+        return;
+
+    case TIC_STATE_IN_GROUP:
+        if (c == TIC_CR)
+        {
+            p->state = TIC_STATE_WAIT_GROUP;
+            tic_end_group(p);
+            return;
+        }
+        if (c == TIC_LF || p->len >= TIC_MAX_GROUP_LEN - 1)
+        {
+            // drop the group, and resynchronize on the next one
+            tic_group_error(p, &p->stats.format_errors);
+            p->state = (c == TIC_LF) ? TIC_STATE_IN_GROUP : TIC_STATE_WAIT_GROUP;
+            p->len = 0;
+            p->sum = 0;
+            return;
+        }
+        p->buf[p->len++] = c;
+        p->sum += (unsigned char)c;
+        return;
+    }
+}
+
+/***************************************************************************/
+
+void tic_init(struct tic_parser *p, tic_group_callback on_group, tic_frame_callback on_frame, void *ctx)
+{
+    memset(p, 0, sizeof(struct tic_parser));
+    p->state = TIC_STATE_WAIT_FRAME;
+    p->on_group = on_group;
+    p->on_frame = on_frame;
+    p->ctx = ctx;
+}
+
+void tic_feed(struct tic_parser *p, const uint8_t *data, size_t len)
+{
+    // 7 bits data, parity bit may not have been stripped
+    for (size_t i = 0; i < len; i++)
+        tic_process(p, data[i] & 0x7F);
+}
\ No newline at end of file
@@ -0,0 +1,83 @@
+#ifndef TIC_H
+#define TIC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Incremental parser for Linky TIC (tele-information client) streams
+ *
+ * Data is fed as received, in chunks of any size. Each byte is processed once :
+ * the checksum is computed on the fly, and fields are split in place, so that
+ * groups are handed to the callback as pointers into the parser buffer,
+ * which are only valid during the call.
+ *
+ * Both historical (space separator) and standard (tab separator, optional
+ * timestamp) modes are supported, the mode being detected on each group.
+ *
+ * This file does not depend on ESP-IDF, so that it can be built on a host
+ * to replay recorded captures.
+ */
+
+// longest standard mode group is around 100 bytes (PJOURF+1)
+#define TIC_MAX_GROUP_LEN 128
+
+enum tic_mode
+{
+    TIC_MODE_UNKNOWN = 0,
+    TIC_MODE_HISTORIC,
+    TIC_MODE_STANDARD,
+};
+
+struct tic_group
+{
+    enum tic_mode mode;
+    const char *label;
+    // NULL if none (historic mode never has one)
+    const char *timestamp;
+    const char *value;
+};
+
+/* called for every group with a valid checksum */
+typedef void (*tic_group_callback)(void *ctx, const struct tic_group *group);
+
+/* called at the end of every frame, valid if none of its groups had errors */
+typedef void (*tic_frame_callback)(void *ctx, bool valid);
+
+struct tic_stats
+{
+    unsigned int frames;
+    unsigned int invalid_frames;
+    unsigned int interrupted_frames;
+    unsigned int groups;
+    unsigned int checksum_errors;
+    unsigned int format_errors;
+};
+
+enum tic_parser_state
+{
+    TIC_STATE_WAIT_FRAME = 0,
+    TIC_STATE_WAIT_GROUP,
+    TIC_STATE_IN_GROUP,
+};
+
+struct tic_parser
+{
+    enum tic_parser_state state;
+    bool frame_valid;
+    // current group, and the sum of its bytes
+    char buf[TIC_MAX_GROUP_LEN];
+    size_t len;
+    unsigned int sum;
+    // callbacks
+    tic_group_callback on_group;
+    tic_frame_callback on_frame;
+    void *ctx;
+    struct tic_stats stats;
+};
+
+void tic_init(struct tic_parser *p, tic_group_callback on_group, tic_frame_callback on_frame, void *ctx);
+void tic_feed(struct tic_parser *p, const uint8_t *data, size_t len);
+
+#endif /* TIC_H */
\ No newline at end of file
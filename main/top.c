@@ -0,0 +1,106 @@
+#include <string.h>
+#include <esp_log.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "sdkconfig.h"
+
+#include "top.h"
+
+static const char TAG[] = "top";
+
+#define TOP_STACK_ROUNDING 256
+
+struct top_stack
+{
+    const char *name;
+    uint32_t size;
+};
+
+/* tasks of the framework */
+static const struct top_stack framework_stacks[] = {
+    {"main", CONFIG_ESP_MAIN_TASK_STACK_SIZE},
+    {"IDLE", CONFIG_FREERTOS_IDLE_TASK_STACKSIZE},
+    {"Tmr Svc", CONFIG_FREERTOS_TIMER_TASK_STACK_DEPTH},
+    {"ipc0", CONFIG_ESP_IPC_TASK_STACK_SIZE},
+    {"ipc1", CONFIG_ESP_IPC_TASK_STACK_SIZE},
+    {"esp_timer", CONFIG_ESP_TIMER_TASK_STACK_SIZE},
+    {"sys_evt", CONFIG_ESP_SYSTEM_EVENT_TASK_STACK_SIZE},
+    {"tiT", CONFIG_LWIP_TCPIP_TASK_STACK_SIZE},
+};
+
+/* global variables */
+static struct top_stack stacks[TOP_MAX_STACKS];
+static int stack_count = 0;
+
+/* mutex variables */
+portMUX_TYPE mutex_top = portMUX_INITIALIZER_UNLOCKED;
+
+/***************************************************************************/
+
+void top_register_stack(const char *name, uint32_t size)
+{
+    bool registered = true;
+    taskENTER_CRITICAL(&mutex_top);
+    int i;
+    for (i = 0; i < stack_count; i++)
+    {
+        if (strcmp(stacks[i].name, name) == 0)
+            break;
+    }
+    if (i < stack_count)
+    {
+        stacks[i].size = size;
+    }
+    else if (stack_count < TOP_MAX_STACKS)
+    {
+        stacks[stack_count].name = name;
+        stacks[stack_count].size = size;
+        stack_count++;
+    }
+    else
+    {
+        registered = false;
+    }
+    taskEXIT_CRITICAL(&mutex_top);
+
+    if (!registered)
+        ESP_LOGW(TAG, "No room to register the stack of task %s", name);
+}
+
+uint32_t top_get_stack_size(const char *name)
+{
+    uint32_t size = 0;
+    taskENTER_CRITICAL(&mutex_top);
+    for (int i = 0; i < stack_count; i++)
+    {
+        if (strcmp(stacks[i].name, name) == 0)
+        {
+            size = stacks[i].size;
+            break;
+        }
+    }
+    taskEXIT_CRITICAL(&mutex_top);
+    if (size != 0)
+        return size;
+
+    for (int i = 0; i < sizeof(framework_stacks) / sizeof(framework_stacks[0]); i++)
+    {
+        if (strcmp(framework_stacks[i].name, name) == 0)
+            return framework_stacks[i].size;
+    }
+    return 0;
+}
+
+uint32_t top_stack_reclaimable(uint32_t size, uint32_t min_free)
+{
+    if (size == 0 || min_free > size || min_free < size / 2)
+        return 0;
+
+    // keep a margin, rounding the suggested size up
+    uint32_t needed = size - min_free + TOP_STACK_MARGIN;
+    needed = (needed + TOP_STACK_ROUNDING - 1) / TOP_STACK_ROUNDING * TOP_STACK_ROUNDING;
+    if (needed >= size || size - needed < TOP_STACK_RECLAIM_MIN)
+        return 0;
+    return size - needed;
+}
\ No newline at end of file
@@ -0,0 +1,32 @@
+#ifndef TOP_H
+#define TOP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Allocated stack size of each task
+ *
+ * FreeRTOS only reports the stack high-water mark of a task, so tasks created
+ * by the firmware register their stack size by name, while the sizes of the
+ * tasks of the framework come from sdkconfig.
+ *
+ * A task is considered over-provisioned when it never used half of its stack,
+ * and more than TOP_STACK_RECLAIM_MIN bytes could be reclaimed while keeping
+ * TOP_STACK_MARGIN bytes free.
+ */
+
+#define TOP_MAX_STACKS 16
+#define TOP_STACK_MARGIN 512
+#define TOP_STACK_RECLAIM_MIN 512
+
+/* name MUST be a string literal (or never freed), as only the pointer is kept */
+void top_register_stack(const char *name, uint32_t size);
+
+/* 0 if unknown */
+uint32_t top_get_stack_size(const char *name);
+
+/* bytes which could be removed from the stack, 0 if not over-provisioned */
+uint32_t top_stack_reclaimable(uint32_t size, uint32_t min_free);
+
+#endif /* TOP_H */
\ No newline at end of file
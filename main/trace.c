@@ -0,0 +1,182 @@
+#include <stdio.h>
+#include <string.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "sdkconfig.h"
+
+#include "trace.h"
+
+static const char *span_names[TRACE_SPAN_ENUM_SIZE] = {
+    [TRACE_SPAN_HTTP_REQUEST] = "http_request",
+    [TRACE_SPAN_HTTP_IP_FILTER] = "http_ip_filter",
+    [TRACE_SPAN_HTTP_AUTH] = "http_auth",
+    [TRACE_SPAN_HTTP_DISPATCH] = "http_dispatch",
+    [TRACE_SPAN_HTTP_HANDLER] = "http_handler",
+    [TRACE_SPAN_HTTP_BODY_READ] = "http_body_read",
+    [TRACE_SPAN_NVS_COMMIT] = "nvs_commit",
+    [TRACE_SPAN_LOOP_ITERATION] = "loop_iteration",
+    [TRACE_SPAN_ORDERS_COMPUTE] = "orders_compute",
+    [TRACE_SPAN_OUTPUT_SUBMIT] = "output_submit",
+    [TRACE_SPAN_OUTPUT_APPLY] = "output_apply",
+};
+
+#ifdef CONFIG_OFP_TRACE
+
+struct trace_entry
+{
+    // record number + 1, 0 while being written
+    uint32_t seq;
+    uint8_t event;
+    uint8_t core;
+    uint16_t task;
+    // full width, 32 bits of microseconds would wrap every 71 minutes
+    int64_t timestamp;
+    int32_t args[TRACE_ARG_COUNT];
+};
+
+/* every format takes TRACE_ARG_COUNT integers, unused ones being ignored */
+static const char *formats[TRACE_EVENT_ENUM_SIZE] = {
+    [TRACE_EVENT_PLANNING_SLOT] = "planning %i slot %i delta %i retained %i",
+    [TRACE_EVENT_PLANNING_ORDER] = "planning %i slot %i order %i",
+    [TRACE_EVENT_ZONE_ORDER] = "zone %i order %i shed %i override %i",
+    [TRACE_EVENT_M1E1_ZONE] = "m1e1 zone %i order %i pos %i neg %i",
+    [TRACE_EVENT_RE_MATCH] = "re_match groups %i result %i length %i",
+    [TRACE_EVENT_TLS_SESSION] = "tls session resumed %i",
+};
+
+/* global variables */
+static struct trace_entry ring[CONFIG_OFP_TRACE_ENTRIES];
+static uint32_t head = 0;
+static uint32_t dumped = 0;
+// recording is suspended while not 0
+static uint32_t suspended = 0;
+
+#endif /* CONFIG_OFP_TRACE */
+
+/***************************************************************************/
+
+void trace_record(enum trace_event event, int32_t a, int32_t b, int32_t c, int32_t d)
+{
+#ifdef CONFIG_OFP_TRACE
+    if (__atomic_load_n(&suspended, __ATOMIC_RELAXED) != 0)
+        return;
+
+    uint32_t n = __atomic_fetch_add(&head, 1, __ATOMIC_RELAXED);
+    struct trace_entry *e = &ring[n % CONFIG_OFP_TRACE_ENTRIES];
+
+    // seqlock writer : readers see the slot as invalid before any data changes
+    __atomic_store_n(&e->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    e->timestamp = esp_timer_get_time();
+    e->event = event;
+    e->core = xPortGetCoreID();
+#ifdef CONFIG_FREERTOS_USE_TRACE_FACILITY
+    e->task = uxTaskGetTaskNumber(xTaskGetCurrentTaskHandle());
+#else
+    e->task = 0;
+#endif /* CONFIG_FREERTOS_USE_TRACE_FACILITY */
+    e->args[0] = a;
+    e->args[1] = b;
+    e->args[2] = c;
+    e->args[3] = d;
+    __atomic_store_n(&e->seq, n + 1, __ATOMIC_RELEASE);
+#endif /* CONFIG_OFP_TRACE */
+}
+
+void trace_suspend(void)
+{
+#ifdef CONFIG_OFP_TRACE
+    __atomic_fetch_add(&suspended, 1, __ATOMIC_RELAXED);
+#endif /* CONFIG_OFP_TRACE */
+}
+
+void trace_resume(void)
+{
+#ifdef CONFIG_OFP_TRACE
+    __atomic_fetch_sub(&suspended, 1, __ATOMIC_RELAXED);
+#endif /* CONFIG_OFP_TRACE */
+}
+
+void trace_scope_end(enum trace_span *span)
+{
+    trace_record(TRACE_EVENT_SPAN_END, *span, 0, 0, 0);
+}
+
+const char *trace_span_name(enum trace_span span)
+{
+    if (span < 0 || span >= TRACE_SPAN_ENUM_SIZE)
+        return "unknown";
+    return span_names[span];
+}
+
+void trace_format(const struct trace_event_data *record, char *buf, size_t len)
+{
+#ifdef CONFIG_OFP_TRACE
+    if (record->event == TRACE_EVENT_SPAN_BEGIN || record->event == TRACE_EVENT_SPAN_END)
+        snprintf(buf, len, "%s %s", record->event == TRACE_EVENT_SPAN_BEGIN ? "begin" : "end", trace_span_name(record->args[0]));
+    else
+        snprintf(buf, len, formats[record->event], record->args[0], record->args[1], record->args[2], record->args[3]);
+#else
+    snprintf(buf, len, "event %i", record->event);
+#endif /* CONFIG_OFP_TRACE */
+}
+
+void trace_export(trace_event_callback callback, void *ctx, bool clear)
+{
+#ifdef CONFIG_OFP_TRACE
+    uint32_t end = __atomic_load_n(&head, __ATOMIC_ACQUIRE);
+    uint32_t start = __atomic_load_n(&dumped, __ATOMIC_RELAXED);
+    if (end - start > CONFIG_OFP_TRACE_ENTRIES)
+        start = end - CONFIG_OFP_TRACE_ENTRIES;
+
+    for (uint32_t n = start; n != end; n++)
+    {
+        // seqlock reader : skip entries being written, or overwritten while copied
+        struct trace_entry *slot = &ring[n % CONFIG_OFP_TRACE_ENTRIES];
+        if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != n + 1)
+            continue;
+        struct trace_entry e = *slot;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) != n + 1)
+            continue;
+        if (e.event >= TRACE_EVENT_ENUM_SIZE)
+            continue;
+
+        struct trace_event_data record = {
+            .timestamp = e.timestamp,
+            .event = e.event,
+            .core = e.core,
+            .task = e.task,
+        };
+        memcpy(record.args, e.args, sizeof(record.args));
+        if (!callback(ctx, &record))
+            return;
+    }
+
+    if (clear)
+        __atomic_store_n(&dumped, end, __ATOMIC_RELAXED);
+#endif /* CONFIG_OFP_TRACE */
+}
+
+struct trace_dump_ctx
+{
+    trace_line_callback callback;
+    void *ctx;
+};
+
+static bool trace_dump_record(void *ctx, const struct trace_event_data *record)
+{
+    struct trace_dump_ctx *d = ctx;
+    char line[TRACE_LINE_MAX_LEN];
+    int len = snprintf(line, sizeof(line), "%10lli %u ", record->timestamp, record->core);
+    trace_format(record, line + len, sizeof(line) - len);
+    return d->callback(d->ctx, line);
+}
+
+void trace_dump(trace_line_callback callback, void *ctx, bool clear)
+{
+    struct trace_dump_ctx d = {.callback = callback, .ctx = ctx};
+    trace_export(trace_dump_record, &d, clear);
+}
\ No newline at end of file
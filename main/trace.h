@@ -0,0 +1,122 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sdkconfig.h"
+
+/*
+ * Binary trace log for hot paths
+ *
+ * Recording an event only stores its id, a timestamp and up to 4 integers in
+ * a lock-free ring (slots are claimed with an atomic increment, and published
+ * with a sequence number once written), so that it can be called from the
+ * control loop or request handlers without distorting their timing.
+ * Formatting only happens when the ring is dumped.
+ *
+ * Spans are a pair of begin and end events, recorded with the task and the
+ * core they ran on, so that the ring can be exported as a timeline.
+ *
+ * TRACE and spans do nothing if OFP_TRACE is disabled
+ */
+
+#define TRACE_ARG_COUNT 4
+#define TRACE_LINE_MAX_LEN 128
+
+/* add the format of new events in trace.c */
+enum trace_event
+{
+    TRACE_EVENT_PLANNING_SLOT = 0,
+    TRACE_EVENT_PLANNING_ORDER,
+    TRACE_EVENT_ZONE_ORDER,
+    TRACE_EVENT_M1E1_ZONE,
+    TRACE_EVENT_RE_MATCH,
+    TRACE_EVENT_TLS_SESSION,
+    // first argument is the span
+    TRACE_EVENT_SPAN_BEGIN,
+    TRACE_EVENT_SPAN_END,
+    TRACE_EVENT_ENUM_SIZE
+};
+
+/* add the name of new spans in trace.c */
+enum trace_span
+{
+    TRACE_SPAN_HTTP_REQUEST = 0,
+    TRACE_SPAN_HTTP_IP_FILTER,
+    TRACE_SPAN_HTTP_AUTH,
+    TRACE_SPAN_HTTP_DISPATCH,
+    TRACE_SPAN_HTTP_HANDLER,
+    TRACE_SPAN_HTTP_BODY_READ,
+    TRACE_SPAN_NVS_COMMIT,
+    TRACE_SPAN_LOOP_ITERATION,
+    TRACE_SPAN_ORDERS_COMPUTE,
+    TRACE_SPAN_OUTPUT_SUBMIT,
+    TRACE_SPAN_OUTPUT_APPLY,
+    TRACE_SPAN_ENUM_SIZE
+};
+
+/* a recorded event, as given to trace_export callbacks */
+struct trace_event_data
+{
+    // microseconds since boot
+    int64_t timestamp;
+    enum trace_event event;
+    int core;
+    // FreeRTOS task number, 0 if unknown
+    int task;
+    int32_t args[TRACE_ARG_COUNT];
+};
+
+#ifdef CONFIG_OFP_TRACE
+#define TRACE(event, a, b, c, d) trace_record(event, a, b, c, d)
+#define TRACE_BEGIN(span) trace_record(TRACE_EVENT_SPAN_BEGIN, span, 0, 0, 0)
+#define TRACE_END(span) trace_record(TRACE_EVENT_SPAN_END, span, 0, 0, 0)
+// ends the span when leaving the enclosing block, whatever the return path
+#define TRACE_SCOPE(span) \
+    __attribute__((cleanup(trace_scope_end))) enum trace_span trace_scope_##span = (TRACE_BEGIN(span), span)
+#else
+#define TRACE(event, a, b, c, d) \
+    do                           \
+    {                            \
+    } while (0)
+#define TRACE_BEGIN(span) \
+    do                    \
+    {                     \
+    } while (0)
+#define TRACE_END(span) \
+    do                  \
+    {                   \
+    } while (0)
+#define TRACE_SCOPE(span) \
+    do                    \
+    {                     \
+    } while (0)
+#endif /* CONFIG_OFP_TRACE */
+
+void trace_record(enum trace_event event, int32_t a, int32_t b, int32_t c, int32_t d);
+void trace_scope_end(enum trace_span *span);
+
+const char *trace_span_name(enum trace_span span);
+
+/* events are dropped from suspend to resume, calls can be nested */
+void trace_suspend(void);
+void trace_resume(void);
+
+/* called for each formatted line, oldest first, return false to stop */
+typedef bool (*trace_line_callback)(void *ctx, const char *line);
+
+/* formats every event still in the ring, then forgets them if clear is set */
+void trace_dump(trace_line_callback callback, void *ctx, bool clear);
+
+/* called for each event, oldest first, return false to stop */
+typedef bool (*trace_event_callback)(void *ctx, const struct trace_event_data *record);
+
+/* same as trace_dump, without formatting */
+void trace_export(trace_event_callback callback, void *ctx, bool clear);
+
+/* formats the event itself, without timestamp nor core */
+void trace_format(const struct trace_event_data *record, char *buf, size_t len);
+
+#endif /* TRACE_H */
\ No newline at end of file
@@ -7,21 +7,27 @@
 #include "freertos/task.h"
 #include "esp_system.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 
 #include "str.h"
 #include "uptime.h"
+#include "top.h"
 
 static const char TAG[] = "uptime";
 
+#define UPTIME_TASK_STACK_SIZE 2048
+
 /* global variables */
 static time_t system_start = 0;
 static time_t last_time = 0;
 static struct uptime_wifi wifi_stats = {0};
+static int64_t wifi_connected_us = 0;
 
 /* mutex variables */
 portMUX_TYPE mutex_uptime_system_start = portMUX_INITIALIZER_UNLOCKED;
 portMUX_TYPE mutex_uptime_last_time = portMUX_INITIALIZER_UNLOCKED;
 portMUX_TYPE mutex_uptime_last_connect = portMUX_INITIALIZER_UNLOCKED;
+portMUX_TYPE mutex_uptime_reconnect = portMUX_INITIALIZER_UNLOCKED;
 
 /* calculate corrected system uptime */
 time_t uptime_get_time(void)
@@ -77,33 +83,19 @@ bool uptime_sync_check(void)
 /* corrects system_time_start upon SNTP synchronization */
 void uptime_sync_task(void *pvParameter)
 {
-    UBaseType_t min = 0xFFFF, max = -1, cur;
-
     for (;;)
     {
         uptime_sync_check();
         vTaskDelay(pdMS_TO_TICKS(UPTIME_LOOP_WAIT_MILLISECONDS));
-        cur = uxTaskGetStackHighWaterMark(NULL);
-        if (cur < min)
-        {
-            min = cur;
-            ESP_LOGD(TAG, "StackHighWaterMark min changed: cur=%i, max=%i, min=%i", cur, max, min);
-        }
-        if (cur > max)
-        {
-            max = cur;
-            ESP_LOGD(TAG, "StackHighWaterMark max changed: cur=%i, max=%i, min=%i", cur, max, min);
-        }
     }
 }
 
 /* starts compensation task */
 void uptime_sync_start(void)
 {
-    // TODO: reduce stack size to maximum possible
-    // I (1548) uptime: StackHighWaterMark min changed: cur=1360, max=-1, min=1360
-    // I (2548) uptime: StackHighWaterMark min changed: cur=432, max=-1, min=432
-    xTaskCreatePinnedToCore(uptime_sync_task, "leap", 2048, NULL, 1, NULL, 1);
+    // stack usage is reported by the 'top' console command
+    top_register_stack("leap", UPTIME_TASK_STACK_SIZE);
+    xTaskCreatePinnedToCore(uptime_sync_task, "leap", UPTIME_TASK_STACK_SIZE, NULL, 1, NULL, 1);
 }
 
 /* computes actual uptime in seconds */
@@ -147,6 +139,12 @@ void uptime_track_wifi_success(void)
     taskENTER_CRITICAL(&mutex_uptime_last_connect);
     wifi_stats.last_connect_time = now;
     taskEXIT_CRITICAL(&mutex_uptime_last_connect);
+
+    /* critical section for wifi_connected_us */
+    int64_t connected = esp_timer_get_time();
+    taskENTER_CRITICAL(&mutex_uptime_reconnect);
+    wifi_connected_us = connected;
+    taskEXIT_CRITICAL(&mutex_uptime_reconnect);
 }
 
 void uptime_track_wifi_disconnect(void)
@@ -155,6 +153,11 @@ void uptime_track_wifi_disconnect(void)
 
     wifi_stats.disconnects++;
 
+    /* critical section for wifi_connected_us */
+    taskENTER_CRITICAL(&mutex_uptime_reconnect);
+    wifi_connected_us = 0;
+    taskEXIT_CRITICAL(&mutex_uptime_reconnect);
+
     /* critical section for wifi_stats.last_connect_time */
     taskENTER_CRITICAL(&mutex_uptime_last_connect);
     time_t tmp = wifi_stats.last_connect_time;
@@ -174,4 +177,26 @@ void uptime_track_wifi_disconnect(void)
 
     wifi_stats.cumulated_uptime += delta;
     ESP_LOGV(TAG, "delta %li", delta);
-}
\ No newline at end of file
+}
+
+/* measures the latency of the first request served after each connection */
+void uptime_track_request_served(void)
+{
+    int64_t now = esp_timer_get_time();
+    int latency = -1;
+
+    /* critical section for wifi_connected_us and reconnect latencies */
+    taskENTER_CRITICAL(&mutex_uptime_reconnect);
+    if (wifi_connected_us != 0)
+    {
+        latency = (now - wifi_connected_us) / 1000;
+        wifi_connected_us = 0;
+        wifi_stats.reconnect_latency_last_ms = latency;
+        if (latency > wifi_stats.reconnect_latency_max_ms)
+            wifi_stats.reconnect_latency_max_ms = latency;
+    }
+    taskEXIT_CRITICAL(&mutex_uptime_reconnect);
+
+    if (latency >= 0)
+        ESP_LOGI(TAG, "First request served %i ms after wifi connection", latency);
+}
@@ -13,6 +13,9 @@ struct uptime_wifi
     int attempts;
     int successes;
     int disconnects;
+    // from connection to first served request, in milliseconds
+    int reconnect_latency_last_ms;
+    int reconnect_latency_max_ms;
 };
 
 /* return corrected system uptime */
@@ -32,5 +35,6 @@ const struct uptime_wifi *uptime_get_wifi_stats(void);
 void uptime_track_wifi_attempt(void);
 void uptime_track_wifi_success(void);
 void uptime_track_wifi_disconnect(void);
+void uptime_track_request_served(void);
 
 #endif /* UPTIME_H */
\ No newline at end of file
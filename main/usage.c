@@ -0,0 +1,291 @@
+#include <stdlib.h>
+#include <string.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "sdkconfig.h"
+
+#include "str.h"
+#include "ofp.h"
+#include "storage.h"
+#include "usage.h"
+#include "top.h"
+
+static const char TAG[] = "usage";
+
+// 2: heater power moved to the zone settings
+#define USAGE_BLOB_VERSION 2
+#define USAGE_US_PER_SECOND 1000000LL
+#define USAGE_TASK_STACK_SIZE 3072
+
+// clock is considered synchronized from this year on
+#define USAGE_MIN_VALID_YEAR 2022
+
+/* persisted as a single blob, followed by zone_count struct usage_zone */
+struct usage_blob_header
+{
+    uint32_t version;
+    uint32_t zone_count;
+    // identifies the current period of each kind, 0 if unknown
+    int32_t keys[USAGE_PERIOD_ENUM_SIZE];
+};
+
+/* run in progress, not persisted */
+struct usage_run
+{
+    bool running;
+    enum ofp_order_id order;
+    int64_t since_us;
+};
+
+static const char *period_names[USAGE_PERIOD_ENUM_SIZE] = {
+    [USAGE_PERIOD_DAY] = "day",
+    [USAGE_PERIOD_WEEK] = "week",
+    [USAGE_PERIOD_MONTH] = "month",
+};
+
+/* global variables */
+static struct usage_blob_header header = {.version = USAGE_BLOB_VERSION};
+static struct usage_zone *zones = NULL;
+static struct usage_run *runs = NULL;
+static TaskHandle_t save_task = NULL;
+
+/* mutex variables */
+portMUX_TYPE mutex_usage = portMUX_INITIALIZER_UNLOCKED;
+
+/***************************************************************************/
+
+/* days since 1970-01-01 of a civil date */
+static int32_t usage_days_from_civil(int year, int month, int day)
+{
+    year -= month <= 2;
+    int era = (year >= 0 ? year : year - 399) / 400;
+    int yoe = year - era * 400;
+    int doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+static void usage_compute_keys(struct tm *timeinfo, int32_t keys[USAGE_PERIOD_ENUM_SIZE])
+{
+    int year = timeinfo->tm_year + 1900;
+    int32_t days = usage_days_from_civil(year, timeinfo->tm_mon + 1, timeinfo->tm_mday);
+
+    // 1970-01-01 was a thursday, so that weeks start on monday
+    keys[USAGE_PERIOD_DAY] = days;
+    keys[USAGE_PERIOD_WEEK] = (days + 3) / 7;
+    keys[USAGE_PERIOD_MONTH] = year * 12 + timeinfo->tm_mon;
+}
+
+static void usage_add(struct usage_zone *z, enum ofp_order_id order, uint32_t seconds)
+{
+    for (int p = 0; p < USAGE_PERIOD_ENUM_SIZE; p++)
+        z->current[p][order] += seconds;
+    z->total[order] += seconds;
+}
+
+/* adds the whole seconds of the run in progress, MUST be called with the mutex held */
+static void usage_flush_run(int zone, int64_t now_us)
+{
+    struct usage_run *r = &runs[zone];
+    if (!r->running)
+        return;
+
+    int64_t seconds = (now_us - r->since_us) / USAGE_US_PER_SECOND;
+    if (seconds <= 0)
+        return;
+
+    usage_add(&zones[zone], r->order, seconds);
+    // keep the remaining fraction for later
+    r->since_us += seconds * USAGE_US_PER_SECOND;
+}
+
+static void usage_flush_all(int64_t now_us)
+{
+    for (int i = 0; i < header.zone_count; i++)
+        usage_flush_run(i, now_us);
+}
+
+/* NVS writes are kept out of the control loop */
+static void usage_task(void *pvParameters)
+{
+    while (true)
+    {
+        // woken up early when a period rolled over
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(CONFIG_OFP_USAGE_SAVE_MINUTES * 60 * 1000));
+        usage_save();
+    }
+}
+
+/***************************************************************************/
+
+void usage_init(void)
+{
+    struct ofp_hw *hw = ofp_hw_get_current();
+    if (hw == NULL)
+        return;
+
+    int count = hw->zone_set.count;
+    struct usage_zone *z = calloc(count, sizeof(struct usage_zone));
+    struct usage_run *r = calloc(count, sizeof(struct usage_run));
+    if (z == NULL || r == NULL)
+    {
+        ESP_LOGE(TAG, "Could not allocate accumulators for %i zones", count);
+        free(z);
+        free(r);
+        return;
+    }
+
+    // restore, unless hardware changed
+    struct usage_blob_header h = {.version = USAGE_BLOB_VERSION, .zone_count = count};
+    size_t len = 0;
+    uint8_t *blob = kv_ns_get_blob_atomic(kv_get_ns_ofp(), stor_key_zone_usage, &len);
+    if (blob != NULL)
+    {
+        struct usage_blob_header *stored = (struct usage_blob_header *)blob;
+        if (len == sizeof(h) + count * sizeof(struct usage_zone) && stored->version == USAGE_BLOB_VERSION && stored->zone_count == count)
+        {
+            h = *stored;
+            memcpy(z, blob + sizeof(h), count * sizeof(struct usage_zone));
+            ESP_LOGI(TAG, "Restored accumulators of %i zones", count);
+        }
+        else
+        {
+            ESP_LOGW(TAG, "Ignoring stored accumulators (%u bytes)", len);
+        }
+        free(blob);
+    }
+
+    taskENTER_CRITICAL(&mutex_usage);
+    header = h;
+    zones = z;
+    runs = r;
+    taskEXIT_CRITICAL(&mutex_usage);
+
+    TaskHandle_t xHandle = NULL;
+    top_register_stack("usage", USAGE_TASK_STACK_SIZE);
+    xTaskCreatePinnedToCore(usage_task, "usage", USAGE_TASK_STACK_SIZE, NULL, 1, &xHandle, 0);
+    configASSERT(xHandle);
+    save_task = xHandle;
+}
+
+void usage_zone_order(int zone, enum ofp_order_id order)
+{
+    taskENTER_CRITICAL(&mutex_usage);
+    if (zones != NULL && zone < header.zone_count && (!runs[zone].running || runs[zone].order != order))
+    {
+        int64_t now_us = esp_timer_get_time();
+        usage_flush_run(zone, now_us);
+        runs[zone].running = true;
+        runs[zone].order = order;
+        runs[zone].since_us = now_us;
+    }
+    taskEXIT_CRITICAL(&mutex_usage);
+}
+
+void usage_tick(struct tm *timeinfo)
+{
+    if (zones == NULL)
+        return;
+
+    int64_t now_us = esp_timer_get_time();
+    bool rolled_over = false;
+
+    if (timeinfo->tm_year + 1900 >= USAGE_MIN_VALID_YEAR)
+    {
+        int32_t keys[USAGE_PERIOD_ENUM_SIZE];
+        usage_compute_keys(timeinfo, keys);
+
+        taskENTER_CRITICAL(&mutex_usage);
+        for (int p = 0; p < USAGE_PERIOD_ENUM_SIZE; p++)
+        {
+            if (header.keys[p] == keys[p])
+                continue;
+
+            // first synchronization only starts the period
+            if (header.keys[p] != 0)
+            {
+                usage_flush_all(now_us);
+                for (int i = 0; i < header.zone_count; i++)
+                {
+                    memcpy(zones[i].previous[p], zones[i].current[p], sizeof(zones[i].current[p]));
+                    memset(zones[i].current[p], 0, sizeof(zones[i].current[p]));
+                }
+            }
+            header.keys[p] = keys[p];
+            rolled_over = true;
+        }
+        taskEXIT_CRITICAL(&mutex_usage);
+    }
+
+    // saved by the usage task, as this runs in the control loop
+    if (rolled_over && save_task != NULL)
+        xTaskNotifyGive(save_task);
+}
+
+void usage_save(void)
+{
+    if (zones == NULL)
+        return;
+
+    size_t len = sizeof(struct usage_blob_header) + header.zone_count * sizeof(struct usage_zone);
+    uint8_t *blob = malloc(len);
+    if (blob == NULL)
+    {
+        ESP_LOGW(TAG, "Could not allocate %u bytes to save accumulators", len);
+        return;
+    }
+
+    taskENTER_CRITICAL(&mutex_usage);
+    int64_t now_us = esp_timer_get_time();
+    usage_flush_all(now_us);
+    memcpy(blob, &header, sizeof(struct usage_blob_header));
+    memcpy(blob + sizeof(struct usage_blob_header), zones, header.zone_count * sizeof(struct usage_zone));
+    taskEXIT_CRITICAL(&mutex_usage);
+
+    kv_ns_set_blob_atomic(kv_get_ns_ofp(), stor_key_zone_usage, blob, len);
+    free(blob);
+    ESP_LOGD(TAG, "Saved %u bytes", len);
+}
+
+void usage_reset(void)
+{
+    if (zones == NULL)
+        return;
+
+    taskENTER_CRITICAL(&mutex_usage);
+    int64_t now_us = esp_timer_get_time();
+    for (int i = 0; i < header.zone_count; i++)
+    {
+        memset(&zones[i], 0, sizeof(struct usage_zone));
+        runs[i].since_us = now_us;
+    }
+    taskEXIT_CRITICAL(&mutex_usage);
+
+    ESP_LOGI(TAG, "Accumulators reset");
+    usage_save();
+}
+
+bool usage_get_zone(int zone, struct usage_zone *out)
+{
+    assert(out != NULL);
+
+    bool found = false;
+    taskENTER_CRITICAL(&mutex_usage);
+    if (zones != NULL && zone >= 0 && zone < header.zone_count)
+    {
+        usage_flush_run(zone, esp_timer_get_time());
+        *out = zones[zone];
+        found = true;
+    }
+    taskEXIT_CRITICAL(&mutex_usage);
+    return found;
+}
+
+const char *usage_period_name(enum usage_period period)
+{
+    assert(period >= 0 && period < USAGE_PERIOD_ENUM_SIZE);
+    return period_names[period];
+}
\ No newline at end of file
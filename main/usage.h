@@ -0,0 +1,54 @@
+#ifndef USAGE_H
+#define USAGE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "ofp.h"
+
+/*
+ * Per-zone time spent in each order
+ *
+ * Accumulators are only updated when the order of a zone changes (the run in
+ * progress is added when reading or saving), rolled over when the day, the
+ * week (starting on monday) or the month changes, and saved to NVS in a single
+ * blob by a dedicated task, every OFP_USAGE_SAVE_MINUTES and on roll over.
+ *
+ * Periods only roll over once the clock is synchronized.
+ */
+
+enum usage_period
+{
+    USAGE_PERIOD_DAY = 0,
+    USAGE_PERIOD_WEEK,
+    USAGE_PERIOD_MONTH,
+    USAGE_PERIOD_ENUM_SIZE
+};
+
+/* seconds spent in each order */
+struct usage_zone
+{
+    uint32_t current[USAGE_PERIOD_ENUM_SIZE][HW_OFP_ORDER_ID_ENUM_SIZE];
+    uint32_t previous[USAGE_PERIOD_ENUM_SIZE][HW_OFP_ORDER_ID_ENUM_SIZE];
+    uint32_t total[HW_OFP_ORDER_ID_ENUM_SIZE];
+};
+
+/* zones MUST have been initialized */
+void usage_init(void);
+
+/* called by ofp_zone_update_current_orders, never writes to NVS */
+void usage_zone_order(int zone, enum ofp_order_id order);
+void usage_tick(struct tm *timeinfo);
+
+/* writes accumulators to NVS now, for example before a reboot */
+void usage_save(void);
+
+/* clears every accumulator */
+void usage_reset(void);
+
+bool usage_get_zone(int zone, struct usage_zone *out);
+
+const char *usage_period_name(enum usage_period period);
+
+#endif /* USAGE_H */
\ No newline at end of file
@@ -4,12 +4,15 @@
 #include <string.h>
 #include <esp_log.h>
 #include <esp_random.h>
+#include <esp_heap_caps.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include <mbedtls/base64.h>
 
 #include "str.h"
 #include "utils.h"
+#include "arena.h"
+#include "trace.h"
 
 static const char *TAG = "utils";
 
@@ -60,7 +63,7 @@ void log_regerror(const char *TAG, regex_t *re, int res)
 /* creates a copy of a substring, which MUST BE FREED BY THE CALLER */
 char *substr(const char *src, int offset, int length)
 {
-    char *dest = malloc(length + 1);
+    char *dest = scoped_malloc(length + 1);
     assert(dest != NULL);
     const char *begin = src + offset;
     strncpy(dest, begin, length);
@@ -129,8 +132,6 @@ char *joinstr_nargs(char *sep, int nargs, ...)
  */
 struct re_result *re_match(const char *re_str, const char *str)
 {
-    ESP_LOGV(TAG, "re_str=%s str=%s", re_str, str);
-
     // compile
     regex_t re;
     int res = regcomp(&re, re_str, REG_EXTENDED);
@@ -155,20 +156,19 @@ struct re_result *re_match(const char *re_str, const char *str)
         tmp++;
     }
     nmatch++; // for the whole match
-    ESP_LOGV(TAG, "nmatch=%d", nmatch);
 
     // alloc and zero members
-    regmatch_t *pmatch = calloc(nmatch, sizeof(regmatch_t));
+    regmatch_t *pmatch = scoped_calloc(nmatch, sizeof(regmatch_t));
     assert(pmatch != NULL);
 
     // match
     res = regexec(&re, str, nmatch, pmatch, 0);
-    ESP_LOGV(TAG, "regexec=%d", res);
+    TRACE(TRACE_EVENT_RE_MATCH, nmatch, res, strlen(str), 0);
     if (res != 0)
     {
         if (res != REG_NOMATCH)
             log_regerror(TAG, &re, res);
-        free(pmatch);
+        scoped_free(pmatch);
         regfree(&re);
         return NULL;
     }
@@ -177,7 +177,7 @@ struct re_result *re_match(const char *re_str, const char *str)
     regfree(&re);
 
     // alloc and zero members
-    char **smatch = calloc(nmatch, sizeof(char *)); // smatch is a array of strings (i.e. char *)
+    char **smatch = scoped_calloc(nmatch, sizeof(char *)); // smatch is a array of strings (i.e. char *)
     assert(smatch != NULL);
 
     // extract
@@ -187,18 +187,16 @@ struct re_result *re_match(const char *re_str, const char *str)
         if (m->rm_so == -1)
         {
             smatch[i] = NULL;
-            ESP_LOGV(TAG, "smatch[%d]=NULL", i);
             continue;
         }
         smatch[i] = substr(str, m->rm_so, m->rm_eo - m->rm_so); // MUST BE FREED BY CALLER
-        ESP_LOGV(TAG, "smatch[%d]=%s", i, smatch[i]);
     }
 
     // cleanup
-    free(pmatch);
+    scoped_free(pmatch);
 
     // alloc and zero members
-    struct re_result *out = calloc(1, sizeof(struct re_result));
+    struct re_result *out = scoped_calloc(1, sizeof(struct re_result));
     assert(out != NULL);
 
     // build result
@@ -212,14 +210,13 @@ void re_free(struct re_result *r)
 {
     if (r == NULL) // behave as free() would
         return;
-    if (!r->strings)
-        return;
-    for (int i = 0; i < r->count; i++)
+    if (r->strings)
     {
-        free(r->strings[i]);
+        for (int i = 0; i < r->count; i++)
+            scoped_free(r->strings[i]);
+        scoped_free(r->strings);
     }
-    free(r->strings);
-    free(r);
+    scoped_free(r);
 }
 
 /* safe access and conversion */
@@ -245,9 +242,11 @@ void split_string_free(struct split_result *splits)
         return;
     if (splits->strings != NULL)
     {
-        free(splits->strings);
+        for (int i = 0; i < splits->count; i++)
+            scoped_free(splits->strings[i]);
+        scoped_free(splits->strings);
     }
-    free(splits);
+    scoped_free(splits);
 }
 
 struct split_result *split_string(const char *str, char sep)
@@ -263,7 +262,7 @@ struct split_result *split_string(const char *str, char sep)
     {
         ESP_LOGV(TAG, "split empty src");
         // alloc and zero members
-        struct split_result *empty = calloc(1, sizeof(struct split_result));
+        struct split_result *empty = scoped_calloc(1, sizeof(struct split_result));
         assert(empty != NULL);
         empty->count = 0;
         empty->strings = NULL;
@@ -283,12 +282,12 @@ struct split_result *split_string(const char *str, char sep)
     ESP_LOGV(TAG, "split sep count %i", count);
 
     // alloc and zero members
-    struct split_result *splits = calloc(1, sizeof(struct split_result));
+    struct split_result *splits = scoped_calloc(1, sizeof(struct split_result));
     assert(splits != NULL);
     splits->count = count;
 
     // alloc and zero members
-    splits->strings = calloc(count, sizeof(char *)); // strings is a array of strings (i.e. char *)
+    splits->strings = scoped_calloc(count, sizeof(char *)); // strings is a array of strings (i.e. char *)
     assert(splits->strings != NULL);
 
     // extract
@@ -335,13 +334,13 @@ void form_data_free(struct ofp_form_data *data)
         {
             struct ofp_form_param *param = &data->params[i];
             if (param->name != NULL)
-                free(param->name);
+                scoped_free(param->name);
             if (param->value != NULL)
-                free(param->value);
+                scoped_free(param->value);
         }
-        free(data->params);
+        scoped_free(data->params);
     }
-    free(data);
+    scoped_free(data);
 }
 
 struct ofp_form_data *form_data_parse(const char *data)
@@ -364,7 +363,7 @@ struct ofp_form_data *form_data_parse(const char *data)
     {
         ESP_LOGV(TAG, "form data parse no params");
         // alloc and zero members
-        struct ofp_form_data *out = calloc(1, sizeof(struct ofp_form_data));
+        struct ofp_form_data *out = scoped_calloc(1, sizeof(struct ofp_form_data));
         assert(out != NULL);
         out->count = 0;
         out->params = NULL;
@@ -373,10 +372,10 @@ struct ofp_form_data *form_data_parse(const char *data)
     }
 
     // alloc and zero members
-    struct ofp_form_data *out = calloc(1, sizeof(struct ofp_form_data));
+    struct ofp_form_data *out = scoped_calloc(1, sizeof(struct ofp_form_data));
     assert(out != NULL);
     out->count = 0;
-    out->params = calloc(params_raw->count, sizeof(struct ofp_form_param));
+    out->params = scoped_calloc(params_raw->count, sizeof(struct ofp_form_param));
     assert(out->params != NULL);
 
     // split params into key/value pairs
@@ -409,6 +408,7 @@ struct ofp_form_data *form_data_parse(const char *data)
         if (key_dec == NULL)
         {
             ESP_LOGD(TAG, "Skipping parameter %s: invalid url-encoded name '%s'", param_raw_string, key_enc);
+            re_free(res);
             continue;
         }
         ESP_LOGV(TAG, "form_data key_dec %s", key_dec);
@@ -419,6 +419,8 @@ struct ofp_form_data *form_data_parse(const char *data)
         if (val_dec == NULL)
         {
             ESP_LOGD(TAG, "Skipping parameter '%s': invalid url-encoded value '%s'", param_raw_string, val_enc);
+            scoped_free(key_dec);
+            re_free(res);
             continue;
         }
         ESP_LOGV(TAG, "form_data val_dec %s", val_dec);
@@ -453,7 +455,7 @@ char *form_data_decode_str(const char *str)
 
     // decoded is shorter or as long as encoded source
     // include terminating NULL character
-    char *decoded = malloc(src_len + 1); // MUST be freed by the caller
+    char *decoded = scoped_malloc(src_len + 1); // MUST be freed by the caller
     char *out = decoded;
 
     // conversion statemachine
@@ -496,7 +498,7 @@ char *form_data_decode_str(const char *str)
             if (tmp == -1)
             {
                 ESP_LOGV(TAG, "Percent1 invalid character");
-                free(decoded);
+                scoped_free(decoded);
                 return NULL;
             }
             value = tmp << 4;
@@ -510,7 +512,7 @@ char *form_data_decode_str(const char *str)
             if (tmp == -1)
             {
                 ESP_LOGV(TAG, "Percent2 invalid character");
-                free(decoded);
+                scoped_free(decoded);
                 return NULL;
             }
             value += tmp;
@@ -580,6 +582,17 @@ int hex_char_to_val(const char c)
     return -1;
 }
 
+/* largest free block against total free memory */
+int heap_get_fragmentation(void)
+{
+    size_t free_size = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    if (free_size == 0)
+        return 100;
+
+    size_t largest = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+    return 100 - (int)(largest * 100 / free_size);
+}
+
 /* wait functions */
 void wait_ms(uint32_t ms)
 {
@@ -125,7 +125,7 @@ void log_current_localtime(const char *tag);
 // regex
 void log_regerror(const char *TAG, regex_t *re, int res);
 
-// creates a copy of a substring, which MUST BE FREED BY THE CALLER
+// creates a copy of a substring, which MUST BE FREED BY THE CALLER using scoped_free() from arena.h
 char *substr(const char *src, int offset, int length);
 
 /*
@@ -201,7 +201,7 @@ char *form_data_get_str(struct ofp_form_data *data, const char *name);
 /*
  * Converts a URL-encoded string back to plaintext
  *
- * Returned pointer (if not NULL) MUST BE FREED BY THE CALLER
+ * Returned pointer (if not NULL) MUST BE FREED BY THE CALLER using scoped_free() from arena.h
  */
 char *form_data_decode_str(const char *str);
 
@@ -217,6 +217,12 @@ int hex_char_to_val(const char c);
  */
 bool parse_int(const char *str, int *target);
 
+/*
+ * Heap fragmentation, in percent, comparing the largest free block to the total free memory
+ * 0 means that all free memory is available as a single block
+ */
+int heap_get_fragmentation(void);
+
 /* wait functions */
 void wait_ms(uint32_t ms);
 void wait_sec(uint32_t sec);
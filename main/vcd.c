@@ -0,0 +1,91 @@
+#include <stdio.h>
+
+#include "vcd.h"
+
+#define VCD_LINE_MAX_LEN 64
+
+// printable identifier of a signal
+#define VCD_ID(signal) ((char)('!' + (signal)))
+
+/***************************************************************************/
+
+void vcd_capture_init(struct vcd_capture *c, struct vcd_edge *edges, int max_edges)
+{
+    c->signal_count = 0;
+    c->edges = edges;
+    c->max_edges = max_edges;
+    c->count = 0;
+    c->dropped = 0;
+}
+
+bool vcd_capture_add_signal(struct vcd_capture *c, const char *name, uint8_t pin)
+{
+    if (c->signal_count >= VCD_MAX_SIGNALS)
+        return false;
+
+    struct vcd_signal *s = &c->signals[c->signal_count++];
+    s->name = name;
+    s->pin = pin;
+    s->value = -1;
+    return true;
+}
+
+void vcd_capture_pin(struct vcd_capture *c, uint8_t pin, uint8_t value, uint32_t time_ns)
+{
+    value = value ? 1 : 0;
+    for (int i = 0; i < c->signal_count; i++)
+    {
+        struct vcd_signal *s = &c->signals[i];
+        if (s->pin != pin || s->value == value)
+            continue;
+
+        s->value = value;
+        if (c->count >= c->max_edges)
+        {
+            c->dropped++;
+            continue;
+        }
+        struct vcd_edge *e = &c->edges[c->count++];
+        e->time_ns = time_ns;
+        e->signal = i;
+        e->value = value;
+    }
+}
+
+void vcd_write(const struct vcd_capture *c, vcd_write_callback callback, void *ctx)
+{
+    char line[VCD_LINE_MAX_LEN];
+
+    // header
+    callback(ctx, "$timescale 1ns $end\n$scope module ofp $end\n");
+    for (int i = 0; i < c->signal_count; i++)
+    {
+        snprintf(line, sizeof(line), "$var wire 1 %c %s $end\n", VCD_ID(i), c->signals[i].name);
+        callback(ctx, line);
+    }
+    callback(ctx, "$upscope $end\n$enddefinitions $end\n");
+
+    // levels are unknown until their first edge
+    callback(ctx, "#0\n$dumpvars\n");
+    for (int i = 0; i < c->signal_count; i++)
+    {
+        snprintf(line, sizeof(line), "x%c\n", VCD_ID(i));
+        callback(ctx, line);
+    }
+    callback(ctx, "$end\n");
+
+    // changes, grouped by timestamp
+    uint32_t last_ns = 0;
+    for (int i = 0; i < c->count; i++)
+    {
+        const struct vcd_edge *e = &c->edges[i];
+        if (e->time_ns != last_ns)
+        {
+            snprintf(line, sizeof(line), "#%u\n", e->time_ns);
+            callback(ctx, line);
+            last_ns = e->time_ns;
+        }
+        snprintf(line, sizeof(line), "%u%c\n", e->value, VCD_ID(e->signal));
+        callback(ctx, line);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,55 @@
+#ifndef VCD_H
+#define VCD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Pin edges capture, exported as a Value Change Dump (VCD) for GTKWave
+ *
+ * Only value changes of the tracked pins are recorded, with a timestamp in
+ * nanoseconds since the start of the capture, into a caller-provided array.
+ * Edges which do not fit are counted as dropped.
+ *
+ * This file does not depend on ESP-IDF, so that it can be built on a host.
+ */
+
+#define VCD_MAX_SIGNALS 8
+
+struct vcd_signal
+{
+    const char *name;
+    uint8_t pin;
+    // -1 until the first edge
+    int8_t value;
+};
+
+struct vcd_edge
+{
+    uint32_t time_ns;
+    uint8_t signal;
+    uint8_t value;
+};
+
+struct vcd_capture
+{
+    int signal_count;
+    struct vcd_signal signals[VCD_MAX_SIGNALS];
+    struct vcd_edge *edges;
+    int max_edges;
+    int count;
+    uint32_t dropped;
+};
+
+void vcd_capture_init(struct vcd_capture *c, struct vcd_edge *edges, int max_edges);
+bool vcd_capture_add_signal(struct vcd_capture *c, const char *name, uint8_t pin);
+
+/* records the change of a tracked pin, other pins and unchanged values are ignored */
+void vcd_capture_pin(struct vcd_capture *c, uint8_t pin, uint8_t value, uint32_t time_ns);
+
+/* called for each piece of the dump, in order */
+typedef void (*vcd_write_callback)(void *ctx, const char *text);
+
+void vcd_write(const struct vcd_capture *c, vcd_write_callback callback, void *ctx);
+
+#endif /* VCD_H */
\ No newline at end of file
@@ -1,5 +1,8 @@
 #include <stdio.h>
+#include <unistd.h>
 #include <esp_log.h>
+#include <esp_system.h>
+#include <esp_timer.h>
 #include <esp_https_server.h>
 #include <mbedtls/base64.h>
 
@@ -7,21 +10,201 @@
 #include "webserver.h"
 #include "ofp.h"
 #include "utils.h"
+#include "arena.h"
+#include "json_pool.h"
+#include "heap_profiler.h"
+#include "trace.h"
+#include "uptime.h"
+#include "top.h"
 #include "api_hw.h"
 #include "api_accounts.h"
 #include "api_zones.h"
 #include "api_mgmt.h"
 #include "api_plannings.h"
+#include "api_bootstrap.h"
+#include "api_batch.h"
 #include "storage.h"
 
 static const char TAG[] = "webserver";
 
+// httpd refuses more sessions than lwIP sockets, minus the 3 it uses itself
+#if CONFIG_OFP_UI_WEBSERVER_MAX_SESSIONS > CONFIG_LWIP_MAX_SOCKETS - 3
+#error "OFP_UI_WEBSERVER_MAX_SESSIONS must not exceed LWIP_MAX_SOCKETS minus 3"
+#endif
+
 /* HTTPS server handle */
 static httpd_handle_t *app_server = NULL;
 
 /* flag to enable/disable httpd serving globally */
 static bool serving_enabled = true;
 
+#ifdef CONFIG_OFP_UI_WEBSERVER_REQUEST_ARENA
+/* short-lived request allocations, the httpd task serves a single request at a time */
+static struct arena *request_arena = NULL;
+#endif /* CONFIG_OFP_UI_WEBSERVER_REQUEST_ARENA */
+
+/* session statistics */
+static struct webserver_stats stats = {0};
+
+/* heap before the sessions being closed are freed, only used by the httpd task */
+static size_t heap_free_at_close = 0;
+static int closing_sessions = 0;
+
+/* mutex variables */
+portMUX_TYPE mutex_webserver_stats = portMUX_INITIALIZER_UNLOCKED;
+
+#define WEBSERVER_SERVER_TIMING_MAX_LEN 200
+
+/* phases of a request, reported in the Server-Timing header */
+enum webserver_phase
+{
+    WEBSERVER_PHASE_IP_FILTER = 0,
+    WEBSERVER_PHASE_AUTH,
+    WEBSERVER_PHASE_DISPATCH,
+    WEBSERVER_PHASE_BODY_READ,
+    WEBSERVER_PHASE_HANDLER,
+    WEBSERVER_PHASE_SERIALIZE,
+    WEBSERVER_PHASE_ENUM_SIZE
+};
+
+static const char *phase_names[WEBSERVER_PHASE_ENUM_SIZE] = {
+    [WEBSERVER_PHASE_IP_FILTER] = "ip",
+    [WEBSERVER_PHASE_AUTH] = "auth",
+    [WEBSERVER_PHASE_DISPATCH] = "dispatch",
+    [WEBSERVER_PHASE_BODY_READ] = "read",
+    [WEBSERVER_PHASE_HANDLER] = "handler",
+    [WEBSERVER_PHASE_SERIALIZE] = "serialize",
+};
+
+/*
+ * Timestamps of the request being served
+ *
+ * Requests are served one at a time by the httpd task, so a single instance
+ * is enough. Phase boundaries only record timestamps, the header is rendered
+ * and set once by the send helpers, right before the response goes out : the
+ * handler phase ends there.
+ */
+struct webserver_timing
+{
+    bool active;
+    int64_t dispatch_start_us;
+    int64_t handler_start_us;
+    int64_t durations_us[WEBSERVER_PHASE_ENUM_SIZE];
+    bool measured[WEBSERVER_PHASE_ENUM_SIZE];
+    // how the credentials were checked (no credential cache exists)
+    const char *auth_desc;
+    char header[WEBSERVER_SERVER_TIMING_MAX_LEN];
+};
+
+static bool server_timing_enabled = false;
+static struct webserver_timing timing;
+
+#ifdef CONFIG_OFP_UI_WEBSERVER_REQUIRES_ENCRYPTION
+/* stored HTTPS certificate and key, loaded once as they are only used after a reboot */
+static bool https_loaded = false;
+static char *https_key = NULL;
+static char *https_certs = NULL;
+static size_t https_key_len = 0;
+static size_t https_certs_len = 0;
+#endif /* CONFIG_OFP_UI_WEBSERVER_REQUIRES_ENCRYPTION */
+
+/***************************************************************************/
+
+/* durations are in milliseconds, with microsecond resolution */
+static void webserver_timing_render(void)
+{
+    if (timing.handler_start_us != 0)
+    {
+        int64_t handler_us = esp_timer_get_time() - timing.handler_start_us - timing.durations_us[WEBSERVER_PHASE_BODY_READ] - timing.durations_us[WEBSERVER_PHASE_SERIALIZE];
+        timing.durations_us[WEBSERVER_PHASE_HANDLER] = handler_us > 0 ? handler_us : 0;
+        timing.measured[WEBSERVER_PHASE_HANDLER] = true;
+    }
+
+    size_t len = 0;
+    for (int i = 0; i < WEBSERVER_PHASE_ENUM_SIZE && len < sizeof(timing.header); i++)
+    {
+        if (!timing.measured[i])
+            continue;
+        int64_t us = timing.durations_us[i];
+        len += snprintf(timing.header + len, sizeof(timing.header) - len, "%s%s;dur=%lli.%03lli",
+                        len == 0 ? "" : ", ", phase_names[i], us / 1000, us % 1000);
+        if (i == WEBSERVER_PHASE_AUTH && timing.auth_desc != NULL && len < sizeof(timing.header))
+            len += snprintf(timing.header + len, sizeof(timing.header) - len, ";desc=\"%s\"", timing.auth_desc);
+    }
+}
+
+/* adds the time elapsed since start_us to the phase */
+static void webserver_timing_add(enum webserver_phase phase, int64_t start_us)
+{
+    if (!timing.active)
+        return;
+    timing.durations_us[phase] += esp_timer_get_time() - start_us;
+    timing.measured[phase] = true;
+}
+
+/* renders and sets the header, later phases would not be sent anyway */
+static void webserver_timing_end(httpd_req_t *req)
+{
+    if (!timing.active)
+        return;
+    timing.active = false;
+
+    // the value is only read when the response is sent
+    webserver_timing_render();
+    if (timing.header[0] != '\0')
+        httpd_resp_set_hdr(req, http_server_timing_hdr, timing.header);
+}
+
+static void webserver_timing_begin(void)
+{
+    memset(&timing, 0, sizeof(timing));
+    timing.active = __atomic_load_n(&server_timing_enabled, __ATOMIC_RELAXED);
+}
+
+void webserver_set_server_timing(bool enabled)
+{
+    __atomic_store_n(&server_timing_enabled, enabled, __ATOMIC_RELAXED);
+}
+
+bool webserver_get_server_timing(void)
+{
+    return __atomic_load_n(&server_timing_enabled, __ATOMIC_RELAXED);
+}
+
+esp_err_t webserver_resp_send(httpd_req_t *req, const char *buf, ssize_t len)
+{
+    webserver_timing_end(req);
+    return httpd_resp_send(req, buf, len);
+}
+
+esp_err_t webserver_resp_sendstr(httpd_req_t *req, const char *str)
+{
+    webserver_timing_end(req);
+    return httpd_resp_sendstr(req, str);
+}
+
+esp_err_t webserver_resp_send_chunk(httpd_req_t *req, const char *buf, ssize_t len)
+{
+    webserver_timing_end(req);
+    return httpd_resp_send_chunk(req, buf, len);
+}
+
+esp_err_t webserver_resp_send_err(httpd_req_t *req, httpd_err_code_t error, const char *msg)
+{
+    webserver_timing_end(req);
+    return httpd_resp_send_err(req, error, msg);
+}
+
+esp_err_t webserver_resp_send_404(httpd_req_t *req)
+{
+    return webserver_resp_send_err(req, HTTPD_404_NOT_FOUND, NULL);
+}
+
+esp_err_t webserver_resp_send_500(httpd_req_t *req)
+{
+    return webserver_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, NULL);
+}
+
 /***************************************************************************/
 
 /* template for every API handler */
@@ -29,13 +212,28 @@ typedef esp_err_t (*api_serve_func)(httpd_req_t *req, struct re_result *captures
 
 /***************************************************************************/
 
+static void ofp_session_free(void *ctx)
+{
+    struct ofp_session_context *o = ctx;
+    ESP_LOGV(TAG, "free sess_ctx %p", o);
+    if (o == NULL)
+        return;
+
+    free(o);
+}
+
 static void ofp_session_init_if_needed(httpd_req_t *req)
 {
     if (req->sess_ctx != NULL)
         return;
 
-    req->sess_ctx = calloc(1, sizeof(struct ofp_session_context));
-    ESP_LOGV(TAG, "alloc sess_ctx %p", req->sess_ctx);
+    struct ofp_session_context *o = calloc(1, sizeof(struct ofp_session_context));
+    ESP_LOGV(TAG, "alloc sess_ctx %p", o);
+    if (o == NULL)
+        return;
+
+    req->sess_ctx = o;
+    req->free_ctx = ofp_session_free;
 }
 
 static void ofp_session_set_user_info(httpd_req_t *req, const char *username)
@@ -137,7 +335,7 @@ static esp_err_t serve_from_asm(httpd_req_t *req, const unsigned char *binary_st
     ESP_LOGV(TAG, "Serve_from_asm start %p end %p size %i", binary_start, binary_end, binary_len);
     httpd_resp_set_hdr(req, str_cache_control, str_private_max_age_600);
     httpd_resp_set_type(req, http_content_type);
-    httpd_resp_send(req, (const char *)binary_start, binary_len);
+    webserver_resp_send(req, (const char *)binary_start, binary_len);
     return ESP_OK;
 }
 
@@ -168,19 +366,21 @@ esp_err_t serve_redirect(httpd_req_t *req, char *target)
 {
     httpd_resp_set_status(req, http_302_hdr);
     httpd_resp_set_hdr(req, http_location_hdr, target);
-    httpd_resp_send(req, NULL, 0);
+    webserver_resp_send(req, NULL, 0);
     return ESP_OK;
 }
 
 esp_err_t serve_json(httpd_req_t *req, cJSON *node)
 {
+    int64_t start_us = esp_timer_get_time();
     const char *txt = cJSON_Print(node);
+    webserver_timing_add(WEBSERVER_PHASE_SERIALIZE, start_us);
     ESP_LOGD(TAG, "Serving serialized JSON: %s", txt);
 
     httpd_resp_set_type(req, http_content_type_json);
-    esp_err_t result = httpd_resp_sendstr(req, txt);
+    esp_err_t result = webserver_resp_sendstr(req, txt);
 
-    free((void *)txt); // we are responsible for freeing the rendering buffer
+    cJSON_free((void *)txt); // we are responsible for freeing the rendering buffer
     return result;
 }
 
@@ -200,7 +400,17 @@ static bool api_route_try(esp_err_t *result, httpd_req_t *req, const char *re_st
     struct re_result *captures = re_match(re_str, req->uri);
     if (captures != NULL)
     {
+        heap_profiler_set_route(re_str);
+        if (timing.active)
+        {
+            int64_t now_us = esp_timer_get_time();
+            timing.durations_us[WEBSERVER_PHASE_DISPATCH] = now_us - timing.dispatch_start_us;
+            timing.measured[WEBSERVER_PHASE_DISPATCH] = true;
+            timing.handler_start_us = now_us;
+        }
+        TRACE_BEGIN(TRACE_SPAN_HTTP_HANDLER);
         *result = handler(req, captures);
+        TRACE_END(TRACE_SPAN_HTTP_HANDLER);
         re_free(captures);
         return true;
     }
@@ -213,18 +423,30 @@ static esp_err_t https_handler_get(httpd_req_t *req)
 {
     // redirect root to static content
     if (strcmp(req->uri, route_root) == 0)
+    {
+        heap_profiler_set_route(route_root);
         return serve_redirect(req, (char *)route_ofp_html);
+    }
 
     // static content
     if (strcmp(req->uri, route_ofp_html) == 0)
+    {
+        heap_profiler_set_route(route_ofp_html);
         return serve_static_ofp_html(req);
+    }
 
     if (strcmp(req->uri, route_ofp_js) == 0)
+    {
+        heap_profiler_set_route(route_ofp_js);
         return serve_static_ofp_js(req);
+    }
 
     // api content
     esp_err_t result;
 
+    if (api_route_try(&result, req, route_api_bootstrap, serve_api_get_bootstrap))
+        return result;
+
     if (api_route_try(&result, req, route_api_hardware, serve_api_get_hardware))
         return result;
 
@@ -240,6 +462,12 @@ static esp_err_t https_handler_get(httpd_req_t *req)
     if (api_route_try(&result, req, route_api_zones, serve_api_get_zones))
         return result;
 
+    if (api_route_try(&result, req, route_api_zones_id_history, serve_api_get_zones_id_history))
+        return result;
+
+    if (api_route_try(&result, req, route_api_usage, serve_api_get_usage))
+        return result;
+
     if (api_route_try(&result, req, route_api_override, serve_api_get_override))
         return result;
 
@@ -262,13 +490,19 @@ static esp_err_t https_handler_get(httpd_req_t *req)
     if (api_route_try(&result, req, route_api_reboot, serve_api_get_reboot))
         return result;
 
-    return httpd_resp_send_404(req);
+    if (api_route_try(&result, req, route_api_trace, serve_api_get_trace))
+        return result;
+
+    return webserver_resp_send_404(req);
 }
 
 static esp_err_t https_handler_post(httpd_req_t *req)
 {
     esp_err_t result;
 
+    if (api_route_try(&result, req, route_api_batch, serve_api_post_batch))
+        return result;
+
     if (api_route_try(&result, req, route_api_hardware, serve_api_post_hardware))
         return result;
 
@@ -287,7 +521,7 @@ static esp_err_t https_handler_post(httpd_req_t *req)
     if (api_route_try(&result, req, route_api_planning_id_slots, serve_api_post_plannings_id_slots))
         return result;
 
-    return httpd_resp_send_404(req);
+    return webserver_resp_send_404(req);
 }
 
 static esp_err_t https_handler_put(httpd_req_t *req)
@@ -300,7 +534,10 @@ static esp_err_t https_handler_put(httpd_req_t *req)
     if (api_route_try(&result, req, route_api_certificate_self_signed, serve_api_put_certificate_self_signed))
         return result;
 
-    return httpd_resp_send_404(req);
+    if (api_route_try(&result, req, route_api_planning_id, serve_api_put_plannings_id))
+        return result;
+
+    return webserver_resp_send_404(req);
 }
 
 static esp_err_t https_handler_patch(httpd_req_t *req)
@@ -319,7 +556,7 @@ static esp_err_t https_handler_patch(httpd_req_t *req)
     if (api_route_try(&result, req, route_api_planning_id_slots_id, serve_api_patch_plannings_id_slots_id))
         return result;
 
-    return httpd_resp_send_404(req);
+    return webserver_resp_send_404(req);
 }
 
 static esp_err_t https_handler_delete(httpd_req_t *req)
@@ -338,7 +575,10 @@ static esp_err_t https_handler_delete(httpd_req_t *req)
     if (api_route_try(&result, req, route_api_certificate, serve_api_delete_certificate))
         return result;
 
-    return httpd_resp_send_404(req);
+    if (api_route_try(&result, req, route_api_usage, serve_api_delete_usage))
+        return result;
+
+    return webserver_resp_send_404(req);
 }
 
 /***************************************************************************/
@@ -348,6 +588,7 @@ static bool is_authentication_valid(httpd_req_t *req)
     ESP_LOGV(TAG, "is_authentication_valid");
 
     bool result = false;
+    timing.auth_desc = "malformed";
 
     // cleanup variables
     char *auth_head = NULL;
@@ -356,9 +597,12 @@ static bool is_authentication_valid(httpd_req_t *req)
 
     size_t auth_head_len = 1 + httpd_req_get_hdr_value_len(req, http_authorization_hdr);
     if (auth_head_len <= 1 + 7)
+    {
+        timing.auth_desc = "missing";
         goto cleanup;
+    }
 
-    auth_head = malloc(auth_head_len);
+    auth_head = scoped_malloc(auth_head_len);
     if (auth_head == NULL)
         goto cleanup;
 
@@ -372,7 +616,7 @@ static bool is_authentication_valid(httpd_req_t *req)
     if (res == NULL)
         goto cleanup;
 
-    free(auth_head);
+    scoped_free(auth_head);
     auth_head = NULL;
 
     char *b64e = re_get_string(res, 1);
@@ -382,7 +626,7 @@ static bool is_authentication_valid(httpd_req_t *req)
     if (r != MBEDTLS_ERR_BASE64_BUFFER_TOO_SMALL)
         goto cleanup;
 
-    b64d = malloc(olen + 1);
+    b64d = scoped_malloc(olen + 1);
     if (b64d == NULL)
         goto cleanup;
 
@@ -401,7 +645,7 @@ static bool is_authentication_valid(httpd_req_t *req)
     if (res == NULL)
         goto cleanup;
 
-    free(b64d);
+    scoped_free(b64d);
     b64d = NULL;
 
     char *username = re_get_string(res, 1);
@@ -411,17 +655,21 @@ static bool is_authentication_valid(httpd_req_t *req)
     struct ofp_account *account = ofp_account_list_find_account_by_id(username);
     ESP_LOGV(TAG, "account %p", account);
     if (account == NULL)
+    {
+        timing.auth_desc = "unknown user";
         goto cleanup;
+    }
 
     result = password_verify(account->pass_data, cleartext);
+    timing.auth_desc = result ? "password verified" : "wrong password";
 
     // set flag for admin rights
     ofp_session_set_user_info(req, username);
 
 cleanup:
-    free(b64d);
+    scoped_free(b64d);
     re_free(res);
-    free(auth_head);
+    scoped_free(auth_head);
 
     return result;
 }
@@ -435,7 +683,7 @@ static esp_err_t authentication_reject(httpd_req_t *req)
     if (ret != ESP_OK)
         return ret;
 
-    ret = httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "Not Authorized");
+    ret = webserver_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "Not Authorized");
     ESP_LOGV(TAG, "httpd_resp_send_err %i", ret);
 
     return ret;
@@ -493,26 +741,37 @@ static bool is_source_ip_authorized(httpd_req_t *req)
 
 static esp_err_t https_handler_generic(httpd_req_t *req)
 {
-    // initialize request properties if needed
-    ofp_session_init_if_needed(req);
+    webserver_timing_begin();
 
     // check source ip filter
-    if (!is_source_ip_authorized(req))
-        return httpd_resp_send_err(req, HTTPD_403_FORBIDDEN, "Source IP not allowed");
+    int64_t start_us = esp_timer_get_time();
+    TRACE_BEGIN(TRACE_SPAN_HTTP_IP_FILTER);
+    bool authorized = is_source_ip_authorized(req);
+    TRACE_END(TRACE_SPAN_HTTP_IP_FILTER);
+    webserver_timing_add(WEBSERVER_PHASE_IP_FILTER, start_us);
+    if (!authorized)
+        return webserver_resp_send_err(req, HTTPD_403_FORBIDDEN, "Source IP not allowed");
 
 #ifdef CONFIG_OFP_UI_WEBSERVER_REQUIRES_AUTHENTICATION
     // check credentials
-    if (!is_authentication_valid(req))
+    start_us = esp_timer_get_time();
+    TRACE_BEGIN(TRACE_SPAN_HTTP_AUTH);
+    bool authenticated = is_authentication_valid(req);
+    TRACE_END(TRACE_SPAN_HTTP_AUTH);
+    webserver_timing_add(WEBSERVER_PHASE_AUTH, start_us);
+    if (!authenticated)
         return authentication_reject(req);
 #endif
 
     if (!webserver_is_enabled())
     {
         ESP_LOGW(TAG, "HTTP serving is disabled, skipping request to %s", req->uri);
-        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Service Unavailable");
+        return webserver_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Service Unavailable");
     }
 
-    // handle requests
+    // handle requests, routing included
+    TRACE_SCOPE(TRACE_SPAN_HTTP_DISPATCH);
+    timing.dispatch_start_us = esp_timer_get_time();
     if (req->method == HTTP_GET)
         return https_handler_get(req);
     if (req->method == HTTP_POST)
@@ -525,16 +784,136 @@ static esp_err_t https_handler_generic(httpd_req_t *req)
         return https_handler_delete(req);
 
     // default
-    return httpd_resp_send_404(req);
+    return webserver_resp_send_404(req);
+}
+
+#ifdef CONFIG_OFP_UI_WEBSERVER_REQUIRES_ENCRYPTION
+#ifndef CONFIG_ESP_TLS_SERVER_SESSION_TICKETS
+#warning "ESP_TLS_SERVER_SESSION_TICKETS is disabled, every HTTPS reconnection will make a full TLS handshake"
+#endif /* CONFIG_ESP_TLS_SERVER_SESSION_TICKETS */
+
+/*
+ * Called once the TLS handshake of a new session is done
+ *
+ * esp-tls configures no session-id cache, so sessions are only resumed from
+ * tickets. The server then echoes the session ID sent along the ticket, while
+ * a full handshake issuing a new ticket sends an empty one (mbedTLS 2.x)
+ */
+static void webserver_tls_session_created(esp_https_server_user_cb_arg_t *arg)
+{
+    bool resumed = arg->tls->ssl.session->id_len != 0;
+
+    taskENTER_CRITICAL(&mutex_webserver_stats);
+    if (resumed)
+        stats.tls_resumed_handshakes++;
+    else
+        stats.tls_full_handshakes++;
+    taskEXIT_CRITICAL(&mutex_webserver_stats);
+    TRACE(TRACE_EVENT_TLS_SESSION, resumed, 0, 0, 0);
+
+    ESP_LOGV(TAG, "TLS session %s", resumed ? "resumed" : "created");
+}
+#endif /* CONFIG_OFP_UI_WEBSERVER_REQUIRES_ENCRYPTION */
+
+/* queued on close, so it runs once the httpd task has freed the sessions */
+static void webserver_sessions_closed(void *arg)
+{
+    if (closing_sessions == 0)
+        return;
+
+    size_t free_heap = esp_get_free_heap_size();
+    int per_session = 0;
+    if (free_heap > heap_free_at_close)
+        per_session = (free_heap - heap_free_at_close) / closing_sessions;
+    closing_sessions = 0;
+
+    if (per_session == 0)
+        return;
+
+    taskENTER_CRITICAL(&mutex_webserver_stats);
+    stats.heap_per_session = per_session;
+    taskEXIT_CRITICAL(&mutex_webserver_stats);
+
+    ESP_LOGV(TAG, "closed sessions released %i bytes each", per_session);
+}
+
+/*
+ * Measures the heap used by a session (mostly its TLS context and buffers)
+ *
+ * The httpd task frees the session right after closing its socket, so the
+ * heap released meanwhile is measured by work queued from here
+ */
+static void webserver_session_close(httpd_handle_t hd, int sockfd)
+{
+    if (closing_sessions++ == 0)
+    {
+        heap_free_at_close = esp_get_free_heap_size();
+        if (httpd_queue_work(hd, webserver_sessions_closed, NULL) != ESP_OK)
+            closing_sessions = 0;
+    }
+    close(sockfd);
+}
+
+/* open sessions, and how many would fit in the free heap at the measured size */
+static void webserver_track_sessions(httpd_req_t *req)
+{
+    size_t count = CONFIG_OFP_UI_WEBSERVER_MAX_SESSIONS;
+    int fds[CONFIG_OFP_UI_WEBSERVER_MAX_SESSIONS];
+    if (httpd_get_client_list(req->handle, &count, fds) != ESP_OK)
+        return;
+
+    size_t free_heap = esp_get_free_heap_size();
+
+    taskENTER_CRITICAL(&mutex_webserver_stats);
+    stats.open_sessions = count;
+    if (stats.open_sessions > stats.peak_sessions)
+        stats.peak_sessions = stats.open_sessions;
+    if (stats.heap_per_session > 0)
+        stats.estimated_capacity = count + free_heap / stats.heap_per_session;
+    taskEXIT_CRITICAL(&mutex_webserver_stats);
+
+    ESP_LOGV(TAG, "%u sessions", count);
 }
 
 static esp_err_t https_handler_input_middleware(httpd_req_t *req)
 {
     struct timeval begin, end;
     gettimeofday(&begin, NULL);
+    TRACE_BEGIN(TRACE_SPAN_HTTP_REQUEST);
+
+    // initialize request properties if needed
+    ofp_session_init_if_needed(req);
+
+    webserver_track_sessions(req);
+
+    // short-lived allocations of parsing helpers are drawn from the request arena
+#ifdef CONFIG_OFP_UI_WEBSERVER_REQUEST_ARENA
+    struct arena *arena = request_arena;
+#else
+    struct arena *arena = NULL;
+#endif /* CONFIG_OFP_UI_WEBSERVER_REQUEST_ARENA */
+    if (arena != NULL)
+    {
+        arena_reset(arena);
+        arena_scope_enter(arena);
+    }
+
+    // long-lived session allocations are made before, so that they are not seen as leaks
+    heap_profiler_request_begin();
+    json_pool_request_begin();
 
     esp_err_t result = https_handler_generic(req);
 
+    unsigned int json_allocations = json_pool_request_end();
+
+    // everything allocated by the request is released at once
+    if (arena != NULL)
+    {
+        arena_scope_leave();
+        arena_reset(arena);
+    }
+    heap_profiler_request_end(req->method);
+
     gettimeofday(&end, NULL);
     uint32_t delta_ms = (end.tv_sec - begin.tv_sec) * 1000LL + (end.tv_usec - begin.tv_usec) / 1000LL;
 
@@ -561,7 +940,11 @@ static esp_err_t https_handler_input_middleware(httpd_req_t *req)
         break;
     }
     ESP_LOGD(TAG, "Request duration for %s %s : %u milliseconds", m, req->uri, delta_ms);
+    ESP_LOGD(TAG, "JSON allocations for %s %s : %u", m, req->uri, json_allocations);
+
+    uptime_track_request_served();
 
+    TRACE_END(TRACE_SPAN_HTTP_REQUEST);
     return result;
 }
 
@@ -589,14 +972,37 @@ static void webserver_register_uri_handlers(httpd_handle_t new_server)
 
 /***************************************************************************/
 
+/* tries to load the provided certificate and key from storage, once */
+void webserver_load_certificates(void)
+{
+#ifdef CONFIG_OFP_UI_WEBSERVER_REQUIRES_ENCRYPTION
+    if (https_loaded)
+        return;
+    https_loaded = true;
+
+    https_key = kv_ns_get_blob_atomic(kv_get_ns_ofp(), stor_key_https_key, &https_key_len);
+    https_certs = kv_ns_get_blob_atomic(kv_get_ns_ofp(), stor_key_https_certs, &https_certs_len);
+    if (https_key == NULL || https_certs == NULL)
+    {
+        // incomplete, keep none
+        free(https_key);
+        free(https_certs);
+        https_key = NULL;
+        https_certs = NULL;
+    }
+    ESP_LOGD(TAG, "Stored HTTPS certificate loaded: %s", https_key != NULL ? "yes" : "no");
+#endif /* CONFIG_OFP_UI_WEBSERVER_REQUIRES_ENCRYPTION */
+}
+
 void webserver_start(void)
 {
     httpd_handle_t new_server = NULL;
 
+    // listening on any address, it survives wifi reconnections
     if (app_server)
     {
-        ESP_LOGW(TAG, "Webserver already started, restarting.");
-        webserver_stop();
+        ESP_LOGD(TAG, "Webserver already started, keeping it.");
+        return;
     }
 
     // Start the httpd server
@@ -617,17 +1023,15 @@ void webserver_start(void)
     conf.prvtkey_pem = prvtkey_pem_start;
     conf.prvtkey_len = prvtkey_pem_end - prvtkey_pem_start;
 
-    /* tries to load the provided ones from storage */
-    size_t len_key, len_cert;
-    char *https_key = kv_ns_get_blob_atomic(kv_get_ns_ofp(), stor_key_https_key, &len_key);
-    char *https_certs = kv_ns_get_blob_atomic(kv_get_ns_ofp(), stor_key_https_certs, &len_cert);
+    /* use the provided ones if available */
+    webserver_load_certificates();
     if (https_key != NULL && https_certs != NULL)
     {
         // These need to be null-terminated too
         conf.cacert_pem = (const uint8_t *)https_certs;
         conf.prvtkey_pem = (const uint8_t *)https_key;
-        conf.cacert_len = len_cert;
-        conf.prvtkey_len = len_key;
+        conf.cacert_len = https_certs_len;
+        conf.prvtkey_len = https_key_len;
         ESP_LOGI(TAG, "Trying to use provided HTTPS certificate");
     }
     else
@@ -635,6 +1039,13 @@ void webserver_start(void)
         ESP_LOGW(TAG, "Missing or incomplete stored HTTPS certificate, falling back to certificate compiled in the firmware");
     }
 
+    // resumption avoids a full handshake on reconnection, tickets are stateless for the server
+    // and their encryption key is rotated every ESP_TLS_SERVER_SESSION_TICKET_TIMEOUT seconds
+#ifdef CONFIG_ESP_TLS_SERVER_SESSION_TICKETS
+    conf.session_tickets = true;
+#endif /* CONFIG_ESP_TLS_SERVER_SESSION_TICKETS */
+    conf.user_cb = webserver_tls_session_created;
+
 #else
     conf.port_insecure = CONFIG_OFP_UI_WEBSERVER_INSECURE_PORT;
     conf.transport_mode = HTTPD_SSL_TRANSPORT_INSECURE;
@@ -646,6 +1057,13 @@ void webserver_start(void)
     // use only wildcard matcher to reduce number of handlers
     conf.httpd.uri_match_fn = httpd_uri_match_wildcard;
 
+    // bounded session count, each one using a TLS context and its buffers,
+    // idle sockets (or left open by a lost link) are recycled when new clients come
+    conf.httpd.max_open_sockets = CONFIG_OFP_UI_WEBSERVER_MAX_SESSIONS;
+    conf.httpd.lru_purge_enable = true;
+    conf.httpd.close_fn = webserver_session_close;
+    closing_sessions = 0;
+
     // errors happening here are due to faulty design
     //
     // certificate parsing is not done here, but upon new connection
@@ -660,17 +1078,33 @@ void webserver_start(void)
     // E (20646) esp_https_server: esp_tls_create_server_session failed
     // W (20656) httpd: httpd_accept_conn: session creation failed
     // W (20656) httpd: httpd_server: error accepting new connection
+#ifdef CONFIG_OFP_UI_WEBSERVER_REQUEST_ARENA
+    // kept across restarts, requests fall back to the heap without it
+    if (request_arena == NULL)
+        request_arena = arena_init(CONFIG_OFP_UI_WEBSERVER_REQUEST_ARENA_SIZE);
+#endif /* CONFIG_OFP_UI_WEBSERVER_REQUEST_ARENA */
+
+    top_register_stack("httpd", conf.httpd.stack_size);
     ESP_ERROR_CHECK(httpd_ssl_start(&new_server, &conf));
 
+    taskENTER_CRITICAL(&mutex_webserver_stats);
+    stats.max_sessions = CONFIG_OFP_UI_WEBSERVER_MAX_SESSIONS;
+    taskEXIT_CRITICAL(&mutex_webserver_stats);
+
     // register generic handles
     webserver_register_uri_handlers(new_server);
 
     // persist handle
     app_server = new_server;
+}
 
-    // cleanup
-    free(https_key);
-    free(https_certs);
+void webserver_get_stats(struct webserver_stats *out)
+{
+    assert(out != NULL);
+
+    taskENTER_CRITICAL(&mutex_webserver_stats);
+    *out = stats;
+    taskEXIT_CRITICAL(&mutex_webserver_stats);
 }
 
 void webserver_stop(void)
@@ -683,8 +1117,11 @@ void webserver_stop(void)
     app_server = NULL;
 }
 
-/* received the required amount of data from incoming request body */
-esp_err_t webserver_read_request_data(httpd_req_t *req, char *buf, size_t len)
+/*
+ * received the required amount of data from incoming request body
+ * on failure, an error response has already been sent
+ */
+static esp_err_t webserver_receive_request_data(httpd_req_t *req, char *buf, size_t len)
 {
     assert(req != NULL);
     assert(buf != NULL);
@@ -710,7 +1147,8 @@ esp_err_t webserver_read_request_data(httpd_req_t *req, char *buf, size_t len)
         if (ret == 0)
         {
             ESP_LOGD(TAG, "httpd_req_recv error: connection closed");
-            return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Connection closed");
+            webserver_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Connection closed");
+            return ESP_FAIL;
         }
 
         // timeout
@@ -718,13 +1156,53 @@ esp_err_t webserver_read_request_data(httpd_req_t *req, char *buf, size_t len)
         {
             // do not bother retrying
             ESP_LOGD(TAG, "httpd_req_recv error: connection timeout");
-            return httpd_resp_send_408(req);
+            httpd_resp_send_408(req);
+            return ESP_FAIL;
         }
 
         // In case of error, returning ESP_FAIL will ensure that the underlying socket is closed
         const char *msg = esp_err_to_name(ret);
         ESP_LOGD(TAG, "httpd_req_recv error: %s", msg);
-        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, msg);
+        webserver_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, msg);
+        return ESP_FAIL;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t webserver_read_request_data(httpd_req_t *req, char *buf, size_t len)
+{
+    int64_t start_us = esp_timer_get_time();
+    TRACE_BEGIN(TRACE_SPAN_HTTP_BODY_READ);
+    esp_err_t err = webserver_receive_request_data(req, buf, len);
+    TRACE_END(TRACE_SPAN_HTTP_BODY_READ);
+    webserver_timing_add(WEBSERVER_PHASE_BODY_READ, start_us);
+    return err;
+}
+
+/* streams the incoming request body through a small buffer, block by block */
+esp_err_t webserver_stream_request_data(httpd_req_t *req, char *buf, size_t buf_size, webserver_request_data_consumer consumer, void *ctx)
+{
+    assert(req != NULL);
+    assert(buf != NULL);
+    assert(buf_size > 0);
+    assert(consumer != NULL);
+    ESP_LOGV(TAG, "Streaming %i bytes using %i bytes blocks", req->content_len, buf_size);
+
+    size_t remaining = req->content_len;
+    while (remaining > 0)
+    {
+        size_t len = remaining < buf_size ? remaining : buf_size;
+        esp_err_t res = webserver_read_request_data(req, buf, len);
+        if (res != ESP_OK)
+            return res;
+
+        if (!consumer(ctx, buf, len))
+        {
+            ESP_LOGD(TAG, "Request data consumer aborted");
+            return ESP_ERR_INVALID_ARG;
+        }
+        remaining -= len;
     }
 
     return ESP_OK;
@@ -738,7 +1216,7 @@ esp_err_t webserver_read_request_data(httpd_req_t *req, char *buf, size_t len)
  * Received the required amount of data from incoming request body
  * Dynamically alloc a buff and ADD NULL terminator
  *
- * Memory MUST BE FREED BY CALLER !
+ * Memory MUST BE FREED BY CALLER using scoped_free() !
  */
 char *webserver_get_request_data_atomic_max_size(httpd_req_t *req, const int max_size)
 {
@@ -753,21 +1231,21 @@ char *webserver_get_request_data_atomic_max_size(httpd_req_t *req, const int max
     }
 
     // alloc
-    char *buf = malloc(needed); // add NULL terminator (we process this as string)
+    char *buf = scoped_malloc(needed); // add NULL terminator (we process this as string)
     assert(buf != NULL);
 
     // read
     esp_err_t res = webserver_read_request_data(req, buf, req->content_len);
     if (res != ESP_OK)
     {
-        free(buf);
+        scoped_free(buf);
         ESP_LOGD(TAG, "Could not read request data: %s", esp_err_to_name(res));
         return NULL;
     }
 
     buf[req->content_len] = '\0'; // add NULL terminator
 
-    return buf; // MUST BE FREED BY CALLER
+    return buf; // MUST BE FREED BY CALLER using scoped_free()
 }
 
 /*
@@ -775,7 +1253,7 @@ char *webserver_get_request_data_atomic_max_size(httpd_req_t *req, const int max
  * Same as above, but with implicit
  * Maximum size = CONFIG_OFP_UI_WEBSERVER_DATA_MAX_SIZE_SINGLE_OP
  *
- * Memory MUST BE FREED BY CALLER !
+ * Memory MUST BE FREED BY CALLER using scoped_free() !
  */
 char *webserver_get_request_data_atomic(httpd_req_t *req)
 {
@@ -801,7 +1279,7 @@ struct ofp_form_data *webserver_form_data_from_req(httpd_req_t *req)
 
     // decode
     struct ofp_form_data *data = form_data_parse(buf);
-    free(buf);
+    scoped_free(buf);
     if (data == NULL)
     {
         ESP_LOGD(TAG, "Error parsing x-www-form-urlencoded data");
@@ -7,15 +7,60 @@
 esp_err_t serve_redirect(httpd_req_t *req, char *target);
 esp_err_t serve_json(httpd_req_t *req, cJSON *node);
 
+/* stored certificate and key are read once and kept, as changes require a reboot */
+void webserver_load_certificates(void);
+
 void webserver_start(void);
 void webserver_stop(void);
 
+struct webserver_stats
+{
+    int max_sessions;
+    int open_sessions;
+    int peak_sessions;
+    // heap released by the last closed sessions, and sessions which would fit at that size
+    int heap_per_session;
+    int estimated_capacity;
+    unsigned int tls_full_handshakes;
+    unsigned int tls_resumed_handshakes;
+};
+
+void webserver_get_stats(struct webserver_stats *stats);
+
+/* Server-Timing response header, disabled at boot */
+void webserver_set_server_timing(bool enabled);
+bool webserver_get_server_timing(void);
+
+/*
+ * Same as the httpd_resp_send* functions, but the Server-Timing header is
+ * rendered and set right there, ending the handler phase, as headers go out
+ * with the response (or its first chunk) : handlers MUST use them
+ */
+esp_err_t webserver_resp_send(httpd_req_t *req, const char *buf, ssize_t len);
+esp_err_t webserver_resp_sendstr(httpd_req_t *req, const char *str);
+esp_err_t webserver_resp_send_chunk(httpd_req_t *req, const char *buf, ssize_t len);
+esp_err_t webserver_resp_send_err(httpd_req_t *req, httpd_err_code_t error, const char *msg);
+esp_err_t webserver_resp_send_404(httpd_req_t *req);
+esp_err_t webserver_resp_send_500(httpd_req_t *req);
+
 /* set up flag preventing web server from serving any new request */
 void webserver_disable(void);
 
-/* received the required amount of data from incoming request body */
+/*
+ * received the required amount of data from incoming request body
+ * on failure, an error response has already been sent
+ */
 esp_err_t webserver_read_request_data(httpd_req_t *req, char *buf, size_t len);
 
+/*
+ * Streams the incoming request body through a small caller-provided buffer
+ *
+ * The consumer is called for every received block, and can abort by returning false,
+ * in which case ESP_ERR_INVALID_ARG is returned and no response has been sent yet
+ */
+typedef bool (*webserver_request_data_consumer)(void *ctx, const char *data, size_t len);
+esp_err_t webserver_stream_request_data(httpd_req_t *req, char *buf, size_t buf_size, webserver_request_data_consumer consumer, void *ctx);
+
 /*
  * THIS FUNCTION SHOULD BE USED ONLY EXCEPTIONNALY FOR LARGE BUFFERS
  * Prefer the function below, as most use-cases do not need large buffers
@@ -24,7 +69,7 @@ esp_err_t webserver_read_request_data(httpd_req_t *req, char *buf, size_t len);
  * Received the required amount of data from incoming request body
  * Dynamically alloc a buff and ADD NULL terminator
  *
- * Memory MUST BE FREED BY CALLER !
+ * Memory MUST BE FREED BY CALLER using scoped_free() from arena.h !
  */
 char *webserver_get_request_data_atomic_max_size(httpd_req_t *req, const int max_size);
 
@@ -33,7 +78,7 @@ char *webserver_get_request_data_atomic_max_size(httpd_req_t *req, const int max
  * Same as above, but with implicit
  * Maximum size = CONFIG_OFP_UI_WEBSERVER_DATA_MAX_SIZE_SINGLE_OP
  *
- * Memory MUST BE FREED BY CALLER !
+ * Memory MUST BE FREED BY CALLER using scoped_free() from arena.h !
  */
 char *webserver_get_request_data_atomic(httpd_req_t *req);
 
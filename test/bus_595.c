@@ -0,0 +1,157 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ofp.h"
+#include "hw_m1e1.h"
+#include "sim_595.h"
+#include "vcd.h"
+#include "driver/gpio.h"
+
+/*
+ * Captures the 595 bus of the M1E1 hardware, on the host
+ *
+ * usage: bus_595 [max_boards]
+ *
+ * For 1 to max_boards E1 boards, the M1E1 hardware is initialized, then
+ * every zone gets an order. The pin changes of the apply hook are recorded
+ * into a VCD capture, timed by a virtual clock advancing by the 1 us wait of
+ * each pin change, as on the device. The capture is replayed through the
+ * model of the chain, as the 'bus' console command does, and every latched
+ * output must match the order of its zone. The bus hold time is reported in
+ * virtual nanoseconds.
+ */
+
+#define BUS_595_DEFAULT_MAX_BOARDS 16
+#define BUS_595_MAX_EDGES 4096
+#define BUS_595_ZONES_PER_BOARD 4
+
+/* virtual clock, in nanoseconds */
+static uint32_t now_ns = 0;
+static struct vcd_capture *capture = NULL;
+
+/* pins of ofp.c */
+
+bool ofp_pin_setup_output_no_pull(uint8_t pin)
+{
+    return true;
+}
+
+bool ofp_pin_setup_input_no_pull(uint8_t pin)
+{
+    return true;
+}
+
+void ofp_pin_set_value_wait_1us(uint8_t pin, uint8_t value)
+{
+    if (capture != NULL)
+        vcd_capture_pin(capture, pin, value, now_ns);
+    now_ns += 1000;
+}
+
+esp_err_t gpio_set_level(uint32_t gpio_num, uint32_t level)
+{
+    if (capture != NULL)
+        vcd_capture_pin(capture, gpio_num, level, now_ns);
+    return 0;
+}
+
+/***************************************************************************/
+
+static size_t vcd_size = 0;
+
+static void count_vcd(void *ctx, const char *text)
+{
+    vcd_size += strlen(text);
+}
+
+/* varies along the chain, so that a shifted or swapped bit is noticed */
+static enum ofp_order_id order_of(int zone, int boards)
+{
+    return (enum ofp_order_id)((zone * 3 + boards) % (HW_OFP_ORDER_ID_STANDARD_COZY + 1));
+}
+
+static int run(struct ofp_hw *hw, int boards, struct vcd_edge *edges)
+{
+    ofp_hw_param_find_by_id(hw, "e1_count")->value.int_ = boards;
+    if (!hw->hw_hooks.init(hw))
+    {
+        printf("FAIL: init with %i boards\n", boards);
+        return 1;
+    }
+
+    int zones = hw->zone_set.count;
+    enum ofp_order_id orders[OFP_MAX_ZONE_COUNT];
+    for (int i = 0; i < zones; i++)
+        orders[i] = order_of(i, boards);
+
+    // capture the apply, as the output task does for a probe
+    struct vcd_capture c;
+    const struct s2p_595 *chain = hw_m1e1_get_chain();
+    vcd_capture_init(&c, edges, BUS_595_MAX_EDGES);
+    vcd_capture_add_signal(&c, "SER", chain->pin_serial_in);
+    vcd_capture_add_signal(&c, "SRCLK", chain->pin_shift_clock);
+    vcd_capture_add_signal(&c, "RCLK", chain->pin_latch_clock);
+    vcd_capture_add_signal(&c, "SRCLR", chain->pin_reset);
+    vcd_capture_add_signal(&c, "OE", chain->pin_output_enable);
+    now_ns = 0;
+    capture = &c;
+    hw->hw_hooks.apply(hw, orders, 0);
+    capture = NULL;
+
+    // replay it, outputs already enabled, and reset inactive
+    struct sim_595 sim;
+    sim_595_init(&sim, (zones * 2 + 7) / 8, chain->pin_serial_in, chain->pin_shift_clock, chain->pin_latch_clock, chain->pin_reset, chain->pin_output_enable);
+    sim_595_pin(&sim, chain->pin_output_enable, 0);
+    for (int i = 0; i < c.count; i++)
+        sim_595_pin(&sim, c.signals[c.edges[i].signal].pin, c.edges[i].value);
+
+    int failures = 0;
+    for (int i = 0; i < zones; i++)
+    {
+        bool pos, neg;
+        ofp_order_to_half_waves(orders[i], &pos, &neg, 0);
+        if (sim_595_output(&sim, i * 2) != pos || sim_595_output(&sim, i * 2 + 1) != neg)
+        {
+            printf("FAIL: zone %s latched P=%i N=%i, expected P=%i N=%i\n",
+                   hw->zone_set.zones[i].id, sim_595_output(&sim, i * 2), sim_595_output(&sim, i * 2 + 1), pos, neg);
+            failures++;
+        }
+    }
+    if (c.dropped != 0 || sim.shifts != zones * 2 || sim.latches != 1)
+    {
+        printf("FAIL: %u dropped edges, %u shifts, %u latches\n", c.dropped, sim.shifts, sim.latches);
+        failures++;
+    }
+
+    vcd_size = 0;
+    vcd_write(&c, count_vcd, NULL);
+
+    uint32_t hold_ns = (c.count > 0) ? c.edges[c.count - 1].time_ns - c.edges[0].time_ns : 0;
+    printf("boards=%i zones=%i edges=%i shifts=%u latches=%u bus_hold_ns=%u vcd_bytes=%zu\n",
+           boards, zones, c.count, sim.shifts, sim.latches, hold_ns, vcd_size);
+    return failures;
+}
+
+int main(int argc, char **argv)
+{
+    int max_boards = (argc > 1) ? atoi(argv[1]) : BUS_595_DEFAULT_MAX_BOARDS;
+    if (max_boards < 1 || max_boards * BUS_595_ZONES_PER_BOARD > OFP_MAX_ZONE_COUNT)
+    {
+        printf("usage: %s [max_boards], from 1 to %i\n", argv[0], OFP_MAX_ZONE_COUNT / BUS_595_ZONES_PER_BOARD);
+        return 2;
+    }
+
+    struct vcd_edge *edges = malloc(BUS_595_MAX_EDGES * sizeof(struct vcd_edge));
+    if (edges == NULL)
+        return 2;
+
+    struct ofp_hw *hw = hw_m1e1_get_definition();
+    int failures = 0;
+    for (int boards = 1; boards <= max_boards; boards++)
+        failures += run(hw, boards, edges);
+
+    free(edges);
+    printf("%s\n", failures ? "FAILED" : "OK");
+    return failures ? 1 : 0;
+}
\ No newline at end of file
@@ -0,0 +1,220 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "ofp.h"
+#include "hw_gpio.h"
+#include "pin_map.h"
+#include "soc/gpio_reg.h"
+
+/*
+ * Pin lists and direct-drive GPIO hardware, against mocked registers
+ *
+ * usage: hw_gpio_mock
+ *
+ * The GPIO output register and pin setup are simulated, the ofp helpers
+ * coming from mock/ofp_mock.c. Pin lists must only accept output capable
+ * GPIO, and the hardware must never rewrite the whole output register, only
+ * set and clear its own pins.
+ */
+
+/* simulated registers */
+static uint32_t gpio_out = 0;
+static unsigned int whole_writes = 0;
+// whether the pins set by the last apply were only set after clearing the others
+static unsigned int cleared_after_set = 0;
+static bool set_done = false;
+
+/* pin setup */
+static uint64_t configured_pins = 0;
+static int failing_pin = -1;
+
+void mock_reg_write(uint32_t reg, uint32_t value)
+{
+    switch (reg)
+    {
+    case GPIO_OUT_REG:
+        whole_writes++;
+        gpio_out = value;
+        break;
+
+    case GPIO_OUT_W1TS_REG:
+        gpio_out |= value;
+        set_done = true;
+        break;
+
+    case GPIO_OUT_W1TC_REG:
+        gpio_out &= ~value;
+        if (set_done)
+            cleared_after_set++;
+        break;
+    }
+}
+
+uint32_t mock_reg_read(uint32_t reg)
+{
+    return (reg == GPIO_OUT_REG) ? gpio_out : 0;
+}
+
+/* pin setup of ofp.c */
+
+bool ofp_pin_setup_output_no_pull(uint8_t pin)
+{
+    if (pin == failing_pin)
+        return false;
+    configured_pins |= (1ULL << pin);
+    return true;
+}
+
+/***************************************************************************/
+
+#define CHECK(cond)                                                   \
+    do                                                                \
+    {                                                                 \
+        if (!(cond))                                                  \
+        {                                                             \
+            printf("FAIL: %s (%s:%i)\n", #cond, __FILE__, __LINE__); \
+            failures++;                                               \
+        }                                                             \
+    } while (0)
+
+static int failures = 0;
+
+struct pin_map_case
+{
+    const char *str;
+    bool valid;
+    int count;
+};
+
+static const struct pin_map_case pin_map_cases[] = {
+    {"", true, 0},
+    {"25", true, 1},
+    {"25,26,27", true, 3},
+    {"0,2,4,5,12,13,14,15,16,17,18,19,21,22,23,25,26,27", true, 18},
+    // console UART, SPI flash
+    {"1", false, 0},
+    {"3", false, 0},
+    {"6", false, 0},
+    {"11", false, 0},
+    // not existing on the ESP32
+    {"20", false, 0},
+    {"24", false, 0},
+    {"28", false, 0},
+    {"31", false, 0},
+    // not in the first output register, or input only
+    {"32", false, 0},
+    {"34", false, 0},
+    {"99", false, 0},
+    // malformed
+    {"25,25", false, 0},
+    {"25,", false, 0},
+    {",25", false, 0},
+    {"25,,26", false, 0},
+    {"25 ,26", false, 0},
+    {"-1", false, 0},
+    {"a", false, 0},
+};
+
+static void test_pin_map(void)
+{
+    for (int i = 0; i < sizeof(pin_map_cases) / sizeof(pin_map_cases[0]); i++)
+    {
+        const struct pin_map_case *c = &pin_map_cases[i];
+        uint8_t pins[PIN_MAP_MAX_PINS];
+        int count = -1;
+        bool valid = pin_map_parse(c->str, pins, PIN_MAP_MAX_PINS, &count);
+        if (valid != c->valid || (valid && count != c->count))
+        {
+            printf("FAIL: pin_map_parse('%s') gave %i with %i pins\n", c->str, valid, count);
+            failures++;
+        }
+    }
+
+    // every output pin, one by one
+    for (int pin = 0; pin < PIN_MAP_MAX_PINS; pin++)
+    {
+        char str[4];
+        uint8_t pins[PIN_MAP_MAX_PINS];
+        int count;
+        snprintf(str, sizeof(str), "%i", pin);
+        bool valid = pin_map_parse(str, pins, PIN_MAP_MAX_PINS, &count);
+        CHECK(valid == ((PIN_MAP_OUTPUT_PINS & (1u << pin)) != 0));
+        if (valid)
+            CHECK(pin_map_mask(pins, count) == (1u << pin));
+    }
+
+    // capacity
+    uint8_t pins[2];
+    int count;
+    CHECK(!pin_map_parse("25,26,27", pins, 2, &count));
+}
+
+static bool init_with(struct ofp_hw *hw, const char *pins_pos, const char *pins_neg)
+{
+    snprintf(ofp_hw_param_find_by_id(hw, "pins_pos")->value.string_, OFP_MAX_LEN_VALUE, "%s", pins_pos);
+    snprintf(ofp_hw_param_find_by_id(hw, "pins_neg")->value.string_, OFP_MAX_LEN_VALUE, "%s", pins_neg);
+    configured_pins = 0;
+    return hw->hw_hooks.init(hw);
+}
+
+static void test_init(struct ofp_hw *hw)
+{
+    // mismatched, shared or unusable pins
+    CHECK(!init_with(hw, "25", "26,14"));
+    CHECK(!init_with(hw, "25,27", "27,14"));
+    CHECK(!init_with(hw, "25,20", "26,14"));
+
+    // pin setup failure
+    failing_pin = 14;
+    CHECK(!init_with(hw, "25,27", "26,14"));
+    failing_pin = -1;
+
+    // other pins keep their level
+    gpio_out = (1u << 2) | (1u << 25) | (1u << 14);
+    CHECK(init_with(hw, "25,27", "26,14"));
+    CHECK(hw->zone_set.count == 2);
+    CHECK(strcmp(hw->zone_set.zones[0].id, "D01") == 0);
+    CHECK(strcmp(hw->zone_set.zones[1].id, "D02") == 0);
+    CHECK(configured_pins == ((1ULL << 25) | (1ULL << 26) | (1ULL << 27) | (1ULL << 14)));
+    CHECK(gpio_out == (1u << 2));
+}
+
+static void apply(struct ofp_hw *hw, enum ofp_order_id zone1, enum ofp_order_id zone2)
+{
+    enum ofp_order_id orders[] = {zone1, zone2};
+    set_done = false;
+    cleared_after_set = 0;
+    CHECK(hw->hw_hooks.apply(hw, orders, 0));
+    CHECK(cleared_after_set == 0);
+}
+
+static void test_apply(struct ofp_hw *hw)
+{
+    const uint32_t other = (1u << 2) | (1u << 5);
+    gpio_out |= other;
+
+    // zone 1 on 25 (positive) and 26 (negative), zone 2 on 27 and 14
+    apply(hw, HW_OFP_ORDER_ID_STANDARD_ECONOMY, HW_OFP_ORDER_ID_STANDARD_NOFREEZE);
+    CHECK(gpio_out == (other | (1u << 25) | (1u << 26) | (1u << 14)));
+
+    apply(hw, HW_OFP_ORDER_ID_STANDARD_COZY, HW_OFP_ORDER_ID_STANDARD_OFFLOAD);
+    CHECK(gpio_out == (other | (1u << 27)));
+
+    apply(hw, HW_OFP_ORDER_ID_STANDARD_OFFLOAD, HW_OFP_ORDER_ID_STANDARD_COZY);
+    CHECK(gpio_out == (other | (1u << 25)));
+
+    // never a read-modify-write of the whole register
+    CHECK(whole_writes == 0);
+}
+
+int main(int argc, char **argv)
+{
+    struct ofp_hw *hw = hw_gpio_get_definition();
+
+    test_pin_map();
+    test_init(hw);
+    test_apply(hw);
+
+    printf("%s\n", failures ? "FAILED" : "OK");
+    return failures ? 1 : 0;
+}
\ No newline at end of file
@@ -0,0 +1,6 @@
+#ifndef MOCK_CJSON_H
+#define MOCK_CJSON_H
+
+typedef struct cJSON cJSON;
+
+#endif /* MOCK_CJSON_H */
\ No newline at end of file
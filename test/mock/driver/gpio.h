@@ -0,0 +1,11 @@
+#ifndef MOCK_DRIVER_GPIO_H
+#define MOCK_DRIVER_GPIO_H
+
+#include <stdint.h>
+
+typedef int esp_err_t;
+
+/* provided by the test */
+esp_err_t gpio_set_level(uint32_t gpio_num, uint32_t level);
+
+#endif /* MOCK_DRIVER_GPIO_H */
\ No newline at end of file
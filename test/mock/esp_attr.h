@@ -0,0 +1,6 @@
+#ifndef MOCK_ESP_ATTR_H
+#define MOCK_ESP_ATTR_H
+
+#define RTC_NOINIT_ATTR
+
+#endif /* MOCK_ESP_ATTR_H */
\ No newline at end of file
@@ -0,0 +1,34 @@
+#ifndef MOCK_ESP_LOG_H
+#define MOCK_ESP_LOG_H
+
+#include <stdarg.h>
+#include <stdio.h>
+
+typedef enum
+{
+    ESP_LOG_NONE,
+    ESP_LOG_ERROR,
+    ESP_LOG_WARN,
+    ESP_LOG_INFO,
+    ESP_LOG_DEBUG,
+    ESP_LOG_VERBOSE
+} esp_log_level_t;
+
+/* not format checked : int64_t is long long on the ESP32, but may be long on the host */
+static inline void mock_esp_log(char level, const char *tag, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    printf("%c %s: ", level, tag);
+    vprintf(format, args);
+    printf("\n");
+    va_end(args);
+}
+
+#define ESP_LOGE(tag, format, ...) mock_esp_log('E', tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) mock_esp_log('W', tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) mock_esp_log('I', tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) ((void)(tag))
+#define ESP_LOGV(tag, format, ...) ((void)(tag))
+
+#endif /* MOCK_ESP_LOG_H */
\ No newline at end of file
@@ -0,0 +1,30 @@
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_rom_crc.h"
+
+/*
+ * Minimal versions of the ESP-IDF functions declared in mock/
+ */
+
+esp_reset_reason_t esp_reset_reason(void)
+{
+    return ESP_RST_POWERON;
+}
+
+int64_t esp_timer_get_time(void)
+{
+    static int64_t now = 0;
+    return ++now;
+}
+
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len)
+{
+    crc = ~crc;
+    for (uint32_t i = 0; i < len; i++)
+    {
+        crc ^= buf[i];
+        for (int b = 0; b < 8; b++)
+            crc = (crc >> 1) ^ (0xEDB88320u & -(crc & 1));
+    }
+    return ~crc;
+}
\ No newline at end of file
@@ -0,0 +1,19 @@
+#ifndef MOCK_ESP_SYSTEM_H
+#define MOCK_ESP_SYSTEM_H
+
+typedef enum
+{
+    ESP_RST_UNKNOWN,
+    ESP_RST_POWERON,
+    ESP_RST_EXT,
+    ESP_RST_SW,
+    ESP_RST_PANIC,
+    ESP_RST_INT_WDT,
+    ESP_RST_TASK_WDT,
+    ESP_RST_WDT,
+} esp_reset_reason_t;
+
+/* power-on, unless a test provides another one */
+esp_reset_reason_t esp_reset_reason(void);
+
+#endif /* MOCK_ESP_SYSTEM_H */
\ No newline at end of file
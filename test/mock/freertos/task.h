@@ -0,0 +1,6 @@
+#ifndef MOCK_FREERTOS_TASK_H
+#define MOCK_FREERTOS_TASK_H
+
+#include "FreeRTOS.h"
+
+#endif /* MOCK_FREERTOS_TASK_H */
\ No newline at end of file
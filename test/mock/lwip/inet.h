@@ -0,0 +1,6 @@
+#ifndef MOCK_LWIP_INET_H
+#define MOCK_LWIP_INET_H
+
+#include <arpa/inet.h>
+
+#endif /* MOCK_LWIP_INET_H */
\ No newline at end of file
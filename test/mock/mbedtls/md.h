@@ -0,0 +1,6 @@
+#ifndef MOCK_MBEDTLS_MD_H
+#define MOCK_MBEDTLS_MD_H
+
+typedef int mbedtls_md_type_t;
+
+#endif /* MOCK_MBEDTLS_MD_H */
\ No newline at end of file
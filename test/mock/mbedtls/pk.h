@@ -0,0 +1,6 @@
+#ifndef MOCK_MBEDTLS_PK_H
+#define MOCK_MBEDTLS_PK_H
+
+typedef struct mbedtls_pk_context mbedtls_pk_context;
+
+#endif /* MOCK_MBEDTLS_PK_H */
\ No newline at end of file
@@ -0,0 +1,6 @@
+#ifndef MOCK_MBEDTLS_X509_CRT_H
+#define MOCK_MBEDTLS_X509_CRT_H
+
+typedef struct mbedtls_x509_crt mbedtls_x509_crt;
+
+#endif /* MOCK_MBEDTLS_X509_CRT_H */
\ No newline at end of file
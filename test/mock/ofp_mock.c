@@ -0,0 +1,48 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ofp.h"
+
+/*
+ * Minimal versions of the ofp.c helpers used by the hardware definitions,
+ * pin setup and pin levels being left to each test
+ */
+
+struct ofp_hw_param *ofp_hw_param_find_by_id(struct ofp_hw *hw, const char *param_id)
+{
+    for (int i = 0; i < hw->param_count; i++)
+        if (strcmp(hw->params[i].id, param_id) == 0)
+            return &hw->params[i];
+    return NULL;
+}
+
+bool ofp_zone_set_allocate(struct ofp_zone_set *zone_set, int zone_count)
+{
+    if (zone_count > OFP_MAX_ZONE_COUNT)
+        return false;
+    free(zone_set->zones);
+    zone_set->count = zone_count;
+    zone_set->zones = (zone_count > 0) ? calloc(zone_count, sizeof(struct ofp_zone)) : NULL;
+    return true;
+}
+
+bool ofp_zone_set_id(struct ofp_zone *zone, const char *id)
+{
+    snprintf(zone->id, sizeof(zone->id), "%s", id);
+    return true;
+}
+
+bool ofp_zone_set_description(struct ofp_zone *zone, const char *description)
+{
+    snprintf(zone->description, sizeof(zone->description), "%s", description);
+    return true;
+}
+
+/* standard orders only, same mapping as ofp.c */
+bool ofp_order_to_half_waves(enum ofp_order_id order_id, bool *positive_half, bool *negative_half, int64_t wall_us)
+{
+    *positive_half = (order_id == HW_OFP_ORDER_ID_STANDARD_OFFLOAD || order_id == HW_OFP_ORDER_ID_STANDARD_ECONOMY);
+    *negative_half = (order_id == HW_OFP_ORDER_ID_STANDARD_NOFREEZE || order_id == HW_OFP_ORDER_ID_STANDARD_ECONOMY);
+    return order_id <= HW_OFP_ORDER_ID_STANDARD_COZY;
+}
\ No newline at end of file
@@ -0,0 +1,6 @@
+#ifndef MOCK_SDKCONFIG_H
+#define MOCK_SDKCONFIG_H
+
+/* every optional feature disabled */
+
+#endif /* MOCK_SDKCONFIG_H */
\ No newline at end of file
@@ -0,0 +1,9 @@
+#ifndef MOCK_SOC_GPIO_REG_H
+#define MOCK_SOC_GPIO_REG_H
+
+/* same addresses as the ESP32 */
+#define GPIO_OUT_REG 0x3FF44004
+#define GPIO_OUT_W1TS_REG 0x3FF44008
+#define GPIO_OUT_W1TC_REG 0x3FF4400C
+
+#endif /* MOCK_SOC_GPIO_REG_H */
\ No newline at end of file
@@ -0,0 +1,13 @@
+#ifndef MOCK_SOC_H
+#define MOCK_SOC_H
+
+#include <stdint.h>
+
+/* provided by the test */
+void mock_reg_write(uint32_t reg, uint32_t value);
+uint32_t mock_reg_read(uint32_t reg);
+
+#define REG_WRITE(reg, value) mock_reg_write((reg), (value))
+#define REG_READ(reg) mock_reg_read(reg)
+
+#endif /* MOCK_SOC_H */
\ No newline at end of file
@@ -0,0 +1,141 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "pulse.h"
+
+/*
+ * Drives the pulse schedule with a virtual clock, on the host
+ *
+ * usage: pulse_edges <start_s> <max_latency_us> [periods]
+ *
+ * Zones with cozy-1 and cozy-2 pulses, and constant levels, are latched on
+ * every edge given by pulse_next_edge, each latch happening a pseudo-random
+ * latency after its edge, as the timer task and the output task would. Every
+ * pulse must start on a period boundary and keep its width, both within that
+ * latency, and constant levels must never change.
+ */
+
+#define PULSE_EDGES_DEFAULT_PERIODS 1000
+#define PULSE_EDGES_ZONE_COUNT 4
+
+static const int64_t lengths_us[PULSE_EDGES_ZONE_COUNT] = {
+    3 * 1000000LL,
+    7 * 1000000LL,
+    0,
+    PULSE_PERIOD_US,
+};
+
+struct pulse_edges_zone
+{
+    bool level;
+    int64_t rise_us; // 0 until the first rising edge
+    unsigned int pulses;
+    int64_t max_width_error_us;
+    int64_t max_start_error_us;
+};
+
+static int64_t abs64(int64_t v)
+{
+    return v < 0 ? -v : v;
+}
+
+static int64_t floor_period(int64_t wall_us)
+{
+    int64_t offset = wall_us % PULSE_PERIOD_US;
+    if (offset < 0)
+        offset += PULSE_PERIOD_US;
+    return wall_us - offset;
+}
+
+static int latch(struct pulse_edges_zone *zones, int64_t now_us)
+{
+    int failures = 0;
+    for (int i = 0; i < PULSE_EDGES_ZONE_COUNT; i++)
+    {
+        struct pulse_edges_zone *zone = &zones[i];
+        bool level = pulse_level_at(lengths_us[i], now_us, NULL);
+        if (level == zone->level)
+            continue;
+
+        if (lengths_us[i] <= 0 || lengths_us[i] >= PULSE_PERIOD_US)
+        {
+            printf("FAIL: zone %i with a constant level changed at %lli\n", i, (long long)now_us);
+            failures++;
+        }
+        else if (level)
+        {
+            // the schedule may be latched late, never early
+            int64_t error = now_us - floor_period(now_us);
+            if (error > zone->max_start_error_us)
+                zone->max_start_error_us = error;
+            zone->rise_us = now_us;
+        }
+        else if (zone->rise_us != 0)
+        {
+            int64_t error = abs64(now_us - zone->rise_us - lengths_us[i]);
+            if (error > zone->max_width_error_us)
+                zone->max_width_error_us = error;
+            zone->pulses++;
+        }
+        zone->level = level;
+    }
+    return failures;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        printf("usage: %s <start_s> <max_latency_us> [periods]\n", argv[0]);
+        return 2;
+    }
+
+    int64_t now_us = atoll(argv[1]) * 1000000LL;
+    int64_t max_latency_us = atoll(argv[2]);
+    int periods = (argc > 3) ? atoi(argv[3]) : PULSE_EDGES_DEFAULT_PERIODS;
+    int64_t end_us = now_us + periods * PULSE_PERIOD_US;
+
+    struct pulse_edges_zone zones[PULSE_EDGES_ZONE_COUNT] = {0};
+    for (int i = 0; i < PULSE_EDGES_ZONE_COUNT; i++)
+        zones[i].level = pulse_level_at(lengths_us[i], now_us, NULL);
+
+    // fixed seed, runs are reproducible
+    srand(42);
+    int failures = 0;
+    unsigned int latches = 0;
+    while (now_us < end_us)
+    {
+        int64_t edge_us = pulse_next_edge(lengths_us, PULSE_EDGES_ZONE_COUNT, now_us);
+        if (edge_us <= now_us)
+        {
+            printf("FAIL: next edge %lli is not after %lli\n", (long long)edge_us, (long long)now_us);
+            return 1;
+        }
+
+        now_us = edge_us + (max_latency_us > 0 ? rand() % (max_latency_us + 1) : 0);
+        failures += latch(zones, now_us);
+        latches++;
+    }
+
+    for (int i = 0; i < PULSE_EDGES_ZONE_COUNT; i++)
+    {
+        struct pulse_edges_zone *zone = &zones[i];
+        printf("zone %i (%lli us): %u pulses, start error up to %lli us, width error up to %lli us\n",
+               i, (long long)lengths_us[i], zone->pulses, (long long)zone->max_start_error_us, (long long)zone->max_width_error_us);
+
+        bool pulsed = lengths_us[i] > 0 && lengths_us[i] < PULSE_PERIOD_US;
+        if (pulsed && zone->pulses + 1 < (unsigned int)periods)
+        {
+            printf("FAIL: expected at least %i pulses\n", periods - 1);
+            failures++;
+        }
+        if (zone->max_start_error_us > max_latency_us || zone->max_width_error_us > max_latency_us)
+        {
+            printf("FAIL: expected errors up to %lli us\n", (long long)max_latency_us);
+            failures++;
+        }
+    }
+    printf("%u latches over %i periods\n", latches, periods);
+
+    return failures ? 1 : 0;
+}
\ No newline at end of file
@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "tic.h"
+
+/*
+ * Replays a recorded TIC capture through the parser, on the host
+ *
+ * usage: tic_replay <capture> <frames> <invalid_frames> <interrupted_frames> [passes]
+ *
+ * The capture is first fed byte by byte, then in chunks the size of the linky
+ * task read buffer : both must give the expected frame counts. It is then
+ * replayed 'passes' times to report the parser throughput in frames per second.
+ */
+
+#define TIC_REPLAY_CHUNK_SIZE 64
+#define TIC_REPLAY_DEFAULT_PASSES 10000
+
+static unsigned int replay(const uint8_t *data, size_t len, size_t chunk, int passes, struct tic_stats *stats)
+{
+    struct tic_parser parser;
+    tic_init(&parser, NULL, NULL, NULL);
+
+    for (int i = 0; i < passes; i++)
+        for (size_t pos = 0; pos < len; pos += chunk)
+            tic_feed(&parser, data + pos, (len - pos < chunk) ? len - pos : chunk);
+
+    *stats = parser.stats;
+    return parser.stats.frames;
+}
+
+static int check(const char *name, const struct tic_stats *stats, unsigned int frames, unsigned int invalid, unsigned int interrupted)
+{
+    printf("%s: %u frames, %u invalid, %u interrupted, %u groups, %u checksum errors, %u format errors\n",
+           name, stats->frames, stats->invalid_frames, stats->interrupted_frames, stats->groups, stats->checksum_errors, stats->format_errors);
+
+    if (stats->frames == frames && stats->invalid_frames == invalid && stats->interrupted_frames == interrupted)
+        return 0;
+
+    printf("FAIL: expected %u frames, %u invalid, %u interrupted\n", frames, invalid, interrupted);
+    return 1;
+}
+
+static uint8_t *load(const char *path, size_t *len)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL)
+        return NULL;
+
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    uint8_t *data = malloc(size > 0 ? size : 1);
+    if (data != NULL && fread(data, 1, size, f) != (size_t)size)
+    {
+        free(data);
+        data = NULL;
+    }
+    fclose(f);
+
+    *len = size;
+    return data;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 5)
+    {
+        printf("usage: %s <capture> <frames> <invalid_frames> <interrupted_frames> [passes]\n", argv[0]);
+        return 2;
+    }
+
+    size_t len = 0;
+    uint8_t *data = load(argv[1], &len);
+    if (data == NULL)
+    {
+        printf("Could not read %s\n", argv[1]);
+        return 2;
+    }
+
+    unsigned int frames = atoi(argv[2]);
+    unsigned int invalid = atoi(argv[3]);
+    unsigned int interrupted = atoi(argv[4]);
+    int passes = (argc > 5) ? atoi(argv[5]) : TIC_REPLAY_DEFAULT_PASSES;
+
+    // results must not depend on how data is split
+    int failures = 0;
+    struct tic_stats stats;
+    replay(data, len, 1, 1, &stats);
+    failures += check("byte by byte", &stats, frames, invalid, interrupted);
+    replay(data, len, TIC_REPLAY_CHUNK_SIZE, 1, &stats);
+    failures += check("chunked", &stats, frames, invalid, interrupted);
+
+    // throughput
+    struct timespec begin, end;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    unsigned int total = replay(data, len, TIC_REPLAY_CHUNK_SIZE, passes, &stats);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double seconds = (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) / 1e9;
+    printf("%u frames (%zu bytes per pass, %i passes) in %.3f s: %.0f frames/s, %.1f MB/s\n",
+           total, len, passes, seconds, seconds > 0 ? total / seconds : 0, seconds > 0 ? len * (double)passes / seconds / 1e6 : 0);
+
+    free(data);
+    return failures ? 1 : 0;
+}
\ No newline at end of file